@@ -214,6 +214,19 @@ public:
     return false;
   }
 
+  /// hook to provide cumulative io accounting, in the spirit of the
+  /// io_ticks/time_in_queue fields of /proc/diskstats:
+  ///  busy_ns:     time during which at least one io was in flight
+  ///  weighted_ns: time integral of the number of ios in flight
+  ///  completed:   number of completed ios
+  ///  inflight:    number of ios currently in flight
+  virtual bool get_io_stats(uint64_t *busy_ns, uint64_t *weighted_ns,
+			    uint64_t *completed, uint64_t *inflight) const {
+    return false;
+  }
+  /// the io accounting is off until a consumer of get_io_stats() asks for it
+  virtual void enable_io_stats(bool enable) {}
+
   virtual int collect_metadata(const std::string& prefix, std::map<std::string,std::string> *pm) const = 0;
 
   virtual int get_devname(std::string *out) const {
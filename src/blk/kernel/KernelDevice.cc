@@ -12,6 +12,7 @@
  *
  */
 
+#include <algorithm>
 #include <limits>
 #include <unistd.h>
 #include <stdlib.h>
@@ -412,6 +413,57 @@ bool KernelDevice::get_thin_utilization(uint64_t *total, uint64_t *avail) const
   return get_vdo_utilization(vdo_fd, total, avail);
 }
 
+void KernelDevice::_io_stats_advance() const
+{
+  ceph_assert(ceph_mutex_is_locked(io_stats_lock));
+  auto now = ceph::mono_clock::now();
+  if (io_inflight) {
+    uint64_t dt = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      now - io_stats_stamp).count();
+    io_busy_ns += dt;
+    io_weighted_ns += dt * io_inflight;
+  }
+  io_stats_stamp = now;
+}
+
+void KernelDevice::_io_stats_submit(uint64_t n)
+{
+  std::lock_guard l(io_stats_lock);
+  _io_stats_advance();
+  io_inflight += n;
+}
+
+void KernelDevice::_io_stats_complete(uint64_t n)
+{
+  std::lock_guard l(io_stats_lock);
+  _io_stats_advance();
+  ceph_assert(io_inflight >= n);
+  io_inflight -= n;
+  io_completed += n;
+}
+
+bool KernelDevice::get_io_stats(uint64_t *busy_ns, uint64_t *weighted_ns,
+				uint64_t *completed, uint64_t *inflight) const
+{
+  if (!io_stats_enabled) {
+    return false;
+  }
+  std::lock_guard l(io_stats_lock);
+  _io_stats_advance();
+  *busy_ns = io_busy_ns;
+  *weighted_ns = io_weighted_ns;
+  *completed = io_completed;
+  *inflight = io_inflight;
+  return true;
+}
+
+void KernelDevice::enable_io_stats(bool enable)
+{
+  dout(10) << __func__ << " " << enable << dendl;
+  // the aios submitted before are still taken out when they complete
+  io_stats_enabled = enable;
+}
+
 int KernelDevice::choose_fd(bool buffered, int write_hint) const
 {
   assert(write_hint >= WRITE_LIFE_NOT_SET && write_hint < WRITE_LIFE_MAX);
@@ -557,6 +609,10 @@ void KernelDevice::_aio_thread()
     }
     if (r > 0) {
       dout(30) << __func__ << " got " << r << " completed aios" << dendl;
+      if (int n = std::count_if(aio, aio + r,
+				[](aio_t *a) { return a->io_stats; }); n) {
+	_io_stats_complete(n);
+      }
       for (int i = 0; i < r; ++i) {
 	IOContext *ioc = static_cast<IOContext*>(aio[i]->priv);
 	_aio_log_finish(ioc, aio[i]->offset, aio[i]->length);
@@ -814,6 +870,12 @@ void KernelDevice::aio_submit(IOContext *ioc)
   int r, retries = 0;
   // num of pending aios should not overflow when passed to submit_batch()
   assert(pending <= std::numeric_limits<uint16_t>::max());
+  if (io_stats_enabled.load(std::memory_order_relaxed)) {
+    for (auto p = ioc->running_aios.begin(); p != e; ++p) {
+      p->io_stats = true;
+    }
+    _io_stats_submit(pending);
+  }
   r = io_queue->submit_batch(ioc->running_aios.begin(), e,
 			     pending, priv, &retries);
 
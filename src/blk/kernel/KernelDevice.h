@@ -78,6 +78,19 @@ class KernelDevice : public BlockDevice {
 
   std::atomic_int injecting_crash;
 
+  // aio accounting, see BlockDevice::get_io_stats()
+  std::atomic<bool> io_stats_enabled = false;
+  mutable ceph::mutex io_stats_lock =
+    ceph::make_mutex("KernelDevice::io_stats_lock");
+  mutable ceph::mono_clock::time_point io_stats_stamp;
+  mutable uint64_t io_busy_ns = 0;
+  mutable uint64_t io_weighted_ns = 0;
+  uint64_t io_completed = 0;
+  uint64_t io_inflight = 0;
+  void _io_stats_advance() const;  // call with io_stats_lock held
+  void _io_stats_submit(uint64_t n);
+  void _io_stats_complete(uint64_t n);
+
   void _aio_thread();
   void _discard_thread();
   int queue_discard(interval_set<uint64_t> &to_release) override;
@@ -125,6 +138,9 @@ public:
   int get_devices(std::set<std::string> *ls) const override;
 
   bool get_thin_utilization(uint64_t *total, uint64_t *avail) const override;
+  bool get_io_stats(uint64_t *busy_ns, uint64_t *weighted_ns,
+		    uint64_t *completed, uint64_t *inflight) const override;
+  void enable_io_stats(bool enable) override;
 
   int read(uint64_t off, uint64_t len, ceph::buffer::list *pbl,
 	   IOContext *ioc,
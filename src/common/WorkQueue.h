@@ -595,6 +595,8 @@ public:
     virtual ~BaseShardedWQ() {}
 
     virtual void _process(uint32_t thread_index, ceph::heartbeat_handle_d *hb ) = 0;
+    /// called by each thread of the pool when it starts
+    virtual void _thread_start(uint32_t thread_index) {}
     virtual void return_waiting_threads() = 0;
     virtual void stop_return_waiting_threads() = 0;
     virtual bool is_shard_empty(uint32_t thread_index) = 0;
@@ -53,6 +53,13 @@ void mempool::dump(ceph::Formatter *f)
   }
   f->close_section();
   f->dump_object("total", total);
+  f->open_object_section("object_caches");
+  for (auto cache : get_object_caches()) {
+    f->open_object_section(ceph_demangle(cache->get_type().name()).c_str());
+    cache->dump(f);
+    f->close_section();
+  }
+  f->close_section();
   f->close_section();
 }
 
@@ -135,3 +142,126 @@ void mempool::pool_t::dump(ceph::Formatter *f, stats_t *ptotal) const
     f->close_section();
   }
 }
+
+// --------------------------------------------------------------
+// object_cache_t
+
+namespace {
+
+std::mutex object_caches_lock;
+
+std::vector<mempool::object_cache_t *>& object_caches()
+{
+  static auto caches = new std::vector<mempool::object_cache_t *>;
+  return *caches;
+}
+
+// the objects cached by a thread, by cache
+struct thread_caches_t {
+  std::vector<std::vector<void *>> lists;
+  ~thread_caches_t() {
+    mempool::object_cache_t::flush_thread();
+  }
+};
+thread_local thread_caches_t thread_caches;
+
+} // anonymous namespace
+
+std::vector<mempool::object_cache_t *> mempool::get_object_caches()
+{
+  std::lock_guard l(object_caches_lock);
+  return object_caches();
+}
+
+mempool::object_cache_t::object_cache_t(
+  const std::type_info& type,
+  size_t max_central,
+  void (*release)(void *))
+  : type(type), max_central(max_central), release(release)
+{
+  std::lock_guard l(object_caches_lock);
+  index = object_caches().size();
+  object_caches().push_back(this);
+}
+
+std::vector<void *>& mempool::object_cache_t::thread_list()
+{
+  auto& lists = thread_caches.lists;
+  if (lists.size() <= index) {
+    lists.resize(index + 1);
+  }
+  return lists[index];
+}
+
+void *mempool::object_cache_t::get()
+{
+  auto& list = thread_list();
+  auto& s = stats[pool_t::pick_a_shard_int()];
+  if (list.empty()) {
+    std::lock_guard l(lock);
+    size_t n = std::min(batch, central.size());
+    list.insert(list.end(), central.end() - n, central.end());
+    central.resize(central.size() - n);
+  }
+  if (list.empty()) {
+    ++s.misses;
+    return nullptr;
+  }
+  ++s.hits;
+  void *p = list.back();
+  list.pop_back();
+  return p;
+}
+
+void mempool::object_cache_t::put(void *p)
+{
+  auto& list = thread_list();
+  list.push_back(p);
+  if (list.size() >= 2 * batch) {
+    give_back(list, batch);
+  }
+}
+
+void mempool::object_cache_t::give_back(std::vector<void *>& list, size_t n)
+{
+  auto first = list.end() - n;
+  {
+    std::lock_guard l(lock);
+    size_t keep = std::min(n, max_central - std::min(max_central,
+						     central.size()));
+    central.insert(central.end(), first, first + keep);
+    first += keep;
+  }
+  for (auto i = first; i != list.end(); ++i) {
+    release(*i);
+  }
+  list.resize(list.size() - n);
+}
+
+void mempool::object_cache_t::flush_thread()
+{
+  auto& lists = thread_caches.lists;
+  for (auto cache : get_object_caches()) {
+    if (cache->index < lists.size()) {
+      auto& list = lists[cache->index];
+      cache->give_back(list, list.size());
+    }
+  }
+}
+
+void mempool::object_cache_t::dump(ceph::Formatter *f) const
+{
+  uint64_t hits = 0, misses = 0;
+  for (auto& s : stats) {
+    hits += s.hits;
+    misses += s.misses;
+  }
+  size_t cached;
+  {
+    std::lock_guard l(lock);
+    cached = central.size();
+  }
+  f->dump_unsigned("hits", hits);
+  f->dump_unsigned("misses", misses);
+  f->dump_unsigned("cached", cached);
+}
@@ -3,8 +3,10 @@
 
 #include "numa.h"
 
+#include <algorithm>
 #include <cstring>
 #include <errno.h>
+#include <pthread.h>
 #include <iostream>
 
 #include "include/stringify.h"
@@ -188,6 +190,66 @@ int set_cpu_affinity_all_threads(size_t cpu_set_size, cpu_set_t *cpu_set)
   return 0;
 }
 
+int set_thread_cpu_affinity(int cpu)
+{
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  return -pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+}
+
+int get_round_robin_cpu(const std::string& cpu_list, unsigned n)
+{
+  if (cpu_list.empty()) {
+    return -1;
+  }
+  size_t cpu_set_size = 0;
+  cpu_set_t cpu_set;
+  if (parse_cpu_set_list(cpu_list.c_str(), &cpu_set_size, &cpu_set) < 0) {
+    return -1;
+  }
+  auto cpus = cpu_set_to_set(cpu_set_size, &cpu_set);
+  if (cpus.empty()) {
+    return -1;
+  }
+  return *std::next(cpus.begin(), n % cpus.size());
+}
+
+int get_current_cpu()
+{
+  return sched_getcpu();
+}
+
+int get_cpu_numa_nodes(std::vector<int> *cpu_nodes)
+{
+  std::set<std::string> ls;
+  int r = easy_readdir("/sys/devices/system/node", &ls);
+  if (r < 0) {
+    return r;
+  }
+  cpu_nodes->clear();
+  for (auto& i : ls) {
+    if (i.compare(0, 4, "node") != 0 || i.size() == 4 ||
+	!std::all_of(i.begin() + 4, i.end(), ::isdigit)) {
+      continue;
+    }
+    int node = atoi(i.c_str() + 4);
+    size_t cpu_set_size = 0;
+    cpu_set_t cpu_set;
+    r = get_numa_node_cpu_set(node, &cpu_set_size, &cpu_set);
+    if (r < 0) {
+      return r;
+    }
+    for (int cpu : cpu_set_to_set(cpu_set_size, &cpu_set)) {
+      if (cpu_nodes->size() <= (size_t)cpu) {
+	cpu_nodes->resize(cpu + 1, -1);
+      }
+      (*cpu_nodes)[cpu] = node;
+    }
+  }
+  return 0;
+}
+
 #else
 int parse_cpu_set_list(const char *s,
 		       size_t *cpu_set_size,
@@ -221,4 +283,24 @@ int set_cpu_affinity_all_threads(size_t cpu_set_size,
   return -ENOTSUP;
 }
 
+int set_thread_cpu_affinity(int cpu)
+{
+  return -ENOTSUP;
+}
+
+int get_round_robin_cpu(const std::string& cpu_list, unsigned n)
+{
+  return -1;
+}
+
+int get_current_cpu()
+{
+  return -1;
+}
+
+int get_cpu_numa_nodes(std::vector<int> *cpu_nodes)
+{
+  return -ENOTSUP;
+}
+
 #endif
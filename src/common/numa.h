@@ -7,6 +7,8 @@
 #include <sched.h>
 #include <ostream>
 #include <set>
+#include <string>
+#include <vector>
 
 int parse_cpu_set_list(const char *s,
 		       size_t *cpu_set_size,
@@ -22,3 +24,16 @@ int get_numa_node_cpu_set(int node,
 
 int set_cpu_affinity_all_threads(size_t cpu_set_size,
 				 cpu_set_t *cpu_set);
+
+// pin the calling thread to 'cpu'
+int set_thread_cpu_affinity(int cpu);
+
+// the CPU the n-th of a set of threads pinned round robin to the CPUs of
+// 'cpu_list' (e.g. "0-3,8") goes to, or -1 if the list is empty or invalid
+int get_round_robin_cpu(const std::string& cpu_list, unsigned n);
+
+// the CPU the calling thread runs on, or -1 if unknown
+int get_current_cpu();
+
+// the numa node of each CPU, indexed by CPU number
+int get_cpu_numa_nodes(std::vector<int> *cpu_nodes);
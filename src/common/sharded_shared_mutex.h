@@ -0,0 +1,110 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include "common/ceph_mutex.h"
+
+// A shared mutex for the locks which are taken shared by many threads at
+// once, and exclusively now and then (e.g. the one protecting the OSDMap
+// of a client): all the readers of a std::shared_mutex update its reader
+// count, so its cache line bounces between the cores even though they do
+// not exclude each other.
+//
+// Here the readers take one of SHARDS shared mutexes, each on its own
+// cache line, the one of their thread, and the writers take all of them
+// in order. Readers of different shards do not share anything, the price
+// being paid by the writers.
+//
+// A shared lock must be released by the thread which took it.
+//
+// With lockdep (CEPH_DEBUG_MUTEX), this is a plain ceph::shared_mutex.
+
+#if defined(CEPH_DEBUG_MUTEX) || (defined(WITH_SEASTAR) && !defined(WITH_ALIEN))
+
+namespace ceph {
+
+using sharded_shared_mutex = shared_mutex;
+
+template <typename ...Args>
+sharded_shared_mutex make_sharded_shared_mutex(Args&& ...args) {
+  return make_shared_mutex(std::forward<Args>(args)...);
+}
+
+} // namespace ceph
+
+#else
+
+#include <atomic>
+#include <shared_mutex>
+
+namespace ceph {
+
+class sharded_shared_mutex {
+public:
+  static constexpr unsigned SHARDS = 16;
+
+  sharded_shared_mutex() = default;
+  sharded_shared_mutex(const sharded_shared_mutex&) = delete;
+  sharded_shared_mutex& operator=(const sharded_shared_mutex&) = delete;
+
+  // exclusive locking
+  void lock() {
+    for (auto& s : shards) {
+      s.lock.lock();
+    }
+  }
+  bool try_lock() {
+    for (unsigned i = 0; i < SHARDS; ++i) {
+      if (!shards[i].lock.try_lock()) {
+	while (i-- > 0) {
+	  shards[i].lock.unlock();
+	}
+	return false;
+      }
+    }
+    return true;
+  }
+  void unlock() {
+    for (unsigned i = SHARDS; i-- > 0; ) {
+      shards[i].lock.unlock();
+    }
+  }
+
+  // shared locking
+  void lock_shared() {
+    shards[thread_shard()].lock.lock_shared();
+  }
+  bool try_lock_shared() {
+    return shards[thread_shard()].lock.try_lock_shared();
+  }
+  void unlock_shared() {
+    shards[thread_shard()].lock.unlock_shared();
+  }
+
+private:
+  struct alignas(64) shard_t {
+    std::shared_mutex lock;
+  };
+  shard_t shards[SHARDS];
+
+  // the threads are spread over the shards in the order they first take
+  // a shared lock, whichever sharded_shared_mutex it is
+  static unsigned thread_shard() {
+    static std::atomic<unsigned> next_shard = {0};
+    thread_local const unsigned shard =
+      next_shard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    return shard;
+  }
+};
+
+// discard arguments to make_sharded_shared_mutex (they are for debugging
+// only)
+template <typename ...Args>
+sharded_shared_mutex make_sharded_shared_mutex(Args&& ...args) {
+  return {};
+}
+
+} // namespace ceph
+
+#endif
@@ -1586,9 +1586,11 @@ public:
     crush_init_workspace(crush, work);
     crush_choose_arg_map arg_map = choose_args_get_with_fallback(
       choose_args_index);
-    int numrep = crush_do_rule(crush, rule, x, rawout, maxout,
-			       std::data(weight), std::size(weight),
-			       work, arg_map.args);
+    // the same mapping as crush_do_rule(), with vectorized straw2 draws
+    int numrep = 0;
+    crush_do_rule_batch(crush, rule, &x, 1, rawout, &numrep, maxout,
+			std::data(weight), std::size(weight),
+			work, arg_map.args);
     if (numrep < 0)
       numrep = 0;
     out.resize(numrep);
@@ -1596,6 +1598,31 @@ public:
       out[i] = rawout[i];
   }
 
+  /// do_rule() for each of xs, in one go
+  template<typename WeightVector>
+  void do_rule_batch(int rule, const std::vector<int>& xs,
+		     std::vector<std::vector<int>>& outs, int maxout,
+		     const WeightVector& weight,
+		     uint64_t choose_args_index) const {
+    std::vector<int> rawout(xs.size() * maxout);
+    std::vector<int> lens(xs.size());
+    std::vector<char> work(crush_work_size(crush, maxout));
+    crush_init_workspace(crush, work.data());
+    crush_choose_arg_map arg_map = choose_args_get_with_fallback(
+      choose_args_index);
+    if (!crush_do_rule_batch(crush, rule, xs.data(), xs.size(),
+			     rawout.data(), lens.data(), maxout,
+			     std::data(weight), std::size(weight),
+			     work.data(), arg_map.args)) {
+      std::fill(lens.begin(), lens.end(), 0);
+    }
+    outs.resize(xs.size());
+    for (size_t i = 0; i < xs.size(); i++) {
+      auto p = rawout.begin() + i * maxout;
+      outs[i].assign(p, p + std::max(lens[i], 0));
+    }
+  }
+
   int _choose_type_stack(
     CephContext *cct,
     const std::vector<std::pair<int,int>>& stack,
@@ -383,12 +383,144 @@ static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 	return bucket->h.items[high];
 }
 
+#ifndef __KERNEL__
+/*
+ * straw2, CRUSH_LANES items at a time
+ *
+ * The draws of bucket_straw2_choose(), bit for bit: the hashes and the
+ * logarithms are computed with vector operations, and the divisions in
+ * double precision, the quotient being corrected to the exact integer
+ * one.  The x86_64 builds carry AVX2 and AVX-512 variants, picked when
+ * loading.
+ */
+#define CRUSH_LANES 8
+
+typedef __u32 crush_lanes_t __attribute__((vector_size(CRUSH_LANES * sizeof(__u32))));
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && \
+	defined(__linux__)
+# define CRUSH_SIMD_CLONES \
+	__attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+# define CRUSH_SIMD_CLONES
+#endif
+
+/* div64_s64(ln, weight) for ln <= 0 and weight != 0 */
+static inline __s64 straw2_div(__s64 ln, __s32 weight)
+{
+	__u64 a = -ln;
+	__u64 b = weight < 0 ? -(__s64)weight : weight;
+	/* a < 2^49: the double quotient is off by less than one */
+	__u64 q = (__u64)((double)a / (double)b);
+
+	if (q * b > a)
+		q--;
+	else if ((q + 1) * b <= a)
+		q++;
+	return weight < 0 ? (__s64)q : -(__s64)q;
+}
+
+CRUSH_SIMD_CLONES
+static void straw2_draws(__u32 x, __u32 r, const __s32 *ids,
+			 const __u32 *weights, __s64 *draws)
+{
+	crush_lanes_t a, b, c, hash, v231232, v1232, xv, shift, iexpon;
+	__u64 ln[CRUSH_LANES];
+	int j;
+
+	/* crush_hash32_rjenkins1_3(x, ids[j], r) */
+	memcpy(&b, ids, sizeof(b));
+	a = b * 0 + x;
+	c = b * 0 + r;
+	v231232 = b * 0 + 231232;
+	v1232 = b * 0 + 1232;
+	hash = crush_hash_seed ^ a ^ b ^ c;
+	crush_hashmix(a, b, hash);
+	crush_hashmix(c, v231232, hash);
+	crush_hashmix(v1232, a, hash);
+	crush_hashmix(b, v231232, hash);
+	crush_hashmix(v1232, c, hash);
+
+	/* crush_ln((hash & 0xffff)), normalizing without clz */
+	xv = (hash & 0xffff) + 1;
+	iexpon = xv * 0 + 15;
+	shift = (crush_lanes_t)(xv < 0x100) & 8;
+	xv <<= shift;
+	iexpon -= shift;
+	shift = (crush_lanes_t)(xv < 0x1000) & 4;
+	xv <<= shift;
+	iexpon -= shift;
+	shift = (crush_lanes_t)(xv < 0x4000) & 2;
+	xv <<= shift;
+	iexpon -= shift;
+	shift = (crush_lanes_t)(xv < 0x8000) & 1;
+	xv <<= shift;
+	iexpon -= shift;
+	for (j = 0; j < CRUSH_LANES; j++) {
+		int index1 = (xv[j] >> 8) << 1;
+		__u64 RH = __RH_LH_tbl[index1 - 256];
+		__u64 LH = __RH_LH_tbl[index1 + 1 - 256];
+		__u64 xl64 = ((__s64)xv[j] * RH) >> 48;
+		__u64 LL = __LL_tbl[xl64 & 0xff];
+
+		ln[j] = ((__u64)iexpon[j] << (12 + 32)) +
+			((LH + LL) >> (48 - 12 - 32));
+	}
+
+	for (j = 0; j < CRUSH_LANES; j++) {
+		if (weights[j])
+			draws[j] = straw2_div(ln[j] - 0x1000000000000ll,
+					      weights[j]);
+		else
+			draws[j] = S64_MIN;
+	}
+}
+
+static int bucket_straw2_choose_simd(const struct crush_bucket_straw2 *bucket,
+				     int x, int r,
+				     const struct crush_choose_arg *arg,
+				     int position)
+{
+	unsigned int i, j, n, high = 0;
+	__s64 high_draw = 0;
+	__u32 *weights = get_choose_arg_weights(bucket, arg, position);
+	__s32 *ids = get_choose_arg_ids(bucket, arg);
+	__s32 lane_ids[CRUSH_LANES];
+	__u32 lane_weights[CRUSH_LANES];
+	__s64 draws[CRUSH_LANES];
+
+	if (bucket->h.hash != CRUSH_HASH_RJENKINS1)
+		return bucket_straw2_choose(bucket, x, r, arg, position);
+
+	for (i = 0; i < bucket->h.size; i += CRUSH_LANES) {
+		n = bucket->h.size - i;
+		if (n > CRUSH_LANES)
+			n = CRUSH_LANES;
+		memcpy(lane_ids, ids + i, n * sizeof(*ids));
+		memcpy(lane_weights, weights + i, n * sizeof(*weights));
+		for (j = n; j < CRUSH_LANES; j++) {
+			lane_ids[j] = 0;
+			lane_weights[j] = 0;
+		}
+		straw2_draws(x, r, lane_ids, lane_weights, draws);
+		for (j = 0; j < n; j++) {
+			if (i + j == 0 || draws[j] > high_draw) {
+				high = i + j;
+				high_draw = draws[j];
+			}
+		}
+	}
+
+	return bucket->h.items[high];
+}
+#endif /* !__KERNEL__ */
+
 
 static int crush_bucket_choose(const struct crush_bucket *in,
 			       struct crush_work_bucket *work,
 			       int x, int r,
                                const struct crush_choose_arg *arg,
-                               int position)
+                               int position, int simd)
 {
 	dprintk(" crush_bucket_choose %d x=%d r=%d\n", in->id, x, r);
 	BUG_ON(in->size == 0);
@@ -408,6 +540,12 @@ static int crush_bucket_choose(const struct crush_bucket *in,
 			(const struct crush_bucket_straw *)in,
 			x, r);
 	case CRUSH_BUCKET_STRAW2:
+#ifndef __KERNEL__
+		if (simd)
+			return bucket_straw2_choose_simd(
+				(const struct crush_bucket_straw2 *)in,
+				x, r, arg, position);
+#endif
 		return bucket_straw2_choose(
 			(const struct crush_bucket_straw2 *)in,
 			x, r, arg, position);
@@ -473,7 +611,8 @@ static int crush_choose_firstn(const struct crush_map *map,
 			       unsigned int stable,
 			       int *out2,
 			       int parent_r,
-                               const struct crush_choose_arg *choose_args)
+                               const struct crush_choose_arg *choose_args,
+			       int simd)
 {
 	int rep;
 	unsigned int ftotal, flocal;
@@ -527,7 +666,7 @@ parent_r %d stable %d\n",
 						in, work->work[-1-in->id],
 						x, r,
                                                 (choose_args ? &choose_args[-1-in->id] : 0),
-                                                outpos);
+                                                outpos, simd);
 				if (item >= map->max_devices) {
 					dprintk("   bad item %d\n", item);
 					skip_rep = 1;
@@ -585,7 +724,8 @@ parent_r %d stable %d\n",
 							    stable,
 							    NULL,
 							    sub_r,
-                                                            choose_args) <= outpos)
+                                                            choose_args,
+							    simd) <= outpos)
 							/* didn't get leaf */
 							reject = 1;
 					} else {
@@ -663,7 +803,8 @@ static void crush_choose_indep(const struct crush_map *map,
 			       int recurse_to_leaf,
 			       int *out2,
 			       int parent_r,
-                               const struct crush_choose_arg *choose_args)
+                               const struct crush_choose_arg *choose_args,
+			       int simd)
 {
 	const struct crush_bucket *in = bucket;
 	int endpos = outpos + left;
@@ -737,7 +878,7 @@ static void crush_choose_indep(const struct crush_map *map,
 					in, work->work[-1-in->id],
 					x, r,
                                         (choose_args ? &choose_args[-1-in->id] : 0),
-                                        outpos);
+                                        outpos, simd);
 				if (item >= map->max_devices) {
 					dprintk("   bad item %d\n", item);
 					out[rep] = CRUSH_ITEM_NONE;
@@ -791,7 +932,8 @@ static void crush_choose_indep(const struct crush_map *map,
 							x, 1, numrep, 0,
 							out2, rep,
 							recurse_tries, 0,
-							0, NULL, r, choose_args);
+							0, NULL, r, choose_args,
+							simd);
 						if (out2 && out2[rep] == CRUSH_ITEM_NONE) {
 							/* placed nothing; no leaf */
 							break;
@@ -886,21 +1028,12 @@ void crush_init_workspace(const struct crush_map *m, void *v) {
 	BUG_ON((char *)point - (char *)w != m->working_size);
 }
 
-/**
- * crush_do_rule - calculate a mapping with the given input and rule
- * @map: the crush_map
- * @ruleno: the rule id
- * @x: hash input
- * @result: pointer to result vector
- * @result_max: maximum result size
- * @weight: weight vector (for map leaves)
- * @weight_max: size of weight vector
- * @cwin: Pointer to at least map->working_size bytes of memory or NULL.
- */
-int crush_do_rule(const struct crush_map *map,
-		  int ruleno, int x, int *result, int result_max,
-		  const __u32 *weight, int weight_max,
-		  void *cwin, const struct crush_choose_arg *choose_args)
+static int crush_do_rule_x(const struct crush_map *map,
+			   int ruleno, int x, int *result, int result_max,
+			   const __u32 *weight, int weight_max,
+			   void *cwin,
+			   const struct crush_choose_arg *choose_args,
+			   int simd)
 {
 	int result_len;
 	struct crush_work *cw = cwin;
@@ -1051,7 +1184,8 @@ int crush_do_rule(const struct crush_map *map,
 						stable,
 						c+osize,
 						0,
-						choose_args);
+						choose_args,
+						simd);
 				} else {
 					out_size = ((numrep < (result_max-osize)) ?
 						    numrep : (result_max-osize));
@@ -1069,7 +1203,8 @@ int crush_do_rule(const struct crush_map *map,
 						recurse_to_leaf,
 						c+osize,
 						0,
-						choose_args);
+						choose_args,
+						simd);
 					osize += out_size;
 				}
 			}
@@ -1103,3 +1238,63 @@ int crush_do_rule(const struct crush_map *map,
 
 	return result_len;
 }
+
+/**
+ * crush_do_rule - calculate a mapping with the given input and rule
+ * @map: the crush_map
+ * @ruleno: the rule id
+ * @x: hash input
+ * @result: pointer to result vector
+ * @result_max: maximum result size
+ * @weight: weight vector (for map leaves)
+ * @weight_max: size of weight vector
+ * @cwin: Pointer to at least map->working_size bytes of memory or NULL.
+ */
+int crush_do_rule(const struct crush_map *map,
+		  int ruleno, int x, int *result, int result_max,
+		  const __u32 *weight, int weight_max,
+		  void *cwin, const struct crush_choose_arg *choose_args)
+{
+	return crush_do_rule_x(map, ruleno, x, result, result_max,
+			       weight, weight_max, cwin, choose_args, 0);
+}
+
+#ifndef __KERNEL__
+/**
+ * crush_do_rule_batch - calculate the mappings of many inputs
+ * @map: the crush_map
+ * @ruleno: the rule id
+ * @xs: hash inputs
+ * @n: number of inputs
+ * @results: pointer to n result vectors of result_max items each
+ * @result_lens: pointer to the n result sizes
+ * @result_max: maximum result size
+ * @weight: weight vector (for map leaves)
+ * @weight_max: size of weight vector
+ * @cwin: Pointer to at least map->working_size bytes of memory or NULL.
+ *
+ * The same mappings as crush_do_rule(), the straw2 buckets choosing
+ * among their items CRUSH_LANES at a time.
+ */
+int crush_do_rule_batch(const struct crush_map *map,
+			int ruleno, const int *xs, int n,
+			int *results, int *result_lens, int result_max,
+			const __u32 *weight, int weight_max,
+			void *cwin, const struct crush_choose_arg *choose_args)
+{
+	int i;
+
+	if ((__u32)ruleno >= map->max_rules) {
+		dprintk(" bad ruleno %d\n", ruleno);
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		result_lens[i] = crush_do_rule_x(map, ruleno, xs[i],
+						 results + i * result_max,
+						 result_max,
+						 weight, weight_max,
+						 cwin, choose_args, 1);
+	}
+	return n;
+}
+#endif
@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <cstring>
 
 #include "ErasureCode.h"
 
@@ -248,6 +249,58 @@ int ErasureCode::decode(const set<int> &want_to_read,
   return _decode(want_to_read, chunks, decoded);
 }
 
+int ErasureCode::encode_chunks_batch(const set<int> &want_to_encode,
+                                     map<int, bufferlist> *encoded,
+                                     unsigned stripe_count)
+{
+  ceph_assert(!encoded->empty());
+  unsigned total = (*encoded->begin()).second.length();
+  if (stripe_count == 0 || total % stripe_count)
+    return -EINVAL;
+  unsigned blocksize = total / stripe_count;
+  // the chunks of each stripe are encoded in place
+  for (auto &&i : *encoded) {
+    i.second.rebuild_aligned_size_and_memory(total, SIMD_ALIGN);
+    ceph_assert(i.second.is_contiguous());
+  }
+  for (unsigned s = 0; s < stripe_count; s++) {
+    map<int, bufferlist> chunks;
+    for (auto &&i : *encoded) {
+      chunks[i.first].substr_of(i.second, s * blocksize, blocksize);
+    }
+    int r = encode_chunks(want_to_encode, &chunks);
+    if (r)
+      return r;
+  }
+  return 0;
+}
+
+int ErasureCode::decode_chunks_batch(const set<int> &want_to_read,
+                                     const map<int, bufferlist> &chunks,
+                                     map<int, bufferlist> *decoded,
+                                     unsigned stripe_count)
+{
+  ceph_assert(!chunks.empty());
+  unsigned total = (*chunks.begin()).second.length();
+  if (stripe_count == 0 || total % stripe_count)
+    return -EINVAL;
+  unsigned blocksize = total / stripe_count;
+  for (unsigned s = 0; s < stripe_count; s++) {
+    map<int, bufferlist> in;
+    for (auto &&i : chunks) {
+      in[i.first].substr_of(i.second, s * blocksize, blocksize);
+    }
+    map<int, bufferlist> out;
+    int r = decode(want_to_read, in, &out, blocksize);
+    if (r)
+      return r;
+    for (auto &&i : out) {
+      (*decoded)[i.first].claim_append(i.second);
+    }
+  }
+  return 0;
+}
+
 int ErasureCode::parse(const ErasureCodeProfile &profile,
 		       ostream *ss)
 {
@@ -329,6 +382,33 @@ int ErasureCode::to_string(const std::string &name,
   return 0;
 }
 
+int ErasureCode::encode_delta(const bufferptr &old_data,
+			      const bufferptr &new_data,
+			      bufferptr *delta)
+{
+  // for codes over GF(2^w), subtraction is XOR
+  if (old_data.length() != new_data.length() ||
+      delta->length() != old_data.length())
+    return -EINVAL;
+  const char *o = old_data.c_str();
+  const char *n = new_data.c_str();
+  char *d = delta->c_str();
+  const unsigned len = old_data.length();
+  unsigned i = 0;
+  // a word at a time, the chunks are page aligned in practice
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t ow, nw;
+    memcpy(&ow, o + i, sizeof(ow));
+    memcpy(&nw, n + i, sizeof(nw));
+    ow ^= nw;
+    memcpy(d + i, &ow, sizeof(ow));
+  }
+  for (; i < len; ++i) {
+    d[i] = o[i] ^ n[i];
+  }
+  return 0;
+}
+
 int ErasureCode::decode_concat(const map<int, bufferlist> &chunks,
 			       bufferlist *decoded)
 {
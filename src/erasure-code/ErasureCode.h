@@ -22,6 +22,8 @@
 
  */ 
 
+#include <cerrno>
+
 #include "ErasureCodeInterface.h"
 
 namespace ceph {
@@ -87,6 +89,15 @@ namespace ceph {
 			const std::map<int, bufferlist> &chunks,
 			std::map<int, bufferlist> *decoded);
 
+    int encode_chunks_batch(const std::set<int> &want_to_encode,
+                            std::map<int, bufferlist> *encoded,
+                            unsigned stripe_count) override;
+
+    int decode_chunks_batch(const std::set<int> &want_to_read,
+                            const std::map<int, bufferlist> &chunks,
+                            std::map<int, bufferlist> *decoded,
+                            unsigned stripe_count) override;
+
     const std::vector<int> &get_chunk_mapping() const override;
 
     int to_mapping(const ErasureCodeProfile &profile,
@@ -113,6 +124,19 @@ namespace ceph {
     int decode_concat(const std::map<int, bufferlist> &chunks,
 			      bufferlist *decoded) override;
 
+    bool supports_parity_delta() const override {
+      return false;
+    }
+
+    int encode_delta(const bufferptr &old_data,
+		     const bufferptr &new_data,
+		     bufferptr *delta) override;
+
+    int apply_delta(const std::map<int, bufferptr> &in,
+		    std::map<int, bufferptr> &out) override {
+      return -EOPNOTSUPP;
+    }
+
   protected:
     int parse(const ErasureCodeProfile &profile,
 	      std::ostream *ss);
@@ -412,6 +412,47 @@ namespace ceph {
                               const std::map<int, bufferlist> &chunks,
                               std::map<int, bufferlist> *decoded) = 0;
 
+    /**
+     * Encode **stripe_count** stripes at once.
+     *
+     * Same as **encode_chunks** except that each of the **encoded**
+     * buffers is the concatenation of the chunks of **stripe_count**
+     * consecutive stripes. Plugins which compute each byte of the
+     * coding chunks from the bytes at the same offset of the data
+     * chunks encode all the stripes with a single call, others encode
+     * them one at a time.
+     *
+     * Returns 0 on success.
+     *
+     * @param [in] want_to_encode chunk indexes to be encoded
+     * @param [in,out] encoded map chunk indexes to chunk data
+     * @param [in] stripe_count number of stripes in each buffer
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int encode_chunks_batch(const std::set<int> &want_to_encode,
+                                    std::map<int, bufferlist> *encoded,
+                                    unsigned stripe_count) = 0;
+
+    /**
+     * Decode **stripe_count** stripes at once.
+     *
+     * Same as **decode** except that each of the **chunks** buffers
+     * is the concatenation of the chunks of **stripe_count**
+     * consecutive stripes, and so are the **decoded** buffers.
+     *
+     * Returns 0 on success.
+     *
+     * @param [in] want_to_read chunk indexes to be decoded
+     * @param [in] chunks map chunk indexes to chunk data
+     * @param [out] decoded map chunk indexes to chunk data
+     * @param [in] stripe_count number of stripes in each buffer
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int decode_chunks_batch(const std::set<int> &want_to_read,
+                                    const std::map<int, bufferlist> &chunks,
+                                    std::map<int, bufferlist> *decoded,
+                                    unsigned stripe_count) = 0;
+
     /**
      * Return the ordered list of chunks or an empty vector
      * if no remapping is necessary.
@@ -459,6 +500,44 @@ namespace ceph {
      */
     virtual int decode_concat(const std::map<int, bufferlist> &chunks,
 			      bufferlist *decoded) = 0;
+
+    /**
+     * Return true if the coding chunks can be updated from the
+     * difference between the old and the new content of some data
+     * chunks, without reading the data chunks that did not change.
+     * This holds for linear codes (e.g. Reed-Solomon) which do not
+     * remap chunks (see **get_chunk_mapping**).
+     *
+     * @return true if **encode_delta** and **apply_delta** are supported
+     */
+    virtual bool supports_parity_delta() const = 0;
+
+    /**
+     * Compute the **delta** between the **old_data** and the
+     * **new_data** content of a data chunk, to be given to
+     * **apply_delta**. The three buffers have the same length.
+     *
+     * @param [in] old_data the current content of the data chunk
+     * @param [in] new_data the content about to be written
+     * @param [out] delta a buffer of the same length, overwritten
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int encode_delta(const bufferptr &old_data,
+			     const bufferptr &new_data,
+			     bufferptr *delta) = 0;
+
+    /**
+     * Update the coding chunks in **out** in place, given the
+     * **delta** of each modified data chunk in **in**. All the
+     * coding chunks must be present in **out** and all buffers
+     * have the same length.
+     *
+     * @param [in] in map data chunk indexes to deltas
+     * @param [in,out] out map coding chunk indexes to their content
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int apply_delta(const std::map<int, bufferptr> &in,
+			    std::map<int, bufferptr> &out) = 0;
   };
 
   typedef std::shared_ptr<ErasureCodeInterface> ErasureCodeInterfaceRef;
@@ -34,8 +34,6 @@ extern "C" {
 #define dout_prefix _prefix(_dout)
 // -----------------------------------------------------------------------------
 
-// -----------------------------------------------------------------------------
-
 static ostream&
 _prefix(std::ostream* _dout)
 {
@@ -116,6 +114,29 @@ int ErasureCodeIsa::decode_chunks(const set<int> &want_to_read,
 
 // -----------------------------------------------------------------------------
 
+int ErasureCodeIsa::encode_chunks_batch(const set<int> &want_to_encode,
+                                        map<int, bufferlist> *encoded,
+                                        unsigned stripe_count)
+{
+  // ec_encode_data computes each coding byte from the data bytes at the
+  // same offset: all the stripes are encoded with a single call
+  return encode_chunks(want_to_encode, encoded);
+}
+
+// -----------------------------------------------------------------------------
+
+int ErasureCodeIsa::decode_chunks_batch(const set<int> &want_to_read,
+                                        const map<int, bufferlist> &chunks,
+                                        map<int, bufferlist> *decoded,
+                                        unsigned stripe_count)
+{
+  // same as encode_chunks_batch: a single decoding table lookup and
+  // ec_encode_data call for all the stripes
+  return _decode(want_to_read, chunks, decoded);
+}
+
+// -----------------------------------------------------------------------------
+
 void
 ErasureCodeIsaDefault::isa_encode(char **data,
                                   char **coding,
@@ -132,6 +153,37 @@ ErasureCodeIsaDefault::isa_encode(char **data,
 
 // -----------------------------------------------------------------------------
 
+// -----------------------------------------------------------------------------
+
+int
+ErasureCodeIsaDefault::apply_delta(const map<int, bufferptr> &in,
+                                   map<int, bufferptr> &out)
+{
+  if (out.size() != (unsigned) m)
+    return -EINVAL;
+  unsigned blocksize = out.begin()->second.length();
+  unsigned char *coding[m];
+  for (auto &&i : out) {
+    if (i.first < k || i.first >= k + m || i.second.length() != blocksize)
+      return -EINVAL;
+    coding[i.first - k] = (unsigned char*) i.second.c_str();
+  }
+  for (auto &&i : in) {
+    if (i.first < 0 || i.first >= k || i.second.length() != blocksize)
+      return -EINVAL;
+    unsigned char *delta = (unsigned char*) const_cast<char*>(i.second.c_str());
+    if (m == 1)
+      // single parity stripe, see isa_encode
+      byte_xor(delta, coding[0], delta + blocksize);
+    else
+      ec_encode_data_update(blocksize, k, m, i.first, encode_tbls,
+                            delta, coding);
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+
 bool
 ErasureCodeIsaDefault::erasure_contains(int *erasures, int i)
 {
@@ -80,6 +80,15 @@ public:
                             const std::map<int, ceph::buffer::list> &chunks,
                             std::map<int, ceph::buffer::list> *decoded) override;
 
+  int encode_chunks_batch(const std::set<int> &want_to_encode,
+                          std::map<int, ceph::buffer::list> *encoded,
+                          unsigned stripe_count) override;
+
+  int decode_chunks_batch(const std::set<int> &want_to_read,
+                          const std::map<int, ceph::buffer::list> &chunks,
+                          std::map<int, ceph::buffer::list> *decoded,
+                          unsigned stripe_count) override;
+
   int init(ceph::ErasureCodeProfile &profile, std::ostream *ss) override;
 
   virtual void isa_encode(char **data,
@@ -145,6 +154,14 @@ public:
 
   void prepare() override;
 
+  bool supports_parity_delta() const override
+  {
+    return true;
+  }
+
+  int apply_delta(const std::map<int, ceph::bufferptr> &in,
+                  std::map<int, ceph::bufferptr> &out) override;
+
  private:
   int parse(ceph::ErasureCodeProfile &profile,
             std::ostream *ss) override;
@@ -53,8 +53,6 @@ ErasureCodeIsaTableCache::~ErasureCodeIsaTableCache()
   codec_tables_t::const_iterator tables_it;
   codec_table_t::const_iterator table_it;
 
-  std::map<int, lru_map_t*>::const_iterator lru_map_it;
-  std::map<int, lru_list_t*>::const_iterator lru_list_it;
 
   // clean-up all allocated tables
   for (ttables_it = encoding_coefficient.begin(); ttables_it != encoding_coefficient.end(); ++ttables_it) {
@@ -82,18 +80,6 @@ ErasureCodeIsaTableCache::~ErasureCodeIsaTableCache()
       }
     }
   }
-
-  for (lru_map_it = decoding_tables.begin(); lru_map_it != decoding_tables.end(); ++lru_map_it) {
-    if (lru_map_it->second) {
-      delete lru_map_it->second;
-    }
-  }
-
-  for (lru_list_it = decoding_tables_lru.begin(); lru_list_it != decoding_tables_lru.end(); ++lru_list_it) {
-    if (lru_list_it->second) {
-      delete lru_list_it->second;
-    }
-  }
 }
 
 // -----------------------------------------------------------------------------
@@ -102,40 +88,24 @@ int
 ErasureCodeIsaTableCache::getDecodingTableCacheSize(int matrixtype)
 {
   std::lock_guard lock{codec_tables_guard};
-  if (decoding_tables[matrixtype])
-    return decoding_tables[matrixtype]->size();
-  else
-    return -1;
+  return getDecodingTables(matrixtype).size;
 }
 
 // -----------------------------------------------------------------------------
 
-ErasureCodeIsaTableCache::lru_map_t*
+ErasureCodeIsaTableCache::decoding_cache_t&
 ErasureCodeIsaTableCache::getDecodingTables(int matrix_type)
 {
-  // the caller must hold the guard mutex:
-  // => std::lock_guard lock{codec_tables_guard};
-
-  // create an lru_map if not yet allocated
-  if (!decoding_tables[matrix_type]) {
-    decoding_tables[matrix_type] = new lru_map_t;
-  }
+  ceph_assert(matrix_type >= 0 && matrix_type < matrix_types);
   return decoding_tables[matrix_type];
 }
 
 // -----------------------------------------------------------------------------
 
-ErasureCodeIsaTableCache::lru_list_t*
-ErasureCodeIsaTableCache::getDecodingTablesLru(int matrix_type)
+int
+ErasureCodeIsaTableCache::getDecodingBucket(const std::string &signature)
 {
-  // the caller must hold the guard mutex:
-  // => std::lock_guard lock{codec_tables_guard};
-
-  // create an lru_list if not yet allocated
-  if (!decoding_tables_lru[matrix_type]) {
-    decoding_tables_lru[matrix_type] = new lru_list_t;
-  }
-  return decoding_tables_lru[matrix_type];
+  return std::hash<std::string>{}(signature) % decoding_tables_buckets;
 }
 
 // -----------------------------------------------------------------------------
@@ -243,28 +213,29 @@ ErasureCodeIsaTableCache::getDecodingTableFromCache(std::string &signature,
 
   dout(12) << "[ get table    ] = " << signature << dendl;
 
-  // we try to fetch a decoding table from an LRU cache
-  bool found = false;
-
-  std::lock_guard lock{codec_tables_guard};
-
-  lru_map_t* decode_tbls_map =
-    getDecodingTables(matrixtype);
-
-  lru_list_t* decode_tbls_lru =
-    getDecodingTablesLru(matrixtype);
-
-  if (decode_tbls_map->count(signature)) {
-    dout(12) << "[ cached table ] = " << signature << dendl;
-    // copy the table out of the cache
-    memcpy(table, (*decode_tbls_map)[signature].second.c_str(), k * (m + k)*32);
-    // find item in LRU queue and push back
-    dout(12) << "[ cache size   ] = " << decode_tbls_lru->size() << dendl;
-    decode_tbls_lru->splice( (decode_tbls_lru->begin()), *decode_tbls_lru, (*decode_tbls_map)[signature].first);
-    found = true;
-  }
-
-  return found;
+  // we try to fetch a decoding table from an LRU cache, without the guard
+  // mutex
+  decoding_cache_t &decode_tbls = getDecodingTables(matrixtype);
+
+  std::shared_ptr<const decoding_bucket_t> bucket =
+    std::atomic_load(&decode_tbls.buckets[getDecodingBucket(signature)]);
+
+  if (!bucket)
+    return false;
+
+  decoding_bucket_t::const_iterator it = bucket->find(signature);
+  if (it == bucket->end())
+    return false;
+
+  dout(12) << "[ cached table ] = " << signature << dendl;
+  // copy the table out of the cache: a table is never modified once
+  // published, it is only dropped from the bucket
+  memcpy(table, it->second->table.c_str(), k * (m + k)*32);
+  // mark it as used since the last insertion
+  uint64_t now = decode_tbls.clock.load(std::memory_order_relaxed);
+  if (it->second->last_used.load(std::memory_order_relaxed) != now)
+    it->second->last_used.store(now, std::memory_order_relaxed);
+  return true;
 }
 
 // -----------------------------------------------------------------------------
@@ -284,44 +255,61 @@ ErasureCodeIsaTableCache::putDecodingTableToCache(std::string &signature,
 
   // we store a new table to the cache
 
-  ceph::buffer::ptr cachetable;
-
   std::lock_guard lock{codec_tables_guard};
 
-  lru_map_t* decode_tbls_map =
-    getDecodingTables(matrixtype);
+  decoding_cache_t &decode_tbls = getDecodingTables(matrixtype);
 
-  lru_list_t* decode_tbls_lru =
-    getDecodingTablesLru(matrixtype);
+  std::shared_ptr<const decoding_bucket_t> &bucket =
+    decode_tbls.buckets[getDecodingBucket(signature)];
 
-  // evt. shrink the LRU queue/map
-  if ((int) decode_tbls_lru->size() >= ErasureCodeIsaTableCache::decoding_tables_lru_length) {
-    dout(12) << "[ shrink lru   ] = " << signature << dendl;
-    // reuse old buffer
-    cachetable = (*decode_tbls_map)[decode_tbls_lru->back()].second;
+  if (bucket && bucket->count(signature)) {
+    // somebody might have deposited this table in the meanwhile
+    return;
+  }
 
-    if ((int) cachetable.length() != (k * (m + k)*32)) {
-      // we need to replace this with a different size buffer
-      cachetable = ceph::buffer::create(k * (m + k)*32);
+  // evt. shrink the LRU cache
+  if (decode_tbls.size >= ErasureCodeIsaTableCache::decoding_tables_lru_length) {
+    // the buffer of the evicted table is not reused, lookups may still be
+    // copying it out
+    int lru_bucket = -1;
+    const std::string *lru_signature = nullptr;
+    uint64_t lru_stamp = 0;
+    for (int b = 0; b < decoding_tables_buckets; b++) {
+      if (!decode_tbls.buckets[b])
+        continue;
+      for (auto &&i : *decode_tbls.buckets[b]) {
+        uint64_t stamp = i.second->last_used;
+        if (lru_bucket < 0 || stamp < lru_stamp) {
+          lru_bucket = b;
+          lru_signature = &i.first;
+          lru_stamp = stamp;
+        }
+      }
     }
-
-    // remove from map
-    decode_tbls_map->erase(decode_tbls_lru->back());
-    // remove from lru
-    decode_tbls_lru->pop_back();
-    // add to the head of lru
-    decode_tbls_lru->push_front(signature);
-    // add the new to the map
-    (*decode_tbls_map)[signature] = std::make_pair(decode_tbls_lru->begin(), cachetable);
-  } else {
-    dout(12) << "[ store table  ] = " << signature << dendl;
-    // allocate a new buffer
-    cachetable = ceph::buffer::create(k * (m + k)*32);
-    decode_tbls_lru->push_front(signature);
-    (*decode_tbls_map)[signature] = std::make_pair(decode_tbls_lru->begin(), cachetable);
-    dout(12) << "[ cache size   ] = " << decode_tbls_lru->size() << dendl;
+    ceph_assert(lru_bucket >= 0);
+    dout(12) << "[ shrink lru   ] = " << *lru_signature << dendl;
+    auto shrunk = std::make_shared<decoding_bucket_t>(
+      *decode_tbls.buckets[lru_bucket]);
+    shrunk->erase(*lru_signature);
+    std::atomic_store(&decode_tbls.buckets[lru_bucket],
+                      std::shared_ptr<const decoding_bucket_t>(std::move(shrunk)));
+    decode_tbls.size--;
   }
 
-  // copy-in the new table
-  memcpy(cachetable.c_str(), table, k * (m + k)*32);
+  dout(12) << "[ store table  ] = " << signature << dendl;
+  // allocate a new buffer and copy-in the new table
+  auto entry = std::make_shared<decoding_table_t>();
+  entry->table = ceph::buffer::create(k * (m + k)*32);
+  memcpy(entry->table.c_str(), table, k * (m + k)*32);
+  entry->last_used =
+    decode_tbls.clock.fetch_add(1, std::memory_order_relaxed) + 1;
+
+  auto grown = bucket ?
+    std::make_shared<decoding_bucket_t>(*bucket) :
+    std::make_shared<decoding_bucket_t>();
+  grown->emplace(signature, std::move(entry));
+  std::atomic_store(&bucket,
+                    std::shared_ptr<const decoding_bucket_t>(std::move(grown)));
+  decode_tbls.size++;
+  dout(12) << "[ cache size   ] = " << decode_tbls.size << dendl;
 }
@@ -28,8 +28,12 @@
 // -----------------------------------------------------------------------------
 #include "common/ceph_mutex.h"
 #include "erasure-code/ErasureCodeInterface.h"
+#include "include/buffer.h"
 // -----------------------------------------------------------------------------
-#include <list>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
 // -----------------------------------------------------------------------------
 
 class ErasureCodeIsaTableCache {
@@ -37,8 +41,20 @@ class ErasureCodeIsaTableCache {
   // This class implements a table cache for encoding and decoding matrices.
   // Encoding matrices are shared for the same (k,m) combination. It supplies
   // a decoding matrix lru cache which is shared for identical
-  // matrix types e.g. there is one cache (lru-list + lru-map) for Cauchy and
-  // one for Vandermonde matrices!
+  // matrix types e.g. there is one cache for Cauchy and one for Vandermonde
+  // matrices!
+  //
+  // Decoding tables are looked up without taking the guard mutex: the cache
+  // of a matrix type is split into buckets, each of them an immutable map
+  // published with std::atomic_store. Insertions and evictions copy the bucket
+  // they modify under the guard mutex. This is not lock-free: libstdc++
+  // implements the shared_ptr atomic functions with a small pool of mutexes
+  // picked by address, held only to copy the pointer, so lookups of different
+  // buckets seldom contend.
+  //
+  // The least recently used table is evicted. The logical clock only ticks
+  // on insertions, lookups copy it to the table they hit if it is stale, so
+  // hot tables are read without writing to a shared cache line.
   // ---------------------------------------------------------------------------
 
 public:
@@ -47,13 +63,29 @@ public:
 
   static const int decoding_tables_lru_length = 2516;
 
-  typedef std::pair<std::list<std::string>::iterator, ceph::buffer::ptr> lru_entry_t;
+  static const int decoding_tables_buckets = 64;
+
+  // kVandermonde and kCauchy
+  static const int matrix_types = 2;
+
   typedef std::map< int, unsigned char** > codec_table_t;
   typedef std::map< int, codec_table_t > codec_tables_t;
   typedef std::map< int, codec_tables_t > codec_technique_tables_t;
 
-  typedef std::map< std::string, lru_entry_t > lru_map_t;
-  typedef std::list< std::string > lru_list_t;
+  struct decoding_table_t {
+    ceph::buffer::ptr table;
+    std::atomic<uint64_t> last_used = {0};
+  };
+  typedef std::map< std::string, std::shared_ptr<decoding_table_t> > decoding_bucket_t;
+
+  struct decoding_cache_t {
+    // accessed with std::atomic_load/std::atomic_store
+    std::shared_ptr<const decoding_bucket_t> buckets[decoding_tables_buckets];
+    // advanced by the insertions, under the guard mutex
+    std::atomic<uint64_t> clock = {0};
+    // protected by the guard mutex
+    int size = 0;
+  };
 
   ErasureCodeIsaTableCache() = default;
 
@@ -89,12 +121,11 @@ private:
   codec_technique_tables_t encoding_coefficient; // encoding coefficients accessed via table[matrix][k][m]
   codec_technique_tables_t encoding_table; // encoding coefficients accessed via table[matrix][k][m]
 
-  std::map<int, lru_map_t*> decoding_tables; // decoding table cache accessed via map[matrixtype]
-  std::map<int, lru_list_t*> decoding_tables_lru; // decoding table lru list accessed via list[matrixtype]
+  decoding_cache_t decoding_tables[matrix_types]; // decoding table cache accessed via [matrixtype]
 
-  lru_map_t* getDecodingTables(int matrix_type);
+  decoding_cache_t& getDecodingTables(int matrix_type);
 
-  lru_list_t* getDecodingTablesLru(int matrix_type);
+  static int getDecodingBucket(const std::string &signature);
 
   ceph::mutex* getLock();
 
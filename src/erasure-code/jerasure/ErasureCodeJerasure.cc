@@ -137,6 +137,49 @@ int ErasureCodeJerasure::decode_chunks(const set<int> &want_to_read,
   return jerasure_decode(erasures, data, coding, blocksize);
 }
 
+int ErasureCodeJerasure::matrix_apply_delta(const int *matrix,
+					    const map<int, bufferptr> &in,
+					    map<int, bufferptr> &out)
+{
+  if (!matrix || (int)out.size() != m)
+    return -EINVAL;
+  unsigned blocksize = out.begin()->second.length();
+  for (auto &&i : in) {
+    if (i.first < 0 || i.first >= k || i.second.length() != blocksize)
+      return -EINVAL;
+  }
+  for (auto &&o : out) {
+    if (o.first < k || o.first >= k + m || o.second.length() != blocksize)
+      return -EINVAL;
+    char *parity = o.second.c_str();
+    for (auto &&i : in) {
+      // coding chunk p is sum(matrix[p][j] * data chunk j) over GF(2^w)
+      int coef = matrix[(o.first - k) * k + i.first];
+      char *delta = const_cast<char*>(i.second.c_str());
+      if (coef == 0) {
+	continue;
+      } else if (coef == 1) {
+	galois_region_xor(delta, parity, blocksize);
+      } else {
+	switch (w) {
+	case 8:
+	  galois_w08_region_multiply(delta, coef, blocksize, parity, 1);
+	  break;
+	case 16:
+	  galois_w16_region_multiply(delta, coef, blocksize, parity, 1);
+	  break;
+	case 32:
+	  galois_w32_region_multiply(delta, coef, blocksize, parity, 1);
+	  break;
+	default:
+	  return -EINVAL;
+	}
+      }
+    }
+  }
+  return 0;
+}
+
 bool ErasureCodeJerasure::is_prime(int value)
 {
   int prime55[] = {
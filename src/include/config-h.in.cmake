@@ -226,6 +226,9 @@
 /* Define to 1 if you have the <linux/version.h> header file. */
 #cmakedefine HAVE_LINUX_VERSION_H 1
 
+/* Define to 1 if you have the <linux/tls.h> header file. */
+#cmakedefine HAVE_LINUX_TLS_H 1
+
 /* Define to 1 if you have sched.h. */
 #cmakedefine HAVE_SCHED 1
 
@@ -105,6 +105,20 @@ BlueStore::Onode, we need to do
 (This is just because we need to name some static variables and we
 can't use :: in a variable name.)
 
+For the types which are allocated and freed at a high rate, such as the
+messages carrying the client and replication ops, use instead
+
+  struct Foo {
+    MEMPOOL_CACHED_CLASS_HELPERS(Foo, osd, 1024);
+    ...
+  };
+
+which needs no factory, also works for class templates, and keeps up to
+that many freed objects (plus a few per thread) for reuse instead of
+giving them back to the allocator. The cached objects are still accounted
+for in the pool, and mempool::dump() shows the hits and misses of each
+cache under "object_caches".
+
 XXX Note: the new operator hard-codes the allocation size to the size of the
 object given in MEMPOOL_DEFINE_OBJECT_FACTORY. For this reason, you cannot
 incorporate mempools into a base class without also defining a helper/factory
@@ -172,6 +186,7 @@ namespace mempool {
   f(osd_pglog)			      \
   f(osdmap)			      \
   f(osdmap_mapping)		      \
+  f(messages)			      \
   f(pgmap)			      \
   f(mds_co)			      \
   f(unittest_1)			      \
@@ -298,6 +313,60 @@ public:
 
 void dump(ceph::Formatter *f);
 
+// --------------------------------------------------------------
+// object_cache_t
+//
+// A cache of freed objects of one type. Each thread keeps a few, and
+// since the threads allocating the objects are often not the ones freeing
+// them (a message is decoded by a messenger thread and freed by the one
+// completing the op), the threads with too many hand them over by batches
+// to a central list, the ones with none pick a batch from there.
+class object_cache_t {
+public:
+  /// the objects a thread keeps, at most twice this
+  static constexpr size_t batch = 32;
+
+  object_cache_t(const std::type_info& type, size_t max_central,
+		 void (*release)(void *));
+  object_cache_t(const object_cache_t&) = delete;
+  object_cache_t& operator=(const object_cache_t&) = delete;
+
+  /// a cached object, nullptr if there is none
+  void *get();
+  /// keep 'p' for reuse, or release it
+  void put(void *p);
+
+  const std::type_info& get_type() const {
+    return type;
+  }
+  void dump(ceph::Formatter *f) const;
+
+  /// give the objects cached by this thread back
+  static void flush_thread();
+
+private:
+  struct stat_shard_t {
+    ceph::atomic<uint64_t> hits = {0};
+    ceph::atomic<uint64_t> misses = {0};
+    char __padding[128 - sizeof(ceph::atomic<uint64_t>)*2];
+  } __attribute__ ((aligned (128)));
+
+  const std::type_info& type;
+  const size_t max_central;
+  void (*release)(void *);
+  size_t index;  ///< in the thread caches
+  stat_shard_t stats[num_shards];
+  mutable std::mutex lock;
+  std::vector<void *> central;
+
+  std::vector<void *>& thread_list();
+  void give_back(std::vector<void *>& list, size_t n);
+};
+
+// the caches are never destroyed, for the threads which outlive the
+// static objects
+std::vector<object_cache_t *> get_object_caches();
+
 
 // STL allocator for use with containers.  All actual state
 // is stored in the static pool_allocator_base_t, which saves us from
@@ -543,6 +612,34 @@ bool operator!=(const std::vector<T, mempool::pool_allocator<pool_index, T>>& lh
   void  operator delete[](void *) { ceph_abort_msg("no array delete"); }
 
 
+// Use this instead of MEMPOOL_CLASS_HELPERS() to keep up to 'max' freed
+// objects of the class in an object_cache_t.
+#define MEMPOOL_CACHED_CLASS_HELPERS(obj,pool,max)			\
+  static mempool::pool::pool_allocator<obj>& _mempool_alloc() {		\
+    static mempool::pool::pool_allocator<obj> alloc{true};		\
+    return alloc;							\
+  }									\
+  static mempool::object_cache_t& _mempool_cache() {			\
+    static auto cache = new mempool::object_cache_t(			\
+      typeid(obj), max,							\
+      [](void *p) { _mempool_alloc().deallocate((obj*)p, 1); });	\
+    return *cache;							\
+  }									\
+  void *operator new(size_t size) {					\
+    ceph_assert(size == sizeof(obj));					\
+    if (void *p = _mempool_cache().get()) {				\
+      return p;								\
+    }									\
+    return _mempool_alloc().allocate(1);				\
+  }									\
+  void *operator new[](size_t size) noexcept {				\
+    ceph_abort_msg("no array new");					\
+    return nullptr; }							\
+  void operator delete(void *p) {					\
+    _mempool_cache().put(p);						\
+  }									\
+  void operator delete[](void *) { ceph_abort_msg("no array delete"); }
+
 // Use this in some particular .cc file to match each class with a
 // MEMPOOL_CLASS_HELPERS().
 #define MEMPOOL_DEFINE_OBJECT_FACTORY(obj,factoryname,pool)		\
@@ -51,6 +51,9 @@
 	(((x) & (CEPH_MSGR2_FEATUREMASK_##name)) == (CEPH_MSGR2_FEATUREMASK_##name))
 
 DEFINE_MSGR2_FEATURE( 0, 1, REVISION_1)   // msgr2.1
+DEFINE_MSGR2_FEATURE( 1, 1, COMPRESSION)  // upstream's, never advertised here
+DEFINE_MSGR2_FEATURE( 2, 1, KTLS)         // secure mode in kernel TLS records
+DEFINE_MSGR2_FEATURE( 3, 1, STREAM_COMPRESSION) // FRAME_EARLY_DATA_STREAM_COMPRESSED
 
 #define CEPH_MSGR2_SUPPORTED_FEATURES (CEPH_MSGR2_FEATURE_REVISION_1)
 
@@ -162,6 +162,20 @@ public:
     return submit_transaction(t);
   }
 
+  /**
+   * Bulk load keys
+   *
+   * Write the keys as a table built aside and added to the store at once,
+   * rather than through the log and the memtable: for loading many keys,
+   * e.g. a whole store. The keys replace those which already exist.
+   *
+   * @returns -EOPNOTSUPP if the backend (or a prefix) does not support it
+   */
+  virtual int ingest(
+    const std::map<std::pair<std::string,std::string>,ceph::buffer::list>& kvs) {
+    return -EOPNOTSUPP;
+  }
+
   /// Retrieve Keys
   virtual int get(
     const std::string &prefix,               ///< [in] Prefix/CF for key
@@ -1,6 +1,8 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <map>
 #include <memory>
@@ -19,6 +21,7 @@
 #include "rocksdb/filter_policy.h"
 #include "rocksdb/utilities/convenience.h"
 #include "rocksdb/merge_operator.h"
+#include "rocksdb/sst_file_writer.h"
 
 #include "common/perf_counters.h"
 #include "common/PriorityCache.h"
@@ -1546,6 +1549,65 @@ int RocksDBStore::submit_transaction_sync(KeyValueDB::Transaction t)
   return result;
 }
 
+int RocksDBStore::ingest(
+  const std::map<std::pair<std::string,std::string>,bufferlist>& kvs)
+{
+  if (kvs.empty()) {
+    return 0;
+  }
+  // the keys of the column families would have to go to a table each
+  for (auto p = kvs.begin(); p != kvs.end();
+       p = kvs.lower_bound({p->first.first + '\0', string()})) {
+    if (cf_handles.count(p->first.first)) {
+      return -EOPNOTSUPP;
+    }
+  }
+  utime_t start = ceph_clock_now();
+  const rocksdb::Options opt = db->GetOptions(default_cf);
+  // a table wants its keys in the order of the comparator
+  std::vector<std::pair<string, const bufferlist*>> keys;
+  keys.reserve(kvs.size());
+  for (auto& [k, v] : kvs) {
+    keys.emplace_back(combine_strings(k.first, k.second), &v);
+  }
+  std::sort(keys.begin(), keys.end(), [&opt](auto& a, auto& b) {
+    return opt.comparator->Compare(a.first, b.first) < 0;
+  });
+
+  static std::atomic<uint64_t> ingest_seq = {0};
+  const string fn = path + "/ingest." + stringify(getpid()) + "." +
+    stringify(++ingest_seq) + ".sst";
+  rocksdb::SstFileWriter writer(rocksdb::EnvOptions(), opt, default_cf);
+  rocksdb::Status status = writer.Open(fn);
+  for (auto p = keys.begin(); status.ok() && p != keys.end(); ++p) {
+    const bufferlist& bl = *p->second;
+    if (bl.is_contiguous() && bl.length() > 0) {
+      status = writer.Put(p->first,
+			  rocksdb::Slice(bl.buffers().front().c_str(),
+					 bl.length()));
+    } else {
+      status = writer.Put(p->first, bl.to_str());
+    }
+  }
+  if (status.ok()) {
+    status = writer.Finish();
+  }
+  if (status.ok()) {
+    // the table is renamed into the store, no copy
+    rocksdb::IngestExternalFileOptions iopt;
+    iopt.move_files = true;
+    status = db->IngestExternalFile(default_cf, {fn}, iopt);
+  }
+  if (!status.ok()) {
+    derr << __func__ << " " << fn << ": " << status.ToString() << dendl;
+    opt.env->DeleteFile(fn);
+    return -EIO;
+  }
+  dout(10) << __func__ << " " << kvs.size() << " keys in "
+	   << (ceph_clock_now() - start) << dendl;
+  return 0;
+}
+
 RocksDBStore::RocksDBTransactionImpl::RocksDBTransactionImpl(RocksDBStore *_db)
 {
   db = _db;
@@ -315,6 +315,9 @@ public:
 
   int submit_transaction(KeyValueDB::Transaction t) override;
   int submit_transaction_sync(KeyValueDB::Transaction t) override;
+  int ingest(
+    const std::map<std::pair<std::string,std::string>,ceph::bufferlist>& kvs)
+    override;
   int get(
     const std::string &prefix,
     const std::set<std::string> &key,
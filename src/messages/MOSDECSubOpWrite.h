@@ -17,6 +17,7 @@
 
 #include "MOSDFastDispatchOp.h"
 #include "osd/ECMsgTypes.h"
+#include "include/mempool.h"
 
 class MOSDECSubOpWrite : public MOSDFastDispatchOp {
 private:
@@ -24,6 +25,8 @@ private:
   static constexpr int COMPAT_VERSION = 1;
 
 public:
+  MEMPOOL_CACHED_CLASS_HELPERS(MOSDECSubOpWrite, messages, 256);
+
   spg_t pgid;
   epoch_t map_epoch = 0, min_epoch = 0;
   ECSubWrite op;
@@ -21,6 +21,7 @@
 #include "MOSDFastDispatchOp.h"
 #include "include/ceph_features.h"
 #include "common/hobject.h"
+#include "include/mempool.h"
 
 /*
  * OSD op
@@ -56,6 +57,8 @@ private:
   std::atomic<bool> final_decode_needed;
   //
 public:
+  MEMPOOL_CACHED_CLASS_HELPERS(MOSDOp, messages, 1024);
+
   V ops;
 private:
   snapid_t snap_seq;
@@ -20,6 +20,7 @@
 
 #include "MOSDOp.h"
 #include "common/errno.h"
+#include "include/mempool.h"
 
 /*
  * OSD op reply
@@ -49,6 +50,8 @@ private:
   request_redirect_t redirect;
 
 public:
+  MEMPOOL_CACHED_CLASS_HELPERS(MOSDOpReply, messages, 1024);
+
   const object_t& get_oid() const { return oid; }
   const pg_t&     get_pg() const { return pgid; }
   int      get_flags() const { return flags; }
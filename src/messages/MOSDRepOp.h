@@ -17,6 +17,7 @@
 #define CEPH_MOSDREPOP_H
 
 #include "MOSDFastDispatchOp.h"
+#include "include/mempool.h"
 
 /*
  * OSD sub op - for internal ops on pobjects between primary and replicas(/stripes/whatever)
@@ -28,6 +29,8 @@ private:
   static constexpr int COMPAT_VERSION = 1;
 
 public:
+  MEMPOOL_CACHED_CLASS_HELPERS(MOSDRepOp, messages, 1024);
+
   epoch_t map_epoch, min_epoch;
 
   // metadata from original request
@@ -18,6 +18,7 @@
 
 #include "MOSDFastDispatchOp.h"
 #include "MOSDRepOp.h"
+#include "include/mempool.h"
 
 /*
  * OSD Client Subop reply
@@ -32,6 +33,8 @@ private:
   static constexpr int HEAD_VERSION = 2;
   static constexpr int COMPAT_VERSION = 1;
 public:
+  MEMPOOL_CACHED_CLASS_HELPERS(MOSDRepOpReply, messages, 1024);
+
   epoch_t map_epoch, min_epoch;
 
   // subop metadata
@@ -833,7 +833,8 @@ PyObject* ActivePyModules::with_perf_counters(
       std::lock_guard l2(metadata->lock);
       if (metadata->perf_counters.instances.count(path)) {
         auto counter_instance = metadata->perf_counters.instances.at(path);
-        auto counter_type = metadata->perf_counters.types.at(path);
+        auto counter_type = metadata->perf_counters.types.with_types(
+          [&path](const auto &types) { return types.at(path); });
         with_gil(no_gil, [&] {
           fct(counter_instance, counter_type, f);
         });
@@ -943,7 +944,11 @@ PyObject* ActivePyModules::get_perf_schema_python(
         for (auto ctr_inst_iter : state->perf_counters.instances) {
           const auto &counter_name = ctr_inst_iter.first;
           f.open_object_section(counter_name.c_str());
-          auto type = state->perf_counters.types[counter_name];
+          auto type = state->perf_counters.types.with_types(
+            [&counter_name](const auto &types) {
+              auto t = types.find(counter_name);
+              return t != types.end() ? t->second : PerfCounterType{};
+            });
           f.dump_string("description", type.description);
           if (!type.nick.empty()) {
             f.dump_string("nick", type.nick);
@@ -587,85 +587,97 @@ bool DaemonServer::handle_report(const ref_t<MMgrReport>& m)
   }
 
 
-  {
-    std::unique_lock locker(lock);
+  // Look up the DaemonState
+  DaemonStatePtr daemon = daemon_state.get(key);
+  if (!daemon) {
+    // we don't know the hostname at this stage, reject MMgrReport here.
+    dout(5) << "rejecting report from " << key << ", since we do not have its metadata now."
+	    << dendl;
+    // issue metadata request in background
+    fetch_missing_metadata(key, m->get_source_addr());
 
-    DaemonStatePtr daemon;
-    // Look up the DaemonState
-    if (daemon_state.exists(key)) {
-      dout(20) << "updating existing DaemonState for " << key << dendl;
-      daemon = daemon_state.get(key);
-    } else {
-      locker.unlock();
+    std::lock_guard locker(lock);
 
-      // we don't know the hostname at this stage, reject MMgrReport here.
-      dout(5) << "rejecting report from " << key << ", since we do not have its metadata now."
-              << dendl;
-      // issue metadata request in background
-      fetch_missing_metadata(key, m->get_source_addr());
+    // kill session
+    auto priv = m->get_connection()->get_priv();
+    auto session = static_cast<MgrSession*>(priv.get());
+    if (!session) {
+      return false;
+    }
+    m->get_connection()->mark_down();
 
-      locker.lock();
+    dout(10) << "unregistering osd." << session->osd_id
+	     << "  session " << session << " con " << m->get_connection() << dendl;
 
-      // kill session
-      auto priv = m->get_connection()->get_priv();
-      auto session = static_cast<MgrSession*>(priv.get());
-      if (!session) {
-        return false;
-      }
-      m->get_connection()->mark_down();
+    if (osd_cons.find(session->osd_id) != osd_cons.end()) {
+      osd_cons[session->osd_id].erase(m->get_connection());
+    }
 
-      dout(10) << "unregistering osd." << session->osd_id
-               << "  session " << session << " con " << m->get_connection() << dendl;
-      
-      if (osd_cons.find(session->osd_id) != osd_cons.end()) {
-        osd_cons[session->osd_id].erase(m->get_connection());
-      }
+    auto iter = daemon_connections.find(m->get_connection());
+    if (iter != daemon_connections.end()) {
+      daemon_connections.erase(iter);
+    }
 
-      auto iter = daemon_connections.find(m->get_connection());
-      if (iter != daemon_connections.end()) {
-        daemon_connections.erase(iter);
-      }
+    return false;
+  }
+  dout(20) << "updating existing DaemonState for " << key << dendl;
 
-      return false;
-    }
+  // Decode the report before taking any lock: the reports are handled
+  // without ::lock, and the python modules read the DaemonState with its
+  // lock. The types have a lock of their own, the session is only updated
+  // by the reports.
+  auto priv = m->get_connection()->get_priv();
+  auto session = static_cast<MgrSession*>(priv.get());
+  if (!session) {
+    return false;
+  }
+  auto counters = DaemonPerfCounters::decode(daemon_state.types,
+					     session->declared_types, *m);
+  decltype(daemon->config) config;
+  decltype(daemon->ignored_mon_config) ignored_mon_config;
+  auto p = m->config_bl.cbegin();
+  const bool has_config = p != m->config_bl.end();
+  if (has_config) {
+    decode(config, p);
+    decode(ignored_mon_config, p);
+    dout(20) << " got config " << config
+	     << " ignored " << ignored_mon_config << dendl;
+  }
 
-    // Update the DaemonState
-    ceph_assert(daemon != nullptr);
-    {
-      std::lock_guard l(daemon->lock);
-      auto &daemon_counters = daemon->perf_counters;
-      daemon_counters.update(*m.get());
-
-      auto p = m->config_bl.cbegin();
-      if (p != m->config_bl.end()) {
-        decode(daemon->config, p);
-        decode(daemon->ignored_mon_config, p);
-        dout(20) << " got config " << daemon->config
-                 << " ignored " << daemon->ignored_mon_config << dendl;
-      }
+  // Update the DaemonState
+  {
+    std::lock_guard l(daemon->lock);
+    daemon->perf_counters.update(counters);
 
-      utime_t now = ceph_clock_now();
-      if (daemon->service_daemon) {
-        if (m->daemon_status) {
-          daemon->service_status_stamp = now;
-          daemon->service_status = *m->daemon_status;
-        }
-        daemon->last_service_beacon = now;
-      } else if (m->daemon_status) {
-        derr << "got status from non-daemon " << key << dendl;
-      }
-      // update task status
-      if (m->task_status) {
-        update_task_status(key, *m->task_status);
-        daemon->last_service_beacon = now;
-      }
-      if (m->get_connection()->peer_is_osd() || m->get_connection()->peer_is_mon()) {
-        // only OSD and MON send health_checks to me now
-        daemon->daemon_health_metrics = std::move(m->daemon_health_metrics);
-        dout(10) << "daemon_health_metrics " << daemon->daemon_health_metrics
-                 << dendl;
+    if (has_config) {
+      daemon->config = std::move(config);
+      daemon->ignored_mon_config = std::move(ignored_mon_config);
+    }
+
+    utime_t now = ceph_clock_now();
+    if (daemon->service_daemon) {
+      if (m->daemon_status) {
+	daemon->service_status_stamp = now;
+	daemon->service_status = *m->daemon_status;
       }
+      daemon->last_service_beacon = now;
+    } else if (m->daemon_status) {
+      derr << "got status from non-daemon " << key << dendl;
     }
+    if (m->task_status) {
+      daemon->last_service_beacon = now;
+    }
+    if (m->get_connection()->peer_is_osd() || m->get_connection()->peer_is_mon()) {
+      // only OSD and MON send health_checks to me now
+      daemon->daemon_health_metrics = std::move(m->daemon_health_metrics);
+      dout(10) << "daemon_health_metrics " << daemon->daemon_health_metrics
+	       << dendl;
+    }
+  }
+  // update task status
+  if (m->task_status) {
+    std::lock_guard l(lock);
+    update_task_status(key, *m->task_status);
   }
 
   // if there are any schema updates, notify the python modules
@@ -15,7 +15,6 @@
 
 #include <experimental/iterator>
 
-#include "MgrSession.h"
 #include "include/stringify.h"
 #include "common/Formatter.h"
 
@@ -318,55 +317,71 @@ void DaemonStateIndex::cull_services(const std::set<std::string>& types_exist)
   }
 }
 
-void DaemonPerfCounters::update(const MMgrReport& report)
+DaemonPerfCounters::Update DaemonPerfCounters::decode(
+  PerfCounterTypes& types,
+  std::set<std::string>& declared_types,
+  const MMgrReport& report)
 {
   dout(20) << "loading " << report.declare_types.size() << " new types, "
 	   << report.undeclare_types.size() << " old types, had "
 	   << types.size() << " types, got "
            << report.packed.length() << " bytes of data" << dendl;
 
-  // Retrieve session state
-  auto priv = report.get_connection()->get_priv();
-  auto session = static_cast<MgrSession*>(priv.get());
-
   // Load any newly declared types
+  if (!report.declare_types.empty()) {
+    types.insert(report.declare_types);
+  }
   for (const auto &t : report.declare_types) {
-    types.insert(std::make_pair(t.path, t));
-    session->declared_types.insert(t.path);
+    declared_types.insert(t.path);
   }
   // Remove any old types
   for (const auto &t : report.undeclare_types) {
-    session->declared_types.erase(t);
+    declared_types.erase(t);
   }
 
-  const auto now = ceph_clock_now();
+  Update u;
+  u.stamp = ceph_clock_now();
+  u.values.reserve(declared_types.size());
 
   // Parse packed data according to declared set of types
   auto p = report.packed.cbegin();
   DECODE_START(1, p);
-  for (const auto &t_path : session->declared_types) {
-    const auto &t = types.at(t_path);
-    auto instances_it = instances.find(t_path);
+  types.with_types([&](const auto &types) {
+    for (const auto &t_path : declared_types) {
+      const auto t = types.find(t_path);
+      ceph_assert(t != types.end());
+      uint64_t val = 0;
+      uint64_t avgcount = 0;
+      uint64_t avgcount2 = 0;
+
+      decode(val, p);
+      if (t->second.type & PERFCOUNTER_LONGRUNAVG) {
+	decode(avgcount, p);
+	decode(avgcount2, p);
+      }
+      u.values.push_back({&t->first, t->second.type, val, avgcount});
+    }
+  });
+  DECODE_FINISH(p);
+  return u;
+}
+
+void DaemonPerfCounters::update(const Update& u)
+{
+  for (const auto &v : u.values) {
+    auto instances_it = instances.find(*v.path);
     // Always check the instance exists, as we don't prevent yet
     // multiple sessions from daemons with the same name, and one
     // session clearing stats created by another on open.
     if (instances_it == instances.end()) {
-      instances_it = instances.insert({t_path, t.type}).first;
+      instances_it = instances.insert({*v.path, v.type}).first;
     }
-    uint64_t val = 0;
-    uint64_t avgcount = 0;
-    uint64_t avgcount2 = 0;
-
-    decode(val, p);
-    if (t.type & PERFCOUNTER_LONGRUNAVG) {
-      decode(avgcount, p);
-      decode(avgcount2, p);
-      instances_it->second.push_avg(now, val, avgcount);
+    if (v.type & PERFCOUNTER_LONGRUNAVG) {
+      instances_it->second.push_avg(u.stamp, v.val, v.avgcount);
     } else {
-      instances_it->second.push(now, val);
+      instances_it->second.push(u.stamp, v.val);
     }
   }
-  DECODE_FINISH(p);
 }
 
 void PerfCounterInstance::push(utime_t t, uint64_t const &v)
@@ -18,8 +18,11 @@
 #include <string>
 #include <memory>
 #include <set>
+#include <vector>
 #include <boost/circular_buffer.hpp>
 
+#include "common/ceph_mutex.h"
+#include "common/sharded_shared_mutex.h"
 #include "include/str_map.h"
 
 #include "msg/msg_types.h"
@@ -92,7 +95,37 @@ class PerfCounterInstance
 };
 
 
-typedef std::map<std::string, PerfCounterType> PerfCounterTypes;
+// The record of perf stat types, shared between daemons: added to by the
+// reports outside of any DaemonState::lock, while the python modules read
+// it. Never removed from, so the keys stay valid.
+class PerfCounterTypes
+{
+  mutable ceph::shared_mutex lock =
+    ceph::make_shared_mutex("PerfCounterTypes::lock");
+  std::map<std::string, PerfCounterType> types;
+
+  public:
+  void insert(const std::vector<PerfCounterType>& declared)
+  {
+    std::unique_lock l(lock);
+    for (const auto &t : declared) {
+      types.insert(std::make_pair(t.path, t));
+    }
+  }
+
+  size_t size() const
+  {
+    std::shared_lock l(lock);
+    return types.size();
+  }
+
+  template<typename Callback, typename...Args>
+  auto with_types(Callback&& cb, Args&&...args) const
+  {
+    std::shared_lock l(lock);
+    return std::forward<Callback>(cb)(types, std::forward<Args>(args)...);
+  }
+};
 
 // Performance counters for one daemon
 class DaemonPerfCounters
@@ -107,7 +140,29 @@ class DaemonPerfCounters
 
   std::map<std::string, PerfCounterInstance> instances;
 
-  void update(const MMgrReport& report);
+  /// The values of an MMgrReport, decoded without holding DaemonState::lock
+  struct Update {
+    struct Value {
+      const std::string *path;  ///< key of the type in PerfCounterTypes
+      enum perfcounter_type_d type;
+      uint64_t val;
+      uint64_t avgcount;
+    };
+    utime_t stamp;
+    std::vector<Value> values;
+  };
+
+  /**
+   * Decode the values of a report.
+   *
+   * @param declared_types the counters declared by the session of the
+   *                       daemon, updated with those of the report
+   */
+  static Update decode(PerfCounterTypes& types,
+		       std::set<std::string>& declared_types,
+		       const MMgrReport& report);
+  /// Apply decoded values, with DaemonState::lock
+  void update(const Update& u);
 
   void clear()
   {
@@ -251,8 +306,9 @@ private:
 class DaemonStateIndex
 {
 private:
-  mutable ceph::shared_mutex lock =
-    ceph::make_shared_mutex("DaemonStateIndex", true, true, true);
+  // taken shared for each report, and by the python modules
+  mutable ceph::sharded_shared_mutex lock =
+    ceph::make_sharded_shared_mutex("DaemonStateIndex", true, true, true);
 
   std::map<std::string, DaemonStateCollection> by_server;
   DaemonStateCollection all;
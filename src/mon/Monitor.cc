@@ -193,6 +193,10 @@ Monitor::Monitor(CephContext* cct_, string nm, MonitorDBStore *s,
   sync_full(false),
   sync_start_version(0),
   sync_timeout_event(NULL),
+  sync_chunks_in_flight(0),
+  sync_bytes(0),
+  sync_chunk_event(NULL),
+  sync_ingest_bytes(0),
   sync_last_committed_floor(0),
 
   timecheck_round(0),
@@ -1439,11 +1443,20 @@ void Monitor::sync_reset_requester()
     timer.cancel_event(sync_timeout_event);
     sync_timeout_event = NULL;
   }
+  if (sync_chunk_event) {
+    timer.cancel_event(sync_chunk_event);
+    sync_chunk_event = NULL;
+  }
 
   sync_provider = entity_addrvec_t();
   sync_cookie = 0;
   sync_full = false;
   sync_start_version = 0;
+  sync_chunks_in_flight = 0;
+  sync_bytes = 0;
+  // a full sync starts over anyway
+  sync_ingest.clear();
+  sync_ingest_bytes = 0;
 }
 
 void Monitor::sync_reset_provider()
@@ -1752,6 +1765,9 @@ void Monitor::handle_sync_cookie(MonOpRequestRef op)
   }
   sync_cookie = m->cookie;
   sync_start_version = m->last_committed;
+  sync_chunks_in_flight = 0;
+  sync_bytes = 0;
+  sync_stamp = ceph_clock_now();
 
   sync_reset_timeout();
   sync_get_next_chunk();
@@ -1761,15 +1777,57 @@ void Monitor::handle_sync_cookie(MonOpRequestRef op)
 
 void Monitor::sync_get_next_chunk()
 {
-  dout(20) << __func__ << " cookie " << sync_cookie << " provider " << sync_provider << dendl;
-  if (g_conf()->mon_inject_sync_get_chunk_delay > 0) {
-    dout(20) << __func__ << " injecting delay of " << g_conf()->mon_inject_sync_get_chunk_delay << dendl;
-    usleep((long long)(g_conf()->mon_inject_sync_get_chunk_delay * 1000000.0));
+  dout(20) << __func__ << " cookie " << sync_cookie << " provider " << sync_provider
+	   << " in flight " << sync_chunks_in_flight << dendl;
+  if (sync_chunk_event) {
+    // throttled
+    return;
+  }
+  // the provider answers the requests in order, each with the chunk
+  // after the one of the previous request: keep a few requested ahead
+  // for it to read the next chunks while we write those we received
+  const unsigned max_in_flight =
+    g_conf().get_val<uint64_t>("mon_sync_max_chunks_in_flight");
+  const uint64_t max_bandwidth =
+    g_conf().get_val<Option::size_t>("mon_sync_max_bandwidth");
+  while (sync_chunks_in_flight < std::max(max_in_flight, 1u)) {
+    if (max_bandwidth > 0) {
+      double ahead = (double)sync_bytes / max_bandwidth -
+	(double)(ceph_clock_now() - sync_stamp);
+      if (ahead > 0) {
+	dout(20) << __func__ << " throttled for " << ahead << "s, "
+		 << byte_u_t(sync_bytes) << " received" << dendl;
+	sync_chunk_event = timer.add_event_after(
+	  ahead,
+	  new C_MonContext{this, [this](int) {
+	      sync_chunk_event = NULL;
+	      sync_get_next_chunk();
+	    }});
+	return;
+      }
+    }
+    if (g_conf()->mon_inject_sync_get_chunk_delay > 0) {
+      dout(20) << __func__ << " injecting delay of " << g_conf()->mon_inject_sync_get_chunk_delay << dendl;
+      usleep((long long)(g_conf()->mon_inject_sync_get_chunk_delay * 1000000.0));
+    }
+    MMonSync *r = new MMonSync(MMonSync::OP_GET_CHUNK, sync_cookie);
+    messenger->send_to_mon(r, sync_provider);
+    ++sync_chunks_in_flight;
+
+    ceph_assert(g_conf()->mon_sync_requester_kill_at != 4);
   }
-  MMonSync *r = new MMonSync(MMonSync::OP_GET_CHUNK, sync_cookie);
-  messenger->send_to_mon(r, sync_provider);
+}
 
-  ceph_assert(g_conf()->mon_sync_requester_kill_at != 4);
+void Monitor::sync_flush_ingest()
+{
+  if (sync_ingest.empty()) {
+    return;
+  }
+  dout(10) << __func__ << " " << sync_ingest.size() << " keys, "
+	   << byte_u_t(sync_ingest_bytes) << dendl;
+  store->ingest(sync_ingest);
+  sync_ingest.clear();
+  sync_ingest_bytes = 0;
 }
 
 void Monitor::handle_sync_chunk(MonOpRequestRef op)
@@ -1789,6 +1847,11 @@ void Monitor::handle_sync_chunk(MonOpRequestRef op)
   ceph_assert(state == STATE_SYNCHRONIZING);
   ceph_assert(g_conf()->mon_sync_requester_kill_at != 5);
 
+  if (sync_chunks_in_flight > 0) {
+    --sync_chunks_in_flight;
+  }
+  sync_bytes += m->chunk_bl.length();
+
   auto tx(std::make_shared<MonitorDBStore::Transaction>());
   tx->append_from_encoded(m->chunk_bl);
 
@@ -1798,7 +1861,27 @@ void Monitor::handle_sync_chunk(MonOpRequestRef op)
   f.flush(*_dout);
   *_dout << dendl;
 
-  store->apply_transaction(tx);
+  // the store is being rebuilt from scratch, and we sync it again from
+  // the start if we fail before the end: rather than writing each chunk,
+  // gather the keys to write them together, bypassing the log
+  const uint64_t ingest_size =
+    g_conf().get_val<Option::size_t>("mon_sync_ingest_size");
+  bool ingest = sync_full && ingest_size > 0 &&
+    std::all_of(tx->ops.begin(), tx->ops.end(), [](auto& op) {
+      return op.type == MonitorDBStore::Transaction::OP_PUT;
+    });
+  if (ingest) {
+    for (auto& op : tx->ops) {
+      sync_ingest_bytes += op.approx_size();
+      sync_ingest[{op.prefix, op.key}] = std::move(op.bl);
+    }
+    if (sync_ingest_bytes >= ingest_size) {
+      sync_flush_ingest();
+    }
+  } else {
+    sync_flush_ingest();
+    store->apply_transaction(tx);
+  }
 
   ceph_assert(g_conf()->mon_sync_requester_kill_at != 6);
 
@@ -1823,13 +1906,21 @@ void Monitor::handle_sync_chunk(MonOpRequestRef op)
     sync_reset_timeout();
     sync_get_next_chunk();
   } else if (m->op == MMonSync::OP_LAST_CHUNK) {
+    sync_flush_ingest();
     sync_finish(m->last_committed);
   }
 }
 
 void Monitor::handle_sync_no_cookie(MonOpRequestRef op)
 {
+  auto m = op->get_req<MMonSync>();
   dout(10) << __func__ << dendl;
+  if (m->cookie != sync_cookie) {
+    // the provider forgot about our cookie once it sent the last chunk:
+    // this is the answer to a chunk we requested ahead
+    dout(10) << __func__ << " cookie does not match, discarding" << dendl;
+    return;
+  }
   bootstrap();
 }
 
@@ -5197,6 +5288,11 @@ void Monitor::handle_subscribe(MonOpRequestRef op)
   MonSession *s = op->get_session();
   ceph_assert(s);
 
+  // the subscriptions are served from our own store, lease or not
+  if (is_peon()) {
+    paxos->logger->inc(l_paxos_peon_local);
+  }
+
   if (m->hostname.size()) {
     s->remote_host = m->hostname;
   }
@@ -5311,10 +5407,16 @@ void Monitor::handle_get_version(MonOpRequestRef op)
 
   if (svc) {
     if (!svc->is_readable()) {
+      if (is_peon()) {
+	paxos->logger->inc(l_paxos_peon_wait);
+      }
       svc->wait_for_readable(op, new C_RetryMessage(this, op));
       goto out;
     }
 
+    if (is_peon()) {
+      paxos->logger->inc(l_paxos_peon_local);
+    }
     MMonGetVersionReply *reply = new MMonGetVersionReply();
     reply->handle = m->handle;
     reply->version = svc->get_last_committed();
@@ -369,6 +369,13 @@ private:
   bool sync_full;                ///< true if we are a full sync, false for recent catch-up
   version_t sync_start_version;  ///< last_committed at sync start
   Context *sync_timeout_event;   ///< timeout event
+  unsigned sync_chunks_in_flight; ///< chunks requested and not received yet
+  uint64_t sync_bytes;           ///< bytes received since sync_stamp
+  utime_t sync_stamp;            ///< when we got our cookie
+  Context *sync_chunk_event;     ///< delayed chunk request, to throttle
+  /// keys of a full sync not in the store yet, to ingest them together
+  std::map<std::pair<std::string,std::string>,ceph::buffer::list> sync_ingest;
+  uint64_t sync_ingest_bytes;
 
   /**
    * floor for sync source
@@ -479,10 +486,18 @@ private:
   void sync_finish(version_t last_committed);
 
   /**
-   * request the next chunk from the provider
+   * request the next chunks from the provider
+   *
+   * Up to mon_sync_max_chunks_in_flight are requested ahead, unless we
+   * are receiving more than mon_sync_max_bandwidth.
    */
   void sync_get_next_chunk();
 
+  /**
+   * write the keys of a full sync gathered so far
+   */
+  void sync_flush_ingest();
+
   /**
    * handle sync message
    *
@@ -353,6 +353,30 @@ class MonitorDBStore
     return r;
   }
 
+  /**
+   * Bulk load keys, e.g. those received while syncing the whole store
+   *
+   * The keys are written as a table added to the store at once if the
+   * backend can do that, in a transaction otherwise.
+   */
+  int ingest(
+    const std::map<std::pair<std::string,std::string>,ceph::buffer::list>& kvs) {
+    if (!do_dump) {
+      int r = db->ingest(kvs);
+      if (r != -EOPNOTSUPP) {
+	if (r < 0) {
+	  ceph_abort_msg("failed to write to db");
+	}
+	return r;
+      }
+    }
+    auto t(std::make_shared<Transaction>());
+    for (auto& [k, v] : kvs) {
+      t->put(k.first, k.second, v);
+    }
+    return apply_transaction(t);
+  }
+
   struct C_DoTransaction : public Context {
     MonitorDBStore *store;
     MonitorDBStore::TransactionRef t;
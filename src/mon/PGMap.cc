@@ -1123,8 +1123,20 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
   version++;
 
   pool_stat_t pg_sum_old = pg_sum;
+  // the sums of the pools we change, as they were before, and the pools
+  // we create: those of the other pools do not need to be copied
   mempool::pgmap::unordered_map<int32_t, pool_stat_t> pg_pool_sum_old;
-  pg_pool_sum_old = pg_pool_sum;
+  set<int64_t> new_pools;
+  auto note_pool = [&](int64_t pool) {
+    if (pg_pool_sum_old.count(pool) || new_pools.count(pool)) {
+      return;
+    }
+    if (auto i = pg_pool_sum.find(pool); i != pg_pool_sum.end()) {
+      pg_pool_sum_old.emplace(pool, i->second);
+    } else {
+      new_pools.insert(pool);
+    }
+  };
 
   for (auto p = inc.pg_stat_updates.begin();
        p != inc.pg_stat_updates.end();
@@ -1133,6 +1145,7 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
     auto update_pool = update_pg.pool();
     const pg_stat_t &update_stat(p->second);
 
+    note_pool(update_pool);
     auto pg_stat_iter = pg_stat.find(update_pg);
     pool_stat_t &pool_sum_ref = pg_pool_sum[update_pool];
     if (pg_stat_iter == pg_stat.end()) {
@@ -1156,6 +1169,7 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
     auto pool_statfs_iter =
       pool_statfs.find(std::make_pair(update_pool, update_osd));
     if (pg_pool_sum.count(update_pool)) {
+      note_pool(update_pool);
       pool_stat_t &pool_sum_ref = pg_pool_sum[update_pool];
       if (pool_statfs_iter == pool_statfs.end()) {
         pool_statfs.emplace(std::make_pair(update_pool, update_osd), statfs_inc);
@@ -1195,6 +1209,7 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
       // decrease pool stats if pg was removed
       auto pool_stats_it = pg_pool_sum.find(removed_pg.pool());
       if (pool_stats_it != pg_pool_sum.end()) {
+        note_pool(removed_pg.pool());
         pool_stats_it->second.sub(s->second);
       }
 
@@ -1213,10 +1228,13 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
       stat_osd_sub(t->first, t->second);
       osd_stat.erase(t);
     }
-    for (auto i = pool_statfs.begin();  i != pool_statfs.end(); ++i) {
+    for (auto i = pool_statfs.begin();  i != pool_statfs.end();) {
       if (i->first.second == *p) {
+	note_pool(i->first.first);
 	pg_pool_sum[i->first.first].sub(i->second);
-	pool_statfs.erase(i);
+	i = pool_statfs.erase(i);
+      } else {
+	++i;
       }
     }
   }
@@ -1242,7 +1260,7 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
   }
   stamp = inc.stamp;
 
-  update_pool_deltas(cct, inc.stamp, pg_pool_sum_old);
+  update_pool_deltas(cct, inc.stamp, pg_pool_sum_old, new_pools);
 
   for (auto p : deleted_pools) {
     if (cct)
@@ -1271,6 +1289,9 @@ void PGMap::calc_stats()
   num_pg_by_state.clear();
   num_pg_by_pool_state.clear();
   num_pg_by_osd.clear();
+  purged_snaps.clear();
+  purged_snaps_bounds.clear();
+  purged_snaps_dirty.clear();
 
   for (auto p = pg_stat.begin();
        p != pg_stat.end();
@@ -1301,6 +1322,7 @@ void PGMap::stat_pg_add(const pg_t &pgid, const pg_stat_t &s,
   num_pg_by_state[s.state]++;
   num_pg_by_pool_state[pgid.pool()][s.state]++;
   num_pg_by_pool[pool]++;
+  stat_pg_purged_snaps(pgid, s, 1);
 
   if ((s.state & PG_STATE_CREATING) &&
       s.parent_split_bits == 0) {
@@ -1361,6 +1383,7 @@ bool PGMap::stat_pg_sub(const pg_t &pgid, const pg_stat_t &s,
   if (end == 0) {
     pool_erased = true;
   }
+  stat_pg_purged_snaps(pgid, s, -1);
 
   if ((s.state & PG_STATE_CREATING) &&
       s.parent_split_bits == 0) {
@@ -1426,26 +1449,62 @@ bool PGMap::stat_pg_sub(const pg_t &pgid, const pg_stat_t &s,
   return pool_erased;
 }
 
+void PGMap::stat_pg_purged_snaps(const pg_t &pgid, const pg_stat_t &s,
+				 int n)
+{
+  const auto pool = pgid.pool();
+  purged_snaps_dirty.insert(pool);
+  if (s.purged_snaps.empty()) {
+    return;
+  }
+  auto& bounds = purged_snaps_bounds[pool];
+  auto bump = [&bounds](snapid_t snap, int32_t d) {
+    auto [i, inserted] = bounds.emplace(snap, d);
+    if (!inserted && (i->second += d) == 0) {
+      bounds.erase(i);
+    }
+  };
+  for (auto i = s.purged_snaps.begin(); i != s.purged_snaps.end(); ++i) {
+    bump(i.get_start(), n);
+    bump(i.get_end(), -n);
+  }
+  if (bounds.empty()) {
+    purged_snaps_bounds.erase(pool);
+  }
+}
+
 void PGMap::calc_purged_snaps()
 {
-  purged_snaps.clear();
-  set<int64_t> unknown;
-  for (auto& i : pg_stat) {
-    if (i.second.state == 0) {
-      unknown.insert(i.first.pool());
-      purged_snaps.erase(i.first.pool());
+  // the snaps purged by all the PGs of a pool, unless the state of some
+  // of them is unknown
+  for (auto pool : purged_snaps_dirty) {
+    purged_snaps.erase(pool);
+    auto n = num_pg_by_pool.find(pool);
+    if (n == num_pg_by_pool.end() || n->second == 0) {
       continue;
-    } else if (unknown.count(i.first.pool())) {
+    }
+    if (auto s = num_pg_by_pool_state.find(pool);
+	s != num_pg_by_pool_state.end() && s->second.count(0)) {
       continue;
     }
-    auto j = purged_snaps.find(i.first.pool());
-    if (j == purged_snaps.end()) {
-      // base case
-      purged_snaps[i.first.pool()] = i.second.purged_snaps;
-    } else {
-      j->second.intersection_of(i.second.purged_snaps);
+    auto& r = purged_snaps[pool];
+    auto b = purged_snaps_bounds.find(pool);
+    if (b == purged_snaps_bounds.end()) {
+      continue;
+    }
+    int64_t count = 0;
+    snapid_t start;
+    for (auto& [snap, d] : b->second) {
+      if (count == n->second) {
+	r.insert(start, snap - start);
+      }
+      count += d;
+      if (count == n->second) {
+	start = snap;
+      }
     }
   }
+  purged_snaps_dirty.clear();
 }
 
 void PGMap::calc_osd_sum_by_class(const OSDMap& osdmap)
@@ -2195,11 +2254,18 @@ void PGMap::update_one_pool_delta(
  */
 void PGMap::update_pool_deltas(
   CephContext *cct, const utime_t ts,
-  const mempool::pgmap::unordered_map<int32_t,pool_stat_t>& pg_pool_sum_old)
+  const mempool::pgmap::unordered_map<int32_t,pool_stat_t>& pg_pool_sum_old,
+  const set<int64_t>& new_pools)
 {
-  for (auto it = pg_pool_sum_old.begin();
-       it != pg_pool_sum_old.end(); ++it) {
-    update_one_pool_delta(cct, ts, it->first, it->second);
+  for (auto& [pool, sum] : pg_pool_sum) {
+    if (new_pools.count(pool)) {
+      continue;
+    }
+    // a pool which did not change still gets its (null) delta, for its
+    // rates to decay
+    auto old = pg_pool_sum_old.find(pool);
+    update_one_pool_delta(cct, ts, pool,
+			  old != pg_pool_sum_old.end() ? old->second : sum);
   }
 }
 
@@ -306,13 +306,27 @@ public:
   mempool::pgmap::unordered_map<int,int> blocked_by_sum;
   mempool::pgmap::list<std::pair<pool_stat_t, utime_t> > pg_sum_deltas;
   mempool::pgmap::unordered_map<int64_t,mempool::pgmap::unordered_map<uint64_t,int32_t>> num_pg_by_pool_state;
+  /**
+   * For each pool, how many of its PGs purged each snap, as the changes
+   * of that count at the bounds of the purged intervals of the PGs: the
+   * intersection calc_purged_snaps() looks for is where the count is the
+   * number of PGs of the pool.
+   */
+  mempool::pgmap::unordered_map<int64_t,mempool::pgmap::map<snapid_t,int32_t>> purged_snaps_bounds;
+  /// the pools whose purged_snaps calc_purged_snaps() has to compute again
+  mempool::pgmap::set<int64_t> purged_snaps_dirty;
 
   utime_t stamp;
 
+  /**
+   * Update the deltas of all the pools; those not in @p pg_pool_sum_old
+   * did not change, and those in @p new_pools did not exist before.
+   */
   void update_pool_deltas(
     CephContext *cct,
     const utime_t ts,
-    const mempool::pgmap::unordered_map<int32_t, pool_stat_t>& pg_pool_sum_old);
+    const mempool::pgmap::unordered_map<int32_t, pool_stat_t>& pg_pool_sum_old,
+    const std::set<int64_t>& new_pools);
   void clear_delta();
 
   void deleted_pool(int64_t pool) {
@@ -327,6 +341,8 @@ public:
     pg_pool_sum.erase(pool);
     num_pg_by_pool_state.erase(pool);
     num_pg_by_pool.erase(pool);
+    purged_snaps_bounds.erase(pool);
+    purged_snaps_dirty.insert(pool);
     per_pool_sum_deltas.erase(pool);
     per_pool_sum_deltas_stamps.erase(pool);
     per_pool_sum_delta.erase(pool);
@@ -424,7 +440,11 @@ public:
 		   bool sameosds=false);
   bool stat_pg_sub(const pg_t &pgid, const pg_stat_t &s,
 		   bool sameosds=false);
+  /// update purged_snaps for the pools whose PGs changed since the last call
+  /// (purged_snaps_dirty)
   void calc_purged_snaps();
+  /// account for the purged snaps of a PG, with @p n 1 to add, -1 to remove
+  void stat_pg_purged_snaps(const pg_t &pgid, const pg_stat_t &s, int n);
   void calc_osd_sum_by_class(const OSDMap& osdmap);
   void stat_osd_add(int osd, const osd_stat_t &s);
   void stat_osd_sub(int osd, const osd_stat_t &s);
@@ -15,6 +15,7 @@
 #include <sstream>
 #include "Paxos.h"
 #include "Monitor.h"
+#include "PaxosService.h"
 #include "messages/MMonPaxos.h"
 
 #include "mon/mon_types.h"
@@ -132,6 +133,11 @@ void Paxos::init_logger()
   pcb.add_u64_avg(l_paxos_share_state_bytes, "share_state_bytes", "Data in shared state", NULL, 0, unit_t(UNIT_BYTES));
   pcb.add_u64_counter(l_paxos_new_pn, "new_pn", "New proposal number queries");
   pcb.add_time_avg(l_paxos_new_pn_latency, "new_pn_latency", "New proposal number getting latency");
+  pcb.add_u64_avg(l_paxos_begin_proposals, "begin_proposals", "Proposals batched in transaction on begin");
+  pcb.add_u64_counter(l_paxos_begin_joined, "begin_joined", "Delayed service proposals joining a begin");
+  pcb.add_u64_counter(l_paxos_peon_local, "peon_local", "Requests a peon answered from its own store");
+  pcb.add_u64_counter(l_paxos_peon_wait, "peon_wait", "Requests a peon deferred until a lease or a commit");
+  pcb.add_u64_counter(l_paxos_peon_forward, "peon_forward", "Requests a peon forwarded to the leader");
   logger = pcb.create_perf_counters();
   g_ceph_context->get_perfcounters_collection()->add(logger);
 }
@@ -731,6 +737,7 @@ void Paxos::handle_begin(MonOpRequestRef op)
   // set state.
   state = STATE_UPDATING;
   lease_expire = {};  // cancel lease
+  lease_valid_until = {};
 
   // yes.
   version_t v = last_committed+1;
@@ -899,6 +906,7 @@ void Paxos::commit_finish()
   //  (this would only happen if message layer lost the 'begin', but
   //   leader still got a majority and committed with out us.)
   lease_expire = {};  // cancel lease
+  lease_valid_until = {};
 
   last_committed++;
   last_commit_time = ceph_clock_now();
@@ -978,6 +986,8 @@ void Paxos::extend_lease()
 
   lease_expire = ceph::real_clock::now();
   lease_expire += ceph::make_timespan(g_conf()->mon_lease);
+  lease_valid_until = ceph::mono_clock::now() +
+    ceph::make_timespan(g_conf()->mon_lease);
   acked_lease.clear();
   acked_lease.insert(mon.rank);
 
@@ -1079,12 +1089,17 @@ void Paxos::finish_round()
   // ok, now go active!
   state = STATE_ACTIVE;
 
+  // the services and the messages woken up here all add to the pending
+  // proposal, which we begin below, rather than the first of them
+  // beginning a round that the others then wait for
+  plug();
   dout(20) << __func__ << " waiting_for_acting" << dendl;
   finish_contexts(g_ceph_context, waiting_for_active);
   dout(20) << __func__ << " waiting_for_readable" << dendl;
   finish_contexts(g_ceph_context, waiting_for_readable);
   dout(20) << __func__ << " waiting_for_writeable" << dendl;
   finish_contexts(g_ceph_context, waiting_for_writeable);
+  unplug();
   
   dout(10) << __func__ << " done w/ waiters, state " << get_statename(state) << dendl;
 
@@ -1098,6 +1113,24 @@ void Paxos::finish_round()
 }
 
 
+double Paxos::get_lease_remaining(double sent, double expire,
+				  double recv, double now, double skew,
+				  double margin, double max_lease)
+{
+  // how long the lease took to reach us: we count on it being less than
+  // the margin deducted below
+  if (recv - (sent + skew) > margin) {
+    return 0;
+  }
+  // the duration is measured on the clock of the leader, and we count it
+  // on ours from when we received the lease: neither depends on the skew
+  double age = std::max(0.0, now - recv);
+  double remaining = std::min(expire - sent, max_lease) - margin - age;
+  // nor do we keep the lease past its expiration on the leader's clock
+  remaining = std::min(remaining, expire + skew - margin - now);
+  return std::max(remaining, 0.0);
+}
+
 // peon
 void Paxos::handle_lease(MonOpRequestRef op)
 {
@@ -1125,6 +1158,32 @@ void Paxos::handle_lease(MonOpRequestRef op)
       derr << "lease_expire from " << lease->get_source_inst() << " is " << diff << " seconds in the past; mons are probably laggy (or possibly clocks are too skewed)" << dendl;
     }
   }
+  // the lease started when the leader sent it, at most a round trip
+  // before we got it; the skew measured by the time checks leaves at most
+  // mon_clock_drift_allowed to account for
+  double margin = g_conf()->mon_clock_drift_allowed;
+  if (auto p = mon.timecheck_latencies.find(mon.rank);
+      p != mon.timecheck_latencies.end()) {
+    margin = std::max(margin, p->second);
+  }
+  double skew = 0;
+  if (auto p = mon.timecheck_skews.find(mon.rank);
+      p != mon.timecheck_skews.end()) {
+    skew = p->second;
+  }
+  double remaining = get_lease_remaining(
+    (double)lease->sent_timestamp, (double)lease->lease_timestamp,
+    (double)lease->get_recv_stamp(), (double)ceph_clock_now(), skew,
+    margin, g_conf()->mon_lease);
+  if (remaining > 0) {
+    auto valid_until = ceph::mono_clock::now() +
+      ceph::make_timespan(remaining);
+    lease_valid_until = std::max(lease_valid_until, valid_until);
+  }
+  dout(20) << __func__ << " lease sent " << lease->sent_timestamp
+	   << " received " << lease->get_recv_stamp() << " skew " << skew
+	   << " margin " << margin << ": valid for " << remaining << "s"
+	   << dendl;
 
   state = STATE_ACTIVE;
 
@@ -1364,6 +1423,7 @@ void Paxos::leader_init()
 
   state = STATE_RECOVERING;
   lease_expire = {};
+  lease_valid_until = {};
   dout(10) << "leader_init -- starting paxos recovery" << dendl;
   collect(0);
 }
@@ -1375,6 +1435,7 @@ void Paxos::peon_init()
 
   state = STATE_RECOVERING;
   lease_expire = {};
+  lease_valid_until = {};
   dout(10) << "peon_init -- i am a peon" << dendl;
 
   // start a timer, in case the leader never manages to issue a lease
@@ -1514,7 +1575,7 @@ version_t Paxos::read_current(bufferlist &bl)
 bool Paxos::is_lease_valid()
 {
   return ((mon.get_quorum().size() == 1)
-	  || (ceph::real_clock::now() < lease_expire));
+	  || (ceph::mono_clock::now() < lease_valid_until));
 }
 
 // -- WRITE --
@@ -1534,6 +1595,23 @@ void Paxos::propose_pending()
 
   cancel_events();
 
+  if (double window = g_conf().get_val<double>("paxos_propose_batch_window");
+      window > 0) {
+    int joined = 0;
+    plug();
+    for (auto& svc : mon.paxos_service) {
+      if (svc->maybe_join_proposal(window)) {
+	++joined;
+      }
+    }
+    unplug();
+    if (joined) {
+      dout(10) << __func__ << " " << joined << " services joined" << dendl;
+      logger->inc(l_paxos_begin_joined, joined);
+    }
+  }
+  logger->inc(l_paxos_begin_proposals, pending_finishers.size());
+
   bufferlist bl;
   pending_proposal->encode(bl);
 
@@ -1571,7 +1649,7 @@ MonitorDBStore::TransactionRef Paxos::get_pending_transaction()
 
 bool Paxos::trigger_propose()
 {
-  if (plugged) {
+  if (is_plugged()) {
     dout(10) << __func__ << " plugged, not proposing now" << dendl;
     return false;
   } else if (is_active()) {
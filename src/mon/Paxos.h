@@ -156,9 +156,36 @@ enum {
   l_paxos_share_state_bytes,
   l_paxos_new_pn,
   l_paxos_new_pn_latency,
+  l_paxos_begin_proposals,
+  l_paxos_begin_joined,
+  l_paxos_peon_local,
+  l_paxos_peon_wait,
+  l_paxos_peon_forward,
   l_paxos_last,
 };
 
+/**
+ * The plugs of the Paxos proposals: while plugged, trigger_propose()
+ * leaves the pending proposal for later. Plugs nest, finish_round()
+ * plugging while it wakes up the waiters, which may plug themselves.
+ */
+class PaxosPlug {
+  /// number of plug() calls not matched by an unplug() yet
+  int plugged = 0;
+public:
+  bool is_plugged() const {
+    return plugged > 0;
+  }
+  void plug() {
+    ++plugged;
+  }
+  /// @returns true if this removed the last plug
+  bool unplug() {
+    ceph_assert(plugged > 0);
+    return --plugged == 0;
+  }
+};
+
 
 // i am one state machine.
 /**
@@ -403,6 +430,17 @@ private:
    * not be extended. 
    */
   ceph::real_clock::time_point lease_expire;
+  /**
+   * Until when our lease lets us serve reads, on our monotonic clock.
+   *
+   * A peon does not compare lease_expire, from the clock of the leader, to
+   * its own: with skewed clocks it would keep its lease past its end, or
+   * not use it at all. It counts the duration of the lease from when it
+   * got it instead, less the round trip to the leader measured by the
+   * time checks, which bounds the time the lease took to reach us. See
+   * get_lease_remaining().
+   */
+  ceph::mono_clock::time_point lease_valid_until;
   /**
    * List of callbacks waiting for our state to change into STATE_ACTIVE.
    */
@@ -625,9 +663,9 @@ private:
   bool trimming;
 
   /**
-   * true if we want trigger_propose to *not* propose (yet)
+   * if plugged, we want trigger_propose to *not* propose (yet)
    */
-  bool plugged = false;
+  PaxosPlug plugs;
 
   /**
    * @defgroup Paxos_h_callbacks Callback classes.
@@ -1023,6 +1061,10 @@ private:
 
   /**
    * Begin proposing the pending_proposal.
+   *
+   * The services whose own proposal is due within
+   * paxos_propose_batch_window join it first, rather than beginning
+   * another round right after this one.
    */
   void propose_pending();
 
@@ -1216,15 +1258,13 @@ public:
   }
 
   bool is_plugged() const {
-    return plugged;
+    return plugs.is_plugged();
   }
   void plug() {
-    ceph_assert(plugged == false);
-    plugged = true;
+    plugs.plug();
   }
   void unplug() {
-    ceph_assert(plugged == true);
-    plugged = false;
+    plugs.unplug();
   }
 
   // read
@@ -1298,6 +1338,26 @@ public:
    * @returns true if the lease is still valid; false otherwise.
    */
   bool is_lease_valid();
+  /**
+   * How long a lease a peon received lets it serve reads, from now.
+   *
+   * The duration granted by the leader is counted from when we received
+   * the lease, and the lease never outlives its expiration converted to
+   * our clock. A lease which took longer than @p margin to reach us is too
+   * stale to count on either.
+   *
+   * @param sent when the leader sent the lease, on its clock
+   * @param expire when the lease expires, on the clock of the leader
+   * @param recv when we received the lease, on our clock
+   * @param now our clock
+   * @param skew how far our clock is ahead of the leader's, 0 if unknown
+   * @param margin bound of the transit time and of the skew left over
+   * @param max_lease bound of the duration granted (mon_lease)
+   * @returns the seconds the lease remains valid for, 0 if not valid
+   */
+  static double get_lease_remaining(double sent, double expire,
+				    double recv, double now, double skew,
+				    double margin, double max_lease);
   // write
   /**
    * @defgroup Paxos_h_write_funcs Write-related functions
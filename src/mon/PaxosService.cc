@@ -71,16 +71,24 @@ bool PaxosService::dispatch(MonOpRequestRef op)
   // make sure our map is readable and up to date
   if (!is_readable(m->version)) {
     dout(10) << " waiting for paxos -> readable (v" << m->version << ")" << dendl;
+    if (mon.is_peon()) {
+      paxos.logger->inc(l_paxos_peon_wait);
+    }
     wait_for_readable(op, new C_RetryMessage(this, op), m->version);
     return true;
   }
 
   // preprocess
-  if (preprocess_query(op)) 
+  if (preprocess_query(op)) {
+    if (mon.is_peon()) {
+      paxos.logger->inc(l_paxos_peon_local);
+    }
     return true;  // easy!
+  }
 
   // leader?
   if (!mon.is_leader()) {
+    paxos.logger->inc(l_paxos_peon_forward);
     mon.forward_request_leader(op);
     return true;
   }
@@ -135,6 +143,8 @@ bool PaxosService::dispatch(MonOpRequestRef op)
     dout(10) << " setting proposal_timer " << do_propose
              << " with delay of " << delay << dendl;
     proposal_timer = mon.timer.add_event_after(delay, do_propose);
+    proposal_due = ceph::mono_clock::now() +
+      ceph::make_timespan(delay);
   } else {
     dout(10) << " proposal_timer already set" << dendl;
   }
@@ -252,6 +262,30 @@ void PaxosService::propose_pending()
   paxos.trigger_propose();
 }
 
+bool PaxosService::maybe_join_proposal(double window)
+{
+  ceph_assert(paxos.is_plugged());
+  if (!proposal_timer || !is_writeable()) {
+    return false;
+  }
+  auto now = ceph::mono_clock::now();
+  if (!proposal_due_within(proposal_due, now, window)) {
+    return false;
+  }
+  dout(10) << __func__ << " proposal due in "
+	   << std::chrono::duration<double>(proposal_due - now).count()
+	   << "s, joining" << dendl;
+  propose_pending();
+  return true;
+}
+
+bool PaxosService::proposal_due_within(ceph::mono_clock::time_point due,
+				       ceph::mono_clock::time_point now,
+				       double window)
+{
+  return due <= now + ceph::make_timespan(window);
+}
+
 bool PaxosService::should_stash_full()
 {
   version_t latest_full = get_version_latest_full();
@@ -68,6 +68,8 @@ protected:
    * runs out and fires.
    */
   Context *proposal_timer;
+  /// when proposal_timer fires
+  ceph::mono_clock::time_point proposal_due;
   /**
    * If the implementation class has anything pending to be proposed to Paxos,
    * then have_pending should be true; otherwise, false.
@@ -232,6 +234,24 @@ public:
    */
   void propose_pending();
 
+  /**
+   * Propose our pending value now, for it to go along with the proposal
+   * Paxos is about to begin, if our proposal timer was due to fire
+   * within @p window seconds anyway.
+   *
+   * @pre Paxos is plugged
+   * @returns true if we proposed
+   */
+  bool maybe_join_proposal(double window);
+
+  /**
+   * Whether a proposal timer due at @p due, as of @p now, fires within
+   * @p window seconds, and so should join the proposal being begun.
+   */
+  static bool proposal_due_within(ceph::mono_clock::time_point due,
+				  ceph::mono_clock::time_point now,
+				  double window);
+
   /**
    * Let others request us to propose.
    *
@@ -28,6 +28,7 @@
 #include "include/buffer.h"
 #include "include/types.h"
 #include "common/item_history.h"
+#include "msg/ConnectionLatency.h"
 #include "msg/MessageRef.h"
 
 // ======================================================
@@ -69,6 +70,11 @@ public:
   Interceptor *interceptor;
 #endif
 
+private:
+  // null unless ms_connection_latency was set when the connection was
+  // created
+  std::unique_ptr<ConnectionLatency> latency;
+
 public:
   void set_priv(const RefCountedPtr& o) {
     std::lock_guard l{lock};
@@ -240,11 +246,19 @@ public:
   }
   bool is_blackhole() const;
 
+  ConnectionLatency *get_latency() const {
+    return latency.get();
+  }
+
 protected:
   Connection(CephContext *cct, Messenger *m)
     : RefCountedObjectSafe(cct),
       msgr(m)
-  {}
+  {
+    if (cct->_conf.get_val<bool>("ms_connection_latency")) {
+      latency = std::make_unique<ConnectionLatency>();
+    }
+  }
 
   ~Connection() override {
     //generic_dout(0) << "~Connection " << this << dendl;
@@ -0,0 +1,99 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "msg/ConnectionLatency.h"
+
+namespace {
+
+// bucket 0 is for negative values (a clock going backwards), bucket i
+// for [2^(i-2), 2^(i-1)) us, with [0, 1) for bucket 1
+const PerfHistogramCommon::axis_config_d latency_axis{
+  "latency_usec", PerfHistogramCommon::SCALE_LOG2, 0, 1,
+  ConnectionLatency::BUCKETS};
+
+int64_t bucket_max_usec(int32_t bucket)
+{
+  return bucket == 0 ? -1 : (int64_t(1) << (bucket - 1)) - 1;
+}
+
+} // anonymous namespace
+
+ConnectionLatency::stage_stats_t::stage_stats_t()
+  : hist({latency_axis})
+{}
+
+const char *ConnectionLatency::get_stage_name(stage_t stage)
+{
+  switch (stage) {
+  case OUT_QUEUE:
+    return "out_queue";
+  case SEND:
+    return "send";
+  case RECV:
+    return "recv";
+  case DISPATCH_QUEUE:
+    return "dispatch_queue";
+  default:
+    return "???";
+  }
+}
+
+void ConnectionLatency::add_usec(stage_t stage, int64_t usec)
+{
+  auto& s = stages[stage];
+  s.hist.inc(usec);
+  s.count.fetch_add(1, std::memory_order_relaxed);
+  if (usec > 0) {
+    s.sum_usec.fetch_add(usec, std::memory_order_relaxed);
+  }
+}
+
+void ConnectionLatency::dump(ceph::Formatter *f) const
+{
+  for (int i = 0; i < NUM_STAGES; ++i) {
+    const auto& s = stages[i];
+    const uint64_t count = s.count.load(std::memory_order_relaxed);
+    f->open_object_section(get_stage_name(static_cast<stage_t>(i)));
+    f->dump_unsigned("count", count);
+    f->dump_float("avg_usec", count ?
+      (double)s.sum_usec.load(std::memory_order_relaxed) / count : 0.0);
+    // the upper bounds of the buckets of the percentiles
+    uint64_t values[BUCKETS];
+    uint64_t total = 0;
+    for (int32_t b = 0; b < BUCKETS; ++b) {
+      values[b] = s.hist.read_bucket(b);
+      total += values[b];
+    }
+    for (auto [name, pct] : {std::make_pair("p50_usec", 50),
+			     std::make_pair("p90_usec", 90),
+			     std::make_pair("p99_usec", 99)}) {
+      const uint64_t rank = (total * pct + 99) / 100;
+      int64_t max_usec = 0;
+      uint64_t seen = 0;
+      for (int32_t b = 0; b < BUCKETS && total > 0; ++b) {
+	seen += values[b];
+	if (seen >= rank) {
+	  max_usec = b == BUCKETS - 1 ? bucket_max_usec(b - 1) + 1 :
+	    bucket_max_usec(b);
+	  break;
+	}
+      }
+      f->dump_int(name, max_usec);
+    }
+    f->open_array_section("histogram");
+    for (int32_t b = 0; b < BUCKETS; ++b) {
+      f->dump_unsigned("count", values[b]);
+    }
+    f->close_section();
+    f->close_section();
+  }
+}
+
+void ConnectionLatency::dump_buckets(ceph::Formatter *f)
+{
+  f->open_array_section("buckets_max_usec");
+  for (int32_t b = 0; b < BUCKETS - 1; ++b) {
+    f->dump_int("max", bucket_max_usec(b));
+  }
+  f->close_section();
+}
@@ -0,0 +1,68 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_CONNECTIONLATENCY_H
+#define CEPH_MSG_CONNECTIONLATENCY_H
+
+#include <atomic>
+
+#include "common/Formatter.h"
+#include "common/ceph_time.h"
+#include "common/perf_histogram.h"
+#include "include/utime.h"
+
+/**
+ * Where the messages of a connection spend their time, kept when
+ * ms_connection_latency is enabled: for each stage, a histogram of the
+ * latencies in microseconds (log2 buckets), as well as their count and
+ * sum. All of it is lockless, the stages being recorded from the
+ * messenger and the dispatch threads.
+ */
+class ConnectionLatency {
+public:
+  enum stage_t {
+    OUT_QUEUE,       ///< send_message() until picked for writing
+    SEND,            ///< send_message() until written to the socket
+    RECV,            ///< first byte read until read, throttling included
+    DISPATCH_QUEUE,  ///< read until handed to a dispatcher
+    NUM_STAGES
+  };
+  static constexpr int32_t BUCKETS = 32;  ///< the last from 2^29us on
+
+  static const char *get_stage_name(stage_t stage);
+
+  void add(stage_t stage, ceph::timespan t) {
+    add_usec(stage, std::chrono::duration_cast<std::chrono::microseconds>(
+		      t).count());
+  }
+  void add(stage_t stage, utime_t t) {
+    add_usec(stage, t.to_nsec() / 1000);
+  }
+
+  void dump(ceph::Formatter *f) const;
+  /// the upper bound of each bucket, as the dumps leave them out
+  static void dump_buckets(ceph::Formatter *f);
+
+private:
+  struct stage_stats_t {
+    PerfHistogram<1> hist;
+    std::atomic<uint64_t> count = {0};
+    std::atomic<uint64_t> sum_usec = {0};
+
+    stage_stats_t();
+  };
+  stage_stats_t stages[NUM_STAGES];
+
+  void add_usec(stage_t stage, int64_t usec);
+};
+
+#endif
@@ -0,0 +1,443 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_DISPATCHLANES_H
+#define CEPH_MSG_DISPATCHLANES_H
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "include/ceph_assert.h"
+#include "include/msgr.h"
+#include "common/ceph_mutex.h"
+
+/**
+ * The index of the calling thread amongst the threads which ever pushed
+ * into some DispatchLanes. Shared by all the instances of a process, so
+ * that a messenger worker gets the same producer slot in every messenger
+ * it serves.
+ */
+inline unsigned dispatch_lanes_producer_index()
+{
+  static std::atomic<unsigned> next_index{0};
+  thread_local unsigned index = next_index++;
+  return index;
+}
+
+/**
+ * The queue between the threads reading messages off the network and the
+ * dispatch thread of a messenger, as an alternative to a PrioritizedQueue
+ * under a single lock.
+ *
+ * Each producer thread gets its own single-producer/single-consumer ring
+ * per priority lane, so that producers never contend with each other nor,
+ * as long as the rings do not fill up, with the consumer. A full ring
+ * spills into a short list under a per-producer lock, which keeps the
+ * order of the items pushed by a thread within a lane.
+ *
+ * Lanes are served strictly in order (HIGH, DEFAULT, then LOW), the
+ * producers round-robin within a lane. Items for a given id (connection)
+ * keep their order as long as they are pushed by the same thread, which
+ * is what the messenger guarantees.
+ *
+ * discard() is lazy: it remembers how far every lane was filled when it
+ * was called, and the consumer drops the items of that id below that mark
+ * when it comes across them.
+ *
+ * push() may be called from any thread; pop(), prepare_sleep() and
+ * wake_up() only from the one consumer thread.
+ */
+template <typename T>
+class DispatchLanes {
+public:
+  enum {
+    LANE_HIGH,     ///< CEPH_MSG_PRIO_HIGH and above
+    LANE_DEFAULT,  ///< CEPH_MSG_PRIO_LOW and above
+    LANE_LOW,
+    NUM_LANES
+  };
+
+  static unsigned lane_of(int priority) {
+    if (priority >= CEPH_MSG_PRIO_HIGH) {
+      return LANE_HIGH;
+    } else if (priority >= CEPH_MSG_PRIO_LOW) {
+      return LANE_DEFAULT;
+    } else {
+      return LANE_LOW;
+    }
+  }
+
+  /**
+   * @param ring_size the number of items per ring, rounded up to a power of 2
+   * @param max_producers the number of threads which may push()
+   */
+  DispatchLanes(unsigned ring_size, unsigned max_producers)
+    : ring_mask(round_up_pow2(std::max(ring_size, 2u)) - 1),
+      max_producers(max_producers),
+      producers(new std::atomic<producer_t*>[max_producers]) {
+    for (unsigned i = 0; i < max_producers; ++i) {
+      producers[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+  ~DispatchLanes() {
+    for (unsigned i = 0; i < max_producers; ++i) {
+      delete producers[i].load(std::memory_order_relaxed);
+    }
+  }
+  DispatchLanes(const DispatchLanes&) = delete;
+  DispatchLanes& operator=(const DispatchLanes&) = delete;
+
+  /**
+   * queue an item
+   *
+   * @param stamp arrival time of the item, for get_max_age()
+   * @return false if the calling thread has no producer slot, in which case
+   *         't' is left untouched
+   */
+  bool push(unsigned lane, uint64_t id, double stamp, T&& t, bool *wake) {
+    producer_t *p = get_producer();
+    if (!p) {
+      return false;
+    }
+    lane_t& l = p->lanes[lane];
+    const uint64_t seq = l.pushed.load(std::memory_order_relaxed);
+    if (l.overflowed.load(std::memory_order_acquire) ||
+	!ring_push(l, id, seq, stamp, t)) {
+      std::lock_guard g{p->overflow_lock};
+      if (!l.overflow.empty() || !ring_push(l, id, seq, stamp, t)) {
+	l.overflow.push_back(entry_t{std::move(t), id, seq, stamp});
+	l.overflowed.store(true, std::memory_order_release);
+      }
+    }
+    l.pushed.store(seq + 1, std::memory_order_release);
+    // pairs with the fence in prepare_sleep(): either the consumer sees the
+    // new item, or we see that it is about to sleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    *wake = sleeping.load(std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * take the next item
+   *
+   * @param drop called with the discarded items found on the way
+   * @return false if there is none
+   */
+  template <typename F>
+  bool pop(T *out, uint64_t *id, F&& drop) {
+    for (unsigned lane = 0; lane < NUM_LANES; ++lane) {
+      const unsigned n = nproducers.load(std::memory_order_acquire);
+      for (unsigned k = 0; k < n; ) {
+	const unsigned i = (rr[lane] + k) % n;
+	producer_t *p = producers[i].load(std::memory_order_acquire);
+	uint64_t seq;
+	if (!p || !lane_pop(*p, lane, out, id, &seq)) {
+	  ++k;
+	  continue;
+	}
+	if (have_discards.load(std::memory_order_acquire) &&
+	    is_discarded(p, lane, *id, seq)) {
+	  drop(std::move(*out));
+	  *out = T();
+	  continue;
+	}
+	rr[lane] = i + 1;
+	return true;
+      }
+    }
+    return false;
+  }
+
+  /// drop the items of 'id' queued so far, see the class comment
+  void discard(uint64_t id) {
+    discard_t d{id, {}};
+    const unsigned n = nproducers.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < n; ++i) {
+      producer_t *p = producers[i].load(std::memory_order_acquire);
+      if (!p) {
+	continue;
+      }
+      for (unsigned lane = 0; lane < NUM_LANES; ++lane) {
+	const uint64_t pushed =
+	  p->lanes[lane].pushed.load(std::memory_order_acquire);
+	if (pushed > p->lanes[lane].popped.load(std::memory_order_acquire)) {
+	  d.until.push_back(mark_t{p, lane, pushed});
+	}
+      }
+    }
+    if (d.until.empty()) {
+      return;
+    }
+    std::lock_guard g{discard_lock};
+    discards.push_back(std::move(d));
+    have_discards.store(true, std::memory_order_release);
+  }
+
+  bool empty() const {
+    const unsigned n = nproducers.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < n; ++i) {
+      producer_t *p = producers[i].load(std::memory_order_acquire);
+      if (!p) {
+	continue;
+      }
+      for (auto& l : p->lanes) {
+	if (l.pushed.load(std::memory_order_acquire) >
+	    l.popped.load(std::memory_order_acquire)) {
+	  return false;
+	}
+      }
+    }
+    return true;
+  }
+
+  /// the number of queued items, including the discarded ones not popped yet
+  uint64_t size() const {
+    uint64_t len = 0;
+    const unsigned n = nproducers.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < n; ++i) {
+      producer_t *p = producers[i].load(std::memory_order_acquire);
+      if (!p) {
+	continue;
+      }
+      for (auto& l : p->lanes) {
+	const uint64_t popped = l.popped.load(std::memory_order_acquire);
+	const uint64_t pushed = l.pushed.load(std::memory_order_acquire);
+	len += pushed > popped ? pushed - popped : 0;
+      }
+    }
+    return len;
+  }
+
+  /**
+   * the arrival stamp of the oldest queued item, 0 if none. Approximate
+   * when racing with the consumer.
+   */
+  double get_oldest_stamp() const {
+    double oldest = 0;
+    const unsigned n = nproducers.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < n; ++i) {
+      producer_t *p = producers[i].load(std::memory_order_acquire);
+      if (!p) {
+	continue;
+      }
+      for (auto& l : p->lanes) {
+	double stamp = 0;
+	const uint64_t head = l.head.load(std::memory_order_acquire);
+	if (head < l.tail.load(std::memory_order_acquire)) {
+	  stamp = l.slots[head & ring_mask].stamp.load(
+	    std::memory_order_relaxed);
+	} else if (l.overflowed.load(std::memory_order_acquire)) {
+	  std::lock_guard g{p->overflow_lock};
+	  if (!l.overflow.empty()) {
+	    stamp = l.overflow.front().stamp;
+	  }
+	}
+	if (stamp > 0 && (oldest == 0 || stamp < oldest)) {
+	  oldest = stamp;
+	}
+      }
+    }
+    return oldest;
+  }
+
+  /**
+   * the consumer is about to wait for a wakeup
+   *
+   * @return false if something was queued meanwhile, and it should not
+   */
+  bool prepare_sleep() {
+    sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!empty()) {
+      sleeping.store(false, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+  void wake_up() {
+    sleeping.store(false, std::memory_order_relaxed);
+  }
+
+private:
+  struct slot_t {
+    T t;
+    uint64_t id = 0;
+    uint64_t seq = 0;
+    std::atomic<double> stamp{0};  ///< read by get_oldest_stamp()
+  };
+  struct entry_t {
+    T t;
+    uint64_t id;
+    uint64_t seq;
+    double stamp;
+  };
+  struct alignas(64) lane_t {
+    // written by the producer
+    alignas(64) std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> pushed{0};      ///< next seq
+    uint64_t cached_head = 0;
+    std::atomic<bool> overflowed{false};  ///< the overflow is not empty
+    // written by the consumer
+    alignas(64) std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> popped{0};      ///< seq of the next item to pop
+    uint64_t cached_tail = 0;
+
+    std::unique_ptr<slot_t[]> slots;
+    std::deque<entry_t> overflow;         ///< under producer_t::overflow_lock
+  };
+  struct producer_t {
+    ceph::mutex overflow_lock =
+      ceph::make_mutex("DispatchLanes::producer::overflow_lock");
+    lane_t lanes[NUM_LANES];
+    explicit producer_t(unsigned size) {
+      for (auto& l : lanes) {
+	l.slots.reset(new slot_t[size]);
+      }
+    }
+  };
+  struct mark_t {
+    producer_t *p;
+    unsigned lane;
+    uint64_t seq;    ///< drop the items pushed before this one
+  };
+  struct discard_t {
+    uint64_t id;
+    std::vector<mark_t> until;
+  };
+
+  static unsigned round_up_pow2(unsigned v) {
+    unsigned r = 1;
+    while (r < v) {
+      r <<= 1;
+    }
+    return r;
+  }
+
+  producer_t *get_producer() {
+    const unsigned i = dispatch_lanes_producer_index();
+    if (i >= max_producers) {
+      return nullptr;
+    }
+    producer_t *p = producers[i].load(std::memory_order_relaxed);
+    if (!p) {
+      // only this thread ever sets its own slot
+      p = new producer_t(ring_mask + 1);
+      producers[i].store(p, std::memory_order_release);
+      unsigned n = nproducers.load(std::memory_order_relaxed);
+      while (n <= i &&
+	     !nproducers.compare_exchange_weak(n, i + 1,
+					       std::memory_order_release)) {}
+    }
+    return p;
+  }
+
+  bool ring_push(lane_t& l, uint64_t id, uint64_t seq, double stamp, T& t) {
+    const uint64_t tail = l.tail.load(std::memory_order_relaxed);
+    if (tail - l.cached_head > ring_mask) {
+      l.cached_head = l.head.load(std::memory_order_acquire);
+      if (tail - l.cached_head > ring_mask) {
+	return false;
+      }
+    }
+    slot_t& s = l.slots[tail & ring_mask];
+    s.t = std::move(t);
+    s.id = id;
+    s.seq = seq;
+    s.stamp.store(stamp, std::memory_order_relaxed);
+    l.tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool lane_pop(producer_t& p, unsigned lane,
+		T *out, uint64_t *id, uint64_t *seq) {
+    lane_t& l = p.lanes[lane];
+    const uint64_t head = l.head.load(std::memory_order_relaxed);
+    if (head == l.cached_tail) {
+      l.cached_tail = l.tail.load(std::memory_order_acquire);
+    }
+    if (head < l.cached_tail) {
+      slot_t& s = l.slots[head & ring_mask];
+      *out = std::move(s.t);
+      s.t = T();
+      *id = s.id;
+      *seq = s.seq;
+      l.head.store(head + 1, std::memory_order_release);
+      l.popped.store(*seq + 1, std::memory_order_release);
+      return true;
+    }
+    // the ring is empty: anything in the overflow is next in line, the
+    // producer does not use the ring again until the overflow is drained
+    if (!l.overflowed.load(std::memory_order_acquire)) {
+      return false;
+    }
+    std::lock_guard g{p.overflow_lock};
+    if (l.overflow.empty()) {
+      return false;
+    }
+    entry_t& e = l.overflow.front();
+    *out = std::move(e.t);
+    *id = e.id;
+    *seq = e.seq;
+    l.overflow.pop_front();
+    if (l.overflow.empty()) {
+      l.overflowed.store(false, std::memory_order_release);
+    }
+    l.popped.store(*seq + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool is_discarded(producer_t *p, unsigned lane, uint64_t id, uint64_t seq) {
+    std::lock_guard g{discard_lock};
+    bool ret = false;
+    for (auto d = discards.begin(); d != discards.end(); ) {
+      bool done = true;
+      for (auto& m : d->until) {
+	if (m.p == p && m.lane == lane && d->id == id && seq < m.seq) {
+	  ret = true;
+	}
+	if (m.p->lanes[m.lane].popped.load(std::memory_order_relaxed) <
+	    m.seq) {
+	  done = false;
+	}
+      }
+      if (done) {
+	d = discards.erase(d);
+      } else {
+	++d;
+      }
+    }
+    if (discards.empty()) {
+      have_discards.store(false, std::memory_order_release);
+    }
+    return ret;
+  }
+
+  const unsigned ring_mask;
+  const unsigned max_producers;
+  std::unique_ptr<std::atomic<producer_t*>[]> producers;
+  std::atomic<unsigned> nproducers{0};  ///< highest used producer slot + 1
+
+  std::atomic<bool> sleeping{false};
+
+  // consumer only
+  unsigned rr[NUM_LANES] = {0};
+
+  ceph::mutex discard_lock = ceph::make_mutex("DispatchLanes::discard_lock");
+  std::vector<discard_t> discards;
+  std::atomic<bool> have_discards{false};
+};
+
+#endif
@@ -32,10 +32,16 @@ using ceph::ref_t;
 
 double DispatchQueue::get_max_age(utime_t now) const {
   std::lock_guard l{lock};
-  if (marrival.empty())
+  double oldest = marrival.empty() ? 0 : (double)marrival.begin()->first;
+  if (lanes) {
+    double stamp = lanes->get_oldest_stamp();
+    if (stamp > 0 && (oldest == 0 || stamp < oldest))
+      oldest = stamp;
+  }
+  if (oldest == 0)
     return 0;
   else
-    return (now - marrival.begin()->first);
+    return ((double)now - oldest);
 }
 
 uint64_t DispatchQueue::pre_dispatch(const ref_t<Message>& m)
@@ -82,6 +88,23 @@ void DispatchQueue::fast_preprocess(const ref_t<Message>& m)
 
 void DispatchQueue::enqueue(const ref_t<Message>& m, int priority, uint64_t id)
 {
+  if (lanes) {
+    if (stop) {
+      return;
+    }
+    ldout(cct,20) << "queue " << m << " prio " << priority << dendl;
+    auto ref = m;
+    bool wake = false;
+    if (lanes->push(MessageLanes::lane_of(priority), id,
+		    (double)m->get_recv_stamp(), std::move(ref), &wake)) {
+      if (wake) {
+	std::lock_guard l{lock};
+	cond.notify_all();
+      }
+      return;
+    }
+    // this thread has no producer slot, fall back to mqueue
+  }
   std::lock_guard l{lock};
   if (stop) {
     return;
@@ -205,12 +228,44 @@ void DispatchQueue::entry()
 
       l.lock();
     }
+    if (lanes && dispatch_from_lanes(l))
+      continue;
     if (stop)
       break;
 
     // wait for something to be put on queue
+    if (lanes && !lanes->prepare_sleep())
+      continue;
     cond.wait(l);
+    if (lanes)
+      lanes->wake_up();
+  }
+}
+
+/*
+ * Deliver the next message from the lanes, if any. The codes and the
+ * messages in mqueue are checked again before each of them.
+ */
+bool DispatchQueue::dispatch_from_lanes(std::unique_lock<ceph::mutex>& l)
+{
+  ref_t<Message> m;
+  uint64_t id;
+  if (!lanes->pop(&m, &id, [this](ref_t<Message>&& d) {
+	ldout(cct,20) << "discarding " << d << dendl;
+	dispatch_throttle_release(d->get_dispatch_throttle_size());
+      })) {
+    return false;
+  }
+  l.unlock();
+  if (stop) {
+    ldout(cct,10) << " stop flag set, discarding " << m << " " << *m << dendl;
+  } else {
+    uint64_t msize = pre_dispatch(m);
+    msgr->ms_deliver_dispatch(m);
+    post_dispatch(m, msize);
   }
+  l.lock();
+  return true;
 }
 
 void DispatchQueue::discard_queue(uint64_t id) {
@@ -223,6 +278,8 @@ void DispatchQueue::discard_queue(uint64_t id) {
     remove_arrival(m);
     dispatch_throttle_release(m->get_dispatch_throttle_size());
   }
+  if (lanes)
+    lanes->discard(id);
 }
 
 void DispatchQueue::start()
@@ -26,6 +26,7 @@
 #include "common/Thread.h"
 #include "common/PrioritizedQueue.h"
 
+#include "DispatchLanes.h"
 #include "Message.h"
 
 class Messenger;
@@ -69,6 +70,13 @@ class DispatchQueue {
 
   PrioritizedQueue<QueueItem, uint64_t> mqueue;
 
+  /// per-thread rings for the messages, if ms_dispatch_queue_lanes is set.
+  /// mqueue then only holds the codes, and the messages from the threads
+  /// which did not get a producer slot.
+  using MessageLanes = DispatchLanes<ceph::ref_t<Message>>;
+  std::unique_ptr<MessageLanes> lanes;
+  bool dispatch_from_lanes(std::unique_lock<ceph::mutex>& l);
+
   std::set<std::pair<double, ceph::ref_t<Message>>> marrival;
   std::map<ceph::ref_t<Message>, decltype(marrival)::iterator> marrival_map;
   void add_arrival(const ceph::ref_t<Message>& m) {
@@ -125,7 +133,7 @@ class DispatchQueue {
   /// Throttle preventing us from building up a big backlog waiting for dispatch
   Throttle dispatch_throttler;
 
-  bool stop;
+  std::atomic<bool> stop;
   void local_delivery(const ceph::ref_t<Message>& m, int priority);
   void local_delivery(Message* m, int priority) {
     return local_delivery(ceph::ref_t<Message>(m, false), priority); /* consume ref */
@@ -136,7 +144,7 @@ class DispatchQueue {
 
   int get_queue_len() const {
     std::lock_guard l{lock};
-    return mqueue.length();
+    return mqueue.length() + (lanes ? lanes->size() : 0);
   }
 
   /**
@@ -231,7 +239,13 @@ class DispatchQueue {
       dispatch_throttler(cct, std::string("msgr_dispatch_throttler-") + name,
                          cct->_conf->ms_dispatch_throttle_bytes),
       stop(false)
-    {}
+    {
+      if (cct->_conf.get_val<bool>("ms_dispatch_queue_lanes")) {
+	lanes = std::make_unique<MessageLanes>(
+	  cct->_conf.get_val<uint64_t>("ms_dispatch_queue_lane_size"),
+	  cct->_conf.get_val<uint64_t>("ms_dispatch_queue_max_producers"));
+      }
+    }
   ~DispatchQueue() {
     ceph_assert(mqueue.empty());
     ceph_assert(marrival.empty());
@@ -657,6 +657,24 @@ public:
    * @defgroup Dispatcher Interfacing
    * @{
    */
+  /**
+   * Account the time a message spent between being read and being
+   * dispatched, if its connection keeps its latencies.
+   *
+   * @param m The Message being dispatched, its dispatch stamp set.
+   */
+  void account_dispatch_queue(const ceph::ref_t<Message> &m) {
+    auto& con = m->get_connection();
+    if (!con) {
+      return;
+    }
+    if (auto latency = con->get_latency();
+	latency && m->get_recv_complete_stamp() != utime_t()) {
+      latency->add(ConnectionLatency::DISPATCH_QUEUE,
+		   m->get_dispatch_stamp() - m->get_recv_complete_stamp());
+    }
+  }
+
   /**
    * Determine whether a message can be fast-dispatched. We will
    * query each Dispatcher in sequence to determine if they are
@@ -680,6 +698,7 @@ public:
    */
   void ms_fast_dispatch(const ceph::ref_t<Message> &m) {
     m->set_dispatch_stamp(ceph_clock_now());
+    account_dispatch_queue(m);
     for (const auto &dispatcher : fast_dispatchers) {
       if (dispatcher->ms_can_fast_dispatch2(m)) {
 	dispatcher->ms_fast_dispatch2(m);
@@ -708,6 +727,7 @@ public:
    */
   void ms_deliver_dispatch(const ceph::ref_t<Message> &m) {
     m->set_dispatch_stamp(ceph_clock_now());
+    account_dispatch_queue(m);
     for (const auto &dispatcher : dispatchers) {
       if (dispatcher->ms_dispatch2(m))
 	return;
@@ -614,6 +614,20 @@ bool AsyncConnection::is_queued() const {
   return outgoing_bl.length();
 }
 
+int AsyncConnection::enable_ktls(
+  const ceph::crypto::onwire::ktls_params_t& params) {
+  ceph_assert(center->in_thread());
+  if (is_queued() || recv_start != recv_end) {
+    // the switch would fall in the middle of the stream
+    ldout(async_msgr->cct, 1) << __func__ << " data pending, "
+                              << outgoing_bl.length() << " bytes to send, "
+                              << recv_end - recv_start << " received"
+                              << dendl;
+    return -EINVAL;
+  }
+  return cs.enable_ktls(params);
+}
+
 void AsyncConnection::shutdown_socket() {
   for (auto &&t : register_time_events) center->delete_time_event(t);
   register_time_events.clear();
@@ -67,6 +67,8 @@ class AsyncConnection : public Connection {
 
   bool is_queued() const;
   void shutdown_socket();
+  // nothing must be buffered either way
+  int enable_ktls(const ceph::crypto::onwire::ktls_params_t& params);
 
    /**
    * The DelayedDelivery is for injecting delays into Message delivery off
@@ -21,6 +21,7 @@
 
 #include "AsyncMessenger.h"
 
+#include "common/admin_socket.h"
 #include "common/config.h"
 #include "common/Timer.h"
 #include "common/errno.h"
@@ -261,6 +262,56 @@ struct StackSingleton {
   }
 };
 
+/*
+ * The dump_connection_latency admin socket command, registered once for
+ * all the AsyncMessengers of a CephContext.
+ */
+class ConnectionLatencyHook : public AdminSocketHook {
+  CephContext *cct;
+  ceph::mutex lock = ceph::make_mutex("ConnectionLatencyHook::lock");
+  std::set<AsyncMessenger*> msgrs;
+
+public:
+  explicit ConnectionLatencyHook(CephContext *c) : cct(c) {
+    int r = cct->get_admin_socket()->register_command(
+      "dump_connection_latency", this,
+      "dump the latency histograms of the messenger connections "
+      "(see ms_connection_latency)");
+    ceph_assert(r == 0);
+  }
+  ~ConnectionLatencyHook() override {
+    cct->get_admin_socket()->unregister_commands(this);
+  }
+
+  void add(AsyncMessenger *msgr) {
+    std::lock_guard l{lock};
+    msgrs.insert(msgr);
+  }
+  void remove(AsyncMessenger *msgr) {
+    std::lock_guard l{lock};
+    msgrs.erase(msgr);
+  }
+
+  int call(std::string_view command,
+	   const cmdmap_t& cmdmap,
+	   ceph::Formatter *f,
+	   std::ostream& errss,
+	   ceph::buffer::list& out) override {
+    f->open_object_section("connection_latency");
+    f->dump_bool("enabled", cct->_conf.get_val<bool>("ms_connection_latency"));
+    ConnectionLatency::dump_buckets(f);
+    f->open_array_section("messengers");
+    {
+      std::lock_guard l{lock};
+      for (auto msgr : msgrs) {
+	msgr->dump_connection_latency(f);
+      }
+    }
+    f->close_section();
+    f->close_section();
+    return 0;
+  }
+};
 
 class C_handle_reap : public EventCallback {
   AsyncMessenger *msgr;
@@ -281,6 +332,7 @@ AsyncMessenger::AsyncMessenger(CephContext *cct, entity_name_t name,
                                const std::string &type, std::string mname, uint64_t _nonce)
   : SimplePolicyMessenger(cct, name),
     dispatch_queue(cct, this, mname),
+    mname(mname),
     nonce(_nonce)
 {
   std::string transport_type = "posix";
@@ -288,6 +340,8 @@ AsyncMessenger::AsyncMessenger(CephContext *cct, entity_name_t name,
     transport_type = "rdma";
   else if (type.find("dpdk") != std::string::npos)
     transport_type = "dpdk";
+  else if (type.find("io_uring") != std::string::npos)
+    transport_type = "io_uring";
 
   auto single = &cct->lookup_or_create_singleton_object<StackSingleton>(
     "AsyncMessenger::NetworkStack::" + transport_type, true, cct);
@@ -304,6 +358,9 @@ AsyncMessenger::AsyncMessenger(CephContext *cct, entity_name_t name,
     processor_num = stack->get_num_worker();
   for (unsigned i = 0; i < processor_num; ++i)
     processors.push_back(new Processor(this, stack->get_worker(i), cct));
+  latency_hook = &cct->lookup_or_create_singleton_object<ConnectionLatencyHook>(
+    "AsyncMessenger::ConnectionLatencyHook", false, cct);
+  latency_hook->add(this);
 }
 
 /**
@@ -312,6 +369,7 @@ AsyncMessenger::AsyncMessenger(CephContext *cct, entity_name_t name,
  */
 AsyncMessenger::~AsyncMessenger()
 {
+  latency_hook->remove(this);
   delete reap_handler;
   ceph_assert(!did_bind); // either we didn't bind or we shut down the Processor
   for (auto &&p : processors)
@@ -820,6 +878,42 @@ void AsyncMessenger::mark_down_addrs(const entity_addrvec_t& addrs)
   }
 }
 
+void AsyncMessenger::dump_connection_latency(ceph::Formatter *f)
+{
+  auto dump_conn = [f](const AsyncConnectionRef& conn) {
+    auto latency = conn->get_latency();
+    if (!latency) {
+      return;
+    }
+    f->open_object_section("connection");
+    f->dump_stream("peer") << entity_name_t(conn->get_peer_type(),
+					   conn->get_peer_id());
+    f->dump_stream("peer_addrs") << conn->get_peer_addrs();
+    latency->dump(f);
+    f->close_section();
+  };
+
+  f->open_object_section("messenger");
+  f->dump_string("name", mname);
+  f->dump_stream("myname") << get_myname();
+  f->dump_stream("myaddrs") << get_myaddrs();
+  f->open_array_section("connections");
+  {
+    std::lock_guard l{lock};
+    for (const auto& [addrs, conn] : conns) {
+      dump_conn(conn);
+    }
+    for (const auto& conn : anon_conns) {
+      dump_conn(conn);
+    }
+    for (const auto& conn : accepting_conns) {
+      dump_conn(conn);
+    }
+  }
+  f->close_section();
+  f->close_section();
+}
+
 int AsyncMessenger::get_proto_version(int peer_type, bool connect) const
 {
   int my_type = my_name.type();
@@ -37,6 +37,7 @@
 #include "include/ceph_assert.h"
 
 class AsyncMessenger;
+class ConnectionLatencyHook;
 
 /**
  * If the Messenger binds to a specific address, the Processor runs
@@ -161,6 +162,12 @@ public:
   }
   /** @} // Connection Management */
 
+  /**
+   * Dump the latency histograms of the connections which keep them (see
+   * ms_connection_latency), for the dump_connection_latency command.
+   */
+  void dump_connection_latency(ceph::Formatter *f);
+
   /**
    * @defgroup Inner classes
    * @{
@@ -218,6 +225,10 @@ private:
   Worker *local_worker;
 
   std::string ms_type;
+  /// the name given at creation (e.g. "client", "cluster")
+  const std::string mname;
+  /// serves dump_connection_latency for all the messengers of the cct
+  ConnectionLatencyHook *latency_hook;
 
   /// overall lock used for AsyncMessenger data structures
   ceph::mutex lock = ceph::make_mutex("AsyncMessenger::lock");
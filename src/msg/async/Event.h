@@ -44,6 +44,7 @@
 #include "common/ceph_time.h"
 #include "common/dout.h"
 #include "net_handler.h"
+#include "TimerWheel.h"
 
 #define EVENT_NONE 0
 #define EVENT_READABLE 1
@@ -107,13 +108,6 @@ class EventCenter {
     FileEvent(): mask(0), read_cb(NULL), write_cb(NULL) {}
   };
 
-  struct TimeEvent {
-    uint64_t id;
-    EventCallbackRef time_cb;
-
-    TimeEvent(): id(0), time_cb(NULL) {}
-  };
-
  public:
   /**
      * A Poller object is invoked once each time through the dispatcher's
@@ -162,13 +156,12 @@ class EventCenter {
   std::deque<EventCallbackRef> external_events;
   std::vector<FileEvent> file_events;
   EventDriver *driver;
-  std::multimap<clock_type::time_point, TimeEvent> time_events;
+  // the time events, in ticks of time_event_tick
+  TimerWheel<EventCallbackRef> time_events;
   // Keeps track of all of the pollers currently defined.  We don't
   // use an intrusive list here because it isn't reentrant: we need
   // to add/remove elements while the center is traversing the list.
   std::vector<Poller*> pollers;
-  std::map<uint64_t, std::multimap<clock_type::time_point, TimeEvent>::iterator> event_map;
-  uint64_t time_event_next_id;
   int notify_receive_fd;
   int notify_send_fd;
   ceph::NetHandler net;
@@ -176,6 +169,16 @@ class EventCenter {
   unsigned center_id;
   AssociatedCenters *global_centers = nullptr;
 
+  // the resolution of the time events
+  static constexpr std::chrono::milliseconds time_event_tick{1};
+  // the tick in which 't' falls
+  static uint64_t to_tick(clock_type::time_point t) {
+    return t.time_since_epoch() / time_event_tick;
+  }
+  static clock_type::time_point from_tick(uint64_t tick) {
+    return clock_type::time_point(tick * time_event_tick);
+  }
+
   int process_time_events();
   FileEvent *_get_file_event(int fd) {
     ceph_assert(fd < nevent);
@@ -186,7 +189,7 @@ class EventCenter {
   explicit EventCenter(CephContext *c):
     cct(c), nevent(0),
     external_num_events(0),
-    driver(NULL), time_event_next_id(1),
+    driver(NULL), time_events(to_tick(clock_type::now())),
     notify_receive_fd(-1), notify_send_fd(-1), net(c),
     notify_handler(NULL), center_id(0) { }
   ~EventCenter();
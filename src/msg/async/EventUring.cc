@@ -0,0 +1,638 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include <poll.h>
+
+#include "liburing.h"
+
+#include "common/errno.h"
+#include "include/intarith.h"
+#include "EventUring.h"
+
+#define dout_subsys ceph_subsys_ms
+
+#undef dout_prefix
+#define dout_prefix *_dout << "UringDriver."
+
+UringDriver::UringDriver(CephContext *c)
+  : cct(c)
+{}
+
+UringDriver::~UringDriver()
+{
+  if (ring) {
+    // the kernel cancels whatever is still in flight
+    io_uring_queue_exit(ring.get());
+  }
+  inflight.clear_and_dispose([](op_t *op) { delete op; });
+  free(buffers);
+}
+
+int UringDriver::init(EventCenter *c, int nevent)
+{
+  queue_depth = cct->_conf.get_val<uint64_t>("ms_async_uring_queue_depth");
+  buffer_size =
+    cct->_conf.get_val<Option::size_t>("ms_async_uring_recv_buffer_size");
+  num_buffers = std::min<uint64_t>(
+    cct->_conf.get_val<uint64_t>("ms_async_uring_recv_buffers"),
+    UINT16_MAX);
+  send_max_bytes =
+    cct->_conf.get_val<Option::size_t>("ms_async_uring_send_max_bytes");
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring = std::make_unique<struct io_uring>();
+  int r = io_uring_queue_init_params(queue_depth, ring.get(), &params);
+  if (r < 0) {
+    lderr(cct) << __func__ << " unable to create io_uring: "
+	       << cpp_strerror(r) << dendl;
+    ring.reset();
+    return r;
+  }
+  // without fast poll, a receive on an idle socket would hold a kernel
+  // worker thread
+  if (!(params.features & IORING_FEAT_FAST_POLL)) {
+    lderr(cct) << __func__ << " io_uring lacks IORING_FEAT_FAST_POLL "
+	       << "(kernel 5.7 or later is needed)" << dendl;
+    return -EOPNOTSUPP;
+  }
+
+  r = posix_memalign((void**)&buffers, CEPH_PAGE_SIZE,
+		     (size_t)buffer_size * num_buffers);
+  if (r) {
+    lderr(cct) << __func__ << " unable to allocate " << num_buffers
+	       << " receive buffers of " << buffer_size << " bytes" << dendl;
+    buffers = nullptr;
+    return -r;
+  }
+  for (unsigned i = 0; i < num_buffers; ++i) {
+    recycled.push_back(i);
+  }
+  provide_recycled();
+
+  // check that the kernel took the buffers
+  io_uring_submit(ring.get());
+  struct io_uring_cqe *cqe;
+  r = io_uring_wait_cqe(ring.get(), &cqe);
+  if (r == 0) {
+    r = cqe->res;
+    release_op(static_cast<op_t*>(io_uring_cqe_get_data(cqe)));
+    io_uring_cqe_seen(ring.get(), cqe);
+  }
+  if (r < 0) {
+    lderr(cct) << __func__ << " unable to provide the receive buffers: "
+	       << cpp_strerror(r) << dendl;
+    return r;
+  }
+
+  ldout(cct, 10) << __func__ << " queue depth " << queue_depth
+		 << ", " << num_buffers << " receive buffers of "
+		 << buffer_size << " bytes" << dendl;
+  return 0;
+}
+
+struct io_uring_sqe *UringDriver::get_sqe()
+{
+  struct io_uring_sqe *sqe = io_uring_get_sqe(ring.get());
+  if (!sqe) {
+    // the submission queue is full, flush it early
+    int r = io_uring_submit(ring.get());
+    ldout(cct, 20) << __func__ << " submission queue full, submitted "
+		   << r << dendl;
+    sqe = io_uring_get_sqe(ring.get());
+    ceph_assert(sqe);
+  }
+  return sqe;
+}
+
+UringDriver::op_t *UringDriver::new_op(op_type_t type, int fd,
+				       UringSocketRef sock)
+{
+  op_t *op = new op_t(type, fd, std::move(sock));
+  inflight.push_back(*op);
+  return op;
+}
+
+void UringDriver::release_op(op_t *op)
+{
+  inflight.erase(inflight.iterator_to(*op));
+  delete op;
+}
+
+void UringDriver::fire(int fd, int mask)
+{
+  if (mask != EVENT_NONE) {
+    fired[fd] |= mask;
+  }
+}
+
+// ---- plain file descriptors ----
+
+void UringDriver::arm_poll(int fd, fd_state_t &st)
+{
+  if (st.poll) {
+    if (st.poll_mask == st.mask) {
+      return;
+    }
+    disarm_poll(st);
+  }
+  if (st.mask == EVENT_NONE) {
+    return;
+  }
+  short events = 0;
+  if (st.mask & EVENT_READABLE)
+    events |= POLLIN;
+  if (st.mask & EVENT_WRITABLE)
+    events |= POLLOUT;
+  auto sqe = get_sqe();
+  st.poll = new_op(OP_POLL, fd);
+  st.poll_mask = st.mask;
+  io_uring_prep_poll_add(sqe, fd, events);
+  io_uring_sqe_set_data(sqe, st.poll);
+}
+
+void UringDriver::disarm_poll(fd_state_t &st)
+{
+  if (!st.poll) {
+    return;
+  }
+  // the removed request completes with -ECANCELED and is then ignored,
+  // since it is no longer the armed one
+  auto sqe = get_sqe();
+  io_uring_prep_poll_remove(sqe, st.poll);
+  io_uring_sqe_set_data(sqe, new_op(OP_POLL_REMOVE, st.poll->fd));
+  st.poll = nullptr;
+  st.poll_mask = EVENT_NONE;
+}
+
+int UringDriver::add_event(int fd, int cur_mask, int add_mask)
+{
+  ldout(cct, 20) << __func__ << " add event fd=" << fd << " cur_mask="
+		 << cur_mask << " add_mask=" << add_mask << dendl;
+  auto &st = fds[fd];
+  st.mask = cur_mask | add_mask;
+  if (!st.sock) {
+    arm_poll(fd, st);
+    return 0;
+  }
+
+  auto &sock = st.sock;
+  if (add_mask & EVENT_READABLE) {
+    if (!sock->rx.empty() || sock->rx_eof || sock->rx_error) {
+      fire(fd, EVENT_READABLE);
+    } else if (rx_wanted(*sock)) {
+      arm_recv(sock);
+    }
+  }
+  if ((add_mask & EVENT_WRITABLE) &&
+      (sock->tx_error ||
+       sock->tx_inflight.length() + sock->tx_pending.length() <
+         send_max_bytes)) {
+    fire(fd, EVENT_WRITABLE);
+  }
+  return 0;
+}
+
+int UringDriver::del_event(int fd, int cur_mask, int del_mask)
+{
+  ldout(cct, 20) << __func__ << " del event fd=" << fd << " cur_mask="
+		 << cur_mask << " del_mask=" << del_mask << dendl;
+  auto it = fds.find(fd);
+  if (it == fds.end()) {
+    return 0;
+  }
+  auto &st = it->second;
+  st.mask = cur_mask & ~del_mask;
+  if (st.sock) {
+    // the receive stays posted: nothing to do
+    return 0;
+  }
+  if (st.mask == EVENT_NONE) {
+    disarm_poll(st);
+    fds.erase(it);
+  } else {
+    arm_poll(fd, st);
+  }
+  return 0;
+}
+
+int UringDriver::resize_events(int newsize)
+{
+  return 0;
+}
+
+void UringDriver::handle_poll(op_t *op, int res)
+{
+  auto it = fds.find(op->fd);
+  if (it == fds.end() || it->second.poll != op) {
+    // removed or re-armed meanwhile
+    return;
+  }
+  auto &st = it->second;
+  st.poll = nullptr;
+  st.poll_mask = EVENT_NONE;
+  int mask = 0;
+  if (res < 0) {
+    ldout(cct, 1) << __func__ << " poll on fd=" << op->fd << " failed: "
+		  << cpp_strerror(res) << dendl;
+    mask = EVENT_READABLE | EVENT_WRITABLE;
+  } else {
+    if (res & (POLLIN | POLLERR | POLLHUP))
+      mask |= EVENT_READABLE;
+    if (res & (POLLOUT | POLLERR | POLLHUP))
+      mask |= EVENT_WRITABLE;
+  }
+  fire(op->fd, mask & st.mask);
+  if (!st.sock) {
+    to_rearm.push_back(op->fd);
+  } else if (rx_wanted(*st.sock)) {
+    // connected meanwhile: from now on the data comes through the ring
+    arm_recv(st.sock);
+  }
+}
+
+// ---- connected sockets ----
+
+void UringDriver::attach_socket(const UringSocketRef& sock)
+{
+  ldout(cct, 20) << __func__ << " fd=" << sock->fd << dendl;
+  auto &st = fds[sock->fd];
+  st.sock = sock;
+  // a poll armed while connecting is left to fire once
+  if (!st.poll && (st.mask & EVENT_READABLE) && rx_wanted(*sock)) {
+    arm_recv(sock);
+  }
+}
+
+void UringDriver::detach_socket(const UringSocketRef& sock)
+{
+  ldout(cct, 20) << __func__ << " fd=" << sock->fd << dendl;
+  sock->closed = true;
+  for (auto &c : sock->rx) {
+    recycle(c.bid);
+  }
+  sock->rx.clear();
+  sock->rx_bytes = 0;
+  sock->tx_pending.clear();
+  // the in-flight ops hold a reference on the file: cancel them, so that
+  // closing the descriptor does close the socket
+  for (void *op : {sock->recv_op, sock->send_op}) {
+    if (op) {
+      auto sqe = get_sqe();
+      io_uring_prep_cancel(sqe, op, 0);
+      io_uring_sqe_set_data(sqe, new_op(OP_CANCEL, sock->fd));
+    }
+  }
+  auto it = fds.find(sock->fd);
+  if (it != fds.end() && it->second.sock == sock) {
+    it->second.sock.reset();
+    if (it->second.mask == EVENT_NONE && !it->second.poll) {
+      fds.erase(it);
+    }
+  }
+}
+
+bool UringDriver::rx_wanted(const UringSocket& sock) const
+{
+  // don't read ahead of a reader which stopped consuming
+  return !sock.closed && !sock.recv_armed && !sock.recv_starved &&
+    !sock.rx_eof && !sock.rx_error && sock.rx_bytes < 2 * buffer_size;
+}
+
+void UringDriver::arm_recv(const UringSocketRef& sock)
+{
+  auto sqe = get_sqe();
+  op_t *op = new_op(OP_RECV, sock->fd, sock);
+  io_uring_prep_recv(sqe, sock->fd, nullptr, buffer_size, 0);
+  io_uring_sqe_set_flags(sqe, IOSQE_BUFFER_SELECT);
+  sqe->buf_group = buffer_group;
+  io_uring_sqe_set_data(sqe, op);
+  sock->recv_armed = true;
+  sock->recv_op = op;
+}
+
+void UringDriver::handle_recv(op_t *op, int res, unsigned flags)
+{
+  auto &sock = op->sock;
+  sock->recv_armed = false;
+  sock->recv_op = nullptr;
+  if (flags & IORING_CQE_F_BUFFER) {
+    uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+    if (res > 0 && !sock->closed) {
+      sock->rx.push_back({bid, 0, static_cast<uint32_t>(res)});
+      sock->rx_bytes += res;
+    } else {
+      recycle(bid);
+    }
+  }
+  if (sock->closed) {
+    return;
+  }
+  if (res == -ENOBUFS) {
+    // all the buffers are held by connections which did not read them yet
+    ldout(cct, 20) << __func__ << " fd=" << sock->fd << " out of buffers"
+		   << dendl;
+    sock->recv_starved = true;
+    starved.push_back(sock);
+    return;
+  }
+  if (res == -EAGAIN || res == -EINTR) {
+    arm_recv(sock);
+    return;
+  }
+  if (res == 0) {
+    sock->rx_eof = true;
+  } else if (res < 0) {
+    sock->rx_error = res;
+  }
+  fire(sock->fd, EVENT_READABLE);
+  if (rx_wanted(*sock)) {
+    arm_recv(sock);
+  }
+}
+
+ssize_t UringDriver::recv(const UringSocketRef& sock, char *buf, size_t len)
+{
+  if (sock->rx.empty()) {
+    if (sock->rx_error) {
+      return sock->rx_error;
+    }
+    if (sock->rx_eof) {
+      return 0;
+    }
+    if (rx_wanted(*sock)) {
+      arm_recv(sock);
+    }
+    return -EAGAIN;
+  }
+
+  size_t copied = 0;
+  while (copied < len && !sock->rx.empty()) {
+    auto &c = sock->rx.front();
+    size_t n = std::min<size_t>(len - copied, c.len);
+    memcpy(buf + copied, buffers + (size_t)c.bid * buffer_size + c.off, n);
+    copied += n;
+    c.off += n;
+    c.len -= n;
+    sock->rx_bytes -= n;
+    if (c.len == 0) {
+      recycle(c.bid);
+      sock->rx.pop_front();
+    }
+  }
+  if (rx_wanted(*sock)) {
+    arm_recv(sock);
+  }
+  return copied;
+}
+
+void UringDriver::recycle(uint16_t bid)
+{
+  recycled.push_back(bid);
+}
+
+void UringDriver::provide_recycled()
+{
+  if (recycled.empty()) {
+    return;
+  }
+  // give the buffers back by runs of consecutive ids
+  std::sort(recycled.begin(), recycled.end());
+  size_t start = 0;
+  for (size_t i = 1; i <= recycled.size(); ++i) {
+    if (i < recycled.size() && recycled[i] == recycled[i - 1] + 1) {
+      continue;
+    }
+    const uint16_t bid = recycled[start];
+    auto sqe = get_sqe();
+    io_uring_prep_provide_buffers(sqe, buffers + (size_t)bid * buffer_size,
+				  buffer_size, i - start, buffer_group, bid);
+    io_uring_sqe_set_data(sqe, new_op(OP_PROVIDE, -1));
+    start = i;
+  }
+  recycled.clear();
+
+  std::vector<UringSocketRef> waiting;
+  waiting.swap(starved);
+  for (auto &sock : waiting) {
+    sock->recv_starved = false;
+    if (rx_wanted(*sock)) {
+      arm_recv(sock);
+    }
+  }
+}
+
+ssize_t UringDriver::send(const UringSocketRef& sock, ceph::buffer::list &bl)
+{
+  if (sock->tx_error) {
+    return sock->tx_error;
+  }
+  if (sock->tx_inflight.length() + sock->tx_pending.length() >=
+      send_max_bytes) {
+    // the writes only progress as their completions are reaped: do it now,
+    // rather than relying on the caller going back to the event loop
+    flush_queued();
+    io_uring_submit(ring.get());
+    reap();
+    if (sock->tx_error) {
+      return sock->tx_error;
+    }
+    if (sock->tx_inflight.length() + sock->tx_pending.length() >=
+        send_max_bytes) {
+      // wait for EVENT_WRITABLE
+      return 0;
+    }
+  }
+  ssize_t len = bl.length();
+  sock->tx_pending.claim_append(bl);
+  if (!sock->send_armed && !sock->send_queued) {
+    sock->send_queued = true;
+    to_send.push_back(sock);
+  }
+  return len;
+}
+
+void UringDriver::submit_send(const UringSocketRef& sock)
+{
+  ceph_assert(!sock->send_armed);
+  sock->tx_inflight.claim_append(sock->tx_pending);
+  if (sock->tx_inflight.length() == 0) {
+    return;
+  }
+  sock->iov.clear();
+  for (auto &p : sock->tx_inflight.buffers()) {
+    if (sock->iov.size() == IOV_MAX) {
+      break;
+    }
+    sock->iov.push_back({const_cast<char*>(p.c_str()), p.length()});
+  }
+  memset(&sock->msg, 0, sizeof(sock->msg));
+  sock->msg.msg_iov = sock->iov.data();
+  sock->msg.msg_iovlen = sock->iov.size();
+
+  auto sqe = get_sqe();
+  op_t *op = new_op(OP_SEND, sock->fd, sock);
+  io_uring_prep_sendmsg(sqe, sock->fd, &sock->msg, MSG_NOSIGNAL);
+  io_uring_sqe_set_data(sqe, op);
+  sock->send_armed = true;
+  sock->send_op = op;
+}
+
+void UringDriver::handle_send(op_t *op, int res)
+{
+  auto &sock = op->sock;
+  sock->send_armed = false;
+  sock->send_op = nullptr;
+  if (sock->closed) {
+    sock->tx_inflight.clear();
+    return;
+  }
+  if (res < 0 && res != -EAGAIN && res != -EINTR) {
+    ldout(cct, 1) << __func__ << " send on fd=" << sock->fd << " failed: "
+		  << cpp_strerror(res) << dendl;
+    sock->tx_error = res;
+    sock->tx_inflight.clear();
+    sock->tx_pending.clear();
+    fire(sock->fd, EVENT_READABLE | EVENT_WRITABLE);
+    return;
+  }
+  if (res > 0) {
+    if (static_cast<unsigned>(res) < sock->tx_inflight.length()) {
+      ceph::buffer::list rest;
+      sock->tx_inflight.splice(res, sock->tx_inflight.length() - res, &rest);
+      sock->tx_inflight.swap(rest);
+    } else {
+      sock->tx_inflight.clear();
+    }
+  }
+  if (sock->tx_inflight.length() + sock->tx_pending.length() <
+      send_max_bytes) {
+    fire(sock->fd, EVENT_WRITABLE);
+  }
+  if (!sock->send_queued) {
+    submit_send(sock);
+  }
+}
+
+// ---- the loop ----
+
+void UringDriver::flush_queued()
+{
+  for (int fd : to_rearm) {
+    auto it = fds.find(fd);
+    if (it != fds.end() && !it->second.sock && !it->second.poll) {
+      arm_poll(fd, it->second);
+    }
+  }
+  to_rearm.clear();
+
+  for (auto &sock : to_send) {
+    sock->send_queued = false;
+    if (!sock->closed && !sock->send_armed) {
+      submit_send(sock);
+    }
+  }
+  to_send.clear();
+
+  provide_recycled();
+}
+
+void UringDriver::handle_cqe(struct io_uring_cqe *cqe)
+{
+  if (cqe->user_data == LIBURING_UDATA_TIMEOUT) {
+    return;
+  }
+  op_t *op = static_cast<op_t*>(io_uring_cqe_get_data(cqe));
+  switch (op->type) {
+  case OP_POLL:
+    handle_poll(op, cqe->res);
+    break;
+  case OP_RECV:
+    handle_recv(op, cqe->res, cqe->flags);
+    break;
+  case OP_SEND:
+    handle_send(op, cqe->res);
+    break;
+  case OP_PROVIDE:
+    if (cqe->res < 0) {
+      lderr(cct) << __func__ << " unable to provide receive buffers: "
+		 << cpp_strerror(cqe->res) << dendl;
+    }
+    break;
+  case OP_POLL_REMOVE:
+  case OP_CANCEL:
+    break;
+  }
+  release_op(op);
+}
+
+void UringDriver::reap()
+{
+  struct io_uring *r = ring.get();
+  struct io_uring_cqe *cqe;
+  unsigned head;
+  unsigned reaped = 0;
+  io_uring_for_each_cqe(r, head, cqe) {
+    handle_cqe(cqe);
+    ++reaped;
+  }
+  io_uring_cq_advance(r, reaped);
+}
+
+int UringDriver::event_wait(std::vector<FiredFileEvent> &fired_events,
+			    struct timeval *tvp)
+{
+  flush_queued();
+
+  struct io_uring *r = ring.get();
+  struct io_uring_cqe *cqe = nullptr;
+  int ret = 0;
+  if (!fired.empty() || io_uring_cq_ready(r) ||
+      (tvp && tvp->tv_sec == 0 && tvp->tv_usec == 0)) {
+    // no waiting
+    if (io_uring_sq_ready(r)) {
+      ret = io_uring_submit(r);
+    }
+  } else if (tvp) {
+    // submits whatever was queued, and waits, with the same syscall
+    struct __kernel_timespec ts;
+    ts.tv_sec = tvp->tv_sec;
+    ts.tv_nsec = tvp->tv_usec * 1000;
+    ret = io_uring_wait_cqe_timeout(r, &cqe, &ts);
+    if (ret == -ETIME) {
+      ret = 0;
+    }
+  } else {
+    ret = io_uring_submit_and_wait(r, 1);
+  }
+  if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+    lderr(cct) << __func__ << " io_uring_enter failed: "
+	       << cpp_strerror(ret) << dendl;
+  }
+
+  reap();
+
+  fired_events.resize(fired.size());
+  int n = 0;
+  for (auto& [fd, mask] : fired) {
+    fired_events[n].fd = fd;
+    fired_events[n].mask = mask;
+    ++n;
+  }
+  fired.clear();
+  return n;
+}
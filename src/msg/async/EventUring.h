@@ -0,0 +1,171 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_EVENTURING_H
+#define CEPH_MSG_EVENTURING_H
+
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <boost/intrusive/list.hpp>
+
+#include "include/buffer.h"
+#include "Event.h"
+
+struct io_uring;
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/*
+ * State of a connected socket whose data path goes through the ring (see
+ * UringStack). Shared by the socket and its in-flight operations, so that a
+ * completion reaped after the socket was closed finds it marked as such.
+ */
+struct UringSocket {
+  struct rx_chunk_t {
+    uint16_t bid;     ///< provided buffer id
+    uint32_t off;
+    uint32_t len;
+  };
+
+  int fd;
+  bool closed = false;
+
+  // rx: one recv in flight at most, filled from the driver's buffer group
+  bool recv_armed = false;
+  void *recv_op = nullptr;
+  bool recv_starved = false;  ///< waiting for a provided buffer
+  std::deque<rx_chunk_t> rx;
+  uint64_t rx_bytes = 0;
+  bool rx_eof = false;
+  int rx_error = 0;
+
+  // tx: bytes accepted by send() and not yet written to the kernel
+  bool send_armed = false;
+  bool send_queued = false;
+  void *send_op = nullptr;
+  ceph::buffer::list tx_inflight;  ///< handed to the current sendmsg
+  ceph::buffer::list tx_pending;   ///< appended while a sendmsg is in flight
+  std::vector<struct iovec> iov;
+  struct msghdr msg = {};
+  int tx_error = 0;
+
+  explicit UringSocket(int f) : fd(f) {}
+};
+using UringSocketRef = std::shared_ptr<UringSocket>;
+
+/*
+ * An EventDriver on top of io_uring(7).
+ *
+ * Plain file descriptors (the notify pipe, listening and connecting sockets)
+ * are watched with one-shot IORING_OP_POLL_ADD requests, re-armed after they
+ * fire, which gives the same level triggered semantics as select().
+ *
+ * The connected sockets of the io_uring stack are attached with
+ * attach_socket() and do not use poll at all: the driver keeps a receive
+ * posted on each of them, picking its buffer from a group of provided
+ * buffers, and reports them readable when data (or an error) was received.
+ * Sends are queued and only submitted when the event loop goes back to
+ * event_wait(), so that all the writes issued while processing a batch of
+ * events cost a single io_uring_enter(2), which is also the one waiting for
+ * the next completions.
+ */
+class UringDriver : public EventDriver {
+ public:
+  explicit UringDriver(CephContext *c);
+  ~UringDriver() override;
+
+  int init(EventCenter *c, int nevent) override;
+  int add_event(int fd, int cur_mask, int add_mask) override;
+  int del_event(int fd, int cur_mask, int del_mask) override;
+  int resize_events(int newsize) override;
+  int event_wait(std::vector<FiredFileEvent> &fired_events,
+		 struct timeval *tp) override;
+
+  /// route the data path of 'sock' through the ring
+  void attach_socket(const UringSocketRef& sock);
+  /// forget about 'sock', its in-flight operations are cancelled
+  void detach_socket(const UringSocketRef& sock);
+
+  /// copy up to 'len' received bytes. -EAGAIN if there are none yet.
+  ssize_t recv(const UringSocketRef& sock, char *buf, size_t len);
+  /// take over the content of 'bl', and send it with the next submission
+  ssize_t send(const UringSocketRef& sock, ceph::buffer::list &bl);
+
+ private:
+  enum op_type_t : uint8_t {
+    OP_POLL,
+    OP_POLL_REMOVE,
+    OP_RECV,
+    OP_SEND,
+    OP_CANCEL,
+    OP_PROVIDE,
+  };
+  struct op_t : public boost::intrusive::list_base_hook<> {
+    op_type_t type;
+    int fd = -1;
+    UringSocketRef sock;
+    op_t(op_type_t t, int f, UringSocketRef s = {})
+      : type(t), fd(f), sock(std::move(s)) {}
+  };
+  struct fd_state_t {
+    int mask = EVENT_NONE;
+    op_t *poll = nullptr;   ///< the armed poll request, if any
+    int poll_mask = EVENT_NONE;
+    UringSocketRef sock;
+  };
+
+  CephContext *cct;
+  std::unique_ptr<struct io_uring> ring;
+  unsigned queue_depth = 0;
+  uint64_t send_max_bytes = 0;
+  boost::intrusive::list<op_t> inflight;  ///< owned, until reaped
+
+  // the provided receive buffers
+  static constexpr int buffer_group = 0;
+  char *buffers = nullptr;
+  unsigned buffer_size = 0;
+  unsigned num_buffers = 0;
+  std::vector<uint16_t> recycled;    ///< to give back to the kernel
+  std::vector<UringSocketRef> starved;
+
+  std::unordered_map<int, fd_state_t> fds;
+  std::vector<int> to_rearm;         ///< fds whose poll fired
+  std::vector<UringSocketRef> to_send;
+  std::unordered_map<int, int> fired; ///< fd -> mask, for event_wait()
+
+  struct io_uring_sqe *get_sqe();
+  op_t *new_op(op_type_t type, int fd, UringSocketRef sock = {});
+  void release_op(op_t *op);
+  void arm_poll(int fd, fd_state_t &st);
+  void disarm_poll(fd_state_t &st);
+  void arm_recv(const UringSocketRef& sock);
+  void submit_send(const UringSocketRef& sock);
+  void provide_recycled();
+  void recycle(uint16_t bid);
+  void fire(int fd, int mask);
+  bool rx_wanted(const UringSocket& sock) const;
+  void flush_queued();
+  void reap();
+
+  void handle_cqe(struct io_uring_cqe *cqe);
+  void handle_poll(op_t *op, int res);
+  void handle_recv(op_t *op, int res, unsigned flags);
+  void handle_send(op_t *op, int res);
+};
+
+#endif
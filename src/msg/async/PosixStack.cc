@@ -22,6 +22,11 @@
 
 #include <algorithm>
 
+#include "acconfig.h"
+#ifdef HAVE_LINUX_TLS_H
+#include <linux/tls.h>
+#endif
+
 #include "PosixStack.h"
 
 #include "include/buffer.h"
@@ -32,11 +37,37 @@
 #include "msg/Messenger.h"
 #include "include/compat.h"
 #include "include/sock_compat.h"
+#include "common/ceph_crypto.h"
+#include "msg/async/crypto_onwire.h"
 
 #define dout_subsys ceph_subsys_ms
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+#ifdef HAVE_LINUX_TLS_H
+// cleared once a connection failed to enable kernel TLS, so that the next
+// ones fall back to the usual secure mode
+static std::atomic<bool> ktls_usable = true;
+
+// whether the kernel has the "tls" ULP, probed on a socket which is not
+// connected yet: attaching it fails with ENOENT if there is no such ULP
+// (after trying to load the module), with ENOTCONN otherwise
+static bool probe_ktls()
+{
+  static const bool available = [] {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return false;
+    }
+    int r = ::setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls"));
+    int err = r < 0 ? errno : 0;
+    ::close(fd);
+    return err != ENOENT && err != ENOPROTOOPT;
+  }();
+  return available;
+}
+#endif
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   ceph::NetHandler &handler;
   int _fd;
@@ -209,6 +240,48 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   int fd() const override {
     return _fd;
   }
+#ifdef HAVE_LINUX_TLS_H
+  bool support_ktls() const override {
+    return ktls_usable && probe_ktls();
+  }
+  int enable_ktls(const ceph::crypto::onwire::ktls_params_t& params) override {
+    int r = ::setsockopt(_fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls"));
+    if (r == 0) {
+      r = set_ktls_crypto_info(TLS_TX, params.key, params.tx_nonce);
+    }
+    if (r == 0) {
+      r = set_ktls_crypto_info(TLS_RX, params.key, params.rx_nonce);
+    }
+    if (r < 0) {
+      r = -errno;
+      ktls_usable = false;
+    }
+    return r;
+  }
+
+ private:
+  int set_ktls_crypto_info(int direction, const std::array<uint8_t, 16>& key,
+			   const std::array<uint8_t, 12>& nonce) {
+    tls12_crypto_info_aes_gcm_128 info;
+    // FIPS zeroization audit: the key is zeroized below.
+    memset(&info, 0, sizeof(info));
+    info.info.version = TLS_1_2_VERSION;
+    info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+    static_assert(sizeof(info.key) == sizeof(key));
+    static_assert(sizeof(info.salt) + sizeof(info.iv) == sizeof(nonce));
+    memcpy(info.key, key.data(), sizeof(info.key));
+    memcpy(info.salt, nonce.data(), sizeof(info.salt));
+    memcpy(info.iv, nonce.data() + sizeof(info.salt), sizeof(info.iv));
+    // rec_seq starts at 0, it is only authenticated
+    int r = ::setsockopt(_fd, SOL_TLS, direction, &info, sizeof(info));
+    int err = errno;
+    ::TOPNSPC::crypto::zeroize_for_security(&info, sizeof(info));
+    errno = err;
+    return r;
+  }
+
+ public:
+#endif
   friend class PosixServerSocketImpl;
   friend class PosixNetworkStack;
 };
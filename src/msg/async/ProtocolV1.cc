@@ -335,8 +335,11 @@ void ProtocolV1::write_event() {
       }
 
       if (m->queue_start != ceph::mono_time()) {
-        connection->logger->tinc(l_msgr_send_messages_queue_lat,
-				 ceph::mono_clock::now() - m->queue_start);
+        const auto queued = ceph::mono_clock::now() - m->queue_start;
+        connection->logger->tinc(l_msgr_send_messages_queue_lat, queued);
+        if (auto latency = connection->get_latency(); latency) {
+          latency->add(ConnectionLatency::OUT_QUEUE, queued);
+        }
       }
 
       r = write_message(m, data, more);
@@ -949,6 +952,13 @@ CtPtr ProtocolV1::handle_message_footer(char *buffer, int r) {
   message->set_recv_stamp(recv_stamp);
   message->set_throttle_stamp(throttle_stamp);
   message->set_recv_complete_stamp(ceph_clock_now());
+  {
+    const utime_t recv_lat = message->get_recv_complete_stamp() - recv_stamp;
+    connection->logger->tinc(l_msgr_recv_messages_lat, recv_lat);
+    if (auto latency = connection->get_latency(); latency) {
+      latency->add(ConnectionLatency::RECV, recv_lat);
+    }
+  }
 
   // check received seq#.  if it is old, drop the message.
   // note that incoming messages may skip ahead.  this is convenient for the
@@ -34,6 +34,16 @@ std::ostream &ProtocolV2::_conn_prefix(std::ostream *_dout) {
 using namespace ceph::msgr::v2;
 
 using CtPtr = Ct<ProtocolV2> *;
+
+// what we advertise in the banner
+static uint64_t msgr2_supported_features(bool ktls) {
+  uint64_t features = CEPH_MSGR2_SUPPORTED_FEATURES |
+    ceph::compression::onwire::rxtx_t::get_supported_features();
+  if (ktls) {
+    features |= CEPH_MSGR2_FEATURE_KTLS;
+  }
+  return features;
+}
 using CtRef = Ct<ProtocolV2> &;
 
 void ProtocolV2::run_continuation(CtPtr pcontinuation) {
@@ -232,6 +242,13 @@ void ProtocolV2::reset_security() {
   auth_meta.reset(new AuthConnectionMeta);
   session_stream_handlers.rx.reset(nullptr);
   session_stream_handlers.tx.reset(nullptr);
+  // the compression streams start over with the next socket
+  session_compression_handlers.rx.reset(nullptr);
+  session_compression_handlers.tx.reset(nullptr);
+  tx_compression_gate.reset();
+  tx_compression_checked = false;
+  session_ktls = false;
+  tx_unflushed.clear();
   pre_auth.rxbuf.clear();
   pre_auth.txbuf.clear();
 }
@@ -511,7 +528,7 @@ ProtocolV2::out_queue_entry_t ProtocolV2::_get_next_outgoing() {
   return out_entry;
 }
 
-ssize_t ProtocolV2::write_message(Message *m, bool more) {
+ssize_t ProtocolV2::write_message(Message *m) {
   FUNCTRACE(cct);
   ceph_assert(connection->center->in_thread());
   m->set_seq(++out_seq);
@@ -537,30 +554,32 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
 			     m->get_payload(),
 			     m->get_middle(),
 			     m->get_data());
-  if (!append_frame(message)) {
+  const __u8 frame_flags = compress_message_frame(message);
+  if (tx_batch.frames == 0) {
+    tx_batch.start = ceph::mono_clock::now();
+    // room for the preambles, crcs and epilogues of the frames to come
+    connection->outgoing_bl.reserve(CEPH_PAGE_SIZE);
+  }
+  const auto queued = connection->outgoing_bl.length();
+  if (!append_frame(message, frame_flags)) {
     m->put();
     return -EILSEQ;
   }
+  tx_batch.bytes += connection->outgoing_bl.length() - queued;
+  ++tx_batch.frames;
+  if (connection->get_latency() && m->queue_start != ceph::mono_time()) {
+    tx_unflushed.push_back(m->queue_start);
+  }
 
   ldout(cct, 5) << __func__ << " sending message m=" << m
                 << " seq=" << m->get_seq() << " " << *m << dendl;
 
   m->trace.event("async writing message");
-  ldout(cct, 20) << __func__ << " sending m=" << m << " seq=" << m->get_seq()
+  ldout(cct, 20) << __func__ << " queued m=" << m << " seq=" << m->get_seq()
                  << " src=" << entity_name_t(messenger->get_myname())
                  << " off=" << header2.data_off
-                 << dendl;
-  ssize_t total_send_size = connection->outgoing_bl.length();
-  ssize_t rc = connection->_try_send(more);
-  if (rc < 0) {
-    ldout(cct, 1) << __func__ << " error sending " << m << ", "
-                  << cpp_strerror(rc) << dendl;
-  } else {
-    connection->logger->inc(
-        l_msgr_send_bytes, total_send_size - connection->outgoing_bl.length());
-    ldout(cct, 10) << __func__ << " sending " << m
-                   << (rc ? " continuely." : " done.") << dendl;
-  }
+                 << ", batch of " << tx_batch.frames << " frames "
+                 << tx_batch.bytes << " bytes" << dendl;
 
 #if defined(WITH_EVENTTRACE)
   if (m->get_type() == CEPH_MSG_OSD_OP)
@@ -570,22 +589,201 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
 #endif
   m->put();
 
+  return 0;
+}
+
+bool ProtocolV2::want_tx_compression() const {
+  if (!ceph::compression::onwire::rxtx_t::is_negotiated(
+          peer_supported_features)) {
+    return false;
+  }
+  const auto mode = cct->_conf.get_val<std::string>("ms_compress_mode");
+  if (mode == "none") {
+    return false;
+  }
+  if ((session_stream_handlers.tx || session_ktls) &&
+      !cct->_conf.get_val<bool>("ms_compress_secure")) {
+    return false;
+  }
+  if (mode == "daemons") {
+    return messenger->get_mytype() != CEPH_ENTITY_TYPE_CLIENT &&
+           connection->get_peer_type() != CEPH_ENTITY_TYPE_CLIENT;
+  }
+  return true;
+}
+
+// Compress the segments of 'frame' if worth it, returns the preamble flags.
+__u8 ProtocolV2::compress_message_frame(MessageFrame& frame) {
+  if (!tx_compression_checked) {
+    tx_compression_checked = true;
+    if (want_tx_compression()) {
+      session_compression_handlers.tx =
+          ceph::compression::onwire::rxtx_t::create_tx_handler(cct);
+      tx_compression_gate.emplace(
+          cct->_conf.get_val<Option::size_t>("ms_compress_min_size"),
+          cct->_conf.get_val<double>("ms_compress_max_ratio"));
+      ldout(cct, 10) << __func__ << " compressing messages" << dendl;
+    }
+  }
+  if (!session_compression_handlers.tx) {
+    return 0;
+  }
+
+  auto& segments = frame.get_segments();
+  uint64_t raw_len = 0;
+  for (const auto& segment : segments) {
+    raw_len += segment.length();
+  }
+  if (!tx_compression_gate->want(raw_len)) {
+    return 0;
+  }
+  uint64_t compressed_len = 0;
+  for (auto& segment : segments) {
+    if (segment.length() > 0) {
+      session_compression_handlers.tx->compress(segment);
+      compressed_len += segment.length();
+    }
+  }
+  tx_compression_gate->account(raw_len, compressed_len);
+  connection->logger->inc(l_msgr_send_compressed_raw_bytes, raw_len);
+  connection->logger->inc(l_msgr_send_compressed_bytes, compressed_len);
+  ldout(cct, 20) << __func__ << " " << raw_len << " -> " << compressed_len
+                 << " bytes, average ratio "
+                 << tx_compression_gate->get_avg_ratio() << dendl;
+  return FRAME_EARLY_DATA_STREAM_COMPRESSED;
+}
+
+bool ProtocolV2::decompress_message_frame() {
+  auto& rx = session_compression_handlers.rx;
+  if (!rx) {
+    rx = ceph::compression::onwire::rxtx_t::create_rx_handler(cct);
+    if (!rx) {
+      ldout(cct, 1) << __func__ << " got a compressed frame, but"
+                    << " compression is not supported" << dendl;
+      return false;
+    }
+  }
+  uint64_t compressed_len = 0;
+  uint64_t raw_len = 0;
+  try {
+    for (size_t i = 0; i < rx_segments_data.size(); i++) {
+      auto& segment = rx_segments_data[i];
+      if (segment.length() > 0) {
+        compressed_len += segment.length();
+        rx->decompress(segment, rx_frame_asm.get_segment_align(i),
+                       ceph::compression::onwire::MAX_FRAME_SIZE - raw_len);
+        raw_len += segment.length();
+      }
+    }
+  } catch (ceph::compression::onwire::DecompressError& e) {
+    ldout(cct, 1) << __func__ << " " << e.what() << dendl;
+    return false;
+  }
+  connection->logger->inc(l_msgr_recv_compressed_bytes, compressed_len);
+  return true;
+}
+
+/*
+ * Kernel TLS: once authenticated, both ends hand the session keys to the
+ * kernel, and send the frames as in crc mode from then on, the kernel
+ * wrapping them in TLS records. Each end switches its socket when it
+ * has sent all of its plaintext and before it may read any ciphertext,
+ * which the handshake arranges for:
+ *
+ *  - the server switches once AUTH_DONE is sent: the client sends nothing
+ *    until it gets it;
+ *  - the client switches when it gets AUTH_DONE, before sending its
+ *    AUTH_SIGNATURE: the server sends its own one only once it got the
+ *    one of the client, instead of right after AUTH_DONE.
+ */
+bool ProtocolV2::want_ktls() const {
+  return ktls_offered &&
+         auth_meta->is_mode_secure() &&
+         HAVE_MSGR2_FEATURE(peer_supported_features, KTLS) &&
+         HAVE_MSGR2_FEATURE(peer_supported_features, REVISION_1);
+}
+
+int ProtocolV2::enable_ktls(bool crossed) {
+  auto params = ceph::crypto::onwire::rxtx_t::get_ktls_params(*auth_meta,
+                                                               crossed);
+  int r = connection->enable_ktls(params);
+  if (r < 0) {
+    // the peer expects TLS records already, there is no going back for
+    // this socket: the next ones will not offer kernel TLS anymore
+    lderr(cct) << __func__ << " failed to enable kernel TLS: "
+               << cpp_strerror(r) << dendl;
+    return r;
+  }
+  ldout(cct, 10) << __func__ << " kernel TLS enabled" << dendl;
+  session_ktls = true;
+  return 0;
+}
+
+bool ProtocolV2::should_flush_batch(bool more) const {
+  if (!more) {
+    // nothing else to wait for: a lone message is sent right away
+    return true;
+  }
+  const auto& conf = cct->_conf;
+  if (tx_batch.bytes >= conf->ms_async_write_coalesce_bytes) {
+    return true;
+  }
+  // the frames of a large batch may take a while to assemble (e.g. to
+  // encrypt), do not hold the first ones for too long
+  return ceph::mono_clock::now() - tx_batch.start >=
+    std::chrono::microseconds(conf->ms_async_write_coalesce_max_us);
+}
+
+ssize_t ProtocolV2::flush_batch(bool more) {
+  ldout(cct, 20) << __func__ << " sending " << tx_batch.frames << " frames "
+                 << tx_batch.bytes << " bytes" << (more ? ", more" : "")
+                 << dendl;
+  ssize_t total_send_size = connection->outgoing_bl.length();
+  ssize_t rc = connection->_try_send(more);
+  if (rc < 0) {
+    ldout(cct, 1) << __func__ << " error sending " << tx_batch.frames
+                  << " frames, " << cpp_strerror(rc) << dendl;
+  } else {
+    connection->logger->inc(
+        l_msgr_send_bytes, total_send_size - connection->outgoing_bl.length());
+    connection->logger->inc(l_msgr_send_batches);
+    ldout(cct, 10) << __func__ << " sending " << tx_batch.frames << " frames"
+                   << (rc ? " continuely." : " done.") << dendl;
+    if (rc == 0) {
+      account_sent();
+    }
+  }
+  tx_batch.bytes = 0;
+  tx_batch.frames = 0;
   return rc;
 }
 
+void ProtocolV2::account_sent() {
+  if (tx_unflushed.empty()) {
+    return;
+  }
+  if (auto latency = connection->get_latency(); latency) {
+    const auto now = ceph::mono_clock::now();
+    for (const auto& queued : tx_unflushed) {
+      latency->add(ConnectionLatency::SEND, now - queued);
+    }
+  }
+  tx_unflushed.clear();
+}
+
 template <class F>
-bool ProtocolV2::append_frame(F& frame) {
-  ceph::bufferlist bl;
+bool ProtocolV2::append_frame(F& frame, __u8 flags) {
+  const auto queued = connection->outgoing_bl.length();
   try {
-    bl = frame.get_buffer(tx_frame_asm);
+    frame.append_buffer(tx_frame_asm, connection->outgoing_bl, flags);
   } catch (ceph::crypto::onwire::TxHandlerError &e) {
     ldout(cct, 1) << __func__ << " " << e.what() << dendl;
     return false;
   }
 
-  ldout(cct, 25) << __func__ << " assembled frame " << bl.length()
+  ldout(cct, 25) << __func__ << " assembled frame "
+                 << connection->outgoing_bl.length() - queued
                  << " bytes " << tx_frame_asm << dendl;
-  connection->outgoing_bl.append(bl);
   return true;
 }
 
@@ -658,12 +856,17 @@ void ProtocolV2::write_event() {
       }
 
       if (out_entry.m->queue_start != ceph::mono_time()) {
-        connection->logger->tinc(l_msgr_send_messages_queue_lat,
-				 ceph::mono_clock::now() -
-				 out_entry.m->queue_start);
+        const auto queued = ceph::mono_clock::now() - out_entry.m->queue_start;
+        connection->logger->tinc(l_msgr_send_messages_queue_lat, queued);
+        if (auto latency = connection->get_latency(); latency) {
+          latency->add(ConnectionLatency::OUT_QUEUE, queued);
+        }
       }
 
-      r = write_message(out_entry.m, more);
+      r = write_message(out_entry.m);
+      if (r == 0 && should_flush_batch(more)) {
+        r = flush_batch(more);
+      }
 
       connection->write_lock.lock();
       if (r == 0) {
@@ -677,6 +880,12 @@ void ProtocolV2::write_event() {
         break;
       }
     } while (can_write);
+    if (r == 0 && tx_batch.frames) {
+      // stopped before the queue got empty
+      r = flush_batch(false);
+    }
+    tx_batch.bytes = 0;
+    tx_batch.frames = 0;
     write_in_progress = false;
 
     // if r > 0 mean data still lefted, so no need _try_send.
@@ -696,6 +905,10 @@ void ProtocolV2::write_event() {
       } else if (is_queued()) {
         r = connection->_try_send();
       }
+      if (r == 0 && !connection->is_queued()) {
+        // what was left over by flush_batch() went out as well
+        account_sent();
+      }
     }
     connection->write_lock.unlock();
 
@@ -821,9 +1034,12 @@ CtPtr ProtocolV2::_banner_exchange(CtRef callback) {
   ldout(cct, 20) << __func__ << dendl;
   bannerExchangeCallback = &callback;
 
+  ktls_offered = cct->_conf.get_val<bool>("ms_ktls") &&
+                 connection->cs.support_ktls();
+
   ceph::bufferlist banner_payload;
   using ceph::encode;
-  encode((uint64_t)CEPH_MSGR2_SUPPORTED_FEATURES, banner_payload, 0);
+  encode(msgr2_supported_features(ktls_offered), banner_payload, 0);
   encode((uint64_t)CEPH_MSGR2_REQUIRED_FEATURES, banner_payload, 0);
 
   ceph::bufferlist bl;
@@ -911,7 +1127,7 @@ CtPtr ProtocolV2::_handle_peer_banner_payload(rx_buffer_t &&buffer, int r) {
 
   // Check feature bit compatibility
 
-  uint64_t supported_features = CEPH_MSGR2_SUPPORTED_FEATURES;
+  uint64_t supported_features = msgr2_supported_features(ktls_offered);
   uint64_t required_features = CEPH_MSGR2_REQUIRED_FEATURES;
 
   if ((required_features & peer_supported_features) != required_features) {
@@ -1104,6 +1320,9 @@ CtPtr ProtocolV2::handle_read_frame_preamble_main(rx_buffer_t &&buffer, int r) {
       lderr(cct) << __func__ << " not in ready state!" << dendl;
       return _fault();
     }
+    // as ProtocolV1 does on its MSG tag: the RECV latency covers the
+    // throttling and the reading of the segments
+    recv_stamp = ceph_clock_now();
     state = THROTTLE_MESSAGE;
     return CONTINUE(throttle_message);
   } else {
@@ -1335,9 +1554,22 @@ CtPtr ProtocolV2::handle_message() {
 #if defined(WITH_EVENTTRACE)
   utime_t ltt_recv_stamp = ceph_clock_now();
 #endif
-  recv_stamp = ceph_clock_now();
 
+  // the throttles were taken for the frame as it came off the wire: when
+  // compressed, for less than the memory the message will use. What it
+  // decompresses to is bounded by MAX_FRAME_SIZE, and the policy throttle
+  // is made up for once the message is decoded
   const size_t cur_msg_size = get_current_msg_size();
+  const __u8 frame_flags = rx_frame_asm.get_preamble_flags();
+  if (frame_flags & FRAME_EARLY_DATA_COMPRESSED) {
+    ldout(cct, 1) << __func__ << " got a frame compressed with the"
+                  << " unsupported upstream on-wire compression" << dendl;
+    return _fault();
+  }
+  if ((frame_flags & FRAME_EARLY_DATA_STREAM_COMPRESSED) &&
+      !decompress_message_frame()) {
+    return _fault();
+  }
   auto msg_frame = MessageFrame::Decode(rx_segments_data);
 
   // XXX: paranoid copy just to avoid oops
@@ -1386,6 +1618,18 @@ CtPtr ProtocolV2::handle_message() {
 
   message->set_byte_throttler(connection->policy.throttler_bytes);
   message->set_message_throttler(connection->policy.throttler_messages);
+  if ((frame_flags & FRAME_EARLY_DATA_STREAM_COMPRESSED) &&
+      connection->policy.throttler_bytes) {
+    // the message gives back what it uses once decompressed, when it
+    // only took what came off the wire
+    const size_t len = msg_frame.front_len() + msg_frame.middle_len() +
+                       msg_frame.data_len();
+    if (len > cur_msg_size) {
+      connection->policy.throttler_bytes->take(len - cur_msg_size);
+    } else {
+      connection->policy.throttler_bytes->put(cur_msg_size - len);
+    }
+  }
 
   // store reservation size in message, so we don't get confused
   // by messages entering the dispatch queue through other paths.
@@ -1394,6 +1638,13 @@ CtPtr ProtocolV2::handle_message() {
   message->set_recv_stamp(recv_stamp);
   message->set_throttle_stamp(throttle_stamp);
   message->set_recv_complete_stamp(ceph_clock_now());
+  {
+    const utime_t recv_lat = message->get_recv_complete_stamp() - recv_stamp;
+    connection->logger->tinc(l_msgr_recv_messages_lat, recv_lat);
+    if (auto latency = connection->get_latency(); latency) {
+      latency->add(ConnectionLatency::RECV, recv_lat);
+    }
+  }
 
   // check received seq#.  if it is old, drop the message.
   // note that incoming messages may skip ahead.  this is convenient for the
@@ -1813,9 +2064,15 @@ CtPtr ProtocolV2::handle_auth_done(ceph::bufferlist &payload)
     return _fault();
   }
   auth_meta->con_mode = auth_done.con_mode();
-  bool is_rev1 = HAVE_MSGR2_FEATURE(peer_supported_features, REVISION_1);
-  session_stream_handlers = ceph::crypto::onwire::rxtx_t::create_handler_pair(
-      cct, *auth_meta, /*new_nonce_format=*/is_rev1, /*crossed=*/false);
+  if (want_ktls()) {
+    if (enable_ktls(/*crossed=*/false) < 0) {
+      return _fault();
+    }
+  } else {
+    bool is_rev1 = HAVE_MSGR2_FEATURE(peer_supported_features, REVISION_1);
+    session_stream_handlers = ceph::crypto::onwire::rxtx_t::create_handler_pair(
+        cct, *auth_meta, /*new_nonce_format=*/is_rev1, /*crossed=*/false);
+  }
 
   state = AUTH_CONNECTING_SIGN;
 
@@ -2194,6 +2451,14 @@ CtPtr ProtocolV2::finish_auth()
   ceph_assert(auth_meta);
   // TODO: having a possibility to check whether we're server or client could
   // allow reusing finish_auth().
+  if (want_ktls()) {
+    if (enable_ktls(/*crossed=*/true) < 0) {
+      return _fault();
+    }
+    // our signature goes after the one of the client, see want_ktls()
+    pre_auth.enabled = false;
+    return CONTINUE(read_frame);
+  }
   bool is_rev1 = HAVE_MSGR2_FEATURE(peer_supported_features, REVISION_1);
   session_stream_handlers = ceph::crypto::onwire::rxtx_t::create_handler_pair(
       cct, *auth_meta, /*new_nonce_format=*/is_rev1, /*crossed=*/true);
@@ -2253,6 +2518,13 @@ CtPtr ProtocolV2::handle_auth_signature(ceph::bufferlist &payload)
     // server had sent AuthDone and client responded with correct pre-auth
     // signature. we can start accepting new sessions/reconnects.
     state = SESSION_ACCEPTING;
+    if (session_ktls) {
+      const auto sig = auth_meta->session_key.empty() ? sha256_digest_t() :
+        auth_meta->session_key.hmac_sha256(cct, pre_auth.rxbuf);
+      auto sig_frame = AuthSignatureFrame::Encode(sig);
+      pre_auth.rxbuf.clear();
+      return WRITE(sig_frame, "auth signature", read_frame);
+    }
     return CONTINUE(read_frame);
   } else if (state == AUTH_CONNECTING_SIGN) {
     // this happened at client side
@@ -2693,7 +2965,8 @@ CtPtr ProtocolV2::reuse_connection(const AsyncConnectionRef& existing,
         new_worker,
         new_center,
         exproto,
-        temp_stream_handlers=std::move(temp_stream_handlers)
+        temp_stream_handlers=std::move(temp_stream_handlers),
+        session_ktls=session_ktls
       ](ConnectedSocket &cs) mutable {
         // we need to delete time event in original thread
         {
@@ -2708,6 +2981,7 @@ CtPtr ProtocolV2::reuse_connection(const AsyncConnectionRef& existing,
           existing->outgoing_bl.clear();
           existing->open_write = false;
           exproto->session_stream_handlers = std::move(temp_stream_handlers);
+          exproto->session_ktls = session_ktls;
           existing->write_lock.unlock();
           if (exproto->state == NONE) {
             existing->shutdown_socket();
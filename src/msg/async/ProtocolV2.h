@@ -4,7 +4,10 @@
 #ifndef _MSG_ASYNC_PROTOCOL_V2_
 #define _MSG_ASYNC_PROTOCOL_V2_
 
+#include <optional>
+
 #include "Protocol.h"
+#include "compression_onwire.h"
 #include "crypto_onwire.h"
 #include "frames_v2.h"
 
@@ -68,6 +71,17 @@ private:
   // TODO: move into auth_meta?
   ceph::crypto::onwire::rxtx_t session_stream_handlers;
 
+  // The compression streams of the current socket, created with the first
+  // message compressed in each direction. See compression_onwire.h.
+  ceph::compression::onwire::rxtx_t session_compression_handlers;
+  std::optional<ceph::compression::onwire::TxGate> tx_compression_gate;
+  bool tx_compression_checked = false;
+
+  // Whether kernel TLS was offered in the banner, and whether it encrypts
+  // the current socket, in place of session_stream_handlers.
+  bool ktls_offered = false;
+  bool session_ktls = false;
+
   entity_name_t peer_name;
   State state;
   uint64_t peer_supported_features;  // CEPH_MSGR2_FEATURE_*
@@ -114,6 +128,17 @@ private:
   bool keepalive;
   bool write_in_progress = false;
 
+  // Message frames appended to outgoing_bl since the last _try_send().
+  // write_event() sends them together, see should_flush_batch().
+  struct {
+    uint64_t bytes = 0;
+    unsigned frames = 0;
+    ceph::mono_time start;
+  } tx_batch;
+  // when the messages written out since the socket was last drained were
+  // queued, for the SEND stage of the ConnectionLatency
+  std::vector<ceph::mono_time> tx_unflushed;
+
   std::ostream& _conn_prefix(std::ostream *_dout);
   void run_continuation(Ct<ProtocolV2> *pcontinuation);
   void run_continuation(Ct<ProtocolV2> &continuation);
@@ -129,7 +154,7 @@ private:
                         ceph::bufferlist &buffer);
 
   template <class F>
-  bool append_frame(F& frame);
+  bool append_frame(F& frame, __u8 flags = 0);
 
   void requeue_sent();
   uint64_t discard_requeued_up_to(uint64_t out_seq, uint64_t seq);
@@ -141,7 +166,15 @@ private:
   void reset_session();
   void prepare_send_message(uint64_t features, Message *m);
   out_queue_entry_t _get_next_outgoing();
-  ssize_t write_message(Message *m, bool more);
+  bool want_tx_compression() const;
+  bool want_ktls() const;
+  int enable_ktls(bool crossed);
+  __u8 compress_message_frame(ceph::msgr::v2::MessageFrame& frame);
+  bool decompress_message_frame();
+  ssize_t write_message(Message *m);
+  bool should_flush_batch(bool more) const;
+  ssize_t flush_batch(bool more);
+  void account_sent();
   void handle_message_ack(uint64_t seq);
 
   CONTINUATION_DECL(ProtocolV2, _wait_for_peer_banner);
@@ -26,8 +26,12 @@
 #ifdef HAVE_DPDK
 #include "dpdk/DPDKStack.h"
 #endif
+#ifdef HAVE_LIBURING
+#include "UringStack.h"
+#endif
 
 #include "common/dout.h"
+#include "common/numa.h"
 #include "include/ceph_assert.h"
 
 #define dout_subsys ceph_subsys_ms
@@ -40,6 +44,18 @@ std::function<void ()> NetworkStack::add_thread(Worker* w)
       char tp_name[16];
       sprintf(tp_name, "msgr-worker-%u", w->id);
       ceph_pthread_setname(pthread_self(), tp_name);
+      if (int cpu = get_round_robin_cpu(
+	    cct->_conf.get_val<std::string>("ms_async_affinity_cores"), w->id);
+	  cpu >= 0) {
+	int r = set_thread_cpu_affinity(cpu);
+	if (r < 0) {
+	  lderr(cct) << __func__ << " failed to pin worker " << w->id
+		     << " to cpu " << cpu << ": " << cpp_strerror(r) << dendl;
+	} else {
+	  ldout(cct, 1) << __func__ << " worker " << w->id << " pinned to cpu "
+			<< cpu << dendl;
+	}
+      }
       const unsigned EventMaxWaitUs = 30000000;
       w->center.set_owner();
       ldout(cct, 10) << __func__ << " starting" << dendl;
@@ -77,6 +93,10 @@ std::shared_ptr<NetworkStack> NetworkStack::create(CephContext *c,
   else if (t == "dpdk")
     stack.reset(new DPDKStack(c));
 #endif
+#ifdef HAVE_LIBURING
+  else if (t == "io_uring")
+    stack.reset(new UringNetworkStack(c));
+#endif
 
   if (stack == nullptr) {
     lderr(c) << __func__ << " ms_async_transport_type " << t <<
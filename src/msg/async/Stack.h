@@ -22,6 +22,10 @@
 #include "msg/msg_types.h"
 #include "msg/async/Event.h"
 
+namespace ceph::crypto::onwire {
+struct ktls_params_t;
+}
+
 class Worker;
 class ConnectedSocketImpl {
  public:
@@ -32,6 +36,13 @@ class ConnectedSocketImpl {
   virtual void shutdown() = 0;
   virtual void close() = 0;
   virtual int fd() const = 0;
+  // kernel TLS, for the stacks which can hand a stream over to the kernel
+  virtual bool support_ktls() const {
+    return false;
+  }
+  virtual int enable_ktls(const ceph::crypto::onwire::ktls_params_t&) {
+    return -EOPNOTSUPP;
+  }
 };
 
 class ConnectedSocket;
@@ -123,6 +134,21 @@ class ConnectedSocket {
     return _csi->fd();
   }
 
+  /// Whether enable_ktls() may work on this socket.
+  bool support_ktls() const {
+    return _csi->support_ktls();
+  }
+  /// Hands the encryption of the stream over to kernel TLS.
+  ///
+  /// From then on, the data sent is encrypted, and the data received
+  /// decrypted, by the kernel, with the AES-128-GCM session of \c params.
+  /// No data of the peer must have been read past that point yet, and all
+  /// that was sent before must have been flushed to the socket already.
+  /// On failure, the socket is not usable anymore.
+  int enable_ktls(const ceph::crypto::onwire::ktls_params_t& params) {
+    return _csi->enable_ktls(params);
+  }
+
   explicit operator bool() const {
     return _csi.get();
   }
@@ -192,6 +218,10 @@ enum {
   l_msgr_send_messages,
   l_msgr_recv_bytes,
   l_msgr_send_bytes,
+  l_msgr_send_batches,
+  l_msgr_send_compressed_raw_bytes,
+  l_msgr_send_compressed_bytes,
+  l_msgr_recv_compressed_bytes,
   l_msgr_created_connections,
   l_msgr_active_connections,
 
@@ -202,6 +232,7 @@ enum {
 
   l_msgr_send_messages_queue_lat,
   l_msgr_handle_ack_lat,
+  l_msgr_recv_messages_lat,
 
   l_msgr_last,
 };
@@ -235,6 +266,10 @@ class Worker {
     plb.add_u64_counter(l_msgr_send_messages, "msgr_send_messages", "Network sent messages");
     plb.add_u64_counter(l_msgr_recv_bytes, "msgr_recv_bytes", "Network received bytes", NULL, 0, unit_t(UNIT_BYTES));
     plb.add_u64_counter(l_msgr_send_bytes, "msgr_send_bytes", "Network sent bytes", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_send_batches, "msgr_send_batches", "Network sends of coalesced messages (msgr2)");
+    plb.add_u64_counter(l_msgr_send_compressed_raw_bytes, "msgr_send_compressed_raw_bytes", "Bytes of the compressed messages, before compression (msgr2)", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_send_compressed_bytes, "msgr_send_compressed_bytes", "Bytes of the compressed messages, after compression (msgr2)", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_recv_compressed_bytes, "msgr_recv_compressed_bytes", "Received bytes of compressed messages (msgr2)", NULL, 0, unit_t(UNIT_BYTES));
     plb.add_u64_counter(l_msgr_active_connections, "msgr_active_connections", "Active connection number");
     plb.add_u64_counter(l_msgr_created_connections, "msgr_created_connections", "Created connection number");
 
@@ -245,6 +280,7 @@ class Worker {
 
     plb.add_time_avg(l_msgr_send_messages_queue_lat, "msgr_send_messages_queue_lat", "Network sent messages lat");
     plb.add_time_avg(l_msgr_handle_ack_lat, "msgr_handle_ack_lat", "Connection handle ack lat");
+    plb.add_time_avg(l_msgr_recv_messages_lat, "msgr_recv_messages_lat", "Network received messages lat, from the first byte to the last (throttling included)", NULL, PerfCountersBuilder::PRIO_USEFUL);
 
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
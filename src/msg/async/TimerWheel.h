@@ -0,0 +1,355 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_TIMERWHEEL_H
+#define CEPH_MSG_TIMERWHEEL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "include/ceph_assert.h"
+
+/**
+ * A hierarchical timing wheel, holding the time events of an EventCenter.
+ *
+ * Time is counted in ticks. LEVELS wheels of SLOTS slots each cover
+ * 256 ticks, 256^2 ticks, and so on: a timer goes into the lowest level
+ * whose range covers its distance to the current tick, in the slot of its
+ * expiry. When the current tick crosses the start of a slot of an upper
+ * level, the timers of that slot are redistributed ("cascaded") to the
+ * lower levels, so that they end up in level 0 when they are due, and a
+ * timer is moved LEVELS - 1 times at most. Timers further away than the
+ * wheels reach are parked in the last level, and reconsidered each time
+ * it cascades.
+ *
+ * The timers live in a vector and are chained by index, the slots being
+ * circular lists around sentinel entries of the same vector, so adding and
+ * cancelling a timer are O(1) and do not allocate once the vector grew to
+ * the number of timers in use. The id of a timer is its index in the
+ * vector tagged with a generation, which is bumped when the entry is
+ * freed, so that a stale id does not cancel another timer.
+ *
+ * advance() moves all the timers due by then, in the order of their
+ * expiry, into the expired list in one go, and pop_expired() takes them
+ * one by one: expired timers can still be cancelled until they are popped.
+ */
+template <typename T>
+class TimerWheel {
+public:
+  static constexpr unsigned LEVEL_BITS = 8;
+  static constexpr unsigned SLOTS = 1u << LEVEL_BITS;
+  static constexpr unsigned LEVELS = 4;
+  /// the farthest tick a timer can be placed at, relative to the current one
+  static constexpr uint64_t MAX_DELTA = (1ull << (LEVEL_BITS * LEVELS)) - 1;
+
+  explicit TimerWheel(uint64_t now = 0)
+    : cur(now), nodes(NUM_LISTS) {
+    for (uint32_t i = 0; i < NUM_LISTS; ++i) {
+      nodes[i].prev = nodes[i].next = i;
+      nodes[i].list = i;
+    }
+  }
+
+  /// the next tick to be processed by advance()
+  uint64_t get_current() const {
+    return cur;
+  }
+  /// the number of timers, expired or not, which were not popped yet
+  size_t size() const {
+    return pending + expired;
+  }
+  bool empty() const {
+    return size() == 0;
+  }
+
+  /**
+   * add a timer
+   *
+   * @param now the current tick
+   * @param when the tick at which it is due; a past tick means as soon as
+   *             possible
+   * @return the id of the new timer, never 0
+   */
+  uint64_t add(uint64_t now, uint64_t when, T value) {
+    if (pending == 0 && now > cur) {
+      // nothing to cascade on the way, catch up with the time
+      cur = now;
+    }
+    uint32_t i;
+    if (free_head != NIL) {
+      i = free_head;
+      free_head = nodes[i].next;
+    } else {
+      i = nodes.size();
+      ceph_assert(i != NIL);
+      nodes.emplace_back();
+    }
+    node_t& n = nodes[i];
+    n.when = when;
+    n.value = std::move(value);
+    place(i);
+    ++pending;
+    return (uint64_t)n.gen << 32 | i;
+  }
+
+  /**
+   * cancel a timer, whether it expired or not, as long as it was not popped
+   *
+   * @return false if there is no such timer (anymore)
+   */
+  bool cancel(uint64_t id) {
+    const uint32_t i = id & 0xffffffff;
+    if (i < NUM_LISTS || i >= nodes.size()) {
+      return false;
+    }
+    node_t& n = nodes[i];
+    if (n.list == NIL || n.gen != id >> 32) {
+      return false;
+    }
+    if (n.list == EXPIRED_LIST) {
+      --expired;
+    } else {
+      --pending;
+    }
+    unlink(i);
+    release(i);
+    return true;
+  }
+
+  /**
+   * process the ticks up to and including 'now': cascade the upper levels
+   * on the way, and move the timers due to the expired list
+   */
+  void advance(uint64_t now) {
+    while (cur <= now) {
+      if (pending == 0) {
+	cur = now + 1;
+	break;
+      }
+      const unsigned idx = cur & MASK;
+      if (idx == 0) {
+	cascade();
+      }
+      // skip the empty slots, up to the next cascade
+      const uint64_t end = std::min(now + 1, (cur | MASK) + 1);
+      const int s = find_slot(0, idx);
+      if (s < 0 || cur + (s - idx) >= end) {
+	cur = end;
+	continue;
+      }
+      cur += s - idx;
+      expire(slot_list(0, s));
+      ++cur;
+    }
+  }
+
+  /**
+   * take the next expired timer
+   *
+   * @return false if there are none
+   */
+  bool pop_expired(uint64_t *id, T *value) {
+    const uint32_t i = nodes[EXPIRED_LIST].next;
+    if (i == EXPIRED_LIST) {
+      return false;
+    }
+    node_t& n = nodes[i];
+    *id = (uint64_t)n.gen << 32 | i;
+    *value = std::move(n.value);
+    --expired;
+    unlink(i);
+    release(i);
+    return true;
+  }
+
+  /**
+   * a lower bound of the tick at which the next timer is due, which is
+   * exact unless the next thing to happen is a cascade
+   *
+   * @return nothing if there are no timers left, expired ones aside
+   */
+  std::optional<uint64_t> next_tick() const {
+    if (pending == 0) {
+      return std::nullopt;
+    }
+    std::optional<uint64_t> next;
+    const unsigned idx = cur & MASK;
+    if (int s = find_slot(0, idx); s >= 0) {
+      next = cur + (s - idx);
+    } else if (int s = find_slot(0, 0); s >= 0) {
+      // wrapped around, in the next round of level 0
+      next = cur + SLOTS - idx + s;
+    }
+    for (unsigned l = 1; l < LEVELS; ++l) {
+      if (level_empty(l)) {
+	continue;
+      }
+      // nothing of this level or above moves before its next slot starts
+      const uint64_t mask = (1ull << (LEVEL_BITS * l)) - 1;
+      const uint64_t cascade_at = (cur + mask) & ~mask;
+      if (!next || cascade_at < *next) {
+	next = cascade_at;
+      }
+      break;
+    }
+    return next;
+  }
+
+  /// forget about all the timers
+  void clear() {
+    for (uint32_t l = 0; l < NUM_LISTS; ++l) {
+      while (nodes[l].next != l) {
+	const uint32_t i = nodes[l].next;
+	unlink(i);
+	release(i);
+      }
+    }
+    for (auto& b : bitmap) {
+      std::fill(std::begin(b), std::end(b), 0);
+    }
+    pending = expired = 0;
+  }
+
+private:
+  static constexpr uint64_t MASK = SLOTS - 1;
+  static constexpr uint32_t EXPIRED_LIST = LEVELS * SLOTS;
+  static constexpr uint32_t NUM_LISTS = EXPIRED_LIST + 1;
+  static constexpr uint32_t NIL = UINT32_MAX;
+  static constexpr unsigned WORD_BITS = 64;
+  static constexpr unsigned WORDS = SLOTS / WORD_BITS;
+
+  struct node_t {
+    uint64_t when = 0;
+    uint32_t prev = NIL;
+    uint32_t next = NIL;
+    uint32_t list = NIL;  ///< the sentinel of the list it is in, NIL if free
+    uint32_t gen = 1;
+    T value{};
+  };
+
+  uint64_t cur;
+  size_t pending = 0;  ///< in the wheels
+  size_t expired = 0;  ///< in the expired list
+  /// the sentinels of the lists first, then the timers
+  std::vector<node_t> nodes;
+  uint32_t free_head = NIL;
+  /// the non-empty slots of each level
+  uint64_t bitmap[LEVELS][WORDS] = {};
+  std::vector<uint32_t> cascading;
+
+  static uint32_t slot_list(unsigned level, unsigned slot) {
+    return level * SLOTS + slot;
+  }
+
+  bool level_empty(unsigned level) const {
+    for (unsigned w = 0; w < WORDS; ++w) {
+      if (bitmap[level][w]) {
+	return false;
+      }
+    }
+    return true;
+  }
+
+  /// the first non-empty slot of 'level' at or after 'from', -1 if none
+  int find_slot(unsigned level, unsigned from) const {
+    unsigned w = from / WORD_BITS;
+    uint64_t bits = bitmap[level][w] & (~0ull << (from % WORD_BITS));
+    while (true) {
+      if (bits) {
+	return w * WORD_BITS + __builtin_ctzll(bits);
+      }
+      if (++w == WORDS) {
+	return -1;
+      }
+      bits = bitmap[level][w];
+    }
+  }
+
+  void link_tail(uint32_t list, uint32_t i) {
+    node_t& n = nodes[i];
+    node_t& head = nodes[list];
+    n.prev = head.prev;
+    n.next = list;
+    nodes[head.prev].next = i;
+    head.prev = i;
+    n.list = list;
+    if (list != EXPIRED_LIST) {
+      bitmap[list / SLOTS][(list % SLOTS) / WORD_BITS] |=
+	1ull << (list % WORD_BITS);
+    }
+  }
+
+  void unlink(uint32_t i) {
+    node_t& n = nodes[i];
+    nodes[n.prev].next = n.next;
+    nodes[n.next].prev = n.prev;
+    const uint32_t list = n.list;
+    if (list != EXPIRED_LIST && nodes[list].next == list) {
+      bitmap[list / SLOTS][(list % SLOTS) / WORD_BITS] &=
+	~(1ull << (list % WORD_BITS));
+    }
+    n.prev = n.next = n.list = NIL;
+  }
+
+  void release(uint32_t i) {
+    node_t& n = nodes[i];
+    n.value = T{};
+    ++n.gen;
+    n.next = free_head;
+    free_head = i;
+  }
+
+  /// put a timer in the slot of its expiry, in the lowest level covering it
+  void place(uint32_t i) {
+    const uint64_t when = std::max(nodes[i].when, cur);
+    const uint64_t at = when - cur > MAX_DELTA ? cur + MAX_DELTA : when;
+    const uint64_t delta = at - cur;
+    unsigned level = 0;
+    while (level < LEVELS - 1 && delta >= (1ull << (LEVEL_BITS * (level + 1)))) {
+      ++level;
+    }
+    link_tail(slot_list(level, (at >> (LEVEL_BITS * level)) & MASK), i);
+  }
+
+  /// redistribute the upper level slots starting at 'cur'
+  void cascade() {
+    for (unsigned l = LEVELS - 1; l > 0; --l) {
+      if (cur & ((1ull << (LEVEL_BITS * l)) - 1)) {
+	continue;
+      }
+      const uint32_t list = slot_list(l, (cur >> (LEVEL_BITS * l)) & MASK);
+      cascading.clear();
+      for (uint32_t i = nodes[list].next; i != list; i = nodes[i].next) {
+	cascading.push_back(i);
+      }
+      for (uint32_t i : cascading) {
+	unlink(i);
+	place(i);
+      }
+    }
+  }
+
+  void expire(uint32_t list) {
+    for (uint32_t i = nodes[list].next; i != list; ) {
+      const uint32_t next = nodes[i].next;
+      unlink(i);
+      link_tail(EXPIRED_LIST, i);
+      --pending;
+      ++expired;
+      i = next;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,249 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+
+#include "UringStack.h"
+#include "EventUring.h"
+
+#include "include/buffer.h"
+#include "common/errno.h"
+#include "common/dout.h"
+#include "msg/Messenger.h"
+#include "include/compat.h"
+#include "include/sock_compat.h"
+
+#define dout_subsys ceph_subsys_ms
+#undef dout_prefix
+#define dout_prefix *_dout << "UringStack "
+
+static UringDriver *get_uring_driver(Worker *w)
+{
+  auto driver = dynamic_cast<UringDriver*>(w->center.get_driver());
+  ceph_assert(driver);
+  return driver;
+}
+
+/*
+ * The socket is attached to the driver of its worker lazily, from that
+ * worker's thread, as the driver is not thread safe: an accepted socket is
+ * created by the thread of the listening worker.
+ */
+class UringConnectedSocketImpl final : public ConnectedSocketImpl {
+  ceph::NetHandler &handler;
+  UringDriver *driver;
+  UringSocketRef sock;
+  entity_addr_t sa;
+  bool connected;
+  bool attached = false;
+  bool shut = false;
+
+  void attach() {
+    if (!attached) {
+      driver->attach_socket(sock);
+      attached = true;
+    }
+  }
+
+ public:
+  UringConnectedSocketImpl(ceph::NetHandler &h, UringDriver *d,
+			   const entity_addr_t &sa, int f, bool connected)
+    : handler(h), driver(d), sock(std::make_shared<UringSocket>(f)),
+      sa(sa), connected(connected) {}
+
+  int is_connected() override {
+    if (connected)
+      return 1;
+
+    int r = handler.reconnect(sa, sock->fd);
+    if (r == 0) {
+      connected = true;
+      return 1;
+    } else if (r < 0) {
+      return r;
+    } else {
+      return 0;
+    }
+  }
+
+  ssize_t read(char *buf, size_t len) override {
+    if (!attached) {
+      // no receive was posted yet, the socket may still be read directly
+      ssize_t r = ::read(sock->fd, buf, len);
+      if (r >= 0)
+	return r;
+      r = -ceph_sock_errno();
+      if (r != -EAGAIN)
+	return r;
+      attach();
+      return -EAGAIN;
+    }
+    return driver->recv(sock, buf, len);
+  }
+
+  // the whole of 'bl' is taken over, unless too much is queued already.
+  // 'more' is moot: the writes are submitted once the event loop is idle
+  ssize_t send(ceph::buffer::list &bl, bool more) override {
+    if (shut) {
+      // what sendmsg(2) would return, the queued writes fail later
+      return -EPIPE;
+    }
+    attach();
+    return driver->send(sock, bl);
+  }
+  void shutdown() override {
+    ::shutdown(sock->fd, SHUT_RDWR);
+    shut = true;
+  }
+  void close() override {
+    if (attached) {
+      driver->detach_socket(sock);
+      attached = false;
+    }
+    compat_closesocket(sock->fd);
+  }
+  int fd() const override {
+    return sock->fd;
+  }
+};
+
+class UringServerSocketImpl : public ServerSocketImpl {
+  ceph::NetHandler &handler;
+  int _fd;
+
+ public:
+  explicit UringServerSocketImpl(ceph::NetHandler &h, int f,
+				 const entity_addr_t& listen_addr, unsigned slot)
+    : ServerSocketImpl(listen_addr.get_type(), slot),
+      handler(h), _fd(f) {}
+  int accept(ConnectedSocket *sock, const SocketOptions &opts, entity_addr_t *out, Worker *w) override;
+  void abort_accept() override {
+    ::close(_fd);
+    _fd = -1;
+  }
+  int fd() const override {
+    return _fd;
+  }
+};
+
+int UringServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &opt, entity_addr_t *out, Worker *w) {
+  ceph_assert(sock);
+  sockaddr_storage ss;
+  socklen_t slen = sizeof(ss);
+  int sd = accept_cloexec(_fd, (sockaddr*)&ss, &slen);
+  if (sd < 0) {
+    return -ceph_sock_errno();
+  }
+
+  int r = handler.set_nonblock(sd);
+  if (r < 0) {
+    ::close(sd);
+    return -ceph_sock_errno();
+  }
+
+  r = handler.set_socket_options(sd, opt.nodelay, opt.rcbuf_size);
+  if (r < 0) {
+    ::close(sd);
+    return -ceph_sock_errno();
+  }
+
+  ceph_assert(NULL != out); //out should not be NULL in accept connection
+
+  out->set_type(addr_type);
+  out->set_sockaddr((sockaddr*)&ss);
+  handler.set_priority(sd, opt.priority, out->get_family());
+
+  // served by the driver of 'w', the worker the connection is assigned to
+  std::unique_ptr<UringConnectedSocketImpl> csi(
+    new UringConnectedSocketImpl(handler, get_uring_driver(w), *out, sd, true));
+  *sock = ConnectedSocket(std::move(csi));
+  return 0;
+}
+
+void UringWorker::initialize()
+{
+}
+
+int UringWorker::listen(entity_addr_t &sa,
+			unsigned addr_slot,
+			const SocketOptions &opt,
+			ServerSocket *sock)
+{
+  int listen_sd = net.create_socket(sa.get_family(), true);
+  if (listen_sd < 0) {
+    return -ceph_sock_errno();
+  }
+
+  int r = net.set_nonblock(listen_sd);
+  if (r < 0) {
+    ::close(listen_sd);
+    return -ceph_sock_errno();
+  }
+
+  r = net.set_socket_options(listen_sd, opt.nodelay, opt.rcbuf_size);
+  if (r < 0) {
+    ::close(listen_sd);
+    return -ceph_sock_errno();
+  }
+
+  r = ::bind(listen_sd, sa.get_sockaddr(), sa.get_sockaddr_len());
+  if (r < 0) {
+    r = -ceph_sock_errno();
+    ldout(cct, 10) << __func__ << " unable to bind to " << sa.get_sockaddr()
+		   << ": " << cpp_strerror(r) << dendl;
+    ::close(listen_sd);
+    return r;
+  }
+
+  r = ::listen(listen_sd, cct->_conf->ms_tcp_listen_backlog);
+  if (r < 0) {
+    r = -ceph_sock_errno();
+    lderr(cct) << __func__ << " unable to listen on " << sa << ": " << cpp_strerror(r) << dendl;
+    ::close(listen_sd);
+    return r;
+  }
+
+  *sock = ServerSocket(
+	  std::unique_ptr<UringServerSocketImpl>(
+	    new UringServerSocketImpl(net, listen_sd, sa, addr_slot)));
+  return 0;
+}
+
+int UringWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, ConnectedSocket *socket) {
+  int sd;
+
+  if (opts.nonblock) {
+    sd = net.nonblock_connect(addr, opts.connect_bind_addr);
+  } else {
+    sd = net.connect(addr, opts.connect_bind_addr);
+  }
+
+  if (sd < 0) {
+    return -ceph_sock_errno();
+  }
+
+  net.set_priority(sd, opts.priority, addr.get_family());
+  *socket = ConnectedSocket(
+      std::unique_ptr<UringConnectedSocketImpl>(
+	new UringConnectedSocketImpl(net, get_uring_driver(this), addr, sd,
+				     !opts.nonblock)));
+  return 0;
+}
+
+UringNetworkStack::UringNetworkStack(CephContext *c)
+    : NetworkStack(c)
+{
+}
@@ -0,0 +1,222 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "compression_onwire.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "acconfig.h"
+#include "common/ceph_context.h"
+#include "include/encoding.h"
+#include "include/msgr.h"
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace ceph::compression::onwire {
+
+#ifdef HAVE_LZ4
+
+// A compressed segment is a sequence of LZ4 blocks, each preceded by
+//
+//   ceph_le32 raw_len
+//   ceph_le32 compressed_len
+//
+// Both ends keep the last WINDOW_SIZE bytes of the stream in a history
+// buffer: the compressor because LZ4 needs the data it refers to to stay
+// in place, the decompressor because it decompresses into it.
+static constexpr uint32_t WINDOW_SIZE = 64 << 10;  // what LZ4 refers to
+static constexpr uint32_t BLOCK_SIZE = 64 << 10;   // at most, uncompressed
+static constexpr uint32_t HISTORY_SIZE = WINDOW_SIZE + 4 * BLOCK_SIZE;
+static constexpr uint32_t BLOCK_HEADER_SIZE = 2 * sizeof(ceph_le32);
+
+class LZ4TxHandler : public TxHandler {
+  LZ4_stream_t* stream;
+  std::unique_ptr<char[]> history;
+  uint32_t pos = 0;
+  int acceleration;
+  std::vector<char> scratch;
+
+public:
+  explicit LZ4TxHandler(int acceleration)
+    : stream(LZ4_createStream()),
+      history(new char[HISTORY_SIZE]),
+      acceleration(acceleration) {
+    if (!stream) {
+      throw std::bad_alloc();
+    }
+  }
+  ~LZ4TxHandler() override {
+    LZ4_freeStream(stream);
+  }
+
+  void compress(ceph::bufferlist& bl) override {
+    auto p = bl.cbegin();
+    uint32_t left = bl.length();
+    const uint32_t nblocks = (left + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    scratch.resize(nblocks * BLOCK_HEADER_SIZE +
+		   nblocks * LZ4_compressBound(std::min(left, BLOCK_SIZE)));
+    char* out = scratch.data();
+    while (left > 0) {
+      const uint32_t len = std::min(left, BLOCK_SIZE);
+      if (pos + len > HISTORY_SIZE) {
+	pos = LZ4_saveDict(stream, history.get(), WINDOW_SIZE);
+      }
+      char* in = history.get() + pos;
+      p.copy(len, in);
+      const int clen = LZ4_compress_fast_continue(
+	stream, in, out + BLOCK_HEADER_SIZE, len,
+	LZ4_compressBound(len), acceleration);
+      ceph_assert(clen > 0);
+      ceph_le32 hdr[2] = {ceph_le32(len), ceph_le32(clen)};
+      ::memcpy(out, hdr, sizeof(hdr));
+      out += BLOCK_HEADER_SIZE + clen;
+      pos += len;
+      left -= len;
+    }
+    ceph::bufferlist compressed;
+    compressed.append(scratch.data(), out - scratch.data());
+    bl.swap(compressed);
+  }
+};
+
+class LZ4RxHandler : public RxHandler {
+  LZ4_streamDecode_t* stream;
+  std::unique_ptr<char[]> history;
+  uint32_t pos = 0;
+  std::vector<char> scratch;
+
+public:
+  LZ4RxHandler()
+    : stream(LZ4_createStreamDecode()),
+      history(new char[HISTORY_SIZE]) {
+    if (!stream) {
+      throw std::bad_alloc();
+    }
+  }
+  ~LZ4RxHandler() override {
+    LZ4_freeStreamDecode(stream);
+  }
+
+  void decompress(ceph::bufferlist& bl, uint16_t align,
+		  uint64_t max_len) override {
+    // validate the block headers, and size the output
+    uint64_t raw_total = 0;
+    for (auto p = bl.cbegin(); !p.end(); ) {
+      if (p.get_remaining() < BLOCK_HEADER_SIZE) {
+	throw DecompressError("truncated block header");
+      }
+      ceph_le32 hdr[2];
+      p.copy(sizeof(hdr), reinterpret_cast<char*>(hdr));
+      if (hdr[0] == 0 || hdr[0] > BLOCK_SIZE ||
+	  hdr[1] == 0 || hdr[1] > (uint32_t)LZ4_compressBound(hdr[0]) ||
+	  hdr[1] > p.get_remaining()) {
+	throw DecompressError("bad block header");
+      }
+      p += hdr[1];
+      raw_total += hdr[0];
+      if (raw_total > max_len) {
+	// each block may expand ~255 times: check before allocating
+	throw DecompressError("frame too large");
+      }
+    }
+
+    if (align < sizeof(void*) || (align & (align - 1))) {
+      align = sizeof(void*);
+    }
+    ceph::bufferptr out(ceph::buffer::create_aligned(raw_total, align));
+    char* o = out.c_str();
+    for (auto p = bl.cbegin(); !p.end(); ) {
+      ceph_le32 hdr[2];
+      p.copy(sizeof(hdr), reinterpret_cast<char*>(hdr));
+      const uint32_t len = hdr[0];
+      const uint32_t clen = hdr[1];
+      if (pos + len > HISTORY_SIZE) {
+	// keep the window right before where the next block goes
+	const uint32_t keep = std::min(pos, WINDOW_SIZE);
+	::memmove(history.get(), history.get() + pos - keep, keep);
+	pos = keep;
+	LZ4_setStreamDecode(stream, history.get(), pos);
+      }
+      const char* in;
+      if (p.get_current_ptr().length() >= clen) {
+	in = p.get_current_ptr().c_str();
+	p += clen;
+      } else {
+	scratch.resize(clen);
+	p.copy(clen, scratch.data());
+	in = scratch.data();
+      }
+      char* dst = history.get() + pos;
+      const int r = LZ4_decompress_safe_continue(stream, in, dst, clen, len);
+      if (r < 0 || (uint32_t)r != len) {
+	throw DecompressError("corrupted block");
+      }
+      ::memcpy(o, dst, len);
+      o += len;
+      pos += len;
+    }
+    bl.clear();
+    bl.append(std::move(out));
+  }
+};
+
+bool rxtx_t::is_supported()
+{
+  return true;
+}
+
+std::unique_ptr<TxHandler> rxtx_t::create_tx_handler(CephContext* cct)
+{
+  return std::make_unique<LZ4TxHandler>(
+    cct->_conf.get_val<int64_t>("ms_compress_lz4_acceleration"));
+}
+
+std::unique_ptr<RxHandler> rxtx_t::create_rx_handler(CephContext* cct)
+{
+  return std::make_unique<LZ4RxHandler>();
+}
+
+#else // !HAVE_LZ4
+
+bool rxtx_t::is_supported()
+{
+  return false;
+}
+
+std::unique_ptr<TxHandler> rxtx_t::create_tx_handler(CephContext* cct)
+{
+  return nullptr;
+}
+
+std::unique_ptr<RxHandler> rxtx_t::create_rx_handler(CephContext* cct)
+{
+  return nullptr;
+}
+
+#endif // HAVE_LZ4
+
+uint64_t rxtx_t::get_supported_features()
+{
+  return is_supported() ? CEPH_MSGR2_FEATURE_STREAM_COMPRESSION : 0;
+}
+
+bool rxtx_t::is_negotiated(uint64_t peer_features)
+{
+  return is_supported() &&
+    HAVE_MSGR2_FEATURE(peer_features, STREAM_COMPRESSION);
+}
+
+} // namespace ceph::compression::onwire
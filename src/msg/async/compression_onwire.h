@@ -0,0 +1,128 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_COMPRESSION_ONWIRE_H
+#define CEPH_COMPRESSION_ONWIRE_H
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+#include "include/buffer.h"
+#include "include/common_fwd.h"
+
+/*
+ * Streaming compression of the msgr2 message frames.
+ *
+ * Each direction of a connection has its own compression stream: all the
+ * segments compressed on a connection go through the same context, so
+ * that a message can refer to the data of the ones sent before it. This
+ * pays off for the many small messages with a similar structure the
+ * daemons exchange (replication ops, map and stat updates), which hardly
+ * compress on their own.
+ *
+ * The frames are decompressed in the order they were compressed, the
+ * streams are restarted with each new socket.
+ */
+namespace ceph::compression::onwire {
+
+struct DecompressError : public std::runtime_error {
+  DecompressError(const char* what)
+    : std::runtime_error(std::string("decompression error: ") + what) {}
+};
+
+struct TxHandler {
+  virtual ~TxHandler() = default;
+
+  // Replace 'bl' with its compressed form, continuing the stream.
+  virtual void compress(ceph::bufferlist& bl) = 0;
+};
+
+// The largest frame compressed, in total over its segments. The
+// receiver allocates the decompressed segments before the messenger can
+// throttle what they use, so it refuses larger ones; the larger frames are
+// sent as is.
+static constexpr uint64_t MAX_FRAME_SIZE = 4 << 20;
+
+struct RxHandler {
+  virtual ~RxHandler() = default;
+
+  // Replace 'bl' with its decompressed form, into a buffer aligned to
+  // 'align'. Throws DecompressError if 'bl' does not continue the stream,
+  // or if it would decompress to more than 'max_len' bytes.
+  virtual void decompress(ceph::bufferlist& bl, uint16_t align,
+			  uint64_t max_len) = 0;
+};
+
+struct rxtx_t {
+  std::unique_ptr<RxHandler> rx;
+  std::unique_ptr<TxHandler> tx;
+
+  // whether this build can compress at all
+  static bool is_supported();
+  // the msgr2 features to advertise in the banner
+  static uint64_t get_supported_features();
+  // whether the frames sent to a peer which advertised 'peer_features' in
+  // its banner may be compressed
+  static bool is_negotiated(uint64_t peer_features);
+  // nullptr if !is_supported()
+  static std::unique_ptr<TxHandler> create_tx_handler(CephContext* cct);
+  static std::unique_ptr<RxHandler> create_rx_handler(CephContext* cct);
+};
+
+// Decides which frames are worth compressing: the small ones are not (nor
+// the ones over MAX_FRAME_SIZE), and
+// as long as the frames of a connection do not compress well (e.g. they
+// carry already compressed or encrypted data), the next ones are sent as
+// is. Compression is tried again after a while.
+class TxGate {
+public:
+  // weight of a frame in the average ratio
+  static constexpr double RATIO_ALPHA = 0.125;
+  // frames sent as is after the ratio went over the limit
+  static constexpr unsigned BACKOFF_FRAMES = 256;
+
+  TxGate(uint64_t min_size, double max_ratio)
+    : min_size(min_size), max_ratio(max_ratio) {}
+
+  bool want(uint64_t len) {
+    if (len < min_size || len > MAX_FRAME_SIZE) {
+      return false;
+    }
+    if (backoff > 0) {
+      --backoff;
+      return false;
+    }
+    return true;
+  }
+
+  void account(uint64_t raw_len, uint64_t compressed_len) {
+    const double ratio = raw_len ? (double)compressed_len / raw_len : 1.0;
+    avg_ratio = RATIO_ALPHA * ratio + (1.0 - RATIO_ALPHA) * avg_ratio;
+    if (avg_ratio > max_ratio) {
+      backoff = BACKOFF_FRAMES;
+      avg_ratio = 0;
+    }
+  }
+
+  double get_avg_ratio() const { return avg_ratio; }
+
+private:
+  const uint64_t min_size;
+  const double max_ratio;
+  double avg_ratio = 0;
+  unsigned backoff = 0;
+};
+
+} // namespace ceph::compression::onwire
+
+#endif // CEPH_COMPRESSION_ONWIRE_H
@@ -18,6 +18,8 @@ static constexpr const std::size_t AESGCM_KEY_LEN{16};
 static constexpr const std::size_t AESGCM_IV_LEN{12};
 static constexpr const std::size_t AESGCM_TAG_LEN{16};
 static constexpr const std::size_t AESGCM_BLOCK_LEN{16};
+// plaintext buffers smaller than this are gathered before being encrypted
+static constexpr const std::size_t AESGCM_GATHER_LEN{4096};
 
 struct nonce_t {
   ceph_le32 fixed;
@@ -75,7 +77,12 @@ public:
   void reset_tx_handler(const uint32_t* first, const uint32_t* last) override;
 
   void authenticated_encrypt_update(const ceph::bufferlist& plaintext) override;
+  void authenticated_encrypt_update(const char* plaintext,
+                                    uint32_t len) override;
   ceph::bufferlist authenticated_encrypt_final() override;
+
+private:
+  void encrypt(char* out, const char* in, uint32_t len);
 };
 
 void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
@@ -105,6 +112,21 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
   }
 }
 
+void AES128GCM_OnWireTxHandler::encrypt(char* out, const char* in,
+                                        uint32_t len)
+{
+  int update_len = 0;
+  if(1 != EVP_EncryptUpdate(ectx.get(),
+      reinterpret_cast<unsigned char*>(out),
+      &update_len,
+      reinterpret_cast<const unsigned char*>(in),
+      len)) {
+    throw std::runtime_error("EVP_EncryptUpdate failed");
+  }
+  ceph_assert_always(update_len >= 0);
+  ceph_assert(static_cast<unsigned>(update_len) == len);
+}
+
 void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
   const ceph::bufferlist& plaintext)
 {
@@ -112,20 +134,35 @@ void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
               plaintext.length());
   auto filler = buffer.append_hole(plaintext.length());
 
+  // The AES-GCM implementations (e.g. the AVX-512/VAES one OpenSSL picks
+  // where available) are only efficient on large inputs, and each call
+  // ending in the middle of a block costs some more.  A message is often
+  // made of many small buffers though: runs of those are copied to the
+  // ciphertext buffer and encrypted there, in place, with a single call.
+  // Large buffers are encrypted from where they are.
+  char* const start = filler.c_str();
+  char* run = start;
+  uint32_t run_len = 0;
   for (const auto& plainbuf : plaintext.buffers()) {
-    int update_len = 0;
-
-    if(1 != EVP_EncryptUpdate(ectx.get(),
-	reinterpret_cast<unsigned char*>(filler.c_str()),
-	&update_len,
-	reinterpret_cast<const unsigned char*>(plainbuf.c_str()),
-	plainbuf.length())) {
-      throw std::runtime_error("EVP_EncryptUpdate failed");
+    if (plainbuf.length() < AESGCM_GATHER_LEN) {
+      ::memcpy(run + run_len, plainbuf.c_str(), plainbuf.length());
+      run_len += plainbuf.length();
+      continue;
     }
-    ceph_assert_always(update_len >= 0);
-    ceph_assert(static_cast<unsigned>(update_len) == plainbuf.length());
-    filler.advance(update_len);
+    if (run_len > 0) {
+      encrypt(run, run, run_len);
+      run += run_len;
+      run_len = 0;
+    }
+    encrypt(run, plainbuf.c_str(), plainbuf.length());
+    run += plainbuf.length();
+  }
+  if (run_len > 0) {
+    encrypt(run, run, run_len);
+    run += run_len;
   }
+  ceph_assert(static_cast<unsigned>(run - start) == plaintext.length());
+  filler.advance(plaintext.length());
 
   ldout(cct, 15) << __func__
 		 << " plaintext.length()=" << plaintext.length()
@@ -133,6 +170,20 @@ void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
 		 << dendl;
 }
 
+void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
+  const char* plaintext, uint32_t len)
+{
+  ceph_assert(buffer.get_append_buffer_unused_tail_length() >= len);
+  auto filler = buffer.append_hole(len);
+  encrypt(filler.c_str(), plaintext, len);
+  filler.advance(len);
+
+  ldout(cct, 15) << __func__
+		 << " len=" << len
+		 << " buffer.length()=" << buffer.length()
+		 << dendl;
+}
+
 ceph::bufferlist AES128GCM_OnWireTxHandler::authenticated_encrypt_final()
 {
   int final_len = 0;
@@ -306,4 +357,33 @@ ceph::crypto::onwire::rxtx_t ceph::crypto::onwire::rxtx_t::create_handler_pair(
   }
 }
 
+ceph::crypto::onwire::ktls_params_t::~ktls_params_t()
+{
+  ::TOPNSPC::crypto::zeroize_for_security(key.data(), key.size());
+}
+
+ceph::crypto::onwire::ktls_params_t
+ceph::crypto::onwire::rxtx_t::get_ktls_params(
+  const AuthConnectionMeta& auth_meta,
+  bool crossed)
+{
+  ceph_assert_always(auth_meta.is_mode_secure());
+  ceph_assert_always(auth_meta.connection_secret.length() >= \
+    sizeof(key_t) + 2 * sizeof(nonce_t));
+  const char* secbuf = auth_meta.connection_secret.c_str();
+
+  // the same layout as in create_handler_pair()
+  static_assert(sizeof(ktls_params_t::key) == sizeof(key_t));
+  static_assert(sizeof(ktls_params_t::rx_nonce) == sizeof(nonce_t));
+  ktls_params_t params;
+  ::memcpy(params.key.data(), secbuf, sizeof(key_t));
+  secbuf += sizeof(key_t);
+  auto& rx_nonce = crossed ? params.tx_nonce : params.rx_nonce;
+  auto& tx_nonce = crossed ? params.rx_nonce : params.tx_nonce;
+  ::memcpy(rx_nonce.data(), secbuf, sizeof(nonce_t));
+  secbuf += sizeof(nonce_t);
+  ::memcpy(tx_nonce.data(), secbuf, sizeof(nonce_t));
+  return params;
+}
+
 } // namespace ceph::crypto::onwire
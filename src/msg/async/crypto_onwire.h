@@ -16,6 +16,7 @@
 #ifndef CEPH_CRYPTO_ONWIRE_H
 #define CEPH_CRYPTO_ONWIRE_H
 
+#include <array>
 #include <cstdint>
 #include <memory>
 
@@ -83,6 +84,11 @@ struct TxHandler {
   virtual void authenticated_encrypt_update(
     const ceph::bufferlist& plaintext) = 0;
 
+  // Same as above, for plaintext in contiguous memory (e.g. the preamble
+  // or the epilogue of a frame) that doesn't need to be put in a bufferlist.
+  virtual void authenticated_encrypt_update(const char* plaintext,
+                                            uint32_t len) = 0;
+
   // Generates authentication signature and returns bufferlist crafted
   // basing on plaintext from preceding call to _update().
   virtual ceph::bufferlist authenticated_encrypt_final() = 0;
@@ -111,6 +117,18 @@ public:
   virtual void authenticated_decrypt_update_final(ceph::bufferlist& bl) = 0;
 };
 
+// The AES-128-GCM key and the initial nonces of both directions of a
+// secure mode session, for a socket to encrypt the stream by itself (see
+// ConnectedSocket::enable_ktls()). The nonces are laid out as the kernel
+// TLS salt (4 bytes) followed by its IV (8 bytes).
+struct ktls_params_t {
+  std::array<std::uint8_t, 16> key;
+  std::array<std::uint8_t, 12> rx_nonce;
+  std::array<std::uint8_t, 12> tx_nonce;
+
+  ~ktls_params_t();
+};
+
 struct rxtx_t {
   //rxtx_t(rxtx_t&& r) : rx(std::move(rx)), tx(std::move(tx)) {}
   // Each peer can use different handlers.
@@ -123,6 +141,12 @@ struct rxtx_t {
     const class AuthConnectionMeta& auth_meta,
     bool new_nonce_format,
     bool crossed);
+
+  // The same session as create_handler_pair(), for kernel TLS. Only for
+  // secure mode, with the msgr2.1 nonce format.
+  static ktls_params_t get_ktls_params(
+    const class AuthConnectionMeta& auth_meta,
+    bool crossed);
 };
 
 } // namespace ceph::crypto::onwire
@@ -61,12 +61,13 @@ static bool check_epilogue_late_status(__u8 late_status) {
   return aborted == FRAME_LATE_STATUS_COMPLETE;
 }
 
-void FrameAssembler::fill_preamble(Tag tag,
+void FrameAssembler::fill_preamble(Tag tag, __u8 flags,
                                    preamble_block_t& preamble) const {
   // FIPS zeroization audit 20191115: this memset is not security related.
   ::memset(&preamble, 0, sizeof(preamble));
 
   preamble.tag = static_cast<__u8>(tag);
+  preamble.flags = flags;
   for (size_t i = 0; i < m_descs.size(); i++) {
     preamble.segments[i].length = m_descs[i].logical_len;
     preamble.segments[i].alignment = m_descs[i].align;
@@ -96,13 +97,14 @@ uint64_t FrameAssembler::get_frame_onwire_len() const {
   return onwire_len;
 }
 
-bufferlist FrameAssembler::asm_crc_rev0(const preamble_block_t& preamble,
-                                        bufferlist segment_bls[]) const {
+void FrameAssembler::asm_crc_rev0(const preamble_block_t& preamble,
+                                  bufferlist segment_bls[],
+                                  bufferlist& frame_bl) const {
   epilogue_crc_rev0_block_t epilogue;
   // FIPS zeroization audit 20191115: this memset is not security related.
   ::memset(&epilogue, 0, sizeof(epilogue));
 
-  bufferlist frame_bl(sizeof(preamble) + sizeof(epilogue));
+  frame_bl.reserve(sizeof(preamble) + sizeof(epilogue));
   frame_bl.append(reinterpret_cast<const char*>(&preamble), sizeof(preamble));
   for (size_t i = 0; i < m_descs.size(); i++) {
     ceph_assert(segment_bls[i].length() == m_descs[i].logical_len);
@@ -112,49 +114,45 @@ bufferlist FrameAssembler::asm_crc_rev0(const preamble_block_t& preamble,
     }
   }
   frame_bl.append(reinterpret_cast<const char*>(&epilogue), sizeof(epilogue));
-  return frame_bl;
 }
 
 bufferlist FrameAssembler::asm_secure_rev0(const preamble_block_t& preamble,
                                            bufferlist segment_bls[]) const {
-  bufferlist preamble_bl(sizeof(preamble));
-  preamble_bl.append(reinterpret_cast<const char*>(&preamble),
-                     sizeof(preamble));
-
   epilogue_secure_rev0_block_t epilogue;
   // FIPS zeroization audit 20191115: this memset is not security related.
   ::memset(&epilogue, 0, sizeof(epilogue));
-  bufferlist epilogue_bl(sizeof(epilogue));
-  epilogue_bl.append(reinterpret_cast<const char*>(&epilogue),
-                     sizeof(epilogue));
 
   // preamble + MAX_NUM_SEGMENTS + epilogue
   uint32_t onwire_lens[MAX_NUM_SEGMENTS + 2];
-  onwire_lens[0] = preamble_bl.length();
+  onwire_lens[0] = sizeof(preamble);
   for (size_t i = 0; i < m_descs.size(); i++) {
     onwire_lens[i + 1] = segment_bls[i].length();  // already padded
   }
-  onwire_lens[m_descs.size() + 1] = epilogue_bl.length();
+  onwire_lens[m_descs.size() + 1] = sizeof(epilogue);
+  // the whole frame is encrypted into a single buffer sized here
   m_crypto->tx->reset_tx_handler(onwire_lens,
                                  onwire_lens + m_descs.size() + 2);
-  m_crypto->tx->authenticated_encrypt_update(preamble_bl);
+  m_crypto->tx->authenticated_encrypt_update(
+      reinterpret_cast<const char*>(&preamble), sizeof(preamble));
   for (size_t i = 0; i < m_descs.size(); i++) {
     if (segment_bls[i].length() > 0) {
       m_crypto->tx->authenticated_encrypt_update(segment_bls[i]);
     }
   }
-  m_crypto->tx->authenticated_encrypt_update(epilogue_bl);
+  m_crypto->tx->authenticated_encrypt_update(
+      reinterpret_cast<const char*>(&epilogue), sizeof(epilogue));
   return m_crypto->tx->authenticated_encrypt_final();
 }
 
-bufferlist FrameAssembler::asm_crc_rev1(const preamble_block_t& preamble,
-                                        bufferlist segment_bls[]) const {
+void FrameAssembler::asm_crc_rev1(const preamble_block_t& preamble,
+                                  bufferlist segment_bls[],
+                                  bufferlist& frame_bl) const {
   epilogue_crc_rev1_block_t epilogue;
   // FIPS zeroization audit 20191115: this memset is not security related.
   ::memset(&epilogue, 0, sizeof(epilogue));
   epilogue.late_status |= FRAME_LATE_STATUS_COMPLETE;
 
-  bufferlist frame_bl(sizeof(preamble) + FRAME_CRC_SIZE + sizeof(epilogue));
+  frame_bl.reserve(sizeof(preamble) + FRAME_CRC_SIZE + sizeof(epilogue));
   frame_bl.append(reinterpret_cast<const char*>(&preamble), sizeof(preamble));
 
   ceph_assert(segment_bls[0].length() == m_descs[0].logical_len);
@@ -164,7 +162,7 @@ bufferlist FrameAssembler::asm_crc_rev1(const preamble_block_t& preamble,
     encode(crc, frame_bl);
   }
   if (m_descs.size() == 1) {
-    return frame_bl;  // no epilogue if only one segment
+    return;  // no epilogue if only one segment
   }
 
   for (size_t i = 1; i < m_descs.size(); i++) {
@@ -175,7 +173,6 @@ bufferlist FrameAssembler::asm_crc_rev1(const preamble_block_t& preamble,
     }
   }
   frame_bl.append(reinterpret_cast<const char*>(&epilogue), sizeof(epilogue));
-  return frame_bl;
 }
 
 bufferlist FrameAssembler::asm_secure_rev1(const preamble_block_t& preamble,
@@ -216,23 +213,21 @@ bufferlist FrameAssembler::asm_secure_rev1(const preamble_block_t& preamble,
   // FIPS zeroization audit 20191115: this memset is not security related.
   ::memset(&epilogue, 0, sizeof(epilogue));
   epilogue.late_status |= FRAME_LATE_STATUS_COMPLETE;
-  bufferlist epilogue_bl(sizeof(epilogue));
-  epilogue_bl.append(reinterpret_cast<const char*>(&epilogue),
-                     sizeof(epilogue));
 
   // MAX_NUM_SEGMENTS - 1 + epilogue
   uint32_t onwire_lens[MAX_NUM_SEGMENTS];
   for (size_t i = 1; i < m_descs.size(); i++) {
     onwire_lens[i - 1] = segment_bls[i].length();  // already padded
   }
-  onwire_lens[m_descs.size() - 1] = epilogue_bl.length();
+  onwire_lens[m_descs.size() - 1] = sizeof(epilogue);
   m_crypto->tx->reset_tx_handler(onwire_lens, onwire_lens + m_descs.size());
   for (size_t i = 1; i < m_descs.size(); i++) {
     if (segment_bls[i].length() > 0) {
       m_crypto->tx->authenticated_encrypt_update(segment_bls[i]);
     }
   }
-  m_crypto->tx->authenticated_encrypt_update(epilogue_bl);
+  m_crypto->tx->authenticated_encrypt_update(
+      reinterpret_cast<const char*>(&epilogue), sizeof(epilogue));
   frame_bl.claim_append(m_crypto->tx->authenticated_encrypt_final());
   return frame_bl;
 }
@@ -240,6 +235,15 @@ bufferlist FrameAssembler::asm_secure_rev1(const preamble_block_t& preamble,
 bufferlist FrameAssembler::assemble_frame(Tag tag, bufferlist segment_bls[],
                                           const uint16_t segment_aligns[],
                                           size_t segment_count) {
+  bufferlist frame_bl;
+  assemble_frame(frame_bl, tag, segment_bls, segment_aligns, segment_count);
+  return frame_bl;
+}
+
+void FrameAssembler::assemble_frame(bufferlist& out, Tag tag,
+                                    bufferlist segment_bls[],
+                                    const uint16_t segment_aligns[],
+                                    size_t segment_count, __u8 flags) {
   m_descs.resize(calc_num_segments(segment_bls, segment_count));
   for (size_t i = 0; i < m_descs.size(); i++) {
     m_descs[i].logical_len = segment_bls[i].length();
@@ -247,7 +251,7 @@ bufferlist FrameAssembler::assemble_frame(Tag tag, bufferlist segment_bls[],
   }
 
   preamble_block_t preamble;
-  fill_preamble(tag, preamble);
+  fill_preamble(tag, flags, preamble);
 
   if (m_crypto->rx) {
     for (size_t i = 0; i < m_descs.size(); i++) {
@@ -262,15 +266,19 @@ bufferlist FrameAssembler::assemble_frame(Tag tag, bufferlist segment_bls[],
         segment_bls[i].append_zero(pad_len);
       }
     }
+    // the ciphertext is only appended once the whole frame is encrypted
     if (m_is_rev1) {
-      return asm_secure_rev1(preamble, segment_bls);
+      out.claim_append(asm_secure_rev1(preamble, segment_bls));
+    } else {
+      out.claim_append(asm_secure_rev0(preamble, segment_bls));
     }
-    return asm_secure_rev0(preamble, segment_bls);
+    return;
   }
   if (m_is_rev1) {
-    return asm_crc_rev1(preamble, segment_bls);
+    asm_crc_rev1(preamble, segment_bls, out);
+  } else {
+    asm_crc_rev0(preamble, segment_bls, out);
   }
-  return asm_crc_rev0(preamble, segment_bls);
 }
 
 Tag FrameAssembler::disassemble_preamble(bufferlist& preamble_bl) {
@@ -317,6 +325,7 @@ Tag FrameAssembler::disassemble_preamble(bufferlist& preamble_bl) {
     m_descs[i].logical_len = preamble->segments[i].length;
     m_descs[i].align = preamble->segments[i].alignment;
   }
+  m_flags = preamble->flags;
   return static_cast<Tag>(preamble->tag);
 }
 
@@ -102,7 +102,8 @@ struct preamble_block_t {
   __u8 num_segments;
 
   segment_t segments[MAX_NUM_SEGMENTS];
-  __u8 _reserved[2];
+  __u8 flags;  // FRAME_EARLY_*
+  __u8 _reserved;
 
   // CRC32 for this single preamble block.
   ceph_le32 crc;
@@ -153,6 +154,16 @@ static constexpr uint32_t FRAME_PREAMBLE_WITH_INLINE_SIZE =
 // is not covered by any crc -- a single bit flip can result in
 // a completed frame being dropped or in an aborted frame with
 // garbage segment payloads being dispatched.
+// The on-wire compression of upstream releases, negotiated with the
+// COMPRESSION_REQUEST/COMPRESSION_DONE frames: neither supported nor
+// advertised (CEPH_MSGR2_FEATURE_COMPRESSION), a frame carrying it is
+// refused.
+#define FRAME_EARLY_DATA_COMPRESSED       (1<<0)
+// The segments of the frame went through the connection's compression
+// stream (see compression_onwire.h). Only set for peers which advertised
+// CEPH_MSGR2_FEATURE_STREAM_COMPRESSION.
+#define FRAME_EARLY_DATA_STREAM_COMPRESSED (1<<1)
+
 #define FRAME_LATE_FLAG_ABORTED           (1<<0)
 
 // For msgr2.1, FRAME_LATE_STATUS_ABORTED has the same meaning
@@ -188,6 +199,11 @@ public:
     return m_is_rev1;
   }
 
+  // the flags of the last disassembled preamble
+  __u8 get_preamble_flags() const {
+    return m_flags;
+  }
+
   size_t get_num_segments() const {
     ceph_assert(!m_descs.empty());
     return m_descs.size();
@@ -297,6 +313,15 @@ public:
                             const uint16_t segment_aligns[],
                             size_t segment_count);
 
+  // Same as above, but appends the frame to 'out', which is left as is
+  // if an exception is thrown.  In crc mode, the preamble, crcs and
+  // epilogue go to the append buffer of 'out': when a batch of frames
+  // is assembled into the same bufferlist, they share its allocation
+  // instead of costing one (or two) per frame.
+  void assemble_frame(bufferlist& out, Tag tag, bufferlist segment_bls[],
+                      const uint16_t segment_aligns[],
+                      size_t segment_count, __u8 flags = 0);
+
   Tag disassemble_preamble(bufferlist& preamble_bl);
 
   // Like msgr1, and unlike msgr2.0, msgr2.1 allows interpreting the
@@ -345,12 +370,12 @@ private:
     return m_crypto->rx->get_extra_size_at_final();
   }
 
-  bufferlist asm_crc_rev0(const preamble_block_t& preamble,
-                          bufferlist segment_bls[]) const;
+  void asm_crc_rev0(const preamble_block_t& preamble,
+                    bufferlist segment_bls[], bufferlist& frame_bl) const;
   bufferlist asm_secure_rev0(const preamble_block_t& preamble,
                              bufferlist segment_bls[]) const;
-  bufferlist asm_crc_rev1(const preamble_block_t& preamble,
-                          bufferlist segment_bls[]) const;
+  void asm_crc_rev1(const preamble_block_t& preamble,
+                    bufferlist segment_bls[], bufferlist& frame_bl) const;
   bufferlist asm_secure_rev1(const preamble_block_t& preamble,
                              bufferlist segment_bls[]) const;
 
@@ -367,13 +392,14 @@ private:
   bool disasm_remaining_secure_rev1(bufferlist segment_bls[],
                                     bufferlist& epilogue_bl) const;
 
-  void fill_preamble(Tag tag, preamble_block_t& preamble) const;
+  void fill_preamble(Tag tag, __u8 flags, preamble_block_t& preamble) const;
   friend std::ostream& operator<<(std::ostream& os,
                                   const FrameAssembler& frame_asm);
 
   boost::container::static_vector<segment_desc_t, MAX_NUM_SEGMENTS> m_descs;
   const ceph::crypto::onwire::rxtx_t* m_crypto;
   bool m_is_rev1;  // msgr2.1?
+  __u8 m_flags = 0;
 };
 
 template <class T, uint16_t... SegmentAlignmentVs>
@@ -395,6 +421,16 @@ public:
     ceph_assert(bl.length() == tx_frame_asm.get_frame_onwire_len());
     return bl;
   }
+
+  // append the frame to 'out', e.g. to a batch of frames to send together
+  void append_buffer(FrameAssembler& tx_frame_asm, ceph::bufferlist& out,
+                     __u8 flags = 0) {
+    const auto start_len = out.length();
+    tx_frame_asm.assemble_frame(out, T::tag, segments.data(),
+                                alignments.data(), SegmentsNumV, flags);
+    ceph_assert(out.length() - start_len ==
+                tx_frame_asm.get_frame_onwire_len());
+  }
 };
 
 // ControlFrames are used to manage transceiver state (like connections) and
@@ -833,6 +869,11 @@ struct MessageFrame : public Frame<MessageFrame,
     return segments[SegmentIndex::Msg::DATA].length();
   }
 
+  // all the segments, as they go on the wire
+  auto &get_segments() {
+    return segments;
+  }
+
 protected:
   using Frame::Frame;
 };
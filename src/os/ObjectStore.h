@@ -336,6 +336,15 @@ public:
     return -EOPNOTSUPP;
   }
 
+  /// cumulative io accounting of the main data device, see
+  /// BlockDevice::get_io_stats()
+  virtual bool get_device_io_stats(uint64_t *busy_ns, uint64_t *weighted_ns,
+				   uint64_t *completed, uint64_t *inflight) {
+    return false;
+  }
+  /// start or stop that accounting, off by default
+  virtual void enable_device_io_stats(bool enable) {}
+
 
   virtual bool can_sort_nibblewise() {
     return false;   // assume a backend cannot, unless it says otherwise
@@ -2608,6 +2608,17 @@ public:
     std::set<int> *nodes,
     std::set<std::string> *failed) override;
 
+  bool get_device_io_stats(uint64_t *busy_ns, uint64_t *weighted_ns,
+			   uint64_t *completed, uint64_t *inflight) override {
+    return bdev &&
+      bdev->get_io_stats(busy_ns, weighted_ns, completed, inflight);
+  }
+  void enable_device_io_stats(bool enable) override {
+    if (bdev) {
+      bdev->enable_io_stats(enable);
+    }
+  }
+
   static int get_block_device_fsid(CephContext* cct, const std::string& path,
 				   uuid_d *fsid);
 
@@ -106,10 +106,12 @@ static ostream &operator<<(
 
 ostream &operator<<(ostream &lhs, const ECBackend::read_request_t &rhs)
 {
-  return lhs << "read_request_t(to_read=[" << rhs.to_read << "]"
-	     << ", need=" << rhs.need
-	     << ", want_attrs=" << rhs.want_attrs
-	     << ")";
+  lhs << "read_request_t(to_read=[" << rhs.to_read << "]"
+      << ", need=" << rhs.need
+      << ", want_attrs=" << rhs.want_attrs;
+  if (!rhs.shard_extents.empty())
+    lhs << ", shard_extents=" << rhs.shard_extents;
+  return lhs << ")";
 }
 
 ostream &operator<<(ostream &lhs, const ECBackend::read_result_t &rhs)
@@ -174,6 +176,7 @@ ostream &operator<<(ostream &lhs, const ECBackend::Op &rhs)
       << " pending_commit=" << rhs.pending_commit
       << " plan.to_read=" << rhs.plan.to_read
       << " plan.will_write=" << rhs.plan.will_write
+      << " delta_stripes=" << rhs.delta_stripes
       << ")";
   return lhs;
 }
@@ -1204,12 +1207,28 @@ void ECBackend::handle_sub_read_reply(
       dout(20) << __func__ << " to_read skipping" << dendl;
       continue;
     }
+    const read_request_t &req = rop.to_read.find(i->first)->second;
     list<boost::tuple<uint64_t, uint64_t, uint32_t> >::const_iterator req_iter =
-      rop.to_read.find(i->first)->second.to_read.begin();
+      req.to_read.begin();
     list<
       boost::tuple<
 	uint64_t, uint64_t, map<pg_shard_t, bufferlist> > >::iterator riter =
       rop.complete[i->first].returned.begin();
+    if (!req.shard_extents.empty()) {
+      // only the extents with a non empty range were read from this shard
+      const auto &extents = req.shard_extents.at(from);
+      auto j = i->second.begin();
+      for (auto e = extents.begin(); e != extents.end(); ++e, ++riter) {
+	ceph_assert(riter != rop.complete[i->first].returned.end());
+	if (e->second == 0)
+	  continue;
+	ceph_assert(j != i->second.end());
+	ceph_assert(e->first == j->first);
+	riter->get<2>()[from] = std::move(j->second);
+	++j;
+      }
+      continue;
+    }
     for (list<pair<uint64_t, bufferlist> >::iterator j = i->second.begin();
 	 j != i->second.end();
 	 ++j, ++req_iter, ++riter) {
@@ -1262,12 +1281,23 @@ void ECBackend::handle_sub_read_reply(
       iter != rop.complete.end();
       ++iter) {
       set<int> have;
-      for (map<pg_shard_t, bufferlist>::const_iterator j =
-          iter->second.returned.front().get<2>().begin();
-        j != iter->second.returned.front().get<2>().end();
-        ++j) {
-        have.insert(j->first.shard);
-        dout(20) << __func__ << " have shard=" << j->first.shard << dendl;
+      const read_request_t &req = rop.to_read.at(iter->first);
+      if (!req.shard_extents.empty()) {
+	// a shard need not have read the first extent
+	for (auto &&j : req.shard_extents) {
+	  if (!iter->second.errors.count(j.first)) {
+	    have.insert(j.first.shard);
+	    dout(20) << __func__ << " have shard=" << j.first.shard << dendl;
+	  }
+	}
+      } else {
+	for (map<pg_shard_t, bufferlist>::const_iterator j =
+	       iter->second.returned.front().get<2>().begin();
+	     j != iter->second.returned.front().get<2>().end();
+	     ++j) {
+	  have.insert(j->first.shard);
+	  dout(20) << __func__ << " have shard=" << j->first.shard << dendl;
+	}
       }
       map<int, vector<pair<int, int>>> dummy_minimum;
       int err;
@@ -1277,7 +1307,9 @@ void ECBackend::handle_sub_read_reply(
 	  // If we don't have enough copies, try other pg_shard_ts if available.
 	  // During recovery there may be multiple osds with copies of the same shard,
 	  // so getting EIO from one may result in multiple passes through this code path.
-	  if (!rop.do_redundant_reads) {
+	  // A partial read is instead retried as a whole stripe read by its
+	  // callback, see CallClientContexts.
+	  if (!rop.do_redundant_reads && req.shard_extents.empty()) {
 	    int r = send_all_remaining_reads(iter->first, rop);
 	    if (r == 0) {
 	      // We changed the rop's to_read and not incrementing is_complete
@@ -1462,6 +1494,7 @@ void ECBackend::on_change()
   waiting_reads.clear();
   waiting_state.clear();
   waiting_commit.clear();
+  delta_inflight.clear();
   for (auto &&op: tid_to_op_map) {
     cache.release_write_pin(op.second.pin);
   }
@@ -1765,6 +1798,23 @@ void ECBackend::do_read_op(ReadOp &op)
       op.obj_to_source[i->first].insert(j->first);
       op.source_to_obj[j->first].insert(i->first);
     }
+    if (!i->second.shard_extents.empty()) {
+      ceph_assert(!need_attrs);
+      for (auto &&k : i->second.need) {
+	const auto &extents = i->second.shard_extents.at(k.first);
+	ceph_assert(extents.size() == i->second.to_read.size());
+	auto e = extents.begin();
+	for (auto j = i->second.to_read.begin();
+	     j != i->second.to_read.end();
+	     ++j, ++e) {
+	  if (e->second == 0)
+	    continue;
+	  messages[k.first].to_read[i->first].push_back(
+	    boost::make_tuple(e->first, e->second, j->get<2>()));
+	}
+      }
+      continue;
+    }
     for (list<boost::tuple<uint64_t, uint64_t, uint32_t> >::const_iterator j =
 	   i->second.to_read.begin();
 	 j != i->second.to_read.end();
@@ -1914,6 +1964,24 @@ bool ECBackend::try_state_to_reads()
     return false;
   }
 
+  for (auto &&hpair: op->plan.will_write) {
+    auto iter = delta_inflight.find(hpair.first);
+    if (iter == delta_inflight.end()) {
+      continue;
+    }
+    extent_set overlap;
+    overlap.intersection_of(
+      iter->second,
+      ECTransaction::get_stripe_bounds(sinfo, hpair.second));
+    if (!overlap.empty()) {
+      dout(20) << __func__ << ": blocking " << *op
+	       << " because it overlaps the parity delta write of "
+	       << hpair.first << " " << overlap
+	       << dendl;
+      return false;
+    }
+  }
+
   if (!pipeline_state.caching_enabled()) {
     op->using_cache = false;
   } else if (op->invalidates_cache()) {
@@ -1922,6 +1990,12 @@ bool ECBackend::try_state_to_reads()
     pipeline_state.invalidate();
   }
 
+  if (op->using_cache &&
+      op->requires_rmw() &&
+      cct->_conf.get_val<bool>("osd_ec_parity_delta_writes")) {
+    plan_parity_deltas(op);
+  }
+
   waiting_state.pop_front();
   waiting_reads.push_back(*op);
 
@@ -1969,10 +2043,185 @@ bool ECBackend::try_state_to_reads()
 	check_ops();
       });
   }
+  if (!op->plan.delta_plans.empty()) {
+    start_parity_delta_reads(op);
+  }
 
   return true;
 }
 
+bool ECBackend::stripes_in_flight(
+  const hobject_t &hoid,
+  const extent_set &stripes) const
+{
+  for (auto &&ops: {&waiting_reads, &waiting_commit}) {
+    for (auto &&op: *ops) {
+      auto iter = op.plan.will_write.find(hoid);
+      if (iter == op.plan.will_write.end()) {
+	continue;
+      }
+      extent_set overlap;
+      overlap.intersection_of(
+	stripes,
+	ECTransaction::get_stripe_bounds(sinfo, iter->second));
+      if (!overlap.empty()) {
+	return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ECBackend::plan_parity_deltas(Op *op)
+{
+  vector<hobject_t> candidates;
+  for (auto &&hpair: op->plan.to_read) {
+    candidates.push_back(hpair.first);
+  }
+  for (auto &&hoid: candidates) {
+    set<int> have;
+    map<shard_id_t, pg_shard_t> shards;
+    get_all_avail_shards(hoid, set<pg_shard_t>(), have, shards, false);
+    if (have.size() != ec_impl->get_chunk_count()) {
+      dout(20) << __func__ << ": " << hoid << " is degraded, have "
+	       << have << dendl;
+      continue;
+    }
+    // the cache would supply the pending stripes of earlier writes,
+    // but not the chunks
+    if (stripes_in_flight(hoid, op->plan.to_read.at(hoid))) {
+      dout(20) << __func__ << ": " << hoid << " has writes in flight"
+	       << dendl;
+      continue;
+    }
+    if (ECTransaction::plan_parity_delta(
+	  op->plan,
+	  hoid,
+	  sinfo,
+	  ec_impl,
+	  get_parent()->get_dpp())) {
+      const extent_set &stripes = op->plan.delta_plans.at(hoid).stripes;
+      op->delta_stripes[hoid] = stripes;
+      delta_inflight[hoid].union_of(stripes);
+    }
+  }
+}
+
+void ECBackend::start_parity_delta_reads(Op *op)
+{
+  map<hobject_t, set<int>> want_to_read;
+  map<hobject_t, read_request_t> for_read_op;
+  vector<pair<int, int>> subchunks;
+  subchunks.push_back(make_pair(0, ec_impl->get_sub_chunk_count()));
+  for (auto &&dpair: op->plan.delta_plans) {
+    const hobject_t &hoid = dpair.first;
+    const auto &dplan = dpair.second;
+    set<int> have;
+    map<shard_id_t, pg_shard_t> shards;
+    get_all_avail_shards(hoid, set<pg_shard_t>(), have, shards, false);
+    map<pg_shard_t, vector<pair<int, int>>> need;
+    for (int shard: dplan.to_read) {
+      auto iter = shards.find(shard_id_t(shard));
+      ceph_assert(iter != shards.end());
+      need.insert(make_pair(iter->second, subchunks));
+    }
+    list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
+    for (auto &&extent: dplan.stripes) {
+      to_read.push_back(boost::make_tuple(extent.first, extent.second, 0));
+    }
+    ++op->delta_reads_in_progress;
+    for_read_op.insert(
+      make_pair(
+	hoid,
+	read_request_t(
+	  to_read,
+	  need,
+	  false,
+	  make_gen_lambda_context<
+	    pair<RecoveryMessages*, read_result_t&> &>(
+	      [this, op, hoid](pair<RecoveryMessages*, read_result_t&> &in) {
+		handle_parity_delta_read(op, hoid, in.second);
+	      }).release())));
+    want_to_read.insert(make_pair(hoid, dplan.to_read));
+  }
+  start_read_op(
+    CEPH_MSG_PRIO_DEFAULT,
+    want_to_read,
+    for_read_op,
+    OpRequestRef(),
+    false, false);
+}
+
+void ECBackend::handle_parity_delta_read(
+  Op *op,
+  const hobject_t &hoid,
+  read_result_t &res)
+{
+  ceph_assert(op->delta_reads_in_progress > 0);
+  auto dpiter = op->plan.delta_plans.find(hoid);
+  ceph_assert(dpiter != op->plan.delta_plans.end());
+  const auto &dplan = dpiter->second;
+
+  bool complete = res.r == 0 && res.errors.empty();
+  map<int, extent_map> chunks;
+  for (auto &&extent: res.returned) {
+    if (!complete) {
+      break;
+    }
+    const uint64_t chunk_off =
+      sinfo.aligned_logical_offset_to_chunk_offset(extent.get<0>());
+    const uint64_t chunk_len =
+      sinfo.aligned_logical_offset_to_chunk_offset(extent.get<1>());
+    map<int, bufferlist> by_shard;
+    for (auto &&j: extent.get<2>()) {
+      by_shard[j.first.shard] = j.second;
+    }
+    for (int shard: dplan.to_read) {
+      auto iter = by_shard.find(shard);
+      if (iter == by_shard.end() || iter->second.length() != chunk_len) {
+	complete = false;
+	break;
+      }
+      chunks[shard].insert(chunk_off, chunk_len, iter->second);
+    }
+  }
+
+  if (complete) {
+    dout(20) << __func__ << ": " << hoid << " read shards "
+	     << dplan.to_read << dendl;
+    op->delta_read_result[hoid] = std::move(chunks);
+    --op->delta_reads_in_progress;
+    check_ops();
+    return;
+  }
+
+  dout(10) << __func__ << ": " << hoid << " failed to read shards "
+	   << dplan.to_read << " r=" << res.r << " errors=" << res.errors
+	   << ", reading the full stripes" << dendl;
+  ECTransaction::revert_parity_delta(op->plan, hoid);
+  const extent_set &stripes = op->plan.to_read.at(hoid);
+  if (op->using_cache) {
+    // the written extents are already pinned, extend to the stripes
+    cache.reserve_extents_for_rmw(
+      hoid,
+      op->pin,
+      op->plan.will_write.at(hoid),
+      extent_set());
+  }
+  op->remote_read[hoid] = stripes;
+  map<hobject_t, extent_set> to_read;
+  to_read[hoid] = stripes;
+  objects_read_async_no_cache(
+    to_read,
+    [this, op](map<hobject_t,pair<int, extent_map> > &&results) {
+      for (auto &&i: results) {
+	op->remote_read_result.emplace(i.first, i.second.second);
+      }
+      --op->delta_reads_in_progress;
+      check_ops();
+    });
+}
+
 bool ECBackend::try_reads_to_commit()
 {
   if (waiting_reads.empty())
@@ -2021,6 +2270,7 @@ bool ECBackend::try_reads_to_commit()
       get_parent()->get_info().pgid.pgid,
       sinfo,
       op->remote_read_result,
+      op->delta_read_result,
       op->log_entries,
       &written,
       &trans,
@@ -2059,6 +2309,7 @@ bool ECBackend::try_reads_to_commit()
   }
   op->remote_read.clear();
   op->remote_read_result.clear();
+  op->delta_read_result.clear();
 
   ObjectStore::Transaction empty;
   bool should_write_local = false;
@@ -2176,6 +2427,15 @@ bool ECBackend::try_finish_rmw()
     }
   }
 
+  for (auto &&hpair: op->delta_stripes) {
+    auto iter = delta_inflight.find(hpair.first);
+    ceph_assert(iter != delta_inflight.end());
+    iter->second.subtract(hpair.second);
+    if (iter->second.empty()) {
+      delta_inflight.erase(iter);
+    }
+  }
+
   if (op->using_cache) {
     cache.release_write_pin(op->pin);
   }
@@ -2218,6 +2478,7 @@ void ECBackend::objects_read_async(
   map<hobject_t,std::list<boost::tuple<uint64_t, uint64_t, uint32_t> > >
     reads;
 
+  // objects_read_and_reconstruct() rounds the extents to stripes if needed
   uint32_t flags = 0;
   extent_set es;
   for (list<pair<boost::tuple<uint64_t, uint64_t, uint32_t>,
@@ -2226,9 +2487,9 @@ void ECBackend::objects_read_async(
        i != to_read.end();
        ++i) {
     pair<uint64_t, uint64_t> tmp =
-      sinfo.offset_len_to_stripe_bounds(
-	make_pair(i->first.get<0>(), i->first.get<1>()));
-
+      make_pair(i->first.get<0>(), i->first.get<1>());
+    if (tmp.second == 0)
+      tmp = sinfo.offset_len_to_stripe_bounds(tmp);
     es.union_insert(tmp.first, tmp.second);
     flags |= i->first.get<2>();
   }
@@ -2333,15 +2594,62 @@ struct CallClientContexts :
   ECBackend *ec;
   ECBackend::ClientAsyncReadStatus *status;
   list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
+  // partial read: the data chunk index of each shard read
+  map<pg_shard_t, int> chunks;
   CallClientContexts(
     hobject_t hoid,
     ECBackend *ec,
     ECBackend::ClientAsyncReadStatus *status,
     const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &to_read)
     : hoid(hoid), ec(ec), status(status), to_read(to_read) {}
+  bool reassemble(ECBackend::read_result_t &res, extent_map *result) {
+    if (res.r != 0)
+      return false;
+    ceph_assert(res.returned.size() == to_read.size());
+    for (auto &&read: to_read) {
+      map<int, bufferlist> data;
+      for (auto &&j : res.returned.front().get<2>()) {
+	ec->get_parent()->get_logger()->inc(
+	  l_osd_ec_read_bytes, j.second.length());
+	data[chunks.at(j.first)] = std::move(j.second);
+      }
+      bufferlist bl;
+      int r = ECUtil::reassemble(
+	ec->sinfo,
+	make_pair(read.get<0>(), read.get<1>()),
+	data,
+	&bl);
+      if (r < 0)
+	return false;
+      result->insert(read.get<0>(), bl.length(), std::move(bl));
+      res.returned.pop_front();
+    }
+    return true;
+  }
   void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
     ECBackend::read_result_t &res = in.second;
     extent_map result;
+    if (!chunks.empty()) {
+      if (reassemble(res, &result))
+	goto out;
+      // some data shard could not be read, fall back to decoding
+      ldpp_dout(ec->get_parent()->get_dpp(), 10)
+	<< "CallClientContexts: partial read of " << hoid
+	<< " failed r=" << res.r << " errors=" << res.errors
+	<< ", reading whole stripes" << dendl;
+      ec->get_parent()->get_logger()->inc(l_osd_ec_read_partial_retry);
+      map<hobject_t, set<int>> want_to_read;
+      map<hobject_t, ECBackend::read_request_t> for_read_op;
+      ec->prepare_client_read(
+	hoid, to_read, status, false, false, &want_to_read, &for_read_op);
+      ec->start_read_op(
+	CEPH_MSG_PRIO_DEFAULT,
+	want_to_read,
+	for_read_op,
+	OpRequestRef(),
+	false, false);
+      return;
+    }
     if (res.r != 0)
       goto out;
     ceph_assert(res.returned.size() == to_read.size());
@@ -2358,6 +2666,8 @@ struct CallClientContexts :
 	     res.returned.front().get<2>().begin();
 	   j != res.returned.front().get<2>().end();
 	   ++j) {
+	ec->get_parent()->get_logger()->inc(
+	  l_osd_ec_read_bytes, j->second.length());
 	to_decode[j->first.shard] = std::move(j->second);
       }
       int r = ECUtil::decode(
@@ -2385,6 +2695,114 @@ out:
   }
 };
 
+void ECBackend::prepare_client_read(
+  const hobject_t &hoid,
+  const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &extents,
+  ClientAsyncReadStatus *status,
+  bool fast_read,
+  bool allow_partial,
+  map<hobject_t, set<int>> *want_to_read,
+  map<hobject_t, read_request_t> *for_read_op)
+{
+  if (allow_partial && !fast_read &&
+      cct->_conf.get_val<bool>("osd_ec_partial_reads")) {
+    set<int> have;
+    map<shard_id_t, pg_shard_t> shards;
+    get_all_avail_shards(hoid, set<pg_shard_t>(), have, shards, false);
+
+    // read from each data shard only the bytes backing the extents
+    const vector<int> &chunk_mapping = ec_impl->get_chunk_mapping();
+    set<int> want;
+    map<pg_shard_t, vector<pair<uint64_t, uint64_t>>> shard_extents;
+    map<pg_shard_t, int> chunks;
+    bool degraded = false;
+    for (int i = 0; i < (int)ec_impl->get_data_chunk_count(); ++i) {
+      vector<pair<uint64_t, uint64_t>> ranges;
+      uint64_t len = 0;
+      for (auto &&e : extents) {
+	ranges.push_back(sinfo.offset_len_to_chunk_range(
+			   i, make_pair(e.get<0>(), e.get<1>())));
+	len += ranges.back().second;
+      }
+      if (len == 0)
+	continue;
+      int shard = (int)chunk_mapping.size() > i ? chunk_mapping[i] : i;
+      if (!have.count(shard)) {
+	degraded = true;
+	break;
+      }
+      const pg_shard_t &pg_shard = shards.at(shard_id_t(shard));
+      want.insert(shard);
+      shard_extents.emplace(pg_shard, std::move(ranges));
+      chunks.emplace(pg_shard, i);
+    }
+    if (!degraded && !want.empty()) {
+      map<pg_shard_t, vector<pair<int, int>>> need;
+      for (auto &&i : shard_extents) {
+	need[i.first].push_back(make_pair(0, ec_impl->get_sub_chunk_count()));
+      }
+      CallClientContexts *c = new CallClientContexts(
+	hoid,
+	this,
+	status,
+	extents);
+      c->chunks = std::move(chunks);
+      auto it = for_read_op->emplace(
+	hoid,
+	read_request_t(
+	  extents,
+	  need,
+	  false,
+	  c)).first;
+      it->second.shard_extents = std::move(shard_extents);
+      want_to_read->emplace(hoid, std::move(want));
+      get_parent()->get_logger()->inc(l_osd_ec_read_partial);
+      return;
+    }
+  }
+
+  // read and decode whole stripes
+  uint32_t flags = 0;
+  extent_set es;
+  for (auto &&e : extents) {
+    pair<uint64_t, uint64_t> tmp =
+      sinfo.offset_len_to_stripe_bounds(make_pair(e.get<0>(), e.get<1>()));
+    if (tmp.second)
+      es.union_insert(tmp.first, tmp.second);
+    flags |= e.get<2>();
+  }
+  list<boost::tuple<uint64_t, uint64_t, uint32_t> > stripes;
+  for (auto j = es.begin(); j != es.end(); ++j) {
+    stripes.push_back(boost::make_tuple(j.get_start(), j.get_len(), flags));
+  }
+
+  set<int> want;
+  get_want_to_read_shards(&want);
+  map<pg_shard_t, vector<pair<int, int>>> shards;
+  int r = get_min_avail_to_read_shards(
+    hoid,
+    want,
+    false,
+    fast_read,
+    &shards);
+  ceph_assert(r == 0);
+
+  CallClientContexts *c = new CallClientContexts(
+    hoid,
+    this,
+    status,
+    stripes);
+  for_read_op->insert(
+    make_pair(
+      hoid,
+      read_request_t(
+	stripes,
+	shards,
+	false,
+	c)));
+  want_to_read->insert(make_pair(hoid, want));
+}
+
 void ECBackend::objects_read_and_reconstruct(
   const map<hobject_t,
     std::list<boost::tuple<uint64_t, uint64_t, uint32_t> >
@@ -2400,34 +2818,20 @@ void ECBackend::objects_read_and_reconstruct(
   }
 
   map<hobject_t, set<int>> obj_want_to_read;
-  set<int> want_to_read;
-  get_want_to_read_shards(&want_to_read);
-    
   map<hobject_t, read_request_t> for_read_op;
   for (auto &&to_read: reads) {
-    map<pg_shard_t, vector<pair<int, int>>> shards;
-    int r = get_min_avail_to_read_shards(
-      to_read.first,
-      want_to_read,
-      false,
-      fast_read,
-      &shards);
-    ceph_assert(r == 0);
-
-    CallClientContexts *c = new CallClientContexts(
+    for (auto &&e : to_read.second) {
+      get_parent()->get_logger()->inc(l_osd_ec_read_bytes_requested,
+				      e.get<1>());
+    }
+    prepare_client_read(
       to_read.first,
-      this,
+      to_read.second,
       &(in_progress_client_reads.back()),
-      to_read.second);
-    for_read_op.insert(
-      make_pair(
-	to_read.first,
-	read_request_t(
-	  to_read.second,
-	  shards,
-	  false,
-	  c)));
-    obj_want_to_read.insert(make_pair(to_read.first, want_to_read));
+      fast_read,
+      true,
+      &obj_want_to_read,
+      &for_read_op);
   }
 
   start_read_op(
@@ -135,6 +135,12 @@ public:
    * still only perform a client read from shards in the acting std::set.  This
    * ensures that we won't ever have to restart a client initiated read in
    * check_recovery_sources.
+   *
+   * Unless fast_read is set, a read whose data chunks are all available
+   * (osd_ec_partial_reads) fetches only the bytes of each data shard backing
+   * the requested extents and reassembles them without decoding.  Otherwise,
+   * or if such a read fails, the extents are rounded to whole stripes which
+   * are read from the minimum std::set of shards and decoded.
    */
   void objects_read_and_reconstruct(
     const std::map<hobject_t, std::list<boost::tuple<uint64_t, uint64_t, uint32_t> >
@@ -351,6 +357,10 @@ public:
     std::map<pg_shard_t, std::vector<std::pair<int, int>>> need;
     bool want_attrs;
     GenContext<std::pair<RecoveryMessages *, read_result_t& > &> *cb;
+    /// if not empty, to_read need not be stripe aligned: each shard in need
+    /// reads these chunk (offset, length) instead, one per to_read extent
+    /// (a 0 length is skipped)
+    std::map<pg_shard_t, std::vector<std::pair<uint64_t, uint64_t>>> shard_extents;
     read_request_t(
       const std::list<boost::tuple<uint64_t, uint64_t, uint32_t> > &to_read,
       const std::map<pg_shard_t, std::vector<std::pair<int, int>>> &need,
@@ -428,6 +438,14 @@ public:
     bool do_redundant_reads, bool for_recovery);
 
   void do_read_op(ReadOp &rop);
+  void prepare_client_read(
+    const hobject_t &hoid,
+    const std::list<boost::tuple<uint64_t, uint64_t, uint32_t> > &extents,
+    ClientAsyncReadStatus *status,
+    bool fast_read,
+    bool allow_partial,
+    std::map<hobject_t, std::set<int>> *want_to_read,
+    std::map<hobject_t, read_request_t> *for_read_op);
   int send_all_remaining_reads(
     const hobject_t &hoid,
     ReadOp &rop);
@@ -471,7 +489,9 @@ public:
     std::set<hobject_t> temp_cleared;
 
     ECTransaction::WritePlan plan;
-    bool requires_rmw() const { return !plan.to_read.empty(); }
+    bool requires_rmw() const {
+      return !plan.to_read.empty() || !plan.delta_plans.empty();
+    }
     bool invalidates_cache() const { return plan.invalidates_cache; }
 
     // must be true if requires_rmw(), must be false if invalidates_cache()
@@ -481,8 +501,13 @@ public:
     std::map<hobject_t,extent_set> pending_read; // subset already being read
     std::map<hobject_t,extent_set> remote_read;  // subset we must read
     std::map<hobject_t,extent_map> remote_read_result;
+    /// parity delta state, see plan_parity_deltas
+    std::map<hobject_t,extent_set> delta_stripes;
+    std::map<hobject_t,std::map<int,extent_map>> delta_read_result;
+    unsigned delta_reads_in_progress = 0;
     bool read_in_progress() const {
-      return !remote_read.empty() && remote_read_result.empty();
+      return (!remote_read.empty() && remote_read_result.empty()) ||
+	delta_reads_in_progress > 0;
     }
 
     /// In progress write state.
@@ -560,6 +585,31 @@ public:
   op_list waiting_commit;       /// writes waiting on initial commit
   eversion_t completed_to;
   eversion_t committed_to;
+
+  /**
+   * Parity delta writes
+   *
+   * With osd_ec_parity_delta_writes, a partial stripe overwrite which
+   * modifies few data chunks reads only the old content of these chunks
+   * and of the coding chunks, and updates the coding chunks with the
+   * delta of the data chunks (see ECTransaction::plan_parity_delta).
+   * The modified logical extents are pinned in the cache as usual, but
+   * the rest of the stripes is never known to the primary: writes
+   * touching these stripes wait in waiting_state until the delta write
+   * completes, see delta_inflight.  If the chunks cannot be read, the
+   * op falls back to a full stripe read.
+   */
+  std::map<hobject_t,extent_set> delta_inflight;
+  bool stripes_in_flight(
+    const hobject_t &hoid,
+    const extent_set &stripes) const;
+  void plan_parity_deltas(Op *op);
+  void start_parity_delta_reads(Op *op);
+  void handle_parity_delta_read(
+    Op *op,
+    const hobject_t &hoid,
+    read_result_t &res);
+
   void start_rmw(Op *op, PGTransactionUPtr &&t);
   bool try_state_to_reads();
   bool try_reads_to_commit();
@@ -12,6 +12,7 @@
  *
  */
 
+#include <cstring>
 #include <iostream>
 #include <vector>
 #include <sstream>
@@ -29,6 +30,7 @@ using std::string;
 using std::vector;
 
 using ceph::bufferlist;
+using ceph::bufferptr;
 using ceph::decode;
 using ceph::encode;
 using ceph::ErasureCodeInterfaceRef;
@@ -92,6 +94,110 @@ void encode_and_write(
   }
 }
 
+static bufferlist get_old_chunk(
+  const map<int, extent_map> &old_chunks,
+  int shard,
+  uint64_t chunk_off,
+  uint64_t chunk_size) {
+  auto iter = old_chunks.find(shard);
+  ceph_assert(iter != old_chunks.end());
+  auto chunk = iter->second.intersect(chunk_off, chunk_size);
+  ceph_assert(!chunk.empty());
+  ceph_assert(chunk.begin().get_off() == chunk_off);
+  ceph_assert(chunk.begin().get_len() == chunk_size);
+  return chunk.begin().get_val();
+}
+
+void delta_and_write(
+  pg_t pgid,
+  const hobject_t &oid,
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  const ECTransaction::WritePlan::DeltaPlan &dplan,
+  const map<int, extent_map> &old_chunks,
+  const extent_map &to_overwrite,
+  uint32_t flags,
+  extent_map &written,
+  map<shard_id_t, ObjectStore::Transaction> *transactions,
+  DoutPrefixProvider *dpp) {
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const int k = ecimpl->get_data_chunk_count();
+  const int n = ecimpl->get_chunk_count();
+
+  for (auto &&stripes: dplan.stripes) {
+    for (uint64_t off = stripes.first;
+	 off < stripes.first + stripes.second;
+	 off += stripe_width) {
+      const uint64_t chunk_off = sinfo.aligned_logical_offset_to_chunk_offset(
+	off);
+      map<int, bufferptr> new_chunks;
+      map<int, bufferptr> deltas;
+      for (int shard: dplan.data_shards) {
+	const uint64_t chunk_start = off + shard * chunk_size;
+	auto updates = to_overwrite.intersect(chunk_start, chunk_size);
+	if (updates.empty()) {
+	  continue;
+	}
+	bufferptr old_chunk = ceph::buffer::create_page_aligned(chunk_size);
+	get_old_chunk(old_chunks, shard, chunk_off, chunk_size).begin().copy(
+	  chunk_size, old_chunk.c_str());
+	bufferptr new_chunk = ceph::buffer::create_page_aligned(chunk_size);
+	memcpy(new_chunk.c_str(), old_chunk.c_str(), chunk_size);
+	for (auto &&update: updates) {
+	  update.get_val().begin().copy(
+	    update.get_len(),
+	    new_chunk.c_str() + (update.get_off() - chunk_start));
+	}
+	bufferptr delta = ceph::buffer::create_page_aligned(chunk_size);
+	int r = ecimpl->encode_delta(old_chunk, new_chunk, &delta);
+	ceph_assert(r == 0);
+	deltas[shard] = std::move(delta);
+	new_chunks[shard] = std::move(new_chunk);
+      }
+      if (deltas.empty()) {
+	continue;
+      }
+      for (int shard = k; shard < n; ++shard) {
+	bufferptr parity = ceph::buffer::create_page_aligned(chunk_size);
+	get_old_chunk(old_chunks, shard, chunk_off, chunk_size).begin().copy(
+	  chunk_size, parity.c_str());
+	new_chunks[shard] = std::move(parity);
+      }
+      {
+	map<int, bufferptr> parity(
+	  new_chunks.lower_bound(k), new_chunks.end());
+	int r = ecimpl->apply_delta(deltas, parity);
+	ceph_assert(r == 0);
+      }
+
+      ldpp_dout(dpp, 20) << __func__ << ": " << oid
+			 << " stripe " << off << "~" << stripe_width
+			 << " updating shards " << new_chunks.size()
+			 << dendl;
+      for (auto &&chunk: new_chunks) {
+	auto t = transactions->find(shard_id_t(chunk.first));
+	if (t == transactions->end()) {
+	  continue;
+	}
+	bufferlist bl;
+	bl.append(chunk.second);
+	t->second.write(
+	  coll_t(spg_t(pgid, t->first)),
+	  ghobject_t(oid, ghobject_t::NO_GEN, t->first),
+	  chunk_off,
+	  bl.length(),
+	  bl,
+	  flags);
+      }
+    }
+  }
+
+  for (auto &&extent: to_overwrite) {
+    written.insert(extent.get_off(), extent.get_len(), extent.get_val());
+  }
+}
+
 bool ECTransaction::requires_overwrite(
   uint64_t prev_size,
   const PGTransaction::ObjectOperation &op) {
@@ -105,12 +211,105 @@ bool ECTransaction::requires_overwrite(
       (op.truncate->first < prev_size)));
 }
 
+bool ECTransaction::plan_parity_delta(
+  WritePlan &plan,
+  const hobject_t &oid,
+  const ECUtil::stripe_info_t &sinfo,
+  const ErasureCodeInterfaceRef &ecimpl,
+  DoutPrefixProvider *dpp)
+{
+  if (!ecimpl->supports_parity_delta() ||
+      !ecimpl->get_chunk_mapping().empty()) {
+    return false;
+  }
+  auto riter = plan.to_read.find(oid);
+  auto witer = plan.will_write.find(oid);
+  auto oiter = plan.t->op_map.find(oid);
+  if (riter == plan.to_read.end() ||
+      witer == plan.will_write.end() ||
+      oiter == plan.t->op_map.end()) {
+    return false;
+  }
+  const auto &op = oiter->second;
+  // only overwrites of partial stripes within the object
+  if (!op.is_none() ||
+      op.truncate ||
+      op.buffer_updates.empty() ||
+      !(riter->second == witer->second)) {
+    return false;
+  }
+
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const unsigned k = ecimpl->get_data_chunk_count();
+  const unsigned m = ecimpl->get_chunk_count() - k;
+  extent_set written;
+  set<int> data_shards;
+  for (auto &&extent: op.buffer_updates) {
+    written.insert(extent.get_off(), extent.get_len());
+    uint64_t first = extent.get_off() / chunk_size;
+    uint64_t last = (extent.get_off() + extent.get_len() - 1) / chunk_size;
+    for (uint64_t c = first; c <= last && data_shards.size() < k; ++c) {
+      data_shards.insert(c % k);
+    }
+  }
+  // the modified and the coding chunks are read and written, vs. the
+  // data chunks read and all the chunks written
+  if (2 * (data_shards.size() + m) >= 2 * k + m) {
+    ldpp_dout(dpp, 20) << __func__ << ": " << oid
+		       << " modifies " << data_shards.size()
+		       << " data chunks, full stripe rmw" << dendl;
+    return false;
+  }
+
+  auto &dplan = plan.delta_plans[oid];
+  dplan.stripes = riter->second;
+  dplan.data_shards = std::move(data_shards);
+  dplan.to_read = dplan.data_shards;
+  for (unsigned i = k; i < k + m; ++i) {
+    dplan.to_read.insert(i);
+  }
+  dplan.orig_to_read = std::move(riter->second);
+  dplan.orig_will_write = std::move(witer->second);
+  witer->second = std::move(written);
+  plan.to_read.erase(riter);
+  ldpp_dout(dpp, 20) << __func__ << ": " << oid
+		     << " stripes " << dplan.stripes
+		     << " reading shards " << dplan.to_read
+		     << dendl;
+  return true;
+}
+
+void ECTransaction::revert_parity_delta(
+  WritePlan &plan,
+  const hobject_t &oid)
+{
+  auto iter = plan.delta_plans.find(oid);
+  ceph_assert(iter != plan.delta_plans.end());
+  plan.to_read[oid] = std::move(iter->second.orig_to_read);
+  plan.will_write[oid] = std::move(iter->second.orig_will_write);
+  plan.delta_plans.erase(iter);
+}
+
+extent_set ECTransaction::get_stripe_bounds(
+  const ECUtil::stripe_info_t &sinfo,
+  const extent_set &extents)
+{
+  extent_set ret;
+  for (auto &&extent: extents) {
+    auto bounds = sinfo.offset_len_to_stripe_bounds(
+      make_pair(extent.first, extent.second));
+    ret.union_insert(bounds.first, bounds.second);
+  }
+  return ret;
+}
+
 void ECTransaction::generate_transactions(
   WritePlan &plan,
   ErasureCodeInterfaceRef &ecimpl,
   pg_t pgid,
   const ECUtil::stripe_info_t &sinfo,
   const map<hobject_t,extent_map> &partial_extents,
+  const map<hobject_t,map<int,extent_map>> &delta_reads,
   vector<pg_log_entry_t> &entries,
   map<hobject_t,extent_map> *written_map,
   map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -557,35 +756,65 @@ void ECTransaction::generate_transactions(
       ldpp_dout(dpp, 20) << __func__ << ": to_overwrite: "
 			 << to_overwrite
 			 << dendl;
+      auto save_rollback_extent = [&](uint64_t off, uint64_t len) {
+	ceph_assert(entry);
+	uint64_t restore_from = sinfo.aligned_logical_offset_to_chunk_offset(
+	  off);
+	uint64_t restore_len = sinfo.aligned_logical_offset_to_chunk_offset(
+	  len);
+	ldpp_dout(dpp, 20) << __func__ << ": overwriting "
+			   << restore_from << "~" << restore_len
+			   << dendl;
+	if (rollback_extents.empty()) {
+	  for (auto &&st : *transactions) {
+	    st.second.touch(
+	      coll_t(spg_t(pgid, st.first)),
+	      ghobject_t(oid, entry->version.version, st.first));
+	  }
+	}
+	rollback_extents.emplace_back(make_pair(restore_from, restore_len));
+	for (auto &&st : *transactions) {
+	  st.second.clone_range(
+	    coll_t(spg_t(pgid, st.first)),
+	    ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+	    ghobject_t(oid, entry->version.version, st.first),
+	    restore_from,
+	    restore_len,
+	    restore_from);
+	}
+      };
+      auto dpiter = plan.delta_plans.find(oid);
+      if (dpiter != plan.delta_plans.end()) {
+	// unaligned overwrites within the object, see plan_parity_delta
+	ceph_assert(to_overwrite.get_interval_set() ==
+		    plan.will_write.at(oid));
+	auto driter = delta_reads.find(oid);
+	ceph_assert(driter != delta_reads.end());
+	if (entry) {
+	  for (auto &&stripes: dpiter->second.stripes) {
+	    save_rollback_extent(stripes.first, stripes.second);
+	  }
+	}
+	delta_and_write(
+	  pgid,
+	  oid,
+	  sinfo,
+	  ecimpl,
+	  dpiter->second,
+	  driter->second,
+	  to_overwrite,
+	  fadvise_flags,
+	  written,
+	  transactions,
+	  dpp);
+	to_overwrite.clear();
+      }
       for (auto &&extent: to_overwrite) {
 	ceph_assert(extent.get_off() + extent.get_len() <= append_after);
 	ceph_assert(sinfo.logical_offset_is_stripe_aligned(extent.get_off()));
 	ceph_assert(sinfo.logical_offset_is_stripe_aligned(extent.get_len()));
 	if (entry) {
-	  uint64_t restore_from = sinfo.aligned_logical_offset_to_chunk_offset(
-	    extent.get_off());
-	  uint64_t restore_len = sinfo.aligned_logical_offset_to_chunk_offset(
-	    extent.get_len());
-	  ldpp_dout(dpp, 20) << __func__ << ": overwriting "
-			     << restore_from << "~" << restore_len
-			     << dendl;
-	  if (rollback_extents.empty()) {
-	    for (auto &&st : *transactions) {
-	      st.second.touch(
-		coll_t(spg_t(pgid, st.first)),
-		ghobject_t(oid, entry->version.version, st.first));
-	    }
-	  }
-	  rollback_extents.emplace_back(make_pair(restore_from, restore_len));
-	  for (auto &&st : *transactions) {
-	    st.second.clone_range(
-	      coll_t(spg_t(pgid, st.first)),
-	      ghobject_t(oid, ghobject_t::NO_GEN, st.first),
-	      ghobject_t(oid, entry->version.version, st.first),
-	      restore_from,
-	      restore_len,
-	      restore_from);
-	  }
+	  save_rollback_extent(extent.get_off(), extent.get_len());
 	}
 	encode_and_write(
 	  pgid,
@@ -30,6 +30,20 @@ namespace ECTransaction {
     std::map<hobject_t,extent_set> will_write; // superset of to_read
 
     std::map<hobject_t,ECUtil::HashInfoRef> hash_infos;
+
+    /**
+     * Partial stripe overwrites applied as parity deltas (see
+     * plan_parity_delta): only the modified data chunks and the
+     * coding chunks of the stripes are read and written.
+     */
+    struct DeltaPlan {
+      extent_set stripes;         // logical, stripe aligned
+      std::set<int> data_shards;  // modified in any of the stripes
+      std::set<int> to_read;      // data_shards and the coding shards
+      extent_set orig_to_read;    // full stripe plan, see revert_parity_delta
+      extent_set orig_will_write;
+    };
+    std::map<hobject_t,DeltaPlan> delta_plans;
   };
 
   bool requires_overwrite(
@@ -182,12 +196,42 @@ namespace ECTransaction {
     return plan;
   }
 
+  /**
+   * Switch the partial stripe overwrite of oid planned by get_write_plan
+   * to a parity delta update if the plugin supports it and the op is an
+   * overwrite for which reading and writing only the modified data
+   * chunks and the coding chunks costs less than a full stripe
+   * read-modify-write.  The caller checks that all shards are readable
+   * and that no in flight write touches the stripes.
+   *
+   * On success plan.to_read no longer holds oid, plan.will_write holds
+   * the logical extents written and plan.delta_plans[oid] the chunks
+   * to read, which are passed back to generate_transactions.
+   */
+  bool plan_parity_delta(
+    WritePlan &plan,
+    const hobject_t &oid,
+    const ECUtil::stripe_info_t &sinfo,
+    const ceph::ErasureCodeInterfaceRef &ecimpl,
+    DoutPrefixProvider *dpp);
+
+  /// back to the full stripe read-modify-write planned by get_write_plan
+  void revert_parity_delta(
+    WritePlan &plan,
+    const hobject_t &oid);
+
+  /// the stripes overlapping extents
+  extent_set get_stripe_bounds(
+    const ECUtil::stripe_info_t &sinfo,
+    const extent_set &extents);
+
   void generate_transactions(
     WritePlan &plan,
     ceph::ErasureCodeInterfaceRef &ecimpl,
     pg_t pgid,
     const ECUtil::stripe_info_t &sinfo,
     const std::map<hobject_t,extent_map> &partial_extents,
+    const std::map<hobject_t,std::map<int,extent_map>> &delta_reads,
     std::vector<pg_log_entry_t> &entries,
     std::map<hobject_t,extent_map> *written,
     std::map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -31,6 +31,31 @@ int ECUtil::decode(
   if (total_data_size == 0)
     return 0;
 
+  if (ec_impl->get_sub_chunk_count() == 1) {
+    // decode all the stripes at once, then interleave their data chunks
+    const uint64_t chunk_size = sinfo.get_chunk_size();
+    const unsigned k = ec_impl->get_data_chunk_count();
+    const vector<int> &chunk_mapping = ec_impl->get_chunk_mapping();
+    set<int> want;
+    for (unsigned i = 0; i < k; i++) {
+      want.insert(chunk_mapping.size() > i ? chunk_mapping[i] : i);
+    }
+    map<int, bufferlist> decoded;
+    int r = ec_impl->decode_chunks_batch(
+      want, to_decode, &decoded, total_data_size / chunk_size);
+    ceph_assert(r == 0);
+    for (uint64_t i = 0; i < total_data_size; i += chunk_size) {
+      for (unsigned j = 0; j < k; j++) {
+	int chunk = chunk_mapping.size() > j ? chunk_mapping[j] : j;
+	ceph_assert(decoded[chunk].length() == total_data_size);
+	bufferlist bl;
+	bl.substr_of(decoded[chunk], i, chunk_size);
+	out->claim_append(bl);
+      }
+    }
+    return 0;
+  }
+
   for (uint64_t i = 0; i < total_data_size; i += sinfo.get_chunk_size()) {
     map<int, bufferlist> chunks;
     for (map<int, bufferlist>::iterator j = to_decode.begin();
@@ -96,23 +121,34 @@ int ECUtil::decode(
     }
   }
 
-  for (int i = 0; i < chunks_count; i++) {
-    map<int, bufferlist> chunks;
-    for (auto j = to_decode.begin();
-	 j != to_decode.end();
-	 ++j) {
-      chunks[j->first].substr_of(j->second, 
-                                 i*repair_data_per_chunk, 
-                                 repair_data_per_chunk);
-    }
+  if (ec_impl->get_sub_chunk_count() == 1) {
+    // no sub-chunk repair: decode all the stripes at once
     map<int, bufferlist> out_bls;
-    r = ec_impl->decode(need, chunks, &out_bls, sinfo.get_chunk_size());
+    r = ec_impl->decode_chunks_batch(need, to_decode, &out_bls, chunks_count);
     ceph_assert(r == 0);
     for (auto j = out.begin(); j != out.end(); ++j) {
       ceph_assert(out_bls.count(j->first));
-      ceph_assert(out_bls[j->first].length() == sinfo.get_chunk_size());
       j->second->claim_append(out_bls[j->first]);
     }
+  } else {
+    for (int i = 0; i < chunks_count; i++) {
+      map<int, bufferlist> chunks;
+      for (auto j = to_decode.begin();
+	   j != to_decode.end();
+	   ++j) {
+	chunks[j->first].substr_of(j->second,
+				   i*repair_data_per_chunk,
+				   repair_data_per_chunk);
+      }
+      map<int, bufferlist> out_bls;
+      r = ec_impl->decode(need, chunks, &out_bls, sinfo.get_chunk_size());
+      ceph_assert(r == 0);
+      for (auto j = out.begin(); j != out.end(); ++j) {
+	ceph_assert(out_bls.count(j->first));
+	ceph_assert(out_bls[j->first].length() == sinfo.get_chunk_size());
+	j->second->claim_append(out_bls[j->first]);
+      }
+    }
   }
   for (auto &&i : out) {
     ceph_assert(i.second->length() == chunks_count * sinfo.get_chunk_size());
@@ -120,6 +156,38 @@ int ECUtil::decode(
   return 0;
 }
 
+int ECUtil::reassemble(
+  const stripe_info_t &sinfo,
+  pair<uint64_t, uint64_t> in,
+  const map<int, bufferlist> &chunks,
+  bufferlist *out) {
+  ceph_assert(out);
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const uint64_t end = in.first + in.second;
+  for (uint64_t off = in.first; off < end; ) {
+    unsigned chunk = (off % stripe_width) / chunk_size;
+    uint64_t in_chunk = off % chunk_size;
+    uint64_t len = std::min(chunk_size - in_chunk, end - off);
+    auto i = chunks.find(chunk);
+    if (i == chunks.end())
+      return -EIO;
+    uint64_t chunk_off =
+      (off / stripe_width) * chunk_size + in_chunk -
+      sinfo.offset_len_to_chunk_range(chunk, in).first;
+    if (chunk_off >= i->second.length())
+      break;
+    uint64_t avail = std::min(len, i->second.length() - chunk_off);
+    bufferlist bl;
+    bl.substr_of(i->second, chunk_off, avail);
+    out->claim_append(bl);
+    if (avail < len)
+      break;
+    off += len;
+  }
+  return 0;
+}
+
 int ECUtil::encode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
@@ -136,20 +204,39 @@ int ECUtil::encode(
   if (logical_size == 0)
     return 0;
 
-  for (uint64_t i = 0; i < logical_size; i += sinfo.get_stripe_width()) {
-    map<int, bufferlist> encoded;
-    bufferlist buf;
-    buf.substr_of(in, i, sinfo.get_stripe_width());
-    int r = ec_impl->encode(want, buf, &encoded);
-    ceph_assert(r == 0);
-    for (map<int, bufferlist>::iterator i = encoded.begin();
-	 i != encoded.end();
-	 ++i) {
-      ceph_assert(i->second.length() == sinfo.get_chunk_size());
-      (*out)[i->first].claim_append(i->second);
+  // lay out the data chunks of all the stripes one after the other and
+  // encode them with a single call
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const uint64_t stripe_count = logical_size / stripe_width;
+  const unsigned k = ec_impl->get_data_chunk_count();
+  const unsigned n = ec_impl->get_chunk_count();
+  const vector<int> &chunk_mapping = ec_impl->get_chunk_mapping();
+  ceph_assert(chunk_size * k == stripe_width);
+
+  map<int, bufferlist> encoded;
+  vector<char*> data(k);
+  for (unsigned i = 0; i < n; i++) {
+    bufferptr ptr(buffer::create_page_aligned(stripe_count * chunk_size));
+    if (i < k)
+      data[i] = ptr.c_str();
+    int chunk = chunk_mapping.size() > i ? chunk_mapping[i] : i;
+    encoded[chunk].push_back(std::move(ptr));
+  }
+  auto p = in.cbegin();
+  for (uint64_t s = 0; s < stripe_count; s++) {
+    for (unsigned i = 0; i < k; i++) {
+      p.copy(chunk_size, data[i] + s * chunk_size);
     }
   }
 
+  int r = ec_impl->encode_chunks_batch(want, &encoded, stripe_count);
+  ceph_assert(r == 0);
+  for (auto &&i : encoded) {
+    if (want.count(i.first))
+      (*out)[i.first].claim_append(i.second);
+  }
+
   for (map<int, bufferlist>::iterator i = out->begin();
        i != out->end();
        ++i) {
@@ -77,6 +77,23 @@ public:
       (in.first - off) + in.second);
     return std::make_pair(off, len);
   }
+  /// the chunk offset and length in which data chunk @chunk stores its
+  /// part of the logical extent @in; the length is 0 if it stores none
+  std::pair<uint64_t, uint64_t> offset_len_to_chunk_range(
+    unsigned chunk, std::pair<uint64_t, uint64_t> in) const {
+    auto to_chunk = [&](uint64_t logical) {
+      uint64_t stripe = logical / stripe_width;
+      uint64_t begin = stripe * stripe_width + chunk * chunk_size;
+      if (logical <= begin)
+	return stripe * chunk_size;
+      if (logical >= begin + chunk_size)
+	return (stripe + 1) * chunk_size;
+      return stripe * chunk_size + (logical - begin);
+    };
+    uint64_t off = to_chunk(in.first);
+    uint64_t end = to_chunk(in.first + in.second);
+    return std::make_pair(off, end > off ? end - off : 0);
+  }
 };
 
 int decode(
@@ -91,6 +108,21 @@ int decode(
   std::map<int, ceph::buffer::list> &to_decode,
   std::map<int, ceph::buffer::list*> &out);
 
+/**
+ * reassemble the logical extent @in from the bytes read from the data
+ * chunks without decoding
+ *
+ * @param chunks data chunk index -> the bytes of its chunk range, see
+ *               stripe_info_t::offset_len_to_chunk_range()
+ * @param out    the extent, truncated where the first chunk comes up short
+ * @return -EIO if the range of a data chunk is missing from @chunks
+ */
+int reassemble(
+  const stripe_info_t &sinfo,
+  std::pair<uint64_t, uint64_t> in,
+  const std::map<int, ceph::buffer::list> &chunks,
+  ceph::buffer::list *out);
+
 int encode(
   const stripe_info_t &sinfo,
   ceph::ErasureCodeInterfaceRef &ec_impl,
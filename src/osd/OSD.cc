@@ -730,6 +730,68 @@ void OSDService::promote_throttle_recalibrate()
   promote_max_bytes = target_bytes_sec * osd->OSD_TICK_INTERVAL * 2;
 }
 
+void OSDService::scrub_rate_recalibrate()
+{
+  const bool enabled = cct->_conf.get_val<bool>("osd_scrub_rate_control");
+  if (enabled != scrub_rate_enabled) {
+    // the device only accounts its ios for us
+    store->enable_device_io_stats(enabled);
+    scrub_rate_enabled = enabled;
+  }
+  if (!enabled) {
+    return;
+  }
+
+  Scrub::RateController::targets_t targets;
+  targets.device_util =
+    cct->_conf.get_val<double>("osd_scrub_rate_target_device_util");
+  targets.client_lat =
+    cct->_conf.get_val<double>("osd_scrub_rate_target_client_lat");
+  targets.max_sleep = cct->_conf.get_val<double>("osd_scrub_rate_max_sleep");
+  targets.min_chunk_ratio =
+    cct->_conf.get_val<double>("osd_scrub_rate_min_chunk_ratio");
+
+  Scrub::RateController::device_stats_t dev;
+  bool have_dev = store->get_device_io_stats(
+    &dev.busy_ns, &dev.weighted_ns, &dev.completed, &dev.inflight);
+  scrub_rate_ctl.update(ceph::mono_clock::now(),
+			have_dev ? &dev : nullptr,
+			targets);
+
+  dout(10) << __func__ << " util "
+	   << scrub_rate_ctl.get_observed_device_util()
+	   << " (target " << targets.device_util << ")"
+	   << " qd " << scrub_rate_ctl.get_observed_queue_depth()
+	   << " client lat " << scrub_rate_ctl.get_observed_client_lat()
+	   << " -> chunk ratio " << scrub_rate_ctl.get_chunk_ratio()
+	   << " sleep " << scrub_rate_ctl.get_sleep()
+	   << " (" << scrub_rate_ctl.get_objects_per_sec() << " objects/s)"
+	   << dendl;
+
+  logger->set(l_osd_scrub_rc_target_util, targets.device_util * 100);
+  logger->set(l_osd_scrub_rc_observed_util,
+	      scrub_rate_ctl.get_observed_device_util() * 100);
+  logger->set(l_osd_scrub_rc_queue_depth,
+	      scrub_rate_ctl.get_observed_queue_depth());
+  logger->tset(l_osd_scrub_rc_client_lat,
+	       utime_t{ceph::make_timespan(
+		 scrub_rate_ctl.get_observed_client_lat())});
+  logger->set(l_osd_scrub_rc_chunk_ratio,
+	      scrub_rate_ctl.get_chunk_ratio() * 100);
+  logger->tset(l_osd_scrub_rc_sleep,
+	       utime_t{ceph::make_timespan(scrub_rate_ctl.get_sleep())});
+  logger->set(l_osd_scrub_rc_objects_per_sec,
+	      scrub_rate_ctl.get_objects_per_sec());
+}
+
+double OSDService::get_scrub_chunk_ratio() const
+{
+  if (!cct->_conf.get_val<bool>("osd_scrub_rate_control")) {
+    return 1.0;
+  }
+  return scrub_rate_ctl.get_chunk_ratio();
+}
+
 // -------------------------------------
 
 float OSDService::get_failsafe_full_ratio()
@@ -2341,6 +2403,10 @@ OSD::OSD(CephContext *cct_,
   op_tracker.set_history_slow_op_size_and_threshold(cct->_conf->osd_op_history_slow_op_size,
                                                     cct->_conf->osd_op_history_slow_op_threshold);
   ObjectCleanRegions::set_max_num_intervals(cct->_conf->osd_object_clean_region_max_num_intervals);
+  // both are startup options
+  threads_pinned =
+    !cct->_conf.get_val<std::string>("ms_async_affinity_cores").empty() ||
+    !cct->_conf.get_val<std::string>("osd_op_shard_affinity_cores").empty();
 #ifdef WITH_BLKIN
   std::stringstream ss;
   ss << "osd." << whoami;
@@ -2401,6 +2467,24 @@ int OSD::pre_init()
   return 0;
 }
 
+void OSD::count_op_handoff(const OSDShard& sdata)
+{
+  const int from = get_current_cpu();
+  const int to = sdata.last_cpu.load(std::memory_order_relaxed);
+  if (from < 0 || to < 0) {
+    return;
+  }
+  if (from == to) {
+    logger->inc(l_osd_op_handoff_same_cpu);
+  } else if (cpu_numa_nodes.empty() ||  // taken as a single node
+	     ((size_t)std::max(from, to) < cpu_numa_nodes.size() &&
+	      cpu_numa_nodes[from] == cpu_numa_nodes[to])) {
+    logger->inc(l_osd_op_handoff_same_node);
+  } else {
+    logger->inc(l_osd_op_handoff_cross_node);
+  }
+}
+
 int OSD::set_numa_affinity()
 {
   // storage numa node
@@ -2468,12 +2552,19 @@ int OSD::set_numa_affinity()
 	      << " cpus "
 	      << cpu_set_to_str_list(numa_cpu_set_size, &numa_cpu_set)
 	      << dendl;
-      r = set_cpu_affinity_all_threads(numa_cpu_set_size, &numa_cpu_set);
-      if (r < 0) {
-	r = -errno;
-	derr << __func__ << " failed to set numa affinity: " << cpp_strerror(r)
-	     << dendl;
-	numa_node = -1;
+      if (threads_pinned) {
+	// do not undo the pinning of the individual threads
+	dout(1) << __func__ << " not setting numa affinity: threads are pinned "
+		<< "per ms_async_affinity_cores and osd_op_shard_affinity_cores"
+		<< dendl;
+      } else {
+	r = set_cpu_affinity_all_threads(numa_cpu_set_size, &numa_cpu_set);
+	if (r < 0) {
+	  r = -errno;
+	  derr << __func__ << " failed to set numa affinity: " << cpp_strerror(r)
+	       << dendl;
+	  numa_node = -1;
+	}
       }
     }
   } else {
@@ -2712,6 +2803,9 @@ will start to track new ops received afterwards.";
     f->open_object_section("remote_reservations");
     service.remote_reserver.dump(f);
     f->close_section();
+    f->open_object_section("bandwidth_budget");
+    service.dump_recovery_budget(f);
+    f->close_section();
     f->close_section();
   } else if (prefix == "dump_scrub_reservations") {
     f->open_object_section("scrub_reservations");
@@ -2766,6 +2860,12 @@ will start to track new ops received afterwards.";
     store->get_db_statistics(f);
   } else if (prefix == "dump_scrubs") {
     service.dumps_scrub(f);
+  } else if (prefix == "dump_scrub_rate_control") {
+    f->open_object_section("scrub_rate_control");
+    f->dump_bool("enabled",
+		 cct->_conf.get_val<bool>("osd_scrub_rate_control"));
+    service.scrub_rate_ctl.dump(f);
+    f->close_section();
   } else if (prefix == "calc_objectstore_db_histogram") {
     store->generate_db_histogram(f);
   } else if (prefix == "flush_store_cache") {
@@ -3562,6 +3662,13 @@ int OSD::init()
     goto out;
   }
 
+  if (auto path = cct->_conf.get_val<std::string>("osd_map_shm_cache_path");
+      !path.empty()) {
+    service.map_shm_cache = std::make_unique<OSDMapShmCache>(
+      cct, superblock.cluster_fsid, path,
+      cct->_conf.get_val<uint64_t>("osd_map_shm_cache_size"));
+  }
+
   startup_time = ceph::mono_clock::now();
 
   // load up "current" osdmap
@@ -3763,6 +3870,10 @@ int OSD::init()
     }
   }
 
+  if (int r = get_cpu_numa_nodes(&cpu_numa_nodes); r < 0) {
+    dout(10) << __func__ << " unable to map the CPUs to numa nodes: "
+	     << cpp_strerror(r) << dendl;
+  }
   osd_op_tp.start();
 
   // start the heartbeat
@@ -3941,6 +4052,11 @@ void OSD::final_init()
 				     "print scheduled scrubs");
   ceph_assert(r == 0);
 
+  r = admin_socket->register_command("dump_scrub_rate_control",
+				     asok_hook,
+				     "show the state of the scrub rate controller");
+  ceph_assert(r == 0);
+
   r = admin_socket->register_command("calc_objectstore_db_histogram",
                                      asok_hook,
                                      "Generate key value histogram of kvdb(rocksdb) which used by bluestore");
@@ -6083,6 +6199,7 @@ void OSD::tick_without_osd_lock()
       sched_scrub();
     }
     service.promote_throttle_recalibrate();
+    service.scrub_rate_recalibrate();
     resume_creating_pg();
     bool need_send_beacon = false;
     const auto now = ceph::coarse_mono_clock::now();
@@ -6823,6 +6940,22 @@ void OSD::request_full_map(epoch_t first, epoch_t last)
   monc->send_mon_message(req);
 }
 
+OSDMap *OSD::get_shared_full_map(const OSDMap::Incremental& inc,
+				 bufferlist *bl)
+{
+  if (!service.map_shm_cache || !inc.have_crc) {
+    return nullptr;
+  }
+  auto o = service.map_shm_cache->get_map(inc, bl);
+  if (!o) {
+    logger->inc(l_osd_map_shm_cache_miss);
+    return nullptr;
+  }
+  dout(10) << __func__ << " e" << inc.epoch << dendl;
+  logger->inc(l_osd_map_shm_cache_hit);
+  return o.release();
+}
+
 void OSD::got_full_map(epoch_t e)
 {
   ceph_assert(requested_full_first <= requested_full_last);
@@ -7546,14 +7679,17 @@ void OSDService::dumps_scrub(ceph::Formatter *f)
 
 double OSD::scrub_sleep_time(bool must_scrub)
 {
+  double normal_sleep = cct->_conf->osd_scrub_sleep;
+  if (cct->_conf.get_val<bool>("osd_scrub_rate_control")) {
+    normal_sleep = service.scrub_rate_ctl.get_sleep();
+  }
   if (must_scrub) {
-    return cct->_conf->osd_scrub_sleep;
+    return normal_sleep;
   }
   utime_t now = ceph_clock_now();
   if (scrub_time_permit(now)) {
-    return cct->_conf->osd_scrub_sleep;
+    return normal_sleep;
   }
-  double normal_sleep = cct->_conf->osd_scrub_sleep;
   double extended_sleep = cct->_conf->osd_scrub_extended_sleep;
   return std::max(extended_sleep, normal_sleep);
 }
@@ -8110,6 +8246,9 @@ void OSD::handle_osd_map(MOSDMap *m)
       added_maps[e] = add_map(o);
       added_maps_bl[e] = bl;
       got_full_map(e);
+      if (service.map_shm_cache) {
+	service.map_shm_cache->put(e, bl);
+      }
       continue;
     }
 
@@ -8120,6 +8259,21 @@ void OSD::handle_osd_map(MOSDMap *m)
       ghobject_t oid = get_inc_osdmap_pobject_name(e);
       t.write(coll_t::meta(), oid, 0, bl.length(), bl);
 
+      OSDMap::Incremental inc;
+      auto p = bl.cbegin();
+      inc.decode(p);
+
+      if (bufferlist fbl; OSDMap *o = get_shared_full_map(inc, &fbl)) {
+	got_full_map(e);
+	purged_snaps[e] = o->get_new_purged_snaps();
+
+	ghobject_t fulloid = get_osdmap_pobject_name(e);
+	t.write(coll_t::meta(), fulloid, 0, fbl.length(), fbl);
+	added_maps[e] = add_map(o);
+	added_maps_bl[e] = fbl;
+	continue;
+      }
+
       OSDMap *o = new OSDMap;
       if (e > 1) {
 	bufferlist obl;
@@ -8132,10 +8286,6 @@ void OSD::handle_osd_map(MOSDMap *m)
 	o->decode(obl);
       }
 
-      OSDMap::Incremental inc;
-      auto p = bl.cbegin();
-      inc.decode(p);
-
       if (o->apply_incremental(inc) < 0) {
 	derr << "ERROR: bad fsid?  i have " << get_osdmap()->get_fsid() << " and inc has " << inc.fsid << dendl;
 	ceph_abort_msg("bad fsid");
@@ -8178,6 +8328,9 @@ void OSD::handle_osd_map(MOSDMap *m)
       t.write(coll_t::meta(), fulloid, 0, fbl.length(), fbl);
       added_maps[e] = add_map(o);
       added_maps_bl[e] = fbl;
+      if (service.map_shm_cache) {
+	service.map_shm_cache->put(e, fbl);
+      }
       continue;
     }
 
@@ -9582,9 +9735,11 @@ void OSDService::_maybe_queue_recovery() {
   uint64_t available_pushes;
   while (!awaiting_throttle.empty() &&
 	 _recover_now(&available_pushes)) {
-    uint64_t to_start = std::min(
-      available_pushes,
-      cct->_conf->osd_recovery_max_single_start);
+    // with a bandwidth budget, start as many as it allows: small objects
+    // are then pushed together
+    uint64_t to_start = recovery_budget.enabled() ?
+      available_pushes :
+      std::min(available_pushes, cct->_conf->osd_recovery_max_single_start);
     _queue_for_recovery(awaiting_throttle.front(), to_start);
     awaiting_throttle.pop_front();
     dout(10) << __func__ << " starting " << to_start
@@ -9609,6 +9764,27 @@ bool OSDService::_recover_now(uint64_t *available_pushes)
     return false;
   }
 
+  recovery_budget.set_rate(
+    cct->_conf.get_val<Option::size_t>("osd_recovery_max_bandwidth"));
+  if (recovery_budget.enabled()) {
+    uint64_t available = recovery_budget.get_available(
+      ceph::mono_clock::now(),
+      recovery_ops_active + recovery_ops_reserved,
+      cct->_conf->osd_max_push_objects);
+    if (!available) {
+      dout(15) << __func__ << " active " << recovery_ops_active
+	       << " + reserved " << recovery_ops_reserved
+	       << " over bandwidth budget (tokens "
+	       << recovery_budget.get_tokens() << ", avg object size "
+	       << recovery_budget.get_avg_object_size() << ")" << dendl;
+      logger->inc(l_osd_recovery_bw_throttled);
+      return false;
+    }
+    if (available_pushes)
+      *available_pushes = available;
+    return true;
+  }
+
   uint64_t max = osd->get_recovery_max_active();
   if (max <= recovery_ops_active + recovery_ops_reserved) {
     dout(15) << __func__ << " active " << recovery_ops_active
@@ -9765,6 +9941,18 @@ bool OSDService::is_recovery_active()
   return local_reserver.has_reservation() || remote_reserver.has_reservation();
 }
 
+void OSDService::charge_recovery_bytes(uint64_t bytes)
+{
+  std::lock_guard l(recovery_lock);
+  recovery_budget.charge(ceph::mono_clock::now(), bytes);
+}
+
+void OSDService::dump_recovery_budget(ceph::Formatter *f)
+{
+  std::lock_guard l(recovery_lock);
+  recovery_budget.dump(f);
+}
+
 void OSDService::release_reserved_pushes(uint64_t pushes)
 {
   std::lock_guard l(recovery_lock);
@@ -10772,6 +10960,25 @@ void OSD::ShardedOpWQ::_add_slot_waiter(
 #undef dout_prefix
 #define dout_prefix *_dout << "osd." << osd->whoami << " op_wq(" << shard_index << ") "
 
+void OSD::ShardedOpWQ::_thread_start(uint32_t thread_index)
+{
+  uint32_t shard_index = thread_index % osd->num_shards;
+  int cpu = get_round_robin_cpu(
+    osd->cct->_conf.get_val<std::string>("osd_op_shard_affinity_cores"),
+    thread_index);
+  if (cpu < 0) {
+    return;
+  }
+  int r = set_thread_cpu_affinity(cpu);
+  if (r < 0) {
+    derr << __func__ << " failed to pin thread " << thread_index
+	 << " to cpu " << cpu << ": " << cpp_strerror(r) << dendl;
+  } else {
+    dout(1) << __func__ << " thread " << thread_index << " pinned to cpu "
+	    << cpu << dendl;
+  }
+}
+
 void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 {
   uint32_t shard_index = thread_index % osd->num_shards;
@@ -10815,6 +11022,10 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
     }
   }
 
+  if (osd->threads_pinned) {
+    sdata->last_cpu.store(get_current_cpu(), std::memory_order_relaxed);
+  }
+
   list<Context *> oncommits;
   if (is_smallest_thread_index) {
     sdata->context_queue.move_to(oncommits);
@@ -11113,6 +11324,9 @@ void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
 
   OSDShard* sdata = osd->shards[shard_index];
   assert (NULL != sdata);
+  if (osd->threads_pinned) {
+    osd->count_op_handoff(*sdata);
+  }
 
   bool empty = true;
   {
@@ -51,7 +51,10 @@
 #include "common/simple_cache.hpp"
 #include "messages/MOSDOp.h"
 #include "common/EventTrace.h"
+#include "osd/OSDMapShmCache.h"
 #include "osd/osd_perf_counters.h"
+#include "osd/recovery_pacing.h"
+#include "osd/scrub_rate_controller.h"
 #include "common/Finisher.h"
 
 #define CEPH_OSD_PROTOCOL    10 /* cluster internal */
@@ -490,6 +493,16 @@ public:
     promote_counter.finish(bytes);
   }
   void promote_throttle_recalibrate();
+
+  /// feedback-driven pacing of the scrubs (osd_scrub_rate_control)
+  Scrub::RateController scrub_rate_ctl;
+  /// osd_scrub_rate_control as of the last tick: the store accounts its
+  /// ios, and the client ops are sampled, only then
+  std::atomic<bool> scrub_rate_enabled = false;
+  void scrub_rate_recalibrate();
+  /// the fraction of osd_scrub_chunk_max a scrubber should use
+  double get_scrub_chunk_ratio() const;
+
   unsigned get_num_shards() const {
     return m_objecter_finishers;
   }
@@ -672,6 +685,8 @@ private:
   uint64_t recovery_ops_active;
   uint64_t recovery_ops_reserved;
   bool recovery_paused;
+  /// bytes/sec allowance of recovery and backfill (osd_recovery_max_bandwidth)
+  Recovery::BandwidthBudget recovery_budget;
 #ifdef DEBUG_RECOVERY_OIDS
   std::map<spg_t, std::set<hobject_t> > recovery_oids;
 #endif
@@ -684,6 +699,9 @@ public:
   void finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue);
   bool is_recovery_active();
   void release_reserved_pushes(uint64_t pushes);
+  /// account for the bytes of a completed recovery op
+  void charge_recovery_bytes(uint64_t bytes);
+  void dump_recovery_budget(ceph::Formatter *f);
   void defer_recovery(float defer_for) {
     defer_recovery_until = ceph_clock_now();
     defer_recovery_until += defer_for;
@@ -763,6 +781,10 @@ public:
   void _add_map_inc_bl(epoch_t e, ceph::buffer::list& bl);
   bool get_inc_map_bl(epoch_t e, ceph::buffer::list& bl);
 
+  /// the full maps shared with the other OSDs of the host, if enabled;
+  /// used by handle_osd_map() only
+  std::unique_ptr<OSDMapShmCache> map_shm_cache;
+
   /// identify split child pgids over a osdmap interval
   void identify_splits_and_merges(
     OSDMapRef old_map,
@@ -1073,6 +1095,9 @@ struct OSDShard {
 
   bool stop_waiting = false;
 
+  /// the CPU a thread of the shard last picked an item on, -1 if unknown
+  std::atomic<int> last_cpu = {-1};
+
   ContextQueue context_queue;
 
   void _attach_pg(OSDShardPGSlot *slot, PG *pg);
@@ -1160,6 +1185,11 @@ protected:
   int numa_node = -1;
   size_t numa_cpu_set_size = 0;
   cpu_set_t numa_cpu_set;
+  /// the numa node of each CPU, for the op handoff counters
+  std::vector<int> cpu_numa_nodes;
+  /// threads pinned per ms_async_affinity_cores or
+  /// osd_op_shard_affinity_cores, the op handoffs are counted
+  bool threads_pinned = false;
 
   bool store_is_rotational = true;
   bool journal_is_rotational = true;
@@ -1641,6 +1671,9 @@ protected:
     /// try to do some work
     void _process(uint32_t thread_index, ceph::heartbeat_handle_d *hb) override;
 
+    /// pin the thread per osd_op_shard_affinity_cores
+    void _thread_start(uint32_t thread_index) override;
+
     /// enqueue a new item
     void _enqueue(OpSchedulerItem&& item) override;
 
@@ -1893,6 +1926,10 @@ protected:
     request_full_map(first, last);
   }
   void got_full_map(epoch_t e);
+  /// the full map of the epoch of 'inc' as published by another OSD of
+  /// the host, if it has the expected crc, and its encoding in 'bl'
+  OSDMap *get_shared_full_map(const OSDMap::Incremental& inc,
+			      ceph::buffer::list *bl);
 
   // -- failures --
   std::map<int,utime_t> failure_queue;
@@ -2117,6 +2154,8 @@ public:
 
   int enable_disable_fuse(bool stop);
   int set_numa_affinity();
+  /// account for an op queued from this thread to 'sdata'
+  void count_op_handoff(const OSDShard& sdata);
 
   void suicide(int exitcode);
   int shutdown();
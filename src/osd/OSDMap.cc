@@ -2667,7 +2667,8 @@ void OSDMap::pg_to_raw_up(pg_t pg, vector<int> *up, int *primary) const
 void OSDMap::_pg_to_up_acting_osds(
   const pg_t& pg, vector<int> *up, int *up_primary,
   vector<int> *acting, int *acting_primary,
-  bool raw_pg_to_pg) const
+  bool raw_pg_to_pg,
+  vector<int> *deps) const
 {
   const pg_pool_t *pool = get_pg_pool(pg.pool());
   if (!pool ||
@@ -2680,6 +2681,8 @@ void OSDMap::_pg_to_up_acting_osds(
       acting->clear();
     if (acting_primary)
       *acting_primary = -1;
+    if (deps)
+      deps->clear();
     return;
   }
   vector<int> raw;
@@ -2695,6 +2698,16 @@ void OSDMap::_pg_to_up_acting_osds(
     _raw_to_up_osds(*pool, raw, &_up);
     _up_primary = _pick_primary(_up);
     _apply_primary_affinity(pps, *pool, &_up, &_up_primary);
+    if (deps) {
+      *deps = raw;
+      const pg_t actual_pg = pool->raw_pg_to_pg(pg);
+      if (auto p = pg_temp->find(actual_pg); p != pg_temp->end()) {
+	deps->insert(deps->end(), p->second.begin(), p->second.end());
+      }
+      if (auto p = primary_temp->find(actual_pg); p != primary_temp->end()) {
+	deps->push_back(p->second);
+      }
+    }
     if (_acting.empty()) {
       _acting = _up;
       if (_acting_primary == -1) {
@@ -4706,7 +4719,9 @@ int OSDMap::calc_pg_upmaps(
   }
   float stddev = 0;
   map<int,float> osd_deviation;       // osd, deviation(pgs)
-  multimap<float,int> deviation_osd;  // deviation(pgs), osd
+  // deviation(pgs), osd: the osds by deviation, then by id; only those
+  // whose deviation changes are moved around after each change
+  set<pair<float,int>> deviation_osd;
   float cur_max_deviation = 0;
   for (auto& i : pgs_by_osd) {
     // make sure osd is still there (belongs to this crush-tree)
@@ -4735,6 +4750,29 @@ int OSDMap::calc_pg_upmaps(
     cct->_conf.get_val<bool>("osd_calc_pg_upmaps_aggressively");
   auto local_fallback_retries =
     cct->_conf.get_val<uint64_t>("osd_calc_pg_upmaps_local_fallback_retries");
+  // what the change being tested did to pgs_by_osd (osd, pg, inserted or
+  // erased), to undo it if the change is not good: pgs_by_osd is way too
+  // large to be copied for each change
+  vector<std::tuple<int,pg_t,bool>> pg_moves;
+  auto move_pg = [&pgs_by_osd, &pg_moves](pg_t pg, int from, int to) {
+    if (pgs_by_osd[from].erase(pg)) {
+      pg_moves.emplace_back(from, pg, false);
+    }
+    if (pgs_by_osd[to].insert(pg).second) {
+      pg_moves.emplace_back(to, pg, true);
+    }
+  };
+  auto undo_pg_moves = [&pgs_by_osd, &pg_moves] {
+    for (auto p = pg_moves.rbegin(); p != pg_moves.rend(); ++p) {
+      auto& [osd, pg, inserted] = *p;
+      if (inserted) {
+        pgs_by_osd[osd].erase(pg);
+      } else {
+        pgs_by_osd[osd].insert(pg);
+      }
+    }
+    pg_moves.clear();
+  };
   while (max--) {
     ldout(cct, 30) << "Top of loop #" << max+1 << dendl;
     // build overfull and underfull
@@ -4779,6 +4817,7 @@ int OSDMap::calc_pg_upmaps(
     ldout(cct, 10) << " overfull " << overfull
                    << " underfull " << underfull
                    << dendl;
+    set<int> underfull_osds(underfull.begin(), underfull.end());
     set<pg_t> to_skip;
     uint64_t local_fallback_retried = 0;
 
@@ -4786,7 +4825,9 @@ int OSDMap::calc_pg_upmaps(
 
     set<pg_t> to_unmap;
     map<pg_t, mempool::osdmap::vector<pair<int32_t,int32_t>>> to_upmap;
-    auto temp_pgs_by_osd = pgs_by_osd;
+    // the remaps we may un-remap, for any underfull osd
+    vector<decltype(tmp.pg_upmap_items)::const_iterator> candidates;
+    ceph_assert(pg_moves.empty());
     // always start with fullest, break if we find any changes to make
     for (auto p = deviation_osd.rbegin(); p != deviation_osd.rend(); ++p) {
       if (skip_overfull && !underfull.empty()) {
@@ -4843,8 +4884,7 @@ int OSDMap::calc_pg_upmaps(
                            << " which remapped " << pg
                            << " into overfull osd." << osd
                            << dendl;
-            temp_pgs_by_osd[q.second].erase(pg);
-            temp_pgs_by_osd[q.first].insert(pg);
+            move_pg(pg, q.second, q.first);
           } else {
             new_upmap_items.push_back(q);
           }
@@ -4936,8 +4976,7 @@ int OSDMap::calc_pg_upmaps(
                          << dendl;
           existing.insert(orig[i]);
           existing.insert(out[i]);
-          temp_pgs_by_osd[orig[i]].erase(pg);
-          temp_pgs_by_osd[out[i]].insert(pg);
+          move_pg(pg, orig[i], out[i]);
           ceph_assert(new_upmap_items.size() < (size_t)pg_pool_size);
           new_upmap_items.push_back(make_pair(orig[i], out[i]));
           // append new remapping pairs slowly
@@ -4953,9 +4992,19 @@ int OSDMap::calc_pg_upmaps(
     ceph_assert(!(to_unmap.size() || to_upmap.size()));
     ldout(cct, 10) << " failed to find any changes for overfull osds"
                    << dendl;
+    if (!underfull.empty()) {
+      candidates.reserve(tmp.pg_upmap_items.size());
+      for (auto i = tmp.pg_upmap_items.cbegin();
+           i != tmp.pg_upmap_items.cend(); ++i) {
+        if (to_skip.count(i->first))
+          continue;
+        if (!only_pools.empty() && !only_pools.count(i->first.pool()))
+          continue;
+        candidates.push_back(i);
+      }
+    }
     for (auto& p : deviation_osd) {
-      if (std::find(underfull.begin(), underfull.end(), p.second) ==
-                    underfull.end())
+      if (!underfull_osds.count(p.second))
         break;
       int osd = p.second;
       float deviation = p.first;
@@ -4972,23 +5021,14 @@ int OSDMap::calc_pg_upmaps(
         break;
       }
       // look for remaps we can un-remap
-      vector<pair<pg_t,
-        mempool::osdmap::vector<pair<int32_t,int32_t>>>> candidates;
-      candidates.reserve(tmp.pg_upmap_items.size());
-      for (auto& i : tmp.pg_upmap_items) {
-        if (to_skip.count(i.first))
-          continue;
-        if (!only_pools.empty() && !only_pools.count(i.first.pool()))
-          continue;
-        candidates.push_back(make_pair(i.first, i.second));
-      }
       if (aggressive) {
         // shuffle candidates so they all get equal (in)attention
         std::random_device rd;
         std::default_random_engine rng{rd()};
         std::shuffle(candidates.begin(), candidates.end(), rng);
       }
-      for (auto& i : candidates) {
+      for (auto c : candidates) {
+        auto& i = *c;
         auto pg = i.first;
         mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items;
         for (auto& j : i.second) {
@@ -4999,8 +5039,7 @@ int OSDMap::calc_pg_upmaps(
                            << " which remapped " << pg
                            << " out from underfull osd." << osd
                            << dendl;
-            temp_pgs_by_osd[j.second].erase(pg);
-            temp_pgs_by_osd[j.first].insert(pg);
+            move_pg(pg, j.second, j.first);
           } else {
             new_upmap_items.push_back(j);
           }
@@ -5051,27 +5090,33 @@ int OSDMap::calc_pg_upmaps(
     // test change, apply if change is good
     ceph_assert(to_unmap.size() || to_upmap.size());
     float new_stddev = 0;
-    map<int,float> temp_osd_deviation;
-    multimap<float,int> temp_deviation_osd;
+    map<int,float> temp_osd_deviation;  // of the osds the change moved pgs of
     float cur_max_deviation = 0;
-    for (auto& i : temp_pgs_by_osd) {
+    for (auto& [osd, pg, inserted] : pg_moves) {
+      if (temp_osd_deviation.count(osd))
+        continue;
       // make sure osd is still there (belongs to this crush-tree)
-      ceph_assert(osd_weight.count(i.first));
-      float target = osd_weight[i.first] * pgs_per_weight;
-      float deviation = (float)i.second.size() - target;
-      ldout(cct, 20) << " osd." << i.first
-                     << "\tpgs " << i.second.size()
+      ceph_assert(osd_weight.count(osd));
+      float target = osd_weight[osd] * pgs_per_weight;
+      float deviation = (float)pgs_by_osd[osd].size() - target;
+      ldout(cct, 20) << " osd." << osd
+                     << "\tpgs " << pgs_by_osd[osd].size()
                      << "\ttarget " << target
                      << "\tdeviation " << deviation
                      << dendl;
-      temp_osd_deviation[i.first] = deviation;
-      temp_deviation_osd.insert(make_pair(deviation, i.first));
-       new_stddev += deviation * deviation;
-      if (fabsf(deviation) > cur_max_deviation)
-        cur_max_deviation = fabsf(deviation);
+      temp_osd_deviation[osd] = deviation;
+    }
+    // summed up in the order of the osds, as it always was
+    for (auto& [osd, deviation] : osd_deviation) {
+      auto p = temp_osd_deviation.find(osd);
+      float d = p == temp_osd_deviation.end() ? deviation : p->second;
+      new_stddev += d * d;
+      if (fabsf(d) > cur_max_deviation)
+        cur_max_deviation = fabsf(d);
     }
     ldout(cct, 10) << " stddev " << stddev << " -> " << new_stddev << dendl;
     if (new_stddev >= stddev) {
+      undo_pg_moves();
       if (!aggressive) {
         ldout(cct, 10) << " break because stddev is not decreasing"
                        << " and aggressive mode is not enabled"
@@ -5102,9 +5147,13 @@ int OSDMap::calc_pg_upmaps(
     // ready to go
     ceph_assert(new_stddev < stddev);
     stddev = new_stddev;
-    pgs_by_osd = temp_pgs_by_osd;
-    osd_deviation = temp_osd_deviation;
-    deviation_osd = temp_deviation_osd;
+    pg_moves.clear();
+    for (auto& [osd, deviation] : temp_osd_deviation) {
+      auto& d = osd_deviation[osd];
+      deviation_osd.erase(make_pair(d, osd));
+      d = deviation;
+      deviation_osd.insert(make_pair(deviation, osd));
+    }
     for (auto& i : to_unmap) {
       ldout(cct, 10) << " unmap pg " << i << dendl;
       ceph_assert(tmp.pg_upmap_items.count(i));
@@ -628,6 +628,7 @@ private:
   uint32_t crush_version = 1;
 
   friend class OSDMonitor;
+  friend class LazyOSDMapMapping;
 
  public:
   OSDMap() : epoch(0), 
@@ -1202,10 +1203,13 @@ private:
 
   /**
    *  map to up and acting. Fills in whatever fields are non-NULL.
+   *  deps, if non-NULL, gets the osds whose state the mapping depends on,
+   *  see pg_to_up_acting_osds().
    */
   void _pg_to_up_acting_osds(const pg_t& pg, std::vector<int> *up, int *up_primary,
                              std::vector<int> *acting, int *acting_primary,
-			     bool raw_pg_to_pg = true) const;
+			     bool raw_pg_to_pg = true,
+			     std::vector<int> *deps = nullptr) const;
 
 public:
   /***
@@ -1245,6 +1249,21 @@ public:
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
+  /**
+   * map a pg to its up and acting sets, also returning the osds whose
+   * state (existence, up/down, weight, primary affinity) the mapping
+   * depends on: those chosen by CRUSH, upmaps applied, and those of its
+   * pg_temp and primary_temp. The mapping of a pg does not change as long
+   * as the state of these osds, the pool, the CRUSH map and the temp and
+   * upmap entries of the pg do not, unless an osd gets a higher weight.
+   * Each of these pointers must be non-NULL.
+   */
+  void pg_to_up_acting_osds(pg_t pg, std::vector<int> *up, int *up_primary,
+                            std::vector<int> *acting, int *acting_primary,
+                            std::vector<int> *deps) const {
+    _pg_to_up_acting_osds(pg, up, up_primary, acting, acting_primary, true,
+                          deps);
+  }
   bool pg_is_ec(pg_t pg) const {
     auto i = pools.find(pg.pool());
     ceph_assert(i != pools.end());
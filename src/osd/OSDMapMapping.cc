@@ -205,3 +205,192 @@ void ParallelPGMapper::queue(
   }
   ceph_assert(any);
 }
+
+// -------------------------
+
+void LazyOSDMapMapping::calc(const OSDMap& map, pg_t pgid, mapping_t *mapping)
+{
+  map.pg_to_up_acting_osds(pgid, &mapping->up, &mapping->up_primary,
+			   &mapping->acting, &mapping->acting_primary,
+			   &mapping->deps);
+}
+
+bool LazyOSDMapMapping::pool_mapping_changed(const pg_pool_t& a,
+					     const pg_pool_t& b)
+{
+  // what _pg_to_raw_osds() and the up/acting filters look at
+  return
+    a.get_type() != b.get_type() ||
+    a.get_size() != b.get_size() ||
+    a.get_crush_rule() != b.get_crush_rule() ||
+    a.get_pg_num() != b.get_pg_num() ||
+    a.get_pgp_num() != b.get_pgp_num() ||
+    a.has_flag(pg_pool_t::FLAG_HASHPSPOOL) !=
+      b.has_flag(pg_pool_t::FLAG_HASHPSPOOL);
+}
+
+void LazyOSDMapMapping::invalidate_pg(pg_t pgid, uint64_t *dropped)
+{
+  auto p = pools.find(pgid.pool());
+  if (p == pools.end() || pgid.ps() >= p->second.size()) {
+    return;
+  }
+  auto& m = p->second[pgid.ps()];
+  if (m.is_valid()) {
+    m = mapping_t();
+    ++*dropped;
+  }
+}
+
+uint64_t LazyOSDMapMapping::invalidate(const OSDMap& map,
+				       const OSDMap::Incremental& inc)
+{
+  auto drop_all = [this] {
+    const uint64_t n = get_num_cached();
+    clear();
+    return n;
+  };
+  if (inc.fullmap.length() || inc.crush.length() ||
+      (inc.new_max_osd >= 0 && inc.new_max_osd != map.get_max_osd())) {
+    return drop_all();
+  }
+
+  // the osds whose state changed: the PGs depending on them may move
+  std::set<int> osds;
+  // whether an upmap may apply differently, as the CRUSH choice it
+  // remaps may change
+  bool upmaps_changed = false;
+  for (auto& [osd, state] : inc.new_state) {
+    if (osd >= map.get_max_osd() || (state & CEPH_OSD_EXISTS)) {
+      // created or destroyed
+      return drop_all();
+    }
+    osds.insert(osd);
+  }
+  for (auto& [osd, addrs] : inc.new_up_client) {
+    if (osd >= map.get_max_osd() || !map.exists(osd)) {
+      return drop_all();
+    }
+    osds.insert(osd);
+  }
+  for (auto& [osd, weight] : inc.new_weight) {
+    if (osd >= map.get_max_osd() || !map.exists(osd) ||
+	weight > map.get_weight(osd)) {
+      // CRUSH may now pick it for the PGs it was rejected for
+      return drop_all();
+    }
+    if (weight < map.get_weight(osd)) {
+      osds.insert(osd);
+      upmaps_changed = true;
+    }
+  }
+  for (auto& [osd, affinity] : inc.new_primary_affinity) {
+    if (osd >= map.get_max_osd()) {
+      return drop_all();
+    }
+    if (affinity != map.get_primary_affinity(osd)) {
+      osds.insert(osd);
+    }
+  }
+
+  uint64_t dropped = 0;
+  auto drop_pool = [this, &dropped](int64_t pool) {
+    auto p = pools.find(pool);
+    if (p == pools.end()) {
+      return;
+    }
+    for (auto& m : p->second) {
+      if (m.is_valid()) {
+	++dropped;
+      }
+    }
+    pools.erase(p);
+  };
+  for (auto& [pool, pi] : inc.new_pools) {
+    auto old = map.get_pg_pool(pool);
+    if (!old || pool_mapping_changed(*old, pi)) {
+      drop_pool(pool);
+    }
+  }
+  for (auto pool : inc.old_pools) {
+    drop_pool(pool);
+  }
+
+  for (auto& i : inc.new_pg_temp) {
+    invalidate_pg(i.first, &dropped);
+  }
+  for (auto& i : inc.new_primary_temp) {
+    invalidate_pg(i.first, &dropped);
+  }
+  for (auto& i : inc.new_pg_upmap) {
+    invalidate_pg(i.first, &dropped);
+  }
+  for (auto& pgid : inc.old_pg_upmap) {
+    invalidate_pg(pgid, &dropped);
+  }
+  for (auto& i : inc.new_pg_upmap_items) {
+    invalidate_pg(i.first, &dropped);
+  }
+  for (auto& pgid : inc.old_pg_upmap_items) {
+    invalidate_pg(pgid, &dropped);
+  }
+  if (upmaps_changed) {
+    for (auto& i : map.pg_upmap) {
+      invalidate_pg(i.first, &dropped);
+    }
+    for (auto& i : map.pg_upmap_items) {
+      invalidate_pg(i.first, &dropped);
+    }
+  }
+
+  if (!osds.empty()) {
+    for (auto& [pool, mappings] : pools) {
+      for (auto& m : mappings) {
+	if (!m.is_valid()) {
+	  continue;
+	}
+	for (auto osd : m.deps) {
+	  if (osds.count(osd)) {
+	    m = mapping_t();
+	    ++dropped;
+	    break;
+	  }
+	}
+      }
+    }
+  }
+  return dropped;
+}
+
+void LazyOSDMapMapping::update_pools(const OSDMap& map)
+{
+  const auto& map_pools = map.get_pools();
+  for (auto p = pools.begin(); p != pools.end(); ) {
+    if (!map_pools.count(p->first)) {
+      p = pools.erase(p);
+    } else {
+      ++p;
+    }
+  }
+  for (auto& [pool, pi] : map_pools) {
+    auto& mappings = pools[pool];
+    if (mappings.size() != pi.get_pg_num()) {
+      // a new pool, or one invalidate() dropped
+      mappings.clear();
+      mappings.resize(pi.get_pg_num());
+    }
+  }
+}
+
+uint64_t LazyOSDMapMapping::get_num_cached() const
+{
+  uint64_t n = 0;
+  for (auto& [pool, mappings] : pools) {
+    for (auto& m : mappings) {
+      if (m.is_valid()) {
+	++n;
+      }
+    }
+  }
+  return n;
+}
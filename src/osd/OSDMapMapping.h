@@ -9,11 +9,10 @@
 #include <map>
 
 #include "osd/osd_types.h"
+#include "osd/OSDMap.h"
 #include "common/WorkQueue.h"
 #include "common/Cond.h"
 
-class OSDMap;
-
 /// work queue to perform work on batches of pgids on multiple CPUs
 class ParallelPGMapper {
 public:
@@ -350,4 +349,79 @@ public:
 };
 
 
+/**
+ * A mapping of the PGs of an OSDMap, computed on demand, which is kept
+ * across epochs: going to the next epoch, only the PGs whose mapping the
+ * incremental may change are dropped, see
+ * OSDMap::pg_to_up_acting_osds(). This is for the clients, which map a
+ * few PGs often rather than all of them at each epoch.
+ *
+ * The PGs are those of pg_num (not raw pgs). This is not thread safe.
+ */
+class LazyOSDMapMapping {
+public:
+  struct mapping_t {
+    std::vector<int> up;
+    int up_primary = -1;
+    std::vector<int> acting;
+    int acting_primary = -1;
+    /// the osds the mapping depends on, empty if the PG is not cached
+    std::vector<int> deps;
+
+    bool is_valid() const {
+      return !deps.empty();
+    }
+  };
+
+  /// @return false if the mapping of pgid is not cached
+  bool get(pg_t pgid, mapping_t *mapping) const {
+    auto p = pools.find(pgid.pool());
+    if (p == pools.end() || pgid.ps() >= p->second.size()) {
+      return false;
+    }
+    const auto& m = p->second[pgid.ps()];
+    if (!m.is_valid()) {
+      return false;
+    }
+    *mapping = m;
+    return true;
+  }
+
+  /// cache the mapping of pgid, as of the map the pools were updated to
+  void set(pg_t pgid, mapping_t&& mapping) {
+    auto p = pools.find(pgid.pool());
+    if (p != pools.end() && pgid.ps() < p->second.size()) {
+      p->second[pgid.ps()] = std::move(mapping);
+    }
+  }
+
+  /// compute the mapping of pgid in map, to be set()
+  static void calc(const OSDMap& map, pg_t pgid, mapping_t *mapping);
+
+  /**
+   * drop the mappings which may change with the next epoch
+   *
+   * @param map the map inc is about to be applied to
+   * @return the number of mappings dropped
+   */
+  uint64_t invalidate(const OSDMap& map, const OSDMap::Incremental& inc);
+
+  /// follow the pools of map, the new PGs not being cached
+  void update_pools(const OSDMap& map);
+
+  void clear() {
+    pools.clear();
+  }
+
+  /// the number of cached mappings
+  uint64_t get_num_cached() const;
+
+private:
+  // pool -> ps -> mapping
+  std::map<int64_t, std::vector<mapping_t>> pools;
+
+  void invalidate_pg(pg_t pgid, uint64_t *dropped);
+  static bool pool_mapping_changed(const pg_pool_t& a, const pg_pool_t& b);
+};
+
 #endif
@@ -0,0 +1,177 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "OSDMapShmCache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string_view>
+
+#include "common/debug.h"
+#include "common/deleter.h"
+#include "common/errno.h"
+#include "include/compat.h"
+#include "include/stringify.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_osd
+#undef dout_prefix
+#define dout_prefix *_dout << "osdmap_shm_cache(" << dir << ") "
+
+OSDMapShmCache::OSDMapShmCache(CephContext *cct, const uuid_d& fsid,
+			       const std::string& path, unsigned size)
+  : cct(cct), size(size)
+{
+  if (path.empty() || size == 0) {
+    return;
+  }
+  // one directory per cluster, as several may share the host
+  const std::string d = path + "/" + stringify(fsid);
+  for (auto& p : {path, d}) {
+    if (::mkdir(p.c_str(), 0700) < 0 && errno != EEXIST) {
+      int r = -errno;
+      lderr(cct) << "osdmap_shm_cache cannot create " << p << ": "
+		 << cpp_strerror(r) << ", disabled" << dendl;
+      return;
+    }
+  }
+  dir = d;
+  ldout(cct, 1) << "keeping the last " << size << " maps" << dendl;
+}
+
+std::string OSDMapShmCache::get_path(epoch_t e) const
+{
+  return dir + "/" + stringify(e);
+}
+
+bool OSDMapShmCache::get(epoch_t e, ceph::buffer::list *bl)
+{
+  if (dir.empty()) {
+    return false;
+  }
+  int fd = ::open(get_path(e).c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  void *p = MAP_FAILED;
+  if (::fstat(fd, &st) == 0 && st.st_size > 0 &&
+      (uint64_t)st.st_size <= UINT32_MAX) {
+    p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  VOID_TEMP_FAILURE_RETRY(::close(fd));
+  if (p == MAP_FAILED) {
+    ldout(cct, 5) << __func__ << " cannot map e" << e << dendl;
+    return false;
+  }
+  // the files are only ever renamed into place and unlinked, never
+  // written to or truncated, so the pages stay valid until unmapped
+  const size_t len = st.st_size;
+  bl->clear();
+  bl->push_back(ceph::buffer::claim_buffer(
+    len, static_cast<char*>(p),
+    make_deleter([p, len] { ::munmap(p, len); })));
+  ldout(cct, 20) << __func__ << " e" << e << " " << len << " bytes" << dendl;
+  return true;
+}
+
+std::unique_ptr<OSDMap> OSDMapShmCache::get_map(
+  const OSDMap::Incremental& inc,
+  ceph::buffer::list *bl)
+{
+  if (!inc.have_crc || !get(inc.epoch, bl)) {
+    return nullptr;
+  }
+  auto o = std::make_unique<OSDMap>();
+  try {
+    o->decode(*bl);
+  } catch (ceph::buffer::error& e) {
+    ldout(cct, 1) << __func__ << " e" << inc.epoch << " failed to decode: "
+		  << e.what() << dendl;
+    o.reset();
+  }
+  if (!o || o->get_epoch() != inc.epoch || o->get_crc() != inc.full_crc) {
+    ldout(cct, 1) << __func__ << " e" << inc.epoch
+		  << " does not match the incremental, ignoring it" << dendl;
+    bl->clear();
+    return nullptr;
+  }
+  return o;
+}
+
+void OSDMapShmCache::put(epoch_t e, const ceph::buffer::list& bl)
+{
+  if (dir.empty()) {
+    return;
+  }
+  const std::string path = get_path(e);
+  if (::access(path.c_str(), F_OK) == 0) {
+    // another OSD was first
+    return;
+  }
+  const std::string tmp =
+    dir + "/." + stringify(e) + "." + stringify(::getpid()) + ".tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    int r = -errno;
+    ldout(cct, 1) << __func__ << " cannot create " << tmp << ": "
+		  << cpp_strerror(r) << dendl;
+    return;
+  }
+  int r = bl.write_fd(fd);
+  VOID_TEMP_FAILURE_RETRY(::close(fd));
+  if (r == 0 && ::rename(tmp.c_str(), path.c_str()) < 0) {
+    r = -errno;
+  }
+  if (r < 0) {
+    ldout(cct, 1) << __func__ << " cannot publish e" << e << ": "
+		  << cpp_strerror(r) << dendl;
+    ::unlink(tmp.c_str());
+    return;
+  }
+  ldout(cct, 20) << __func__ << " e" << e << " " << bl.length() << " bytes"
+		 << dendl;
+  if (e >= size) {
+    trim(e - size + 1);
+  }
+}
+
+void OSDMapShmCache::trim(epoch_t e)
+{
+  if (dir.empty() || e <= trimmed_to) {
+    return;
+  }
+  DIR *d = ::opendir(dir.c_str());
+  if (!d) {
+    return;
+  }
+  // the other OSDs trim too, and publish behind our back: look at what
+  // is there rather than at what we published
+  while (struct dirent *de = ::readdir(d)) {
+    // <e>, or .<e>.<pid>.tmp if an OSD died before renaming it
+    const char *name = de->d_name;
+    const bool tmp = name[0] == '.';
+    if (tmp) {
+      name++;
+    }
+    char *end;
+    unsigned long epoch = ::strtoul(name, &end, 10);
+    if (name[0] < '0' || name[0] > '9' || epoch >= e) {
+      continue;
+    }
+    const std::string_view rest(end);
+    if (tmp ? (rest.size() <= 5 || rest[0] != '.' ||
+	       rest.substr(rest.size() - 4) != ".tmp") :
+	!rest.empty()) {
+      continue;
+    }
+    ldout(cct, 20) << __func__ << " removing " << de->d_name << dendl;
+    ::unlinkat(::dirfd(d), de->d_name, 0);
+  }
+  ::closedir(d);
+  trimmed_to = e;
+}
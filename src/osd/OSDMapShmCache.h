@@ -0,0 +1,62 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "include/buffer.h"
+#include "include/types.h"
+#include "include/uuid.h"
+#include "osd/OSDMap.h"
+
+class CephContext;
+
+/**
+ * The encoded full OSDMaps shared by the OSDs of a host.
+ *
+ * When an OSD builds the full map of an epoch from an incremental and
+ * finds the expected crc, it publishes the encoding in a directory shared
+ * by the OSDs of the host (normally on a tmpfs, e.g. /dev/shm), one
+ * immutable file per epoch, written aside and renamed into place. The
+ * other OSDs of the host then take it from there rather than applying the
+ * incremental to their previous map and encoding the result, and they
+ * mmap it: the buffers they keep for that epoch are the same pages of
+ * memory.
+ *
+ * Nothing taken from here is trusted: the callers check the crc of what
+ * they decode against the one of the incremental, and fall back to
+ * building the map themselves. The files of the epochs older than the
+ * last 'size' ones published are removed; the OSDs which still map them
+ * keep their pages until they let go of them.
+ */
+class OSDMapShmCache {
+public:
+  OSDMapShmCache(CephContext *cct, const uuid_d& fsid,
+		 const std::string& path, unsigned size);
+
+  /// false if the directory cannot be used
+  bool is_enabled() const {
+    return !dir.empty();
+  }
+
+  /// the encoded full map of epoch 'e', if some OSD of the host published it
+  bool get(epoch_t e, ceph::buffer::list *bl);
+  /// the full map of the epoch of 'inc' if some OSD of the host published
+  /// it and it has the crc 'inc' expects, and its encoding in 'bl'
+  std::unique_ptr<OSDMap> get_map(const OSDMap::Incremental& inc,
+				  ceph::buffer::list *bl);
+  /// publish the encoded full map of epoch 'e'
+  void put(epoch_t e, const ceph::buffer::list& bl);
+  /// remove the maps older than 'e', and what was left of their
+  /// publication by OSDs which stopped halfway
+  void trim(epoch_t e);
+
+private:
+  CephContext *cct;
+  std::string dir;  ///< <path>/<fsid>, empty if disabled
+  unsigned size;
+  epoch_t trimmed_to = 0;
+
+  std::string get_path(epoch_t e) const;
+};
@@ -486,6 +486,8 @@ void PrimaryLogPG::on_global_recover(
   recovery_state.object_recovered(soid, stat_diff);
   publish_stats_to_osd();
   dout(10) << "pushed " << soid << " to all replicas" << dendl;
+  osd->charge_recovery_bytes(stat_diff.num_bytes_recovered);
+  recovery_heat.erase(soid);
   auto i = recovering.find(soid);
   ceph_assert(i != recovering.end());
 
@@ -616,6 +618,63 @@ void PrimaryLogPG::maybe_kick_recovery(
   }
 }
 
+void PrimaryLogPG::refresh_recovery_heat_conf()
+{
+  recovery_heat_enabled =
+    cct->_conf.get_val<bool>("osd_recovery_prioritize_hot_objects");
+  const auto max_objects =
+    cct->_conf.get_val<uint64_t>("osd_recovery_heat_max_objects");
+  const auto half_life =
+    cct->_conf.get_val<double>("osd_recovery_heat_half_life");
+  if (max_objects != recovery_heat_max_objects ||
+      half_life != recovery_heat_half_life) {
+    recovery_heat_max_objects = max_objects;
+    recovery_heat_half_life = half_life;
+    recovery_heat.set_limits(max_objects, half_life);
+  }
+}
+
+void PrimaryLogPG::note_recovery_heat(const hobject_t& soid)
+{
+  if (!recovery_heat_enabled ||
+      !recovery_state.get_missing_loc().needs_recovery(soid)) {
+    return;
+  }
+  recovery_heat.note_access(soid, ceph::mono_clock::now());
+}
+
+void PrimaryLogPG::seed_recovery_heat_from_hit_set()
+{
+  refresh_recovery_heat_conf();
+  if (!is_primary() || !needs_recovery() || !recovery_heat_enabled) {
+    return;
+  }
+  std::vector<HitSetRef> hit_sets;
+  if (hit_set) {
+    hit_sets.push_back(hit_set);
+  }
+  if (agent_state) {
+    for (const auto& [start, hs] : agent_state->hit_set_map) {
+      hit_sets.push_back(hs);
+    }
+  }
+  if (hit_sets.empty()) {
+    return;
+  }
+  unsigned seeded = 0;
+  for (const auto& [soid, item] :
+	 recovery_state.get_missing_loc().get_needs_recovery()) {
+    for (const auto& hs : hit_sets) {
+      if (hs->contains(soid)) {
+	note_recovery_heat(soid);
+	++seeded;
+      }
+    }
+  }
+  dout(10) << __func__ << " " << seeded << " hits in " << hit_sets.size()
+	   << " hit sets" << dendl;
+}
+
 void PrimaryLogPG::wait_for_unreadable_object(
   const hobject_t& soid, OpRequestRef op)
 {
@@ -1735,6 +1794,7 @@ PrimaryLogPG::PrimaryLogPG(OSDService *o, OSDMapRef curmap,
   snap_trimmer_machine.initiate();
 
   m_scrubber = make_unique<PrimaryLogScrub>(this);
+  refresh_recovery_heat_conf();
 }
 
 void PrimaryLogPG::get_src_oloc(const object_t& oid, const object_locator_t& oloc, object_locator_t& src_oloc)
@@ -2143,6 +2203,11 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
     auto do_op_span = jaeger_tracing::child_span(__func__, op->osd_parent_span);
   }
 #endif
+  if (is_primary() &&
+      !recovery_state.get_missing_loc().get_needs_recovery().empty()) {
+    note_recovery_heat(head);
+  }
+
   // missing object?
   if (is_unreadable_object(head)) {
     if (!is_primary()) {
@@ -4336,6 +4401,9 @@ void PrimaryLogPG::log_op_stats(const OpRequest& op,
   osd->logger->inc(l_osd_op_inb, inb);
   osd->logger->tinc(l_osd_op_lat, latency);
   osd->logger->tinc(l_osd_op_process_lat, process_latency);
+  if (osd->scrub_rate_enabled.load(std::memory_order_relaxed)) {
+    osd->scrub_rate_ctl.note_client_op(ceph::timespan(latency.to_nsec()));
+  }
 
   if (op.may_read() && op.may_write()) {
     osd->logger->inc(l_osd_op_rw);
@@ -12933,6 +13001,7 @@ void PrimaryLogPG::on_activate_complete()
 
   hit_set_setup();
   agent_setup();
+  seed_recovery_heat_from_hit_set();
 }
 
 void PrimaryLogPG::on_change(ObjectStore::Transaction &t)
@@ -13053,6 +13122,9 @@ void PrimaryLogPG::plpg_on_role_change()
     dout(10) << " clearing hit set" << dendl;
     hit_set_clear();
   }
+  if (get_role() != 0) {
+    recovery_heat.clear();
+  }
 }
 
 void PrimaryLogPG::plpg_on_pool_change()
@@ -13168,20 +13240,27 @@ bool PrimaryLogPG::start_recovery_ops(
     recovery_state.local_recovery_complete();
   }
 
-  if (!missing.have_missing() || // Primary does not have missing
-      // or all of the missing objects are unfound.
-      recovery_state.all_missing_unfound()) {
+  // objects clients are waiting for go first
+  refresh_recovery_heat_conf();
+  const uint64_t hot = recover_hot_objects(max, &recovery_started);
+  const uint64_t left = max - hot;
+
+  if (left &&
+      (!missing.have_missing() || // Primary does not have missing
+       // or all of the missing objects are unfound.
+       recovery_state.all_missing_unfound())) {
     // Recover the replicas.
-    started = recover_replicas(max, handle, &recovery_started);
+    started = recover_replicas(left, handle, &recovery_started);
   }
-  if (!started) {
+  if (left && !started) {
     // We still have missing objects that we should grab from replicas.
-    started += recover_primary(max, handle);
+    started += recover_primary(left, handle);
   }
-  if (!started && num_unfound != get_num_unfound()) {
+  if (left && !started && num_unfound != get_num_unfound()) {
     // second chance to recovery replicas
-    started = recover_replicas(max, handle, &recovery_started);
+    started = recover_replicas(left, handle, &recovery_started);
   }
+  started += hot;
 
   if (started || recovery_started)
     work_in_progress = true;
@@ -13292,6 +13371,91 @@ bool PrimaryLogPG::start_recovery_ops(
   return false;
 }
 
+/**
+ * start the recovery of the objects of recovery_heat, hottest first.
+ * return the number of ops started.
+ */
+uint64_t PrimaryLogPG::recover_hot_objects(uint64_t max, bool *work_started)
+{
+  if (max == 0 || recovery_heat.empty() || !recovery_heat_enabled) {
+    return 0;
+  }
+
+  const auto &missing = recovery_state.get_pg_log().get_missing();
+  const auto &missing_loc = recovery_state.get_missing_loc();
+  const auto &log_objects = recovery_state.get_pg_log().get_log().objects;
+  uint64_t started = 0;
+  PGBackend::RecoveryHandle *h = nullptr;
+
+  for (const auto& [soid, heat] :
+	 recovery_heat.hottest(ceph::mono_clock::now())) {
+    if (started >= max) {
+      break;
+    }
+    eversion_t v;
+    if (!missing_loc.needs_recovery(soid, &v)) {
+      recovery_heat.erase(soid);
+      continue;
+    }
+    if (recovering.count(soid) || missing_loc.is_unfound(soid)) {
+      continue;
+    }
+    const hobject_t head = soid.get_head();
+    if (missing.is_missing(soid)) {
+      if (recovering.count(head)) {
+	continue;
+      }
+      // reverts need the special handling of recover_primary()
+      if (auto p = log_objects.find(soid);
+	  p != log_objects.end() &&
+	  p->second->op == pg_log_entry_t::LOST_REVERT) {
+	continue;
+      }
+    } else if (!missing_loc.is_deleted(soid)) {
+      if (soid.is_snap() && missing.is_missing(head)) {
+	continue;
+      }
+      // objects beyond last_backfill are left to recover_backfill()
+      bool backfilling = false;
+      for (const auto& [peer, pm] : recovery_state.get_peer_missing()) {
+	if (pm.is_missing(soid) &&
+	    (!recovery_state.has_peer_info(peer) ||
+	     soid > recovery_state.get_peer_info(peer).last_backfill)) {
+	  backfilling = true;
+	  break;
+	}
+      }
+      if (backfilling) {
+	continue;
+      }
+    }
+
+    dout(10) << __func__ << ": " << soid << " v " << v
+	     << " heat " << heat << dendl;
+    if (!h) {
+      h = pgbackend->open_recovery_op();
+    }
+    uint64_t n = 0;
+    if (missing.is_missing(soid)) {
+      n = recover_missing(soid, v, get_recovery_op_priority(), h) ==
+	PULL_NONE ? 0 : 1;
+    } else if (missing_loc.is_deleted(soid)) {
+      n = prep_object_replica_deletes(soid, v, h, work_started);
+    } else {
+      n = prep_object_replica_pushes(soid, v, h, work_started);
+    }
+    started += n;
+  }
+
+  if (h) {
+    pgbackend->run_recovery_op(h, get_recovery_op_priority());
+  }
+  if (started) {
+    osd->logger->inc(l_osd_recovery_hot_started, started);
+  }
+  return started;
+}
+
 /**
  * do one recovery op.
  * return true if done, false if nothing left to do.
@@ -962,6 +962,18 @@ protected:
 				       utime_t end,
 				       bool using_gmt);
 
+  // recovery prioritization (osd_recovery_prioritize_hot_objects)
+  Recovery::ObjectHeat recovery_heat; ///< client accesses to degraded objects
+  // the options, not looked up for each op but on activation and on each
+  // round of recovery
+  bool recovery_heat_enabled = false;
+  uint64_t recovery_heat_max_objects = 1024;
+  double recovery_heat_half_life = 60;
+
+  void refresh_recovery_heat_conf();
+  void note_recovery_heat(const hobject_t& soid); ///< note a client access
+  void seed_recovery_heat_from_hit_set(); ///< heat up the objects in hit_set
+
   // agent
   boost::scoped_ptr<TierAgentState> agent_state;
 
@@ -1261,6 +1273,12 @@ protected:
   uint64_t recover_primary(uint64_t max, ThreadPool::TPHandle &handle);
   uint64_t recover_replicas(uint64_t max, ThreadPool::TPHandle &handle,
 		            bool *recovery_started);
+  /**
+   * recover the objects with the most client accesses first
+   * @param work_started will be set to true if an object is busy
+   * @returns the number of operations started
+   */
+  uint64_t recover_hot_objects(uint64_t max, bool *work_started);
   hobject_t earliest_peer_backfill() const;
   bool all_peer_done() const;
   /**
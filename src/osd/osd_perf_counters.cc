@@ -212,6 +212,12 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_u64_counter(
     l_osd_map_bl_cache_miss, "osd_map_bl_cache_miss",
     "OSDMap buffer cache misses");
+  osd_plb.add_u64_counter(
+    l_osd_map_shm_cache_hit, "osd_map_shm_cache_hit",
+    "Full OSDMaps taken from the ones shared by the OSDs of the host");
+  osd_plb.add_u64_counter(
+    l_osd_map_shm_cache_miss, "osd_map_shm_cache_miss",
+    "Full OSDMaps built from an incremental, not shared by the OSDs of the host");
 
   osd_plb.add_u64(
     l_osd_stat_bytes, "stat_bytes", "OSD size", "size",
@@ -278,6 +284,60 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_u64(
+    l_osd_scrub_rc_target_util, "scrub_rc_target_util",
+    "Scrub rate control: target device utilization (percent)");
+  osd_plb.add_u64(
+    l_osd_scrub_rc_observed_util, "scrub_rc_observed_util",
+    "Scrub rate control: observed device utilization (percent)");
+  osd_plb.add_u64(
+    l_osd_scrub_rc_queue_depth, "scrub_rc_queue_depth",
+    "Scrub rate control: observed device queue depth");
+  osd_plb.add_time(
+    l_osd_scrub_rc_client_lat, "scrub_rc_client_lat",
+    "Scrub rate control: observed client op latency");
+  osd_plb.add_u64(
+    l_osd_scrub_rc_chunk_ratio, "scrub_rc_chunk_ratio",
+    "Scrub rate control: used fraction of the max chunk size (percent)");
+  osd_plb.add_time(
+    l_osd_scrub_rc_sleep, "scrub_rc_sleep",
+    "Scrub rate control: delay between scrub chunks");
+  osd_plb.add_u64(
+    l_osd_scrub_rc_objects_per_sec, "scrub_rc_objects_per_sec",
+    "Scrub rate control: objects scrubbed per second");
+
+  osd_plb.add_u64_counter(
+    l_osd_ec_read_bytes_requested, "ec_read_bytes_requested",
+    "Bytes requested by erasure coded reads",
+    NULL, 0, unit_t(UNIT_BYTES));
+  osd_plb.add_u64_counter(
+    l_osd_ec_read_bytes, "ec_read_bytes",
+    "Bytes read from the shards by erasure coded reads",
+    NULL, 0, unit_t(UNIT_BYTES));
+  osd_plb.add_u64_counter(
+    l_osd_ec_read_partial, "ec_read_partial",
+    "Erasure coded object reads of only the needed data shard ranges");
+  osd_plb.add_u64_counter(
+    l_osd_ec_read_partial_retry, "ec_read_partial_retry",
+    "Erasure coded partial object reads retried as whole stripe reads");
+
+  osd_plb.add_u64_counter(
+    l_osd_recovery_hot_started, "recovery_hot_started",
+    "Recovery ops started ahead of the log order for accessed objects");
+  osd_plb.add_u64_counter(
+    l_osd_recovery_bw_throttled, "recovery_bw_throttled",
+    "Recovery starts deferred by the recovery bandwidth budget");
+
+  osd_plb.add_u64_counter(
+    l_osd_op_handoff_same_cpu, "op_handoff_same_cpu",
+    "Ops queued to a shard last running on the same CPU");
+  osd_plb.add_u64_counter(
+    l_osd_op_handoff_same_node, "op_handoff_same_node",
+    "Ops queued to a shard last running on another CPU of the same numa node");
+  osd_plb.add_u64_counter(
+    l_osd_op_handoff_cross_node, "op_handoff_cross_node",
+    "Ops queued to a shard last running on another numa node");
+
   return osd_plb.create_perf_counters();
 }
  
@@ -81,6 +81,8 @@ enum {
   l_osd_map_cache_miss_low_avg,
   l_osd_map_bl_cache_hit,
   l_osd_map_bl_cache_miss,
+  l_osd_map_shm_cache_hit,
+  l_osd_map_shm_cache_miss,
 
   l_osd_stat_bytes,
   l_osd_stat_bytes_used,
@@ -118,6 +120,26 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_scrub_rc_target_util,
+  l_osd_scrub_rc_observed_util,
+  l_osd_scrub_rc_queue_depth,
+  l_osd_scrub_rc_client_lat,
+  l_osd_scrub_rc_chunk_ratio,
+  l_osd_scrub_rc_sleep,
+  l_osd_scrub_rc_objects_per_sec,
+
+  l_osd_ec_read_bytes_requested,
+  l_osd_ec_read_bytes,
+  l_osd_ec_read_partial,
+  l_osd_ec_read_partial_retry,
+
+  l_osd_recovery_hot_started,
+  l_osd_recovery_bw_throttled,
+
+  l_osd_op_handoff_same_cpu,
+  l_osd_op_handoff_same_node,
+  l_osd_op_handoff_cross_node,
+
   l_osd_last,
 };
 
@@ -590,8 +590,11 @@ bool PgScrubber::select_range()
   int min_idx = std::max<int64_t>(
     3, m_pg->get_cct()->_conf->osd_scrub_chunk_min / preemption_data.chunk_divisor());
 
-  int max_idx = std::max<int64_t>(min_idx, m_pg->get_cct()->_conf->osd_scrub_chunk_max /
-					     preemption_data.chunk_divisor());
+  // when pacing is feedback-driven, only a fraction of the configured max
+  // chunk size is used
+  int max_idx = std::max<int64_t>(
+    min_idx, m_pg->get_cct()->_conf->osd_scrub_chunk_max *
+	       m_osds->get_scrub_chunk_ratio() / preemption_data.chunk_divisor());
 
   dout(10) << __func__ << " Min: " << min_idx << " Max: " << max_idx
 	   << " Div: " << preemption_data.chunk_divisor() << dendl;
@@ -1163,6 +1166,7 @@ void PgScrubber::run_callbacks()
 
 void PgScrubber::maps_compare_n_cleanup()
 {
+  m_osds->scrub_rate_ctl.note_objects_scrubbed(m_primary_scrubmap.objects.size());
   scrub_compare_maps();
   m_start = m_end;
   run_callbacks();
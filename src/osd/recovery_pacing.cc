@@ -0,0 +1,147 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "recovery_pacing.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "common/Formatter.h"
+
+using namespace std::chrono;
+
+namespace Recovery {
+
+// ---- ObjectHeat ----
+
+void ObjectHeat::set_limits(size_t max, double hl)
+{
+  max_objects = std::max<size_t>(max, 1);
+  half_life = hl;
+}
+
+double ObjectHeat::decayed(const entry_t& e, ceph::mono_time now) const
+{
+  if (half_life <= 0 || now <= e.stamp) {
+    return e.score;
+  }
+  const double age = duration_cast<duration<double>>(now - e.stamp).count();
+  return e.score * std::exp2(-age / half_life);
+}
+
+void ObjectHeat::note_access(const hobject_t& soid, ceph::mono_time now)
+{
+  auto [it, inserted] = objects.try_emplace(soid);
+  it->second.score = decayed(it->second, now) + 1.0;
+  it->second.stamp = now;
+  if (inserted && objects.size() > max_objects) {
+    trim(now);
+  }
+}
+
+double ObjectHeat::get(const hobject_t& soid, ceph::mono_time now) const
+{
+  auto it = objects.find(soid);
+  return it == objects.end() ? 0.0 : decayed(it->second, now);
+}
+
+std::vector<std::pair<hobject_t, double>>
+ObjectHeat::hottest(ceph::mono_time now) const
+{
+  std::vector<std::pair<hobject_t, double>> ret;
+  ret.reserve(objects.size());
+  for (const auto& [soid, e] : objects) {
+    ret.emplace_back(soid, decayed(e, now));
+  }
+  // ties are broken by the hobject order, as the plain recovery would
+  std::stable_sort(ret.begin(), ret.end(),
+		   [](const auto& l, const auto& r) {
+		     return l.second > r.second;
+		   });
+  return ret;
+}
+
+void ObjectHeat::trim(ceph::mono_time now)
+{
+  std::vector<double> scores;
+  scores.reserve(objects.size());
+  for (const auto& [soid, e] : objects) {
+    scores.push_back(decayed(e, now));
+  }
+  // drop the coldest quarter in one go, so that we do not rescan the whole
+  // map on every insertion
+  const size_t drop = std::max<size_t>(objects.size() / 4, 1);
+  std::nth_element(scores.begin(), scores.begin() + (drop - 1), scores.end());
+  const double threshold = scores[drop - 1];
+  size_t dropped = 0;
+  for (auto it = objects.begin();
+       it != objects.end() && dropped < drop;) {
+    if (decayed(it->second, now) <= threshold) {
+      it = objects.erase(it);
+      ++dropped;
+    } else {
+      ++it;
+    }
+  }
+}
+
+// ---- BandwidthBudget ----
+
+void BandwidthBudget::set_rate(uint64_t bytes_per_sec)
+{
+  if (bytes_per_sec == rate) {
+    return;
+  }
+  if (rate == 0) {
+    // (re)enabled: start with a full bucket
+    tokens = bytes_per_sec * burst_seconds;
+    stamp = ceph::mono_clock::now();
+  }
+  rate = bytes_per_sec;
+  tokens = std::min(tokens, rate * burst_seconds);
+}
+
+void BandwidthBudget::refill(ceph::mono_time now)
+{
+  if (now > stamp) {
+    const double dt = duration_cast<duration<double>>(now - stamp).count();
+    tokens = std::min(tokens + dt * rate, rate * burst_seconds);
+    stamp = now;
+  }
+}
+
+void BandwidthBudget::charge(ceph::mono_time now, uint64_t bytes)
+{
+  if (!enabled()) {
+    return;
+  }
+  refill(now);
+  tokens -= bytes;
+  avg_object_size = std::max(
+    min_object_size,
+    ewma_alpha * bytes + (1.0 - ewma_alpha) * avg_object_size);
+}
+
+uint64_t BandwidthBudget::get_available(ceph::mono_time now,
+					uint64_t in_flight,
+					uint64_t max_ops)
+{
+  if (!enabled()) {
+    return max_ops;
+  }
+  refill(now);
+  const double room = tokens - in_flight * avg_object_size;
+  if (room <= 0) {
+    return 0;
+  }
+  return std::min<uint64_t>(std::ceil(room / avg_object_size), max_ops);
+}
+
+void BandwidthBudget::dump(ceph::Formatter* f) const
+{
+  f->dump_unsigned("rate", rate);
+  f->dump_float("tokens", tokens);
+  f->dump_float("avg_object_size", avg_object_size);
+}
+
+}  // namespace Recovery
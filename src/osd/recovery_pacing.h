@@ -0,0 +1,117 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "common/ceph_time.h"
+#include "common/hobject.h"
+
+namespace ceph {
+class Formatter;
+}
+
+namespace Recovery {
+
+/**
+ * Tracks how often clients access the objects of a PG that still need
+ * recovery, so that the hottest ones can be recovered first.
+ *
+ * Each access adds 1 to the object's score; scores decay exponentially with
+ * the configured half-life. The number of tracked objects is bounded: when
+ * full, the coldest quarter of the entries is dropped.
+ *
+ * Not thread safe: used under the PG lock.
+ */
+class ObjectHeat {
+ public:
+  void set_limits(size_t max_objects, double half_life);
+
+  /// note a client access to 'soid'
+  void note_access(const hobject_t& soid, ceph::mono_time now);
+
+  /// the current (decayed) score of 'soid'. 0 if not tracked.
+  double get(const hobject_t& soid, ceph::mono_time now) const;
+
+  /// the tracked objects, hottest first
+  std::vector<std::pair<hobject_t, double>> hottest(ceph::mono_time now) const;
+
+  void erase(const hobject_t& soid) { objects.erase(soid); }
+  void clear() { objects.clear(); }
+  bool empty() const { return objects.empty(); }
+  size_t size() const { return objects.size(); }
+
+ private:
+  struct entry_t {
+    double score{0};
+    ceph::mono_time stamp;
+  };
+
+  double decayed(const entry_t& e, ceph::mono_time now) const;
+  void trim(ceph::mono_time now);
+
+  std::map<hobject_t, entry_t> objects;
+  size_t max_objects{1024};
+  double half_life{60.0};  ///< seconds
+};
+
+/**
+ * A token bucket limiting the bandwidth used by recovery and backfill on
+ * an OSD.
+ *
+ * The size of an object is only known once it was recovered, so the bucket
+ * is charged after the fact (and may go into debt). To bound what is
+ * started meanwhile, the ops already in flight are assumed to cost the
+ * average size of the recently recovered objects. New ops may start as
+ * long as the tokens cover that estimate; many small objects may thus be
+ * started at once, sharing the same push messages, where a single large one
+ * would use up the budget.
+ *
+ * Not thread safe: used under OSDService::recovery_lock.
+ */
+class BandwidthBudget {
+ public:
+  /// @param bytes_per_sec 0 - disabled
+  void set_rate(uint64_t bytes_per_sec);
+  uint64_t get_rate() const { return rate; }
+  bool enabled() const { return rate > 0; }
+
+  /// charge a completed recovery op
+  void charge(ceph::mono_time now, uint64_t bytes);
+
+  /**
+   * the number of recovery ops that may be started now
+   * @param in_flight ops started but not charged yet
+   * @param max_ops upper bound of the returned value
+   */
+  uint64_t get_available(ceph::mono_time now,
+			 uint64_t in_flight,
+			 uint64_t max_ops);
+
+  double get_tokens() const { return tokens; }
+  double get_avg_object_size() const { return avg_object_size; }
+
+  void dump(ceph::Formatter* f) const;
+
+ private:
+  /// the bucket holds at most this many seconds worth of tokens
+  static constexpr double burst_seconds = 1.0;
+  /// the size assumed for objects before any was recovered
+  static constexpr double initial_object_size = 4 << 20;
+  /// the smallest per-op estimate (deletes are 'free', but not quite)
+  static constexpr double min_object_size = 4096;
+  /// weight of a new sample in the average object size
+  static constexpr double ewma_alpha = 0.1;
+
+  void refill(ceph::mono_time now);
+
+  uint64_t rate{0};
+  double tokens{0};
+  double avg_object_size{initial_object_size};
+  ceph::mono_time stamp;
+};
+
+}  // namespace Recovery
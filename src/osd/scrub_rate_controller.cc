@@ -0,0 +1,134 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "scrub_rate_controller.h"
+
+#include <algorithm>
+
+#include "common/Formatter.h"
+
+using namespace std::chrono;
+
+namespace Scrub {
+
+namespace {
+double ewma(double prev, double sample, double alpha)
+{
+  return alpha * sample + (1.0 - alpha) * prev;
+}
+}  // namespace
+
+void RateController::note_client_op(ceph::timespan latency)
+{
+  client_lat_ns += duration_cast<nanoseconds>(latency).count();
+  ++client_ops;
+}
+
+void RateController::note_objects_scrubbed(uint64_t n)
+{
+  objects_scrubbed += n;
+}
+
+void RateController::update(ceph::mono_time now,
+			    const device_stats_t* dev,
+			    const targets_t& targets)
+{
+  std::lock_guard l{lock};
+
+  const uint64_t ops = client_ops;
+  const uint64_t lat_ns = client_lat_ns;
+  const uint64_t objs = objects_scrubbed;
+  target_util = targets.device_util;
+
+  if (!have_prev) {
+    have_prev = true;
+    prev_stamp = now;
+    if (dev) {
+      prev_dev = *dev;
+    }
+    prev_client_ops = ops;
+    prev_client_lat_ns = lat_ns;
+    prev_objects = objs;
+    return;
+  }
+
+  const double dt = duration_cast<duration<double>>(now - prev_stamp).count();
+  if (dt <= 0) {
+    return;
+  }
+
+  // sample the signals
+  double util = observed_util;
+  double qd = observed_qd;
+  if (dev) {
+    const double dt_ns = dt * 1e9;
+    util = ewma(util,
+		std::min(1.0, (dev->busy_ns - prev_dev.busy_ns) / dt_ns),
+		ewma_alpha);
+    qd = ewma(qd, (dev->weighted_ns - prev_dev.weighted_ns) / dt_ns,
+	      ewma_alpha);
+    if (dev->completed > prev_dev.completed) {
+      // Little's law
+      observed_dev_lat = ewma(
+	observed_dev_lat,
+	(dev->weighted_ns - prev_dev.weighted_ns) / 1e9 /
+	  (dev->completed - prev_dev.completed),
+	ewma_alpha);
+    }
+    prev_dev = *dev;
+  }
+
+  double client_lat = observed_client_lat;
+  if (ops > prev_client_ops) {
+    client_lat = ewma(client_lat,
+		      (lat_ns - prev_client_lat_ns) / 1e9 /
+			(ops - prev_client_ops),
+		      ewma_alpha);
+  }
+  prev_client_ops = ops;
+  prev_client_lat_ns = lat_ns;
+
+  objects_per_sec =
+    ewma(objects_per_sec, (objs - prev_objects) / dt, ewma_alpha);
+  prev_objects = objs;
+  prev_stamp = now;
+
+  // the 'pressure' is the worst of the observed/target ratios
+  double pressure = 0.0;
+  if (dev && targets.device_util > 0) {
+    pressure = std::max(pressure, util / targets.device_util);
+  }
+  if (targets.client_lat > 0) {
+    pressure = std::max(pressure, client_lat / targets.client_lat);
+  }
+
+  if (pressure > 1.0) {
+    throttle *= std::max(max_backoff, 1.0 / pressure);
+  } else {
+    throttle = std::min(1.0, throttle + increase_step * (1.0 - pressure));
+  }
+
+  const double min_ratio = std::clamp(targets.min_chunk_ratio, 0.0, 1.0);
+  chunk_ratio = min_ratio + (1.0 - min_ratio) * throttle;
+  sleep = std::max(0.0, targets.max_sleep) * (1.0 - throttle);
+  observed_util = util;
+  observed_qd = qd;
+  observed_client_lat = client_lat;
+}
+
+void RateController::dump(ceph::Formatter* f) const
+{
+  std::lock_guard l{lock};
+  f->dump_float("target_device_util", target_util);
+  f->dump_float("observed_device_util", observed_util);
+  f->dump_float("observed_queue_depth", observed_qd);
+  f->dump_float("observed_device_lat", observed_dev_lat);
+  f->dump_float("observed_client_lat", observed_client_lat);
+  f->dump_float("throttle", throttle);
+  f->dump_float("chunk_ratio", chunk_ratio);
+  f->dump_float("sleep", sleep);
+  f->dump_float("objects_per_sec", objects_per_sec);
+  f->dump_unsigned("objects_scrubbed", objects_scrubbed);
+}
+
+}  // namespace Scrub
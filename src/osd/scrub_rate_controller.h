@@ -0,0 +1,114 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
+
+namespace ceph {
+class Formatter;
+}
+
+namespace Scrub {
+
+/**
+ * A feedback loop pacing all the scrubs of an OSD.
+ *
+ * The controller is fed with:
+ * - cumulative io accounting of the data device (see
+ *   ObjectStore::get_device_io_stats()), from which the device utilization
+ *   (fraction of wall time with io in flight), the average queue depth and
+ *   the average device latency are derived;
+ * - the latencies of completed client ops;
+ * - the number of objects scrubbed.
+ *
+ * Once per OSD tick, update() compares the observed device utilization and
+ * client op latency to their targets and adjusts a single 'throttle' knob in
+ * [0, 1] (AIMD: multiplicative backoff when over target, additive increase
+ * when under target). The knob is translated into:
+ * - the fraction of osd_scrub_chunk_max to use when selecting a chunk;
+ * - the delay to inject between consecutive chunks.
+ *
+ * The getters used by the scrubbers are lockless.
+ */
+class RateController {
+ public:
+  /// cumulative counters, as reported by BlockDevice::get_io_stats()
+  struct device_stats_t {
+    uint64_t busy_ns{0};
+    uint64_t weighted_ns{0};
+    uint64_t completed{0};
+    uint64_t inflight{0};
+  };
+
+  struct targets_t {
+    double device_util{0.6};  ///< 0 - ignore device utilization
+    double client_lat{0};     ///< seconds. 0 - ignore client op latency
+    double max_sleep{1.0};    ///< seconds, injected when fully throttled
+    double min_chunk_ratio{0.1};
+  };
+
+  /// lockless. Called on every completed client op.
+  void note_client_op(ceph::timespan latency);
+
+  /// lockless. Called by the scrubbers once a chunk was compared.
+  void note_objects_scrubbed(uint64_t n);
+
+  /**
+   * recompute the throttle, given a new sample of the device counters.
+   * @param dev nullptr if the object store does not report device stats
+   */
+  void update(ceph::mono_time now,
+	      const device_stats_t* dev,
+	      const targets_t& targets);
+
+  /// the fraction of the configured max chunk size to use
+  double get_chunk_ratio() const { return chunk_ratio; }
+
+  /// seconds to sleep between chunks
+  double get_sleep() const { return sleep; }
+
+  double get_observed_device_util() const { return observed_util; }
+  double get_observed_queue_depth() const { return observed_qd; }
+  double get_observed_client_lat() const { return observed_client_lat; }
+  double get_objects_per_sec() const { return objects_per_sec; }
+  double get_target_device_util() const { return target_util; }
+
+  void dump(ceph::Formatter* f) const;
+
+ private:
+  /// weight of a new sample in the exponentially-weighted averages
+  static constexpr double ewma_alpha = 0.5;
+  /// added to the throttle knob on each non-congested tick
+  static constexpr double increase_step = 0.05;
+  /// the largest single multiplicative backoff
+  static constexpr double max_backoff = 0.5;
+
+  std::atomic<uint64_t> client_ops{0};
+  std::atomic<uint64_t> client_lat_ns{0};
+  std::atomic<uint64_t> objects_scrubbed{0};
+
+  mutable ceph::mutex lock = ceph::make_mutex("Scrub::RateController::lock");
+  bool have_prev{false};
+  ceph::mono_time prev_stamp;
+  device_stats_t prev_dev;
+  uint64_t prev_client_ops{0};
+  uint64_t prev_client_lat_ns{0};
+  uint64_t prev_objects{0};
+  double throttle{1.0};  ///< 1 - full speed, 0 - slowest pace
+  double observed_dev_lat{0};
+
+  // published values (read without the lock)
+  std::atomic<double> chunk_ratio{1.0};
+  std::atomic<double> sleep{0.0};
+  std::atomic<double> observed_util{0.0};
+  std::atomic<double> observed_qd{0.0};
+  std::atomic<double> observed_client_lat{0.0};
+  std::atomic<double> objects_per_sec{0.0};
+  std::atomic<double> target_util{0.0};
+};
+
+}  // namespace Scrub
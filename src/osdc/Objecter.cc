@@ -174,6 +174,10 @@ enum {
   l_osdc_osdop_omap_rd,
   l_osdc_osdop_omap_del,
 
+  l_osdc_pg_mapping_hit,
+  l_osdc_pg_mapping_miss,
+  l_osdc_pg_mapping_invalidated,
+
   l_osdc_last,
 };
 
@@ -369,6 +373,14 @@ void Objecter::init()
     pcb.add_u64_counter(l_osdc_osdop_omap_del, "omap_del",
 			"OSD OMAP delete operations");
 
+    pcb.add_u64_counter(l_osdc_pg_mapping_hit, "pg_mapping_hit",
+			"PG mappings found in the cache");
+    pcb.add_u64_counter(l_osdc_pg_mapping_miss, "pg_mapping_miss",
+			"PG mappings computed");
+    pcb.add_u64_counter(l_osdc_pg_mapping_invalidated,
+			"pg_mapping_invalidated",
+			"Cached PG mappings dropped by new OSD maps");
+
     logger = pcb.create_perf_counters();
     cct->get_perfcounters_collection()->add(logger);
   }
@@ -393,6 +405,18 @@ void Objecter::init()
   initialized = true;
 }
 
+void Objecter::invalidate_pg_mapping(const OSDMap::Incremental& inc)
+{
+  uint64_t dropped;
+  {
+    std::lock_guard l{pg_mapping_lock};
+    dropped = pg_mappings.invalidate(*osdmap, inc);
+  }
+  ldout(cct, 20) << __func__ << " epoch " << inc.epoch << " dropped "
+		 << dropped << " pg mappings" << dendl;
+  logger->inc(l_osdc_pg_mapping_invalidated, dropped);
+}
+
 /*
  * ok, cluster interaction can happen
  */
@@ -403,7 +427,7 @@ void Objecter::start(const OSDMap* o)
   start_tick();
   if (o) {
     osdmap->deepish_copy_from(*o);
-    prune_pg_mapping(osdmap->get_pools());
+    prune_pg_mapping(true);
   } else if (osdmap->get_epoch() == 0) {
     _maybe_request_map();
   }
@@ -526,7 +550,7 @@ void Objecter::shutdown()
 }
 
 void Objecter::_send_linger(LingerOp *info,
-			    ceph::shunique_lock<ceph::shared_mutex>& sul)
+			    ceph::shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   ceph_assert(sul.owns_lock() && sul.mutex() == &rwlock);
 
@@ -860,7 +884,7 @@ ceph_tid_t Objecter::linger_notify(LingerOp *info,
 }
 
 void Objecter::_linger_submit(LingerOp *info,
-			      ceph::shunique_lock<ceph::shared_mutex>& sul)
+			      ceph::shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   ceph_assert(sul.owns_lock() && sul.mutex() == &rwlock);
   ceph_assert(info->linger_id);
@@ -1023,7 +1047,7 @@ void Objecter::_scan_requests(
   map<ceph_tid_t, Op*>& need_resend,
   list<LingerOp*>& need_resend_linger,
   map<ceph_tid_t, CommandOp*>& need_resend_command,
-  ceph::shunique_lock<ceph::shared_mutex>& sul)
+  ceph::shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   ceph_assert(sul.owns_lock() && sul.mutex() == &rwlock);
 
@@ -1184,7 +1208,9 @@ void Objecter::handle_osd_map(MOSDMap *m)
 	  ldout(cct, 3) << "handle_osd_map decoding incremental epoch " << e
 			<< dendl;
 	  OSDMap::Incremental inc(m->incremental_maps[e]);
+	  invalidate_pg_mapping(inc);
 	  osdmap->apply_incremental(inc);
+	  prune_pg_mapping(false);
 
           emit_blocklist_events(inc);
 
@@ -1197,6 +1223,7 @@ void Objecter::handle_osd_map(MOSDMap *m)
 
           emit_blocklist_events(*osdmap, *new_osdmap);
           osdmap = std::move(new_osdmap);
+	  prune_pg_mapping(true);
 
 	  logger->inc(l_osdc_map_full);
 	}
@@ -1216,7 +1243,6 @@ void Objecter::handle_osd_map(MOSDMap *m)
 	}
 	logger->set(l_osdc_map_epoch, osdmap->get_epoch());
 
-        prune_pg_mapping(osdmap->get_pools());
 	cluster_full = cluster_full || _osdmap_full_flag();
 	update_pool_full_map(pool_full_map);
 
@@ -1257,7 +1283,7 @@ void Objecter::handle_osd_map(MOSDMap *m)
 	ldout(cct, 3) << "handle_osd_map decoding full epoch "
 		      << m->get_last() << dendl;
 	osdmap->decode(m->maps[m->get_last()]);
-        prune_pg_mapping(osdmap->get_pools());
+        prune_pg_mapping(true);
 
 	_scan_requests(homeless_session, false, false, NULL,
 		       need_resend, need_resend_linger,
@@ -1761,7 +1787,7 @@ void Objecter::_command_cancel_map_check(CommandOp *c)
  * promotion to write.
  */
 int Objecter::_get_session(int osd, OSDSession **session,
-			   shunique_lock<ceph::shared_mutex>& sul)
+			   shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   ceph_assert(sul && sul.mutex() == &rwlock);
 
@@ -1916,7 +1942,7 @@ void Objecter::wait_for_osd_map(epoch_t e)
 
 void Objecter::_get_latest_version(epoch_t oldest, epoch_t newest,
 				   std::unique_ptr<OpCompletion> fin,
-				   std::unique_lock<ceph::shared_mutex>&& l)
+				   std::unique_lock<ceph::sharded_shared_mutex>&& l)
 {
   ceph_assert(fin);
   if (osdmap->get_epoch() >= newest) {
@@ -2038,7 +2064,7 @@ void Objecter::_kick_requests(OSDSession *session,
 }
 
 void Objecter::_linger_ops_resend(map<uint64_t, LingerOp *>& lresend,
-				  unique_lock<ceph::shared_mutex>& ul)
+				  unique_lock<ceph::sharded_shared_mutex>& ul)
 {
   ceph_assert(ul.owns_lock());
   shunique_lock sul(std::move(ul));
@@ -2199,7 +2225,7 @@ void Objecter::op_submit(Op *op, ceph_tid_t *ptid, int *ctx_budget)
 }
 
 void Objecter::_op_submit_with_budget(Op *op,
-				      shunique_lock<ceph::shared_mutex>& sul,
+				      shunique_lock<ceph::sharded_shared_mutex>& sul,
 				      ceph_tid_t *ptid,
 				      int *ctx_budget)
 {
@@ -2303,7 +2329,7 @@ void Objecter::_send_op_account(Op *op)
   }
 }
 
-void Objecter::_op_submit(Op *op, shunique_lock<ceph::shared_mutex>& sul, ceph_tid_t *ptid)
+void Objecter::_op_submit(Op *op, shunique_lock<ceph::sharded_shared_mutex>& sul, ceph_tid_t *ptid)
 {
   // rwlock is locked
 
@@ -2761,20 +2787,18 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
   vector<int> up, acting;
   ps_t actual_ps = ceph_stable_mod(pgid.ps(), pg_num, pg_num_mask);
   pg_t actual_pgid(actual_ps, pgid.pool());
-  pg_mapping_t pg_mapping;
-  pg_mapping.epoch = osdmap->get_epoch();
+  LazyOSDMapMapping::mapping_t pg_mapping;
   if (lookup_pg_mapping(actual_pgid, &pg_mapping)) {
-    up = pg_mapping.up;
-    up_primary = pg_mapping.up_primary;
-    acting = pg_mapping.acting;
-    acting_primary = pg_mapping.acting_primary;
+    logger->inc(l_osdc_pg_mapping_hit);
   } else {
-    osdmap->pg_to_up_acting_osds(actual_pgid, &up, &up_primary,
-                                 &acting, &acting_primary);
-    pg_mapping_t pg_mapping(osdmap->get_epoch(),
-                            up, up_primary, acting, acting_primary);
-    update_pg_mapping(actual_pgid, std::move(pg_mapping));
-  }
+    logger->inc(l_osdc_pg_mapping_miss);
+    LazyOSDMapMapping::calc(*osdmap, actual_pgid, &pg_mapping);
+    update_pg_mapping(actual_pgid, LazyOSDMapMapping::mapping_t(pg_mapping));
+  }
+  up = std::move(pg_mapping.up);
+  up_primary = pg_mapping.up_primary;
+  acting = std::move(pg_mapping.acting);
+  acting_primary = pg_mapping.acting_primary;
   bool sort_bitwise = osdmap->test_flag(CEPH_OSDMAP_SORTBITWISE);
   bool recovery_deletes = osdmap->test_flag(CEPH_OSDMAP_RECOVERY_DELETES);
   unsigned prev_seed = ceph_stable_mod(pgid.ps(), t->pg_num, t->pg_num_mask);
@@ -2922,7 +2946,7 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
 }
 
 int Objecter::_map_session(op_target_t *target, OSDSession **s,
-			   shunique_lock<ceph::shared_mutex>& sul)
+			   shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   _calc_target(target, nullptr);
   return _get_session(target->osd, s, sul);
@@ -3029,7 +3053,7 @@ void Objecter::_session_command_op_assign(OSDSession *to, CommandOp *op)
 }
 
 int Objecter::_recalc_linger_op_target(LingerOp *linger_op,
-				       shunique_lock<ceph::shared_mutex>& sul)
+				       shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   // rwlock is locked unique
 
@@ -3246,7 +3270,7 @@ int Objecter::calc_op_budget(const bc::small_vector_base<OSDOp>& ops)
 }
 
 void Objecter::_throttle_op(Op *op,
-			    shunique_lock<ceph::shared_mutex>& sul,
+			    shunique_lock<ceph::sharded_shared_mutex>& sul,
 			    int op_budget)
 {
   ceph_assert(sul && sul.mutex() == &rwlock);
@@ -4759,7 +4783,7 @@ void Objecter::submit_command(CommandOp *c, ceph_tid_t *ptid)
 }
 
 int Objecter::_calc_command_target(CommandOp *c,
-				   shunique_lock<ceph::shared_mutex>& sul)
+				   shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   ceph_assert(sul.owns_lock() && sul.mutex() == &rwlock);
 
@@ -4815,7 +4839,7 @@ int Objecter::_calc_command_target(CommandOp *c,
 }
 
 void Objecter::_assign_command_session(CommandOp *c,
-				       shunique_lock<ceph::shared_mutex>& sul)
+				       shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   ceph_assert(sul.owns_lock() && sul.mutex() == &rwlock);
 
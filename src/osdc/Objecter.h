@@ -47,6 +47,7 @@
 #include "common/ceph_mutex.h"
 #include "common/ceph_timer.h"
 #include "common/config_obs.h"
+#include "common/sharded_shared_mutex.h"
 #include "common/shunique_lock.h"
 #include "common/zipkin_trace.h"
 #include "common/Throttle.h"
@@ -57,6 +58,7 @@
 #include "msg/Dispatcher.h"
 
 #include "osd/OSDMap.h"
+#include "osd/OSDMapMapping.h"
 
 class Context;
 class Messenger;
@@ -1658,62 +1660,31 @@ private:
   // to be drained by consume_blocklist_events.
   bool blocklist_events_enabled = false;
   std::set<entity_addr_t> blocklist_events;
-  struct pg_mapping_t {
-    epoch_t epoch = 0;
-    std::vector<int> up;
-    int up_primary = -1;
-    std::vector<int> acting;
-    int acting_primary = -1;
-
-    pg_mapping_t() {}
-    pg_mapping_t(epoch_t epoch, std::vector<int> up, int up_primary,
-                 std::vector<int> acting, int acting_primary)
-               : epoch(epoch), up(up), up_primary(up_primary),
-                 acting(acting), acting_primary(acting_primary) {}
-  };
-  ceph::shared_mutex pg_mapping_lock =
-    ceph::make_shared_mutex("Objecter::pg_mapping_lock");
-  // pool -> pg mapping
-  std::map<int64_t, std::vector<pg_mapping_t>> pg_mappings;
+  ceph::sharded_shared_mutex pg_mapping_lock =
+    ceph::make_sharded_shared_mutex("Objecter::pg_mapping_lock");
+  // the PGs mapped so far, kept across epochs
+  LazyOSDMapMapping pg_mappings;
 
   // convenient accessors
-  bool lookup_pg_mapping(const pg_t& pg, pg_mapping_t* pg_mapping) {
+  bool lookup_pg_mapping(const pg_t& pg,
+			 LazyOSDMapMapping::mapping_t* pg_mapping) {
     std::shared_lock l{pg_mapping_lock};
-    auto it = pg_mappings.find(pg.pool());
-    if (it == pg_mappings.end())
-      return false;
-    auto& mapping_array = it->second;
-    if (pg.ps() >= mapping_array.size())
-      return false;
-    if (mapping_array[pg.ps()].epoch != pg_mapping->epoch) // stale
-      return false;
-    *pg_mapping = mapping_array[pg.ps()];
-    return true;
+    return pg_mappings.get(pg, pg_mapping);
   }
-  void update_pg_mapping(const pg_t& pg, pg_mapping_t&& pg_mapping) {
+  void update_pg_mapping(const pg_t& pg,
+			 LazyOSDMapMapping::mapping_t&& pg_mapping) {
     std::lock_guard l{pg_mapping_lock};
-    auto& mapping_array = pg_mappings[pg.pool()];
-    ceph_assert(pg.ps() < mapping_array.size());
-    mapping_array[pg.ps()] = std::move(pg_mapping);
+    pg_mappings.set(pg, std::move(pg_mapping));
   }
-  void prune_pg_mapping(const mempool::osdmap::map<int64_t,pg_pool_t>& pools) {
+  // before applying an incremental to osdmap
+  void invalidate_pg_mapping(const OSDMap::Incremental& inc);
+  // after a new osdmap, or an incremental, was applied
+  void prune_pg_mapping(bool new_map) {
     std::lock_guard l{pg_mapping_lock};
-    for (auto& pool : pools) {
-      auto& mapping_array = pg_mappings[pool.first];
-      size_t pg_num = pool.second.get_pg_num();
-      if (mapping_array.size() != pg_num) {
-        // catch both pg_num increasing & decreasing
-        mapping_array.resize(pg_num);
-      }
-    }
-    for (auto it = pg_mappings.begin(); it != pg_mappings.end(); ) {
-      if (!pools.count(it->first)) {
-        // pool is gone
-        pg_mappings.erase(it++);
-        continue;
-      }
-      it++;
+    if (new_map) {
+      pg_mappings.clear();
     }
+    pg_mappings.update_pools(*osdmap);
   }
 
 public:
@@ -1727,8 +1698,9 @@ private:
   version_t last_seen_osdmap_version = 0;
   version_t last_seen_pgmap_version = 0;
 
-  mutable ceph::shared_mutex rwlock =
-	   ceph::make_shared_mutex("Objecter::rwlock");
+  // taken shared by each op submitted, from any number of threads
+  mutable ceph::sharded_shared_mutex rwlock =
+	   ceph::make_sharded_shared_mutex("Objecter::rwlock");
   ceph::timer<ceph::coarse_mono_clock> timer;
 
   PerfCounters* logger = nullptr;
@@ -2240,9 +2212,9 @@ public:
 
   void submit_command(CommandOp *c, ceph_tid_t *ptid);
   int _calc_command_target(CommandOp *c,
-			   ceph::shunique_lock<ceph::shared_mutex> &sul);
+			   ceph::shunique_lock<ceph::sharded_shared_mutex> &sul);
   void _assign_command_session(CommandOp *c,
-			       ceph::shunique_lock<ceph::shared_mutex> &sul);
+			       ceph::shunique_lock<ceph::sharded_shared_mutex> &sul);
   void _send_command(CommandOp *c);
   int command_op_cancel(OSDSession *s, ceph_tid_t tid,
 			boost::system::error_code ec);
@@ -2475,7 +2447,7 @@ public:
   int _calc_target(op_target_t *t, Connection *con,
 		   bool any_change = false);
   int _map_session(op_target_t *op, OSDSession **s,
-		   ceph::shunique_lock<ceph::shared_mutex>& lc);
+		   ceph::shunique_lock<ceph::sharded_shared_mutex>& lc);
 
   void _session_op_assign(OSDSession *s, Op *op);
   void _session_op_remove(OSDSession *s, Op *op);
@@ -2484,16 +2456,16 @@ public:
   void _session_command_op_assign(OSDSession *to, CommandOp *op);
   void _session_command_op_remove(OSDSession *from, CommandOp *op);
 
-  int _assign_op_target_session(Op *op, ceph::shunique_lock<ceph::shared_mutex>& lc,
+  int _assign_op_target_session(Op *op, ceph::shunique_lock<ceph::sharded_shared_mutex>& lc,
 				bool src_session_locked,
 				bool dst_session_locked);
   int _recalc_linger_op_target(LingerOp *op,
-			       ceph::shunique_lock<ceph::shared_mutex>& lc);
+			       ceph::shunique_lock<ceph::sharded_shared_mutex>& lc);
 
   void _linger_submit(LingerOp *info,
-		      ceph::shunique_lock<ceph::shared_mutex>& sul);
+		      ceph::shunique_lock<ceph::sharded_shared_mutex>& sul);
   void _send_linger(LingerOp *info,
-		    ceph::shunique_lock<ceph::shared_mutex>& sul);
+		    ceph::shunique_lock<ceph::sharded_shared_mutex>& sul);
   void _linger_commit(LingerOp *info, boost::system::error_code ec,
 		      ceph::buffer::list& outbl);
   void _linger_reconnect(LingerOp *info, boost::system::error_code ec);
@@ -2525,10 +2497,10 @@ private:
 
   void _kick_requests(OSDSession *session, std::map<uint64_t, LingerOp *>& lresend);
   void _linger_ops_resend(std::map<uint64_t, LingerOp *>& lresend,
-			  std::unique_lock<ceph::shared_mutex>& ul);
+			  std::unique_lock<ceph::sharded_shared_mutex>& ul);
 
   int _get_session(int osd, OSDSession **session,
-		   ceph::shunique_lock<ceph::shared_mutex>& sul);
+		   ceph::shunique_lock<ceph::sharded_shared_mutex>& sul);
   void put_session(OSDSession *s);
   void get_session(OSDSession *s);
   void _reopen_session(OSDSession *session);
@@ -2546,9 +2518,9 @@ private:
    * If throttle_op needs to throttle it will unlock client_lock.
    */
   int calc_op_budget(const boost::container::small_vector_base<OSDOp>& ops);
-  void _throttle_op(Op *op, ceph::shunique_lock<ceph::shared_mutex>& sul,
+  void _throttle_op(Op *op, ceph::shunique_lock<ceph::sharded_shared_mutex>& sul,
 		    int op_size = 0);
-  int _take_op_budget(Op *op, ceph::shunique_lock<ceph::shared_mutex>& sul) {
+  int _take_op_budget(Op *op, ceph::shunique_lock<ceph::sharded_shared_mutex>& sul) {
     ceph_assert(sul && sul.mutex() == &rwlock);
     int op_budget = calc_op_budget(op->ops);
     if (keep_balanced_budget) {
@@ -2622,7 +2594,7 @@ private:
     std::map<ceph_tid_t, Op*>& need_resend,
     std::list<LingerOp*>& need_resend_linger,
     std::map<ceph_tid_t, CommandOp*>& need_resend_command,
-    ceph::shunique_lock<ceph::shared_mutex>& sul);
+    ceph::shunique_lock<ceph::sharded_shared_mutex>& sul);
 
   int64_t get_object_hash_position(int64_t pool, const std::string& key,
 				   const std::string& ns);
@@ -2701,10 +2673,10 @@ private:
                              const OSDMap &new_osd_map);
 
   // low-level
-  void _op_submit(Op *op, ceph::shunique_lock<ceph::shared_mutex>& lc,
+  void _op_submit(Op *op, ceph::shunique_lock<ceph::sharded_shared_mutex>& lc,
 		  ceph_tid_t *ptid);
   void _op_submit_with_budget(Op *op,
-			      ceph::shunique_lock<ceph::shared_mutex>& lc,
+			      ceph::shunique_lock<ceph::sharded_shared_mutex>& lc,
 			      ceph_tid_t *ptid,
 			      int *ctx_budget = NULL);
   // public interface
@@ -2822,7 +2794,7 @@ public:
 
   void _get_latest_version(epoch_t oldest, epoch_t neweset,
 			   std::unique_ptr<OpCompletion> fin,
-			   std::unique_lock<ceph::shared_mutex>&& ul);
+			   std::unique_lock<ceph::sharded_shared_mutex>&& ul);
 
   /** Get the current set of global op flags */
   int get_global_op_flags() const { return global_op_flags; }
@@ -70,3 +70,14 @@ TEST(cpu_set, round_trip_list)
   }
 }
 
+
+TEST(cpu_set, round_robin_cpu)
+{
+  ASSERT_EQ(-1, get_round_robin_cpu("", 0));
+  ASSERT_EQ(-1, get_round_robin_cpu("a", 0));
+  ASSERT_EQ(0, get_round_robin_cpu("0-3,8", 0));
+  ASSERT_EQ(3, get_round_robin_cpu("0-3,8", 3));
+  ASSERT_EQ(8, get_round_robin_cpu("0-3,8", 4));
+  ASSERT_EQ(0, get_round_robin_cpu("0-3,8", 5));
+  ASSERT_EQ(5, get_round_robin_cpu("5", 7));
+}
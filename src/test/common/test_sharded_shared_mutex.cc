@@ -0,0 +1,123 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <future>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "common/sharded_shared_mutex.h"
+#include "common/shunique_lock.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+bool try_lock_elsewhere(ceph::sharded_shared_mutex& sm) {
+  return std::async(std::launch::async, [&sm] {
+    if (!sm.try_lock()) {
+      return false;
+    }
+    sm.unlock();
+    return true;
+  }).get();
+}
+
+bool try_lock_shared_elsewhere(ceph::sharded_shared_mutex& sm) {
+  return std::async(std::launch::async, [&sm] {
+    if (!sm.try_lock_shared()) {
+      return false;
+    }
+    sm.unlock_shared();
+    return true;
+  }).get();
+}
+
+} // anonymous namespace
+
+TEST(ShardedSharedMutex, Conflicts)
+{
+  auto sm = ceph::make_sharded_shared_mutex("ShardedSharedMutex::Conflicts");
+  {
+    std::shared_lock l(sm);
+    ASSERT_FALSE(try_lock_elsewhere(sm));
+    ASSERT_TRUE(try_lock_shared_elsewhere(sm));
+  }
+  {
+    std::unique_lock l(sm);
+    ASSERT_FALSE(try_lock_elsewhere(sm));
+    ASSERT_FALSE(try_lock_shared_elsewhere(sm));
+  }
+  ASSERT_TRUE(try_lock_elsewhere(sm));
+  ASSERT_TRUE(try_lock_shared_elsewhere(sm));
+}
+
+TEST(ShardedSharedMutex, SharedFromManyThreads)
+{
+  // the readers of all the shards keep a writer out
+  auto sm = ceph::make_sharded_shared_mutex("ShardedSharedMutex::Many");
+  constexpr int nthreads = 40;
+  std::vector<std::thread> readers;
+  std::vector<std::promise<void>> locked(nthreads);
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  for (int i = 0; i < nthreads; ++i) {
+    readers.emplace_back([&sm, &locked, released, i] {
+      ceph::shunique_lock l(sm, ceph::acquire_shared);
+      locked[i].set_value();
+      released.wait();
+    });
+  }
+  for (auto& p : locked) {
+    p.get_future().wait();
+  }
+  ASSERT_FALSE(try_lock_elsewhere(sm));
+  ASSERT_TRUE(try_lock_shared_elsewhere(sm));
+  release.set_value();
+  for (auto& t : readers) {
+    t.join();
+  }
+  ASSERT_TRUE(try_lock_elsewhere(sm));
+}
+
+TEST(ShardedSharedMutex, Counter)
+{
+  // the writers exclude each other, and the readers
+  auto sm = ceph::make_sharded_shared_mutex("ShardedSharedMutex::Counter");
+  uint64_t counter = 0;
+  constexpr int nthreads = 8;
+  constexpr int rounds = 10000;
+  std::atomic<bool> torn = false;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < nthreads; ++i) {
+    threads.emplace_back([&] {
+      for (int r = 0; r < rounds; ++r) {
+	if (r % 4 == 0) {
+	  std::unique_lock l(sm);
+	  counter++;
+	  counter++;
+	} else {
+	  std::shared_lock l(sm);
+	  if (counter % 2) {
+	    torn = true;
+	  }
+	}
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_FALSE(torn);
+  ASSERT_EQ(2u * nthreads * (rounds / 4), counter);
+}
@@ -9,8 +9,11 @@
  */
 
 #include <gtest/gtest.h>
+#include <chrono>
 #include <iostream>
 #include <memory>
+#include <numeric>
+#include <random>
 #include <set>
 
 #include "common/ceph_argparse.h"
@@ -656,3 +659,161 @@ TEST_F(CRUSHTest, straw2_reweight) {
     cout << "     vs " << estddev << std::endl;
   }
 }
+
+namespace {
+
+// a root of straw2 hosts of straw2 osds, with all sorts of weights
+std::unique_ptr<CrushWrapper> build_straw2_map(std::mt19937& rng,
+					       int num_host, int num_osd)
+{
+  std::unique_ptr<CrushWrapper> c(new CrushWrapper);
+  c->create();
+  c->set_tunables_optimal();
+  c->set_type_name(2, "root");
+  c->set_type_name(1, "host");
+  c->set_type_name(0, "osd");
+  auto random_weight = [&rng] {
+    switch (rng() % 8) {
+    case 0:
+      return 0;
+    case 1:
+      return (int)(rng() & 0x7fffffff);  // huge
+    default:
+      return (int)(rng() % 0x40000);
+    }
+  };
+  std::vector<int> hosts, host_weights;
+  int osd = 0;
+  for (int h = 0; h < num_host; ++h) {
+    std::vector<int> items, weights;
+    for (int i = 0; i < num_osd; ++i) {
+      items.push_back(osd++);
+      weights.push_back(random_weight());
+    }
+    crush_bucket *b = crush_make_bucket(c->get_crush_map(),
+					CRUSH_BUCKET_STRAW2,
+					CRUSH_HASH_RJENKINS1, 1, num_osd,
+					items.data(), weights.data());
+    int id;
+    EXPECT_EQ(0, crush_add_bucket(c->get_crush_map(), 0, b, &id));
+    hosts.push_back(id);
+    host_weights.push_back(b->weight);
+  }
+  crush_bucket *root = crush_make_bucket(c->get_crush_map(),
+					 CRUSH_BUCKET_STRAW2,
+					 CRUSH_HASH_RJENKINS1, 2, num_host,
+					 hosts.data(), host_weights.data());
+  int rootno;
+  EXPECT_EQ(0, crush_add_bucket(c->get_crush_map(), 0, root, &rootno));
+  c->set_item_name(rootno, "default");
+  c->set_max_devices(osd);
+  EXPECT_EQ(0, c->add_simple_rule("firstn", "default", "host", "",
+				  "firstn", pg_pool_t::TYPE_REPLICATED));
+  EXPECT_EQ(1, c->add_simple_rule("indep", "default", "host", "",
+				  "indep", pg_pool_t::TYPE_ERASURE));
+  EXPECT_EQ(2, c->add_simple_rule("osd", "default", "osd", "",
+				  "firstn", pg_pool_t::TYPE_REPLICATED));
+  c->finalize();
+  return c;
+}
+
+} // anonymous namespace
+
+TEST_F(CRUSHTest, straw2_batch) {
+  // crush_do_rule_batch() maps as crush_do_rule() does, bit for bit
+  std::mt19937 rng(42);
+  for (int round = 0; round < 20; ++round) {
+    auto c = build_straw2_map(rng, 1 + rng() % 30, 1 + rng() % 20);
+    crush_map *map = c->get_crush_map();
+    std::vector<__u32> weight(c->get_max_devices());
+    for (auto& w : weight) {
+      w = rng() % 4 ? 0x10000 : rng() % 0x10000;
+    }
+    // and with weight sets, as the balancer uses
+    crush_choose_arg *args = nullptr;
+    if (round % 2) {
+      args = crush_make_choose_args(map, 2);
+      for (int b = 0; b < map->max_buckets; ++b) {
+	for (unsigned p = 0; p < args[b].weight_set_positions; ++p) {
+	  for (unsigned i = 0; i < args[b].weight_set[p].size; ++i) {
+	    args[b].weight_set[p].weights[i] =
+	      rng() % 4 ? rng() % 0x30000 : rng();
+	  }
+	}
+      }
+    }
+    const int result_max = 1 + rng() % 6;
+    std::vector<char> work(crush_work_size(map, result_max));
+    std::vector<char> batch_work(crush_work_size(map, result_max));
+    crush_init_workspace(map, work.data());
+    crush_init_workspace(map, batch_work.data());
+    std::vector<int> xs(1000);
+    for (auto& x : xs) {
+      x = rng();
+    }
+    for (int rule = 0; rule < 3; ++rule) {
+      std::vector<int> results(xs.size() * result_max);
+      std::vector<int> lens(xs.size());
+      ASSERT_EQ((int)xs.size(),
+		crush_do_rule_batch(map, rule, xs.data(), xs.size(),
+				    results.data(), lens.data(), result_max,
+				    weight.data(), weight.size(),
+				    batch_work.data(), args));
+      for (size_t i = 0; i < xs.size(); ++i) {
+	std::vector<int> out(result_max);
+	int len = crush_do_rule(map, rule, xs[i], out.data(), result_max,
+				weight.data(), weight.size(),
+				work.data(), args);
+	ASSERT_EQ(len, lens[i]) << "rule " << rule << " x " << xs[i];
+	out.resize(len);
+	ASSERT_EQ(out, std::vector<int>(results.begin() + i * result_max,
+					results.begin() + i * result_max + len))
+	  << "rule " << rule << " x " << xs[i];
+      }
+    }
+    if (args) {
+      crush_destroy_choose_args(args);
+    }
+  }
+  // a bad rule maps nothing
+  auto c = build_straw2_map(rng, 3, 3);
+  std::vector<char> work(crush_work_size(c->get_crush_map(), 3));
+  crush_init_workspace(c->get_crush_map(), work.data());
+  int x = 1, result[3], len;
+  std::vector<__u32> weight(c->get_max_devices(), 0x10000);
+  ASSERT_EQ(0, crush_do_rule_batch(c->get_crush_map(), 12, &x, 1, result,
+				   &len, 3, weight.data(), weight.size(),
+				   work.data(), nullptr));
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST_F(CRUSHTest, DISABLED_straw2_batch_benchmark) {
+  std::mt19937 rng(1);
+  for (auto [hosts, osds] : {std::pair{10, 10}, {100, 24}, {500, 60}}) {
+    auto c = build_straw2_map(rng, hosts, osds);
+    crush_map *map = c->get_crush_map();
+    std::vector<__u32> weight(c->get_max_devices(), 0x10000);
+    std::vector<char> work(crush_work_size(map, 3));
+    crush_init_workspace(map, work.data());
+    std::vector<int> xs(100000);
+    std::iota(xs.begin(), xs.end(), 0);
+    std::vector<int> results(xs.size() * 3), lens(xs.size());
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < xs.size(); ++i) {
+      lens[i] = crush_do_rule(map, 0, xs[i], &results[i * 3], 3,
+			      weight.data(), weight.size(), work.data(),
+			      nullptr);
+    }
+    auto scalar = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    crush_do_rule_batch(map, 0, xs.data(), xs.size(), results.data(),
+			lens.data(), 3, weight.data(), weight.size(),
+			work.data(), nullptr);
+    auto batch = std::chrono::steady_clock::now() - start;
+    cout << hosts << " hosts of " << osds << " osds: "
+	 << xs.size() / std::chrono::duration<double>(scalar).count()
+	 << " mappings/s scalar, "
+	 << xs.size() / std::chrono::duration<double>(batch).count()
+	 << " mappings/s batch" << std::endl;
+  }
+}
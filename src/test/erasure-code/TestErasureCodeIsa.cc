@@ -874,6 +874,106 @@ TEST_F(IsaErasureCodeTest, isa_xor_codec)
   EXPECT_EQ(5, cnt_cf);
 }
 
+TEST_F(IsaErasureCodeTest, parity_delta)
+{
+  // reed-solomon and the m=1 xor codec
+  for (unsigned m = 1; m <= 2; m++) {
+    const unsigned k = 4;
+    ErasureCodeIsaDefault Isa(tcache);
+    ErasureCodeProfile profile;
+    profile["k"] = stringify(k);
+    profile["m"] = stringify(m);
+    EXPECT_EQ(0, Isa.init(profile, &cerr));
+    EXPECT_TRUE(Isa.supports_parity_delta());
+
+    bufferlist in;
+    in.append(string(k * 4096, 'X'));
+    set<int> want_to_encode;
+    for (unsigned i = 0; i < k + m; i++)
+      want_to_encode.insert(i);
+    map<int, bufferlist> encoded;
+    EXPECT_EQ(0, Isa.encode(want_to_encode, in, &encoded));
+    unsigned length = encoded[0].length();
+
+    // overwrite the first half of the last data chunk
+    bufferptr old_chunk(encoded[k - 1].c_str(), length);
+    bufferptr new_chunk(encoded[k - 1].c_str(), length);
+    memset(new_chunk.c_str(), 'Y', length / 2);
+    bufferptr delta(length);
+    EXPECT_EQ(0, Isa.encode_delta(old_chunk, new_chunk, &delta));
+    map<int, bufferptr> deltas;
+    deltas[k - 1] = delta;
+    map<int, bufferptr> parity;
+    for (unsigned i = k; i < k + m; i++)
+      parity[i] = bufferptr(encoded[i].c_str(), length);
+    EXPECT_EQ(0, Isa.apply_delta(deltas, parity));
+
+    bufferlist modified;
+    modified.append(in.c_str(), in.length());
+    modified.begin((k - 1) * length).copy_in(length, new_chunk.c_str());
+    map<int, bufferlist> reencoded;
+    EXPECT_EQ(0, Isa.encode(want_to_encode, modified, &reencoded));
+    for (unsigned i = k; i < k + m; i++) {
+      EXPECT_EQ(0, memcmp(parity[i].c_str(), reencoded[i].c_str(), length));
+    }
+
+    // all the coding chunks must be updated at once
+    parity.erase(k);
+    EXPECT_EQ(-EINVAL, Isa.apply_delta(deltas, parity));
+  }
+}
+
+TEST_F(IsaErasureCodeTest, batch)
+{
+  // reed-solomon and the m=1 xor codec
+  for (unsigned m = 1; m <= 2; m++) {
+    const unsigned k = 4;
+    const unsigned stripe_count = 8;
+    ErasureCodeIsaDefault Isa(tcache);
+    ErasureCodeProfile profile;
+    profile["k"] = stringify(k);
+    profile["m"] = stringify(m);
+    EXPECT_EQ(0, Isa.init(profile, &cerr));
+
+    set<int> want_to_encode;
+    for (unsigned i = 0; i < k + m; i++)
+      want_to_encode.insert(i);
+
+    // encode the stripes one at a time
+    const unsigned length = Isa.get_chunk_size(k * 4096);
+    map<int, bufferlist> expected;
+    for (unsigned s = 0; s < stripe_count; s++) {
+      bufferlist in;
+      for (unsigned i = 0; i < k; i++)
+        in.append(string(length, 'A' + s * k + i));
+      map<int, bufferlist> encoded;
+      EXPECT_EQ(0, Isa.encode(want_to_encode, in, &encoded));
+      for (auto &&i : encoded)
+        expected[i.first].append(i.second);
+    }
+
+    // and all at once
+    map<int, bufferlist> batch;
+    for (unsigned i = 0; i < k + m; i++) {
+      bufferptr ptr(buffer::create_aligned(stripe_count * length, 32));
+      if (i < k)
+        ptr.copy_in(0, stripe_count * length, expected[i].c_str());
+      batch[i].push_back(ptr);
+    }
+    EXPECT_EQ(0, Isa.encode_chunks_batch(want_to_encode, &batch, stripe_count));
+    for (unsigned i = k; i < k + m; i++)
+      EXPECT_TRUE(batch[i].contents_equal(expected[i]));
+
+    // recover the first data chunk of all the stripes at once
+    map<int, bufferlist> chunks = expected;
+    chunks.erase(0);
+    map<int, bufferlist> decoded;
+    EXPECT_EQ(0, Isa.decode_chunks_batch(set<int>{0}, chunks, &decoded,
+                                         stripe_count));
+    EXPECT_TRUE(decoded[0].contents_equal(expected[0]));
+  }
+}
+
 TEST_F(IsaErasureCodeTest, create_rule)
 {
   std::unique_ptr<CrushWrapper> c = std::make_unique<CrushWrapper>();
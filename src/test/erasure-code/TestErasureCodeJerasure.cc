@@ -129,6 +129,113 @@ TYPED_TEST(ErasureCodeTest, encode_decode)
   }
 }
 
+TYPED_TEST(ErasureCodeTest, parity_delta)
+{
+  TypeParam jerasure;
+  map<int, bufferptr> deltas;
+  map<int, bufferptr> parity;
+  if (!jerasure.supports_parity_delta()) {
+    EXPECT_EQ(-EOPNOTSUPP, jerasure.apply_delta(deltas, parity));
+    return;
+  }
+  const unsigned k = 4;
+  const unsigned m = 2;
+  ErasureCodeProfile profile;
+  profile["k"] = stringify(k);
+  profile["m"] = stringify(m);
+  EXPECT_EQ(0, jerasure.init(profile, &cerr));
+
+  bufferlist in;
+  in.append(string(k * 4096, 'X'));
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < k + m; i++)
+    want_to_encode.insert(i);
+  map<int, bufferlist> encoded;
+  EXPECT_EQ(0, jerasure.encode(want_to_encode, in, &encoded));
+  unsigned length = encoded[0].length();
+
+  // overwrite the first half of the second data chunk
+  bufferptr old_chunk(encoded[1].c_str(), length);
+  bufferptr new_chunk(encoded[1].c_str(), length);
+  memset(new_chunk.c_str(), 'Y', length / 2);
+  bufferptr delta(length);
+  EXPECT_EQ(0, jerasure.encode_delta(old_chunk, new_chunk, &delta));
+  deltas[1] = delta;
+  for (unsigned i = k; i < k + m; i++)
+    parity[i] = bufferptr(encoded[i].c_str(), length);
+  EXPECT_EQ(0, jerasure.apply_delta(deltas, parity));
+
+  // the coding chunks are the same as if the stripe was encoded again
+  bufferlist modified;
+  modified.append(in.c_str(), in.length());
+  modified.begin(length).copy_in(length, new_chunk.c_str());
+  map<int, bufferlist> reencoded;
+  EXPECT_EQ(0, jerasure.encode(want_to_encode, modified, &reencoded));
+  for (unsigned i = k; i < k + m; i++) {
+    EXPECT_EQ(0, memcmp(parity[i].c_str(), reencoded[i].c_str(), length));
+  }
+
+  // the delta must be for a data chunk
+  deltas.clear();
+  deltas[k] = delta;
+  EXPECT_EQ(-EINVAL, jerasure.apply_delta(deltas, parity));
+}
+
+TYPED_TEST(ErasureCodeTest, batch)
+{
+  TypeParam jerasure;
+  const unsigned k = 2;
+  const unsigned m = 2;
+  const unsigned stripe_count = 4;
+  ErasureCodeProfile profile;
+  profile["k"] = stringify(k);
+  profile["m"] = stringify(m);
+  profile["packetsize"] = "8";
+  EXPECT_EQ(0, jerasure.init(profile, &cerr));
+
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < k + m; i++)
+    want_to_encode.insert(i);
+
+  // encode the stripes one at a time
+  const unsigned length = jerasure.get_chunk_size(k * 1024);
+  map<int, bufferlist> expected;
+  for (unsigned s = 0; s < stripe_count; s++) {
+    bufferlist in;
+    for (unsigned i = 0; i < k; i++)
+      in.append(string(length, 'A' + s * k + i));
+    map<int, bufferlist> encoded;
+    EXPECT_EQ(0, jerasure.encode(want_to_encode, in, &encoded));
+    for (auto &&i : encoded)
+      expected[i.first].append(i.second);
+  }
+
+  // and all at once
+  map<int, bufferlist> batch;
+  for (unsigned i = 0; i < k + m; i++) {
+    bufferptr ptr(buffer::create_page_aligned(stripe_count * length));
+    if (i < k)
+      ptr.copy_in(0, stripe_count * length, expected[i].c_str());
+    batch[i].push_back(ptr);
+  }
+  EXPECT_EQ(0, jerasure.encode_chunks_batch(want_to_encode, &batch,
+					    stripe_count));
+  for (unsigned i = k; i < k + m; i++)
+    EXPECT_TRUE(batch[i].contents_equal(expected[i]));
+
+  // recover both data chunks of all the stripes at once
+  map<int, bufferlist> chunks = expected;
+  chunks.erase(0);
+  chunks.erase(1);
+  map<int, bufferlist> decoded;
+  EXPECT_EQ(0, jerasure.decode_chunks_batch(set<int>{0, 1}, chunks, &decoded,
+					    stripe_count));
+  EXPECT_TRUE(decoded[0].contents_equal(expected[0]));
+  EXPECT_TRUE(decoded[1].contents_equal(expected[1]));
+  EXPECT_EQ(-EINVAL, jerasure.decode_chunks_batch(set<int>{0}, chunks,
+						  &decoded, 3));
+}
+
 TYPED_TEST(ErasureCodeTest, minimum_to_decode)
 {
   TypeParam jerasure;
@@ -50,7 +50,8 @@ int ErasureCodeBench::setup(int argc, char** argv) {
     ("plugin,p", po::value<string>()->default_value("jerasure"),
      "erasure code plugin name")
     ("workload,w", po::value<string>()->default_value("encode"),
-     "run either encode or decode")
+     "run encode, decode, rmw (overwrite one data chunk and encode the"
+     " stripe) or delta (overwrite one data chunk and apply the parity delta)")
     ("erasures,e", po::value<int>()->default_value(1),
      "number of erasures when decoding")
     ("erased", po::value<vector<int> >(),
@@ -62,6 +63,11 @@ int ErasureCodeBench::setup(int argc, char** argv) {
      " the first chunk, then the second etc.)")
     ("parameter,P", po::value<vector<string> >(),
      "add a parameter to the erasure code profile")
+    ("stripe-width,S", po::value<int>()->default_value(0),
+     "encode the buffer as stripes of this size, one at a time (0 means"
+     " the whole buffer is a single stripe)")
+    ("batch,b", "with --stripe-width, encode all the stripes with a single"
+     " encode_chunks_batch call")
     ;
 
   po::variables_map vm;
@@ -113,6 +119,8 @@ int ErasureCodeBench::setup(int argc, char** argv) {
   max_iterations = vm["iterations"].as<int>();
   plugin = vm["plugin"].as<string>();
   workload = vm["workload"].as<string>();
+  stripe_width = vm["stripe-width"].as<int>();
+  batch = vm.count("batch") > 0;
   erasures = vm["erasures"].as<int>();
   if (vm.count("erasures-generation") > 0 &&
       vm["erasures-generation"].as<string>() == "exhaustive")
@@ -138,6 +146,12 @@ int ErasureCodeBench::setup(int argc, char** argv) {
     return -EINVAL;
   } 
 
+  if (stripe_width < 0 || (stripe_width && in_size % stripe_width)) {
+    cout << "--size " << in_size << " must be a multiple of --stripe-width "
+	 << stripe_width << endl;
+    return -EINVAL;
+  }
+
   verbose = vm.count("verbose") > 0 ? true : false;
 
   return 0;
@@ -149,6 +163,10 @@ int ErasureCodeBench::run() {
 
   if (workload == "encode")
     return encode();
+  else if (workload == "rmw")
+    return overwrite(false);
+  else if (workload == "delta")
+    return overwrite(true);
   else
     return decode();
 }
@@ -173,10 +191,51 @@ int ErasureCodeBench::encode()
   for (int i = 0; i < k + m; i++) {
     want_to_encode.insert(i);
   }
+  unsigned stripe_count = 1;
+  unsigned chunk_size = 0;
+  if (stripe_width) {
+    stripe_count = in_size / stripe_width;
+    chunk_size = erasure_code->get_chunk_size(stripe_width);
+    if (chunk_size * k != (unsigned)stripe_width) {
+      cerr << "--stripe-width " << stripe_width << " is not a multiple of"
+	   << " k times the chunk alignment" << endl;
+      return -EINVAL;
+    }
+  }
+  const vector<int> &chunk_mapping = erasure_code->get_chunk_mapping();
   utime_t begin_time = ceph_clock_now();
   for (int i = 0; i < max_iterations; i++) {
     map<int,bufferlist> encoded;
-    code = erasure_code->encode(want_to_encode, in, &encoded);
+    if (!stripe_width) {
+      code = erasure_code->encode(want_to_encode, in, &encoded);
+    } else if (!batch) {
+      for (unsigned s = 0; s < stripe_count && !code; s++) {
+	bufferlist stripe;
+	stripe.substr_of(in, s * stripe_width, stripe_width);
+	encoded.clear();
+	code = erasure_code->encode(want_to_encode, stripe, &encoded);
+      }
+    } else {
+      // lay out the data chunks of the stripes one after the other, as
+      // ECUtil::encode does
+      vector<char*> data(k);
+      for (int j = 0; j < k + m; j++) {
+	bufferptr ptr(buffer::create_aligned(stripe_count * chunk_size,
+					     ErasureCode::SIMD_ALIGN));
+	if (j < k)
+	  data[j] = ptr.c_str();
+	int chunk = (int)chunk_mapping.size() > j ? chunk_mapping[j] : j;
+	encoded[chunk].push_back(std::move(ptr));
+      }
+      auto p = in.cbegin();
+      for (unsigned s = 0; s < stripe_count; s++) {
+	for (int j = 0; j < k; j++) {
+	  p.copy(chunk_size, data[j] + s * chunk_size);
+	}
+      }
+      code = erasure_code->encode_chunks_batch(want_to_encode, &encoded,
+					       stripe_count);
+    }
     if (code)
       return code;
   }
@@ -185,6 +244,80 @@ int ErasureCodeBench::encode()
   return 0;
 }
 
+int ErasureCodeBench::overwrite(bool delta)
+{
+  ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
+  ErasureCodeInterfaceRef erasure_code;
+  stringstream messages;
+  int code = instance.factory(plugin,
+			      g_conf().get_val<std::string>("erasure_code_dir"),
+			      profile, &erasure_code, &messages);
+  if (code) {
+    cerr << messages.str() << endl;
+    return code;
+  }
+  if (delta && !erasure_code->supports_parity_delta()) {
+    cerr << "plugin " << plugin
+	 << " does not support parity deltas" << endl;
+    return -EOPNOTSUPP;
+  }
+
+  bufferlist in;
+  in.append(string(in_size, 'X'));
+  in.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+  set<int> want_to_encode;
+  for (int i = 0; i < k + m; i++) {
+    want_to_encode.insert(i);
+  }
+  map<int,bufferlist> encoded;
+  code = erasure_code->encode(want_to_encode, in, &encoded);
+  if (code)
+    return code;
+  unsigned chunk_size = encoded[0].length();
+  map<int,bufferptr> parity;
+  for (int i = k; i < k + m; i++) {
+    encoded[i].rebuild_aligned(ErasureCode::SIMD_ALIGN);
+    parity[i] = encoded[i].front();
+  }
+  bufferptr old_chunk = buffer::create_aligned(chunk_size,
+					       ErasureCode::SIMD_ALIGN);
+  bufferptr new_chunk = buffer::create_aligned(chunk_size,
+					       ErasureCode::SIMD_ALIGN);
+  bufferptr delta_chunk = buffer::create_aligned(chunk_size,
+						 ErasureCode::SIMD_ALIGN);
+
+  utime_t begin_time = ceph_clock_now();
+  for (int i = 0; i < max_iterations; i++) {
+    int chunk = i % k;
+    memset(new_chunk.c_str(), 'A' + i % 26, chunk_size);
+    if (delta) {
+      encoded[chunk].begin().copy(chunk_size, old_chunk.c_str());
+      code = erasure_code->encode_delta(old_chunk, new_chunk, &delta_chunk);
+      if (code)
+	return code;
+      map<int,bufferptr> deltas;
+      deltas[chunk] = delta_chunk;
+      code = erasure_code->apply_delta(deltas, parity);
+      if (code)
+	return code;
+      encoded[chunk].begin().copy_in(chunk_size, new_chunk.c_str());
+    } else {
+      unsigned off = chunk * chunk_size;
+      if (off < (unsigned)in_size)
+	in.begin(off).copy_in(std::min(chunk_size, in_size - off),
+			      new_chunk.c_str());
+      encoded.clear();
+      code = erasure_code->encode(want_to_encode, in, &encoded);
+      if (code)
+	return code;
+    }
+  }
+  utime_t end_time = ceph_clock_now();
+  cout << (end_time - begin_time) << "\t"
+       << (max_iterations * (chunk_size / 1024)) << endl;
+  return 0;
+}
+
 static void display_chunks(const map<int,bufferlist> &chunks,
 			   unsigned int chunk_count) {
   cout << "chunks ";
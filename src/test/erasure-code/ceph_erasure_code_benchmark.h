@@ -34,6 +34,8 @@ class ErasureCodeBench {
   bool exhaustive_erasures;
   vector<int> erased;
   string workload;
+  int stripe_width;
+  bool batch;
 
   ErasureCodeProfile profile;
 
@@ -49,6 +51,7 @@ public:
 		      ErasureCodeInterfaceRef erasure_code);
   int decode();
   int encode();
+  int overwrite(bool delta);
 };
 
 #endif
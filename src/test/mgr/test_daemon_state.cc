@@ -0,0 +1,168 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "common/ceph_time.h"
+#include "include/stringify.h"
+#include "mgr/DaemonState.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// the reports of a daemon declaring 'n' counters, every 'avg_every'th
+// being an average
+class ReportGenerator {
+public:
+  ReportGenerator(unsigned n, unsigned avg_every)
+  {
+    for (unsigned i = 0; i < n; i++) {
+      PerfCounterType t;
+      t.path = "osd.counter_" + stringify(i);
+      t.description = "counter " + stringify(i);
+      t.type = (i % avg_every == 0) ?
+	perfcounter_type_d(PERFCOUNTER_U64 | PERFCOUNTER_LONGRUNAVG) :
+	perfcounter_type_d(PERFCOUNTER_U64 | PERFCOUNTER_COUNTER);
+      t.unit = UNIT_NONE;
+      types.push_back(t);
+    }
+  }
+
+  /// the next report, declaring the types in the first one
+  ceph::ref_t<MMgrReport> next() {
+    auto m = ceph::make_message<MMgrReport>();
+    if (seq == 0) {
+      m->declare_types = types;
+    }
+    // the values are packed in the order of the paths
+    std::map<std::string, const PerfCounterType*> sorted;
+    for (auto& t : types) {
+      sorted[t.path] = &t;
+    }
+    ENCODE_START(1, 1, m->packed);
+    for (auto& [path, t] : sorted) {
+      encode(value(*t), m->packed);
+      if (t->type & PERFCOUNTER_LONGRUNAVG) {
+	encode(seq, m->packed);
+	encode(seq, m->packed);
+      }
+    }
+    ENCODE_FINISH(m->packed);
+    ++seq;
+    return m;
+  }
+
+  uint64_t value(const PerfCounterType& t) const {
+    return seq * 1000 + t.path.size();
+  }
+
+  std::vector<PerfCounterType> types;
+  uint64_t seq = 0;
+};
+
+} // anonymous namespace
+
+TEST(DaemonPerfCounters, update)
+{
+  PerfCounterTypes types;
+  std::set<std::string> declared;
+  DaemonPerfCounters counters(types);
+  ReportGenerator gen(20, 4);
+
+  for (int i = 0; i < 3; i++) {
+    auto m = gen.next();
+    auto u = DaemonPerfCounters::decode(types, declared, *m);
+    ASSERT_EQ(20u, u.values.size());
+    counters.update(u);
+  }
+  ASSERT_EQ(20u, types.size());
+  ASSERT_EQ(20u, declared.size());
+  ASSERT_EQ(20u, counters.instances.size());
+  for (auto& t : gen.types) {
+    auto& i = counters.instances.at(t.path);
+    if (t.type & PERFCOUNTER_LONGRUNAVG) {
+      ASSERT_EQ(2u, i.get_latest_data_avg().c);
+      ASSERT_EQ(3u, i.get_data_avg().size());
+    } else {
+      ASSERT_EQ(2000u + t.path.size(), i.get_latest_data().v);
+      ASSERT_EQ(3u, i.get_data().size());
+    }
+  }
+
+  // a daemon undeclaring a counter stops sending its values
+  const std::string gone = gen.types.back().path;
+  gen.types.pop_back();
+  auto m = gen.next();
+  m->undeclare_types.push_back(gone);
+  auto u = DaemonPerfCounters::decode(types, declared, *m);
+  ASSERT_EQ(19u, u.values.size());
+  ASSERT_EQ(19u, declared.size());
+}
+
+// Replays the reports of many OSDs, as handle_report() ingests them,
+// while other threads read the counters as the python modules do; run
+// with --gtest_also_run_disabled_tests
+TEST(DaemonPerfCounters, DISABLED_report_ingest_bench)
+{
+  const unsigned daemons = 5000, counters = 400, rounds = 5, readers = 4;
+  DaemonStateIndex index;
+  std::vector<ReportGenerator> gens;
+  std::vector<std::set<std::string>> declared(daemons);
+  for (unsigned i = 0; i < daemons; i++) {
+    auto state = std::make_shared<DaemonState>(index.types);
+    state->key = DaemonKey{"osd", stringify(i)};
+    state->hostname = "host" + stringify(i / 20);
+    index.insert(state);
+    gens.emplace_back(counters, 8);
+  }
+
+  std::atomic<bool> done = false;
+  std::atomic<uint64_t> reads = 0;
+  std::vector<std::thread> threads;
+  for (unsigned r = 0; r < readers; r++) {
+    threads.emplace_back([&, r] {
+      unsigned i = r;
+      while (!done) {
+	auto state = index.get(DaemonKey{"osd", stringify(i++ % daemons)});
+	std::lock_guard l(state->lock);
+	for (auto& [path, instance] : state->perf_counters.instances) {
+	  // the schema, as get_perf_schema_python() reads it
+	  reads += state->perf_counters.types.with_types(
+	    [&path=path](const auto &types) {
+	      return types.count(path);
+	    });
+	  break;
+	}
+      }
+    });
+  }
+
+  auto start = ceph::mono_clock::now();
+  ceph::timespan decoding{0};
+  for (unsigned round = 0; round < rounds; round++) {
+    for (unsigned i = 0; i < daemons; i++) {
+      auto m = gens[i].next();
+      auto t = ceph::mono_clock::now();
+      auto state = index.get(DaemonKey{"osd", stringify(i)});
+      auto u = DaemonPerfCounters::decode(index.types, declared[i], *m);
+      decoding += ceph::mono_clock::now() - t;
+      std::lock_guard l(state->lock);
+      state->perf_counters.update(u);
+    }
+  }
+  auto elapsed = ceph::mono_clock::now() - start;
+  done = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+  const double secs = std::chrono::duration<double>(elapsed).count();
+  std::cout << daemons * rounds << " reports of " << counters
+	    << " counters in " << secs << "s: "
+	    << daemons * rounds / secs << " reports/s, "
+	    << std::chrono::duration<double>(decoding).count() / secs * 100
+	    << "% decoding, " << reads << " reads meanwhile" << std::endl;
+}
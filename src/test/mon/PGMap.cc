@@ -16,6 +16,8 @@
 
 #include "include/stringify.h"
 
+#include <random>
+
 
 namespace {
   class CheckTextTable : public TextTable {
@@ -164,3 +166,145 @@ TEST(pgmap, dump_object_stat_sum_2)
   ASSERT_EQ(percentify(0), tbl.get(0, col++));
   ASSERT_EQ(stringify(byte_u_t(avail/pool.size)), tbl.get(0, col++));
 }
+
+namespace {
+  // what calc_purged_snaps() used to compute, from scratch
+  map<int64_t,interval_set<snapid_t>> expected_purged_snaps(const PGMap& pgmap)
+  {
+    map<int64_t,interval_set<snapid_t>> r;
+    set<int64_t> unknown;
+    for (auto& [pgid, s] : pgmap.pg_stat) {
+      if (unknown.count(pgid.pool())) {
+	continue;
+      } else if (s.state == 0) {
+	unknown.insert(pgid.pool());
+	r.erase(pgid.pool());
+      } else if (auto j = r.find(pgid.pool()); j == r.end()) {
+	r[pgid.pool()] = s.purged_snaps;
+      } else {
+	j->second.intersection_of(s.purged_snaps);
+      }
+    }
+    return r;
+  }
+
+  pg_stat_t random_pg_stat(std::mt19937& rng)
+  {
+    pg_stat_t s;
+    s.state = rng() % 10 ? PG_STATE_ACTIVE | PG_STATE_CLEAN : 0;
+    // mostly the same snaps, so that the intersections are not empty
+    for (snapid_t snap = 1; snap < 60; snap += 1 + rng() % 4) {
+      if (rng() % 8) {
+	s.purged_snaps.insert(snap, 1 + rng() % 3);
+      }
+      snap += 3;
+    }
+    return s;
+  }
+}
+
+TEST(pgmap, purged_snaps_incremental)
+{
+  std::mt19937 rng(42);
+  PGMap pgmap;
+  for (int round = 0; round < 200; round++) {
+    PGMap::Incremental inc;
+    inc.version = pgmap.version + 1;
+    inc.stamp = utime_t(round + 1, 0);
+    for (int i = rng() % 20; i > 0; i--) {
+      pg_t pgid(rng() % 16, 1 + rng() % 4);
+      if (rng() % 4 == 0 && pgmap.pg_stat.count(pgid)) {
+	inc.pg_remove.insert(pgid);
+      } else if (!inc.pg_remove.count(pgid)) {
+	inc.pg_stat_updates[pgid] = random_pg_stat(rng);
+      }
+    }
+    pgmap.apply_incremental(nullptr, inc);
+    pgmap.calc_purged_snaps();
+    map<int64_t,interval_set<snapid_t>> got(pgmap.purged_snaps.begin(),
+					    pgmap.purged_snaps.end());
+    ASSERT_EQ(expected_purged_snaps(pgmap), got) << "round " << round;
+  }
+
+  // and the same from scratch
+  PGMap copy;
+  bufferlist bl;
+  pgmap.encode(bl, CEPH_FEATURES_ALL);
+  auto p = bl.cbegin();
+  copy.decode(p);
+  copy.calc_purged_snaps();
+  ASSERT_EQ(pgmap.purged_snaps, copy.purged_snaps);
+}
+
+TEST(pgmap, pool_deltas)
+{
+  PGMap pgmap;
+  PGMap::Incremental inc;
+  pg_stat_t s;
+  s.state = PG_STATE_ACTIVE | PG_STATE_CLEAN;
+  s.stats.sum.num_objects = 10;
+  s.stats.sum.num_wr = 10;
+  inc.pg_stat_updates[pg_t(0, 1)] = s;
+  inc.pg_stat_updates[pg_t(0, 2)] = s;
+  inc.version = 1;
+  inc.stamp = utime_t(1, 0);
+  pgmap.apply_incremental(nullptr, inc);
+  // the pools appeared: no delta yet
+  ASSERT_EQ(0u, pgmap.per_pool_sum_deltas.count(1));
+  ASSERT_EQ(0u, pgmap.per_pool_sum_deltas.count(2));
+
+  // only pool 1 changes
+  s.stats.sum.num_wr = 30;
+  inc.pg_stat_updates.clear();
+  inc.pg_stat_updates[pg_t(0, 1)] = s;
+  inc.version = 2;
+  inc.stamp = utime_t(3, 0);
+  pgmap.apply_incremental(nullptr, inc);
+  ASSERT_EQ(1u, pgmap.per_pool_sum_deltas[1].size());
+  ASSERT_EQ(20, pgmap.per_pool_sum_delta[1].first.stats.sum.num_wr);
+  ASSERT_EQ(utime_t(3, 0), pgmap.per_pool_sum_delta[1].second);
+  // the other one still gets its null delta
+  ASSERT_EQ(1u, pgmap.per_pool_sum_deltas[2].size());
+  ASSERT_EQ(0, pgmap.per_pool_sum_delta[2].first.stats.sum.num_wr);
+  ASSERT_EQ(utime_t(3, 0), pgmap.per_pool_sum_delta[2].second);
+}
+
+// how long the digest takes to maintain, with many PGs of which few
+// change; run with --gtest_also_run_disabled_tests
+TEST(pgmap, DISABLED_apply_incremental_bench)
+{
+  const int pools = 10, pgs_per_pool = 20000;
+  std::mt19937 rng(42);
+  PGMap pgmap;
+  PGMap::Incremental inc;
+  for (int pool = 0; pool < pools; pool++) {
+    for (int ps = 0; ps < pgs_per_pool; ps++) {
+      auto s = random_pg_stat(rng);
+      s.state = PG_STATE_ACTIVE | PG_STATE_CLEAN;
+      inc.pg_stat_updates[pg_t(ps, pool)] = s;
+    }
+  }
+  inc.version = 1;
+  inc.stamp = utime_t(1, 0);
+  pgmap.apply_incremental(nullptr, inc);
+  pgmap.calc_purged_snaps();
+
+  const int rounds = 100;
+  auto start = ceph::mono_clock::now();
+  for (int round = 0; round < rounds; round++) {
+    PGMap::Incremental inc;
+    inc.version = pgmap.version + 1;
+    inc.stamp = utime_t(round + 2, 0);
+    for (int i = 0; i < 100; i++) {
+      auto s = random_pg_stat(rng);
+      s.state = PG_STATE_ACTIVE | PG_STATE_CLEAN;
+      inc.pg_stat_updates[pg_t(rng() % pgs_per_pool, rng() % pools)] = s;
+    }
+    pgmap.apply_incremental(nullptr, inc);
+    pgmap.calc_purged_snaps();
+  }
+  auto elapsed = ceph::mono_clock::now() - start;
+  std::cout << pools * pgs_per_pool << " pgs: "
+	    << std::chrono::duration<double, std::milli>(elapsed).count() / rounds
+	    << " ms per incremental" << std::endl;
+}
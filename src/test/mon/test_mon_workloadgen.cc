@@ -25,6 +25,8 @@
 #include <sys/vfs.h>
 #endif
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <map>
@@ -63,6 +65,7 @@
 #include "messages/MPGStats.h"
 #include "messages/MLog.h"
 #include "messages/MOSDPGTemp.h"
+#include "messages/MOSDMarkMeDown.h"
 
 using namespace std;
 
@@ -79,6 +82,48 @@ typedef boost::mt11213b rngen_t;
 typedef boost::scoped_ptr<Messenger> MessengerRef;
 typedef boost::scoped_ptr<Objecter> ObjecterRef;
 
+/*
+ * With --storm-interval, all the OSD stubs mark themselves down at the
+ * same time every so often, and boot again as soon as they see it in the
+ * map, replaying the boot and failure storms of a cluster losing and
+ * getting back a whole rack or room. What they observe is collected here
+ * and summed up at the end: how long the mons took to publish the maps
+ * with the OSDs down, and then up.
+ */
+double storm_interval = 0;
+
+struct StormStats {
+  ceph::mutex lock = ceph::make_mutex("StormStats::lock");
+  vector<double> down;  ///< seconds from MOSDMarkMeDown to a map with us down
+  vector<double> up;    ///< seconds from MOSDBoot to a map with us up
+
+  void add(vector<double>& v, double t) {
+    std::lock_guard l{lock};
+    v.push_back(t);
+  }
+
+  static void print(ostream& out, const char *name, vector<double> v) {
+    out << name << ": " << v.size() << " samples";
+    if (!v.empty()) {
+      std::sort(v.begin(), v.end());
+      double sum = 0;
+      for (auto t : v) {
+	sum += t;
+      }
+      out << ", avg " << sum / v.size()
+	  << "s, p50 " << v[v.size() / 2]
+	  << "s, p99 " << v[v.size() * 99 / 100]
+	  << "s, max " << v.back() << "s";
+    }
+    out << std::endl;
+  }
+  void print(ostream& out) {
+    std::lock_guard l{lock};
+    print(out, "mark down to down", down);
+    print(out, "boot to up", up);
+  }
+} storm_stats;
+
 class TestStub : public Dispatcher
 {
  protected:
@@ -319,10 +364,15 @@ class OSDStub : public TestStub
   boost::uniform_int<> mon_osd_rng;
 
   utime_t last_boot_attempt;
-  static const double STUB_BOOT_INTERVAL;
+
+  // --storm-interval
+  utime_t next_storm;
+  utime_t boot_sent;
+  utime_t mark_down_sent;
 
 
  public:
+  static const double STUB_BOOT_INTERVAL;
 
   enum {
     STUB_MON_OSD_ALIVE	  = 1,
@@ -458,9 +508,49 @@ class OSDStub : public TestStub
     MOSDBoot *mboot = new MOSDBoot;
     mboot->sb = sb;
     last_boot_attempt = now;
+    if (boot_sent == utime_t()) {
+      boot_sent = now;
+    }
     monc.send_mon_message(mboot);
   }
 
+  void mark_down() {
+    dout(1) << __func__ << dendl;
+    mark_down_sent = ceph_clock_now();
+    monc.send_mon_message(
+      new MOSDMarkMeDown(monc.get_fsid(), whoami, osdmap.get_addrs(whoami),
+			 osdmap.get_epoch(), false));
+  }
+
+  // at every storm, the stubs all go down within a tick of each other
+  void maybe_storm() {
+    utime_t now = ceph_clock_now();
+    if (next_storm == utime_t()) {
+      double t = (double)now;
+      next_storm.set_from_double(
+	(std::floor(t / storm_interval) + 1) * storm_interval);
+    }
+    if (now < next_storm) {
+      return;
+    }
+    next_storm += storm_interval;
+    if (mark_down_sent == utime_t() && boot_sent == utime_t()) {
+      mark_down();
+    }
+  }
+
+  void note_storm_map() {
+    utime_t now = ceph_clock_now();
+    if (mark_down_sent != utime_t() && !osdmap.is_up(whoami)) {
+      storm_stats.add(storm_stats.down, now - mark_down_sent);
+      mark_down_sent = utime_t();
+    }
+    if (boot_sent != utime_t() && osdmap.is_up(whoami)) {
+      storm_stats.add(storm_stats.up, now - boot_sent);
+      boot_sent = utime_t();
+    }
+  }
+
   void add_pg(pg_t pgid, epoch_t epoch, pg_t parent) {
 
     utime_t now = ceph_clock_now();
@@ -719,6 +809,15 @@ class OSDStub : public TestStub
       boot();
       return;
     }
+    if (storm_interval > 0) {
+      if (!osdmap.is_up(whoami)) {
+	if (mark_down_sent == utime_t()) {
+	  boot();
+	}
+	return;
+      }
+      maybe_storm();
+    }
 
     update_osd_stat();
 
@@ -856,6 +955,9 @@ class OSDStub : public TestStub
       dout(1) << __func__
 	      << " got into the osdmap and we're up!" << dendl;
     }
+    if (storm_interval > 0) {
+      note_storm_map();
+    }
 
     if (m->newest_map && m->newest_map > last) {
       dout(1) << __func__
@@ -959,6 +1061,11 @@ Test-specific Options:\n\
   --stub-id ID1..ID2        Interval of OSD ids for multiple stubs to mimic.\n\
   --stub-id ID              OSD id a stub will mimic to be\n\
                             (same as --stub-id ID..ID)\n\
+  --duration SECS           Run for SECS seconds (default 300)\n\
+  --storm-interval SECS     Have all the stubs mark themselves down every\n\
+                            SECS seconds (more than 10), and boot again\n\
+                            right away; print how long the mons took to\n\
+                            mark them down and up\n\
 " << std::endl;
 }
 
@@ -1028,6 +1135,16 @@ int main(int argc, const char *argv[])
 		  << err << std::endl;
 	exit(1);
       }
+    } else if (ceph_argparse_witharg(args, i, &val,
+	"--storm-interval", (char*) NULL)) {
+      string err;
+      storm_interval = strict_strtod(val.c_str(), &err);
+      if (!err.empty() || storm_interval <= OSDStub::STUB_BOOT_INTERVAL) {
+	std::cerr << "** error parsing '--storm-interval " << val << "': "
+		  << "must be more than " << OSDStub::STUB_BOOT_INTERVAL
+		  << " seconds" << std::endl;
+	exit(1);
+      }
     } else if (ceph_argparse_flag(args, i, "--help", (char*) NULL)) {
       usage();
       exit(0);
@@ -1100,5 +1217,8 @@ int main(int argc, const char *argv[])
     }
   }
 
+  if (storm_interval > 0) {
+    storm_stats.print(std::cout);
+  }
   return 0;
 }
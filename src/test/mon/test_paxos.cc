@@ -0,0 +1,118 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "mon/Paxos.h"
+#include "mon/PaxosService.h"
+
+#include "gtest/gtest.h"
+
+TEST(PaxosPlug, nested)
+{
+  PaxosPlug plugs;
+  ASSERT_FALSE(plugs.is_plugged());
+
+  // finish_round() plugging while a woken up command plugs itself
+  plugs.plug();
+  plugs.plug();
+  ASSERT_TRUE(plugs.is_plugged());
+  ASSERT_FALSE(plugs.unplug());
+  ASSERT_TRUE(plugs.is_plugged());
+  ASSERT_TRUE(plugs.unplug());
+  ASSERT_FALSE(plugs.is_plugged());
+
+  plugs.plug();
+  ASSERT_TRUE(plugs.is_plugged());
+  ASSERT_TRUE(plugs.unplug());
+  ASSERT_FALSE(plugs.is_plugged());
+}
+
+TEST(PaxosService, proposal_due_within)
+{
+  auto now = ceph::mono_clock::now();
+  const double window = 0.1;
+
+  // overdue, e.g. the timer event is queued behind us
+  ASSERT_TRUE(PaxosService::proposal_due_within(
+    now - std::chrono::seconds(1), now, window));
+  ASSERT_TRUE(PaxosService::proposal_due_within(now, now, window));
+  ASSERT_TRUE(PaxosService::proposal_due_within(
+    now + std::chrono::milliseconds(50), now, window));
+  ASSERT_TRUE(PaxosService::proposal_due_within(
+    now + std::chrono::milliseconds(100), now, window));
+  ASSERT_FALSE(PaxosService::proposal_due_within(
+    now + std::chrono::milliseconds(101), now, window));
+  ASSERT_FALSE(PaxosService::proposal_due_within(
+    now + std::chrono::seconds(1), now, window));
+
+  // a 0 window only joins the proposals already due
+  ASSERT_TRUE(PaxosService::proposal_due_within(now, now, 0));
+  ASSERT_FALSE(PaxosService::proposal_due_within(
+    now + std::chrono::nanoseconds(1), now, 0));
+}
+
+TEST(Paxos, lease_remaining)
+{
+  const double lease = 5, margin = 0.05;
+  // a lease sent at 100 by the leader, expiring at 105 on its clock, and
+  // which took 10ms to reach us
+  const double sent = 100, expire = 105, transit = 0.01;
+
+  // synchronized clocks
+  ASSERT_NEAR(5 - margin - transit,
+	      Paxos::get_lease_remaining(sent, expire, sent + transit,
+					 sent + transit, 0, margin, lease),
+	      1e-9);
+  // counted from when we received it
+  ASSERT_NEAR(3 - margin - transit,
+	      Paxos::get_lease_remaining(sent, expire, sent + transit,
+					 sent + transit + 2, 0, margin, lease),
+	      1e-9);
+  ASSERT_EQ(0.0, Paxos::get_lease_remaining(sent, expire, sent + transit,
+					    sent + 6, 0, margin, lease));
+
+  // our clock 10s behind the leader's
+  for (double skew : {-10.0, 0.0}) {
+    // whether the time checks measured it or not, the lease is counted
+    // from its receipt rather than up to its expiration on our clock
+    double recv = sent - 10 + transit;
+    ASSERT_NEAR(
+      skew ? 5 - margin - transit : 5 - margin,
+      Paxos::get_lease_remaining(sent, expire, recv, recv, skew, margin,
+				 lease),
+      1e-9);
+  }
+
+  // our clock 10s ahead of the leader's, measured by the time checks
+  {
+    double recv = sent + 10 + transit;
+    ASSERT_NEAR(5 - margin - transit,
+		Paxos::get_lease_remaining(sent, expire, recv, recv, 10,
+					   margin, lease),
+		1e-9);
+    // not measured yet: the lease looks stale, and is not counted on
+    ASSERT_EQ(0.0, Paxos::get_lease_remaining(sent, expire, recv, recv, 0,
+					      margin, lease));
+  }
+
+  // a lease delayed by more than the margin is dropped
+  ASSERT_EQ(0.0, Paxos::get_lease_remaining(sent, expire, sent + 0.2,
+					    sent + 0.2, 0, margin, lease));
+  ASSERT_EQ(0.0, Paxos::get_lease_remaining(sent, expire, sent + 10.2,
+					    sent + 10.2, 10, margin, lease));
+
+  // never past its expiration on the leader's clock, converted to ours
+  ASSERT_NEAR(1 - margin,
+	      Paxos::get_lease_remaining(sent, expire, sent + transit,
+					 expire - 1, 0, margin, lease),
+	      1e-9);
+  ASSERT_NEAR(1 - margin,
+	      Paxos::get_lease_remaining(sent, expire, sent + 2 + transit,
+					 expire + 2 - 1, 2, margin, lease),
+	      1e-9);
+
+  // nor longer than mon_lease, whatever the leader granted
+  ASSERT_NEAR(lease - margin,
+	      Paxos::get_lease_remaining(sent, sent + 60, sent, sent, 0,
+					 margin, lease),
+	      1e-9);
+}
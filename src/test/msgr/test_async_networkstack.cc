@@ -71,7 +71,8 @@ class NetworkWorkerTest : public ::testing::TestWithParam<const char*> {
   void SetUp() override {
     cerr << __func__ << " start set up " << GetParam() << std::endl;
     if (strncmp(GetParam(), "dpdk", 4)) {
-      g_ceph_context->_conf.set_val("ms_type", "async+posix");
+      g_ceph_context->_conf.set_val("ms_type",
+				    std::string("async+") + GetParam());
       addr = "127.0.0.1:15000";
       port_addr = "127.0.0.1:15001";
     } else {
@@ -1061,6 +1062,9 @@ INSTANTIATE_TEST_SUITE_P(
   ::testing::Values(
 #ifdef HAVE_DPDK
     "dpdk",
+#endif
+#ifdef HAVE_LIBURING
+    "io_uring",
 #endif
     "posix"
   )
@@ -0,0 +1,76 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <chrono>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "common/Formatter.h"
+#include "msg/ConnectionLatency.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+std::string dump(const ConnectionLatency& l)
+{
+  std::unique_ptr<ceph::Formatter> f(ceph::Formatter::create("json"));
+  f->open_object_section("latency");
+  l.dump(f.get());
+  f->close_section();
+  std::ostringstream ss;
+  f->flush(ss);
+  return ss.str();
+}
+
+} // anonymous namespace
+
+TEST(ConnectionLatency, Empty)
+{
+  ConnectionLatency l;
+  const auto s = dump(l);
+  for (auto stage : {"out_queue", "send", "recv", "dispatch_queue"}) {
+    ASSERT_NE(std::string::npos, s.find(std::string("\"") + stage + "\""));
+  }
+  ASSERT_NE(std::string::npos, s.find("\"count\":0,\"avg_usec\":0"));
+  ASSERT_NE(std::string::npos, s.find("\"p99_usec\":0"));
+}
+
+TEST(ConnectionLatency, Percentiles)
+{
+  ConnectionLatency l;
+  // 90 fast ones, 9 slower and a slow one
+  for (int i = 0; i < 90; ++i) {
+    l.add(ConnectionLatency::RECV, 10us);
+  }
+  for (int i = 0; i < 9; ++i) {
+    l.add(ConnectionLatency::RECV, 1ms);
+  }
+  l.add(ConnectionLatency::RECV, utime_t(1, 0));
+  const auto s = dump(l);
+  // 10us falls in [8, 15], 1000us in [512, 1023], 1s in [2^19, 2^20 - 1]
+  ASSERT_NE(std::string::npos,
+	    s.find("\"recv\":{\"count\":100,\"avg_usec\":10099,"
+		   "\"p50_usec\":15,\"p90_usec\":15,\"p99_usec\":1023,"));
+  // the other stages are left alone
+  ASSERT_NE(std::string::npos, s.find("\"send\":{\"count\":0,"));
+}
+
+TEST(ConnectionLatency, Overflow)
+{
+  ConnectionLatency l;
+  // beyond the last bucket
+  l.add(ConnectionLatency::SEND, std::chrono::hours(1000));
+  const auto s = dump(l);
+  ASSERT_NE(std::string::npos, s.find("\"p50_usec\":536870912"));
+}
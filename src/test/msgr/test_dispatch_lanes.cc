@@ -0,0 +1,306 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/PrioritizedQueue.h"
+#include "common/ceph_time.h"
+#include "msg/DispatchLanes.h"
+
+namespace {
+
+struct item_t {
+  uint64_t session = 0;
+  uint64_t seq = 0;
+  ceph::mono_time stamp;
+};
+
+using Lanes = DispatchLanes<item_t>;
+
+// pushing from a thread of its own gives a test a fresh producer slot
+template <typename F>
+void in_thread(F&& f)
+{
+  std::thread t(std::forward<F>(f));
+  t.join();
+}
+
+bool pop(Lanes& lanes, item_t *out, std::vector<item_t> *dropped = nullptr)
+{
+  uint64_t id;
+  return lanes.pop(out, &id, [dropped](item_t&& i) {
+    if (dropped) {
+      dropped->push_back(i);
+    }
+  });
+}
+
+} // anonymous namespace
+
+TEST(DispatchLanes, LanesInOrder)
+{
+  Lanes lanes(16, 1024);
+  in_thread([&] {
+    bool wake;
+    ASSERT_TRUE(lanes.push(Lanes::lane_of(CEPH_MSG_PRIO_LOW - 1), 1, 1,
+			   item_t{1, 0}, &wake));
+    ASSERT_TRUE(lanes.push(Lanes::lane_of(CEPH_MSG_PRIO_DEFAULT), 1, 2,
+			   item_t{1, 1}, &wake));
+    ASSERT_TRUE(lanes.push(Lanes::lane_of(CEPH_MSG_PRIO_HIGHEST), 1, 3,
+			   item_t{1, 2}, &wake));
+    ASSERT_FALSE(wake);
+  });
+  ASSERT_EQ(3u, lanes.size());
+  ASSERT_EQ(1.0, lanes.get_oldest_stamp());
+  item_t i;
+  ASSERT_TRUE(pop(lanes, &i));
+  ASSERT_EQ(2u, i.seq);
+  ASSERT_TRUE(pop(lanes, &i));
+  ASSERT_EQ(1u, i.seq);
+  ASSERT_TRUE(pop(lanes, &i));
+  ASSERT_EQ(0u, i.seq);
+  ASSERT_FALSE(pop(lanes, &i));
+  ASSERT_TRUE(lanes.empty());
+  ASSERT_EQ(0.0, lanes.get_oldest_stamp());
+}
+
+TEST(DispatchLanes, Overflow)
+{
+  Lanes lanes(4, 1024);
+  item_t i;
+  // fill the ring, spill, and check that the ring is not used again before
+  // the spilled items are popped
+  in_thread([&] {
+    bool wake;
+    for (uint64_t seq = 0; seq < 10; ++seq) {
+      ASSERT_TRUE(lanes.push(Lanes::LANE_DEFAULT, 1, 1, item_t{1, seq},
+			     &wake));
+    }
+  });
+  ASSERT_TRUE(pop(lanes, &i));
+  ASSERT_EQ(0u, i.seq);
+  in_thread([&] {
+    bool wake;
+    ASSERT_TRUE(lanes.push(Lanes::LANE_DEFAULT, 1, 1, item_t{1, 10}, &wake));
+  });
+  ASSERT_EQ(10u, lanes.size());
+  // that was another thread, hence another producer
+  for (uint64_t seq : {10, 1, 2, 3, 4, 5, 6, 7, 8, 9}) {
+    ASSERT_TRUE(pop(lanes, &i));
+    ASSERT_EQ(seq, i.seq);
+  }
+  ASSERT_FALSE(pop(lanes, &i));
+}
+
+TEST(DispatchLanes, Discard)
+{
+  Lanes lanes(4, 1024);
+  std::vector<item_t> dropped;
+  item_t i;
+  std::thread producer;
+  ceph::mutex lock = ceph::make_mutex("DispatchLanes::Discard");
+  ceph::condition_variable cond;
+  int step = 0;
+  auto wait_step = [&](int s) {
+    std::unique_lock l{lock};
+    cond.wait(l, [&] { return step >= s; });
+  };
+  auto next_step = [&] {
+    std::lock_guard l{lock};
+    ++step;
+    cond.notify_all();
+  };
+
+  producer = std::thread([&] {
+    bool wake;
+    for (uint64_t seq = 0; seq < 6; ++seq) {
+      lanes.push(Lanes::LANE_DEFAULT, 1 + seq % 2, 1, item_t{1 + seq % 2, seq},
+		 &wake);
+    }
+    next_step();
+    wait_step(2);
+    // queued after the discard, so not dropped
+    lanes.push(Lanes::LANE_DEFAULT, 1, 1, item_t{1, 6}, &wake);
+    next_step();
+  });
+  wait_step(1);
+  lanes.discard(1);
+  next_step();
+  wait_step(3);
+  producer.join();
+
+  std::vector<uint64_t> popped;
+  while (pop(lanes, &i, &dropped)) {
+    popped.push_back(i.seq);
+  }
+  ASSERT_EQ(std::vector<uint64_t>({1, 3, 5, 6}), popped);
+  ASSERT_EQ(3u, dropped.size());
+  ASSERT_TRUE(lanes.empty());
+}
+
+TEST(DispatchLanes, NoProducerSlot)
+{
+  Lanes lanes(4, 0);
+  bool wake;
+  item_t i{1, 1};
+  ASSERT_FALSE(lanes.push(Lanes::LANE_DEFAULT, 1, 1, std::move(i), &wake));
+  ASSERT_TRUE(lanes.empty());
+}
+
+namespace {
+
+/*
+ * An MDS-like load: 'workers' messenger threads each serving many client
+ * sessions, sending small requests of mixed priorities to one dispatch
+ * thread, which checks that each session is seen in order.
+ */
+struct workload_t {
+  unsigned workers;
+  unsigned sessions_per_worker;
+  unsigned messages_per_session;
+};
+
+struct result_t {
+  double seconds = 0;
+  std::vector<double> latencies;  // in us, sorted
+};
+
+class LockedQueue {
+  ceph::mutex lock = ceph::make_mutex("LockedQueue::lock");
+  ceph::condition_variable cond;
+  PrioritizedQueue<item_t, uint64_t> q{16 << 20, 64 << 10};
+public:
+  void push(int prio, uint64_t id, item_t&& i) {
+    std::lock_guard l{lock};
+    if (prio >= CEPH_MSG_PRIO_LOW) {
+      q.enqueue_strict(id, prio, std::move(i));
+    } else {
+      q.enqueue(id, prio, 1, std::move(i));
+    }
+    cond.notify_all();
+  }
+  item_t pop() {
+    std::unique_lock l{lock};
+    cond.wait(l, [this] { return !q.empty(); });
+    return q.dequeue();
+  }
+};
+
+class LanesQueue {
+  ceph::mutex lock = ceph::make_mutex("LanesQueue::lock");
+  ceph::condition_variable cond;
+  Lanes lanes{1024, 1024};
+public:
+  void push(int prio, uint64_t id, item_t&& i) {
+    bool wake = false;
+    ceph_assert(lanes.push(Lanes::lane_of(prio), id, 1, std::move(i), &wake));
+    if (wake) {
+      std::lock_guard l{lock};
+      cond.notify_all();
+    }
+  }
+  item_t pop() {
+    item_t i;
+    uint64_t id;
+    std::unique_lock l{lock};
+    while (!lanes.pop(&i, &id, [](item_t&&) {})) {
+      if (lanes.prepare_sleep()) {
+	cond.wait(l);
+      }
+      lanes.wake_up();
+    }
+    return i;
+  }
+};
+
+template <typename Queue>
+result_t run_workload(const workload_t& w)
+{
+  Queue q;
+  const uint64_t total = (uint64_t)w.workers * w.sessions_per_worker *
+    w.messages_per_session;
+  result_t r;
+  r.latencies.reserve(total);
+  auto start = ceph::mono_clock::now();
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < w.workers; ++t) {
+    workers.emplace_back([&q, &w, t] {
+      for (unsigned m = 0; m < w.messages_per_session; ++m) {
+	for (unsigned s = 0; s < w.sessions_per_worker; ++s) {
+	  const uint64_t session = t * w.sessions_per_worker + s + 1;
+	  // one session in 16 is doing something important
+	  const int prio = session % 16 == 0 ?
+	    CEPH_MSG_PRIO_HIGH : CEPH_MSG_PRIO_DEFAULT;
+	  q.push(prio, session,
+		 item_t{session, m, ceph::mono_clock::now()});
+	}
+      }
+    });
+  }
+
+  std::map<uint64_t, uint64_t> next;
+  for (uint64_t n = 0; n < total; ++n) {
+    item_t i = q.pop();
+    r.latencies.push_back(
+      std::chrono::duration<double, std::micro>(
+	ceph::mono_clock::now() - i.stamp).count());
+    ceph_assert(next[i.session]++ == i.seq);
+  }
+  r.seconds = std::chrono::duration<double>(
+    ceph::mono_clock::now() - start).count();
+  for (auto& t : workers) {
+    t.join();
+  }
+  std::sort(r.latencies.begin(), r.latencies.end());
+  return r;
+}
+
+void report(const char *name, const workload_t& w, const result_t& r)
+{
+  auto pct = [&r](double p) {
+    return r.latencies[std::min<size_t>(r.latencies.size() * p,
+					r.latencies.size() - 1)];
+  };
+  std::cout << name << " workers " << w.workers
+	    << " sessions " << w.workers * w.sessions_per_worker
+	    << ": " << r.latencies.size() / r.seconds / 1000 << " kmsg/s"
+	    << ", latency us p50 " << pct(0.5)
+	    << " p99 " << pct(0.99)
+	    << " max " << r.latencies.back()
+	    << std::endl;
+}
+
+} // anonymous namespace
+
+TEST(DispatchLanes, Workload)
+{
+  workload_t w{4, 64, 100};
+  auto r = run_workload<LanesQueue>(w);
+  ASSERT_EQ(4u * 64 * 100, r.latencies.size());
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(DispatchLanes, DISABLED_Benchmark)
+{
+  for (unsigned workers : {1, 3, 8, 16}) {
+    workload_t w{workers, 4096 / workers, 256};
+    report("locked", w, run_workload<LockedQueue>(w));
+    report("lanes ", w, run_workload<LanesQueue>(w));
+  }
+}
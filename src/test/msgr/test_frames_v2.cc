@@ -13,17 +13,22 @@
  */
 
 #include "msg/async/frames_v2.h"
+#include "msg/async/compression_onwire.h"
 
 #include <numeric>
 #include <ostream>
 #include <string>
 #include <tuple>
 
+#include <fmt/format.h>
+
 #include "auth/Auth.h"
 #include "common/ceph_argparse.h"
+#include "common/ceph_time.h"
 #include "global/global_init.h"
 #include "global/global_context.h"
 #include "include/Context.h"
+#include "include/msgr.h"
 
 #include <gtest/gtest.h>
 
@@ -38,6 +43,10 @@ struct TestFrame : Frame<TestFrame,
                          segment_t::PAGE_SIZE_ALIGNMENT> {
   static constexpr Tag tag = static_cast<Tag>(123);
 
+  auto& get_segments() {
+    return segments;
+  }
+
   static TestFrame Encode(const bufferlist& header,
                           const bufferlist& front,
                           const bufferlist& middle,
@@ -130,6 +139,21 @@ static bufferlist make_bufferlist(size_t len, char c) {
   return bl;
 }
 
+// a copy of 'bl' made of buffers of the given (repeated) lengths
+static bufferlist fragment(const bufferlist& bl,
+                           const std::vector<uint32_t>& lens) {
+  bufferlist out;
+  auto p = bl.cbegin();
+  for (size_t i = 0; p.get_remaining() > 0; i++) {
+    uint32_t len = std::min<uint32_t>(lens[i % lens.size()],
+                                      p.get_remaining());
+    bufferptr bp(len);
+    p.copy(len, bp.c_str());
+    out.push_back(std::move(bp));
+  }
+  return out;
+}
+
 bool disassemble_frame(FrameAssembler& frame_asm, bufferlist& frame_bl,
                        Tag& tag, segment_bls_t& segment_bls) {
   bufferlist preamble_bl;
@@ -200,8 +224,13 @@ protected:
               frame_asm.get_frame_onwire_len());
   }
 
-  void test_round_trip() {
-    auto tx_frame = TestFrame::Encode(m_header, m_front, m_middle, m_data);
+  void test_round_trip(const std::vector<uint32_t>& frag_lens = {}) {
+    auto tx_frame = frag_lens.empty() ?
+      TestFrame::Encode(m_header, m_front, m_middle, m_data) :
+      TestFrame::Encode(fragment(m_header, frag_lens),
+                        fragment(m_front, frag_lens),
+                        fragment(m_middle, frag_lens),
+                        fragment(m_data, frag_lens));
     auto onwire_bl = tx_frame.get_buffer(m_tx_frame_asm);
     check_frame_assembler(m_tx_frame_asm);
     EXPECT_EQ(m_tx_frame_asm.get_frame_onwire_len(), onwire_bl.length());
@@ -245,6 +274,84 @@ TEST_P(RoundTripTest, Reuse) {
   }
 }
 
+// segments made of many buffers, small and large (in secure mode, runs of
+// small ones are gathered before being encrypted)
+TEST_P(RoundTripTest, Fragmented) {
+  test_round_trip({1, 100, 5000, 7, 4096, 4095, 16});
+}
+
+// several frames assembled back to back into the same bufferlist, as
+// ProtocolV2 does when coalescing writes
+TEST_P(RoundTripTest, Batch) {
+  bufferlist onwire_bl;
+  onwire_bl.append("junk", 4);  // pretend a previous write is pending
+  for (int i = 0; i < 3; i++) {
+    auto tx_frame = TestFrame::Encode(m_header, m_front, m_middle, m_data);
+    tx_frame.append_buffer(m_tx_frame_asm, onwire_bl);
+    check_frame_assembler(m_tx_frame_asm);
+  }
+  EXPECT_EQ(4 + 3 * m_tx_frame_asm.get_frame_onwire_len(),
+            onwire_bl.length());
+
+  onwire_bl.splice(0, 4);
+  for (int i = 0; i < 3; i++) {
+    Tag rx_tag;
+    segment_bls_t rx_segment_bls;
+    EXPECT_TRUE(disassemble_frame(m_rx_frame_asm, onwire_bl, rx_tag,
+                                  rx_segment_bls));
+    EXPECT_EQ(TestFrame::tag, rx_tag);
+
+    auto rx_frame = TestFrame::Decode(rx_segment_bls);
+    EXPECT_TRUE(m_header.contents_equal(rx_frame.header()));
+    EXPECT_TRUE(m_front.contents_equal(rx_frame.front()));
+    EXPECT_TRUE(m_middle.contents_equal(rx_frame.middle()));
+    EXPECT_TRUE(m_data.contents_equal(rx_frame.data()));
+  }
+  EXPECT_EQ(0, onwire_bl.length());
+}
+
+// frames whose segments went through the compression streams, as
+// ProtocolV2 sends the messages when ms_compress_mode allows
+TEST_P(RoundTripTest, Compressed) {
+  using ceph::compression::onwire::rxtx_t;
+  if (!rxtx_t::is_supported()) {
+    GTEST_SKIP() << "no compression support";
+  }
+  auto tx = rxtx_t::create_tx_handler(g_ceph_context);
+  auto rx = rxtx_t::create_rx_handler(g_ceph_context);
+  for (int i = 0; i < 3; i++) {
+    auto tx_frame = TestFrame::Encode(m_header, m_front, m_middle, m_data);
+    for (auto& segment : tx_frame.get_segments()) {
+      if (segment.length() > 0) {
+        tx->compress(segment);
+      }
+    }
+    bufferlist onwire_bl;
+    tx_frame.append_buffer(m_tx_frame_asm, onwire_bl,
+                           FRAME_EARLY_DATA_STREAM_COMPRESSED);
+
+    Tag rx_tag;
+    segment_bls_t rx_segment_bls;
+    EXPECT_TRUE(disassemble_frame(m_rx_frame_asm, onwire_bl, rx_tag,
+                                  rx_segment_bls));
+    EXPECT_EQ(TestFrame::tag, rx_tag);
+    EXPECT_EQ(FRAME_EARLY_DATA_STREAM_COMPRESSED,
+              m_rx_frame_asm.get_preamble_flags());
+    for (size_t i = 0; i < rx_segment_bls.size(); i++) {
+      if (rx_segment_bls[i].length() > 0) {
+        rx->decompress(rx_segment_bls[i],
+                       m_rx_frame_asm.get_segment_align(i),
+                       ceph::compression::onwire::MAX_FRAME_SIZE);
+      }
+    }
+    auto rx_frame = TestFrame::Decode(rx_segment_bls);
+    EXPECT_TRUE(m_header.contents_equal(rx_frame.header()));
+    EXPECT_TRUE(m_front.contents_equal(rx_frame.front()));
+    EXPECT_TRUE(m_middle.contents_equal(rx_frame.middle()));
+    EXPECT_TRUE(m_data.contents_equal(rx_frame.data()));
+  }
+}
+
 static const round_trip_instance_t round_trip_instances[] = {
   // first segment is empty
   { 0,   0,   0,   0, 1, {{32,  0,  17,   0,   0,  0},
@@ -402,6 +509,55 @@ TEST_P(RoundTripPerfTest, DISABLED_Basic) {
   }
 }
 
+// Secure mode tx throughput, for segments made of buffers of various
+// sizes: a message data payload is often gathered from small buffers.
+class SecureTxPerfTest : public ::testing::TestWithParam<
+                             std::tuple<uint32_t, uint32_t, bool>> {
+protected:
+  SecureTxPerfTest()
+      : m_tx_frame_asm(&m_tx_crypto, std::get<2>(GetParam())) {
+    AuthConnectionMeta auth_meta;
+    auth_meta.con_mode = CEPH_CON_MODE_SECURE;
+    auth_meta.connection_secret.resize(64);
+    g_ceph_context->random()->get_bytes(auth_meta.connection_secret.data(),
+                                        auth_meta.connection_secret.size());
+    m_tx_crypto = ceph::crypto::onwire::rxtx_t::create_handler_pair(
+        g_ceph_context, auth_meta, /*new_nonce_format=*/std::get<2>(GetParam()),
+        /*crossed=*/false);
+  }
+
+  ceph::crypto::onwire::rxtx_t m_tx_crypto;
+  FrameAssembler m_tx_frame_asm;
+};
+
+TEST_P(SecureTxPerfTest, DISABLED_Basic) {
+  const auto& [data_len, frag_len, is_rev1] = GetParam();
+  const auto header = make_bufferlist(41, 'H');
+  const auto front = make_bufferlist(250, 'F');
+  const auto data = fragment(make_bufferlist(data_len, 'D'), {frag_len});
+
+  const uint64_t bytes = 1ull << 30;
+  const uint64_t iterations = std::max<uint64_t>(bytes / data_len, 1);
+  auto start = ceph::mono_clock::now();
+  for (uint64_t i = 0; i < iterations; i++) {
+    auto tx_frame = TestFrame::Encode(header, front, {}, data);
+    auto onwire_bl = tx_frame.get_buffer(m_tx_frame_asm);
+    ASSERT_EQ(m_tx_frame_asm.get_frame_onwire_len(), onwire_bl.length());
+  }
+  auto elapsed = ceph::to_seconds<double>(ceph::mono_clock::now() - start);
+  std::cout << "msgr2." << is_rev1 << "-secure " << data_len
+            << " bytes in " << (data_len + frag_len - 1) / frag_len
+            << " buffers: "
+            << iterations * data_len / elapsed / (1 << 20) << " MiB/s, "
+            << iterations / elapsed << " frames/s" << std::endl;
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    SecureTxPerfTests, SecureTxPerfTest, ::testing::Combine(
+        ::testing::Values(4096, 65536, 4194304),
+        ::testing::Values(512, 4096, 65536),
+        ::testing::Bool()));
+
 static const round_trip_instance_t round_trip_perf_instances[] = {
   {41, 250, 0,       0, 2, {{32, 41, 250, 17,       0,  0},
                             {32, 48, 256, 32,       0,  0},
@@ -434,6 +590,188 @@ INSTANTIATE_TEST_SUITE_P(
         ::testing::ValuesIn(round_trip_perf_instances),
         ::testing::ValuesIn(modes)));
 
+// small messages with the same structure, e.g. replication ops
+static bufferlist make_small_message(unsigned i) {
+  bufferlist bl;
+  bl.append(fmt::format("osd_repop(client.4{}:{} 2.{} e{}/{} "
+                        "2:{:08x}:::rbd_data.10{}:head v {}'{}, "
+                        "mlcod={}'{}) v3",
+                        i % 7, 1000 + i, i % 32, 40 + i / 100, 38,
+                        i * 2654435761u, i % 13, 40 + i / 100, 100 + i,
+                        40 + i / 100, 99 + i));
+  bl.append_zero(64);
+  return bl;
+}
+
+TEST(KernelTLS, Params) {
+  AuthConnectionMeta auth_meta;
+  auth_meta.con_mode = CEPH_CON_MODE_SECURE;
+  auth_meta.connection_secret.resize(64);
+  g_ceph_context->random()->get_bytes(auth_meta.connection_secret.data(),
+                                      auth_meta.connection_secret.size());
+  using ceph::crypto::onwire::rxtx_t;
+  auto client = rxtx_t::get_ktls_params(auth_meta, /*crossed=*/false);
+  auto server = rxtx_t::get_ktls_params(auth_meta, /*crossed=*/true);
+  // the same key and nonces as the userspace handlers
+  const char* secret = auth_meta.connection_secret.data();
+  EXPECT_EQ(0, memcmp(client.key.data(), secret, 16));
+  EXPECT_EQ(0, memcmp(client.rx_nonce.data(), secret + 16, 12));
+  EXPECT_EQ(0, memcmp(client.tx_nonce.data(), secret + 28, 12));
+  EXPECT_EQ(client.key, server.key);
+  EXPECT_EQ(client.tx_nonce, server.rx_nonce);
+  EXPECT_EQ(client.rx_nonce, server.tx_nonce);
+}
+
+TEST(CompressionOnwire, Stream) {
+  using ceph::compression::onwire::rxtx_t;
+  if (!rxtx_t::is_supported()) {
+    GTEST_SKIP() << "no compression support";
+  }
+  auto tx = rxtx_t::create_tx_handler(g_ceph_context);
+  auto rx = rxtx_t::create_rx_handler(g_ceph_context);
+  uint64_t raw_len = 0;
+  uint64_t stream_len = 0;
+  uint64_t oneshot_len = 0;
+  for (unsigned i = 0; i < 1000; i++) {
+    auto msg = make_small_message(i);
+    raw_len += msg.length();
+
+    auto bl = msg;
+    tx->compress(bl);
+    stream_len += bl.length();
+    rx->decompress(bl, segment_t::DEFAULT_ALIGNMENT,
+                   ceph::compression::onwire::MAX_FRAME_SIZE);
+    ASSERT_TRUE(msg.contents_equal(bl));
+
+    auto oneshot = msg;
+    rxtx_t::create_tx_handler(g_ceph_context)->compress(oneshot);
+    oneshot_len += oneshot.length();
+  }
+  std::cout << raw_len << " bytes: " << oneshot_len << " compressed alone, "
+            << stream_len << " compressed as a stream" << std::endl;
+  EXPECT_LT(stream_len * 2, oneshot_len);
+}
+
+TEST(CompressionOnwire, Large) {
+  using ceph::compression::onwire::rxtx_t;
+  if (!rxtx_t::is_supported()) {
+    GTEST_SKIP() << "no compression support";
+  }
+  auto tx = rxtx_t::create_tx_handler(g_ceph_context);
+  auto rx = rxtx_t::create_rx_handler(g_ceph_context);
+  // larger than the history buffers, with both compressible and random data
+  for (unsigned len : {1u << 20, 100u, 300000u, 4u << 20}) {
+    bufferlist data;
+    bufferptr bp(len);
+    for (unsigned i = 0; i < len; i++) {
+      bp.c_str()[i] = (i / 4096) % 2 ? rand() : i % 251;
+    }
+    data.append(std::move(bp));
+    auto bl = fragment(data, {4096, 100, 65536});
+    tx->compress(bl);
+    rx->decompress(bl, segment_t::PAGE_SIZE_ALIGNMENT,
+                   ceph::compression::onwire::MAX_FRAME_SIZE);
+    ASSERT_TRUE(data.contents_equal(bl));
+    ASSERT_TRUE(bl.is_aligned(segment_t::PAGE_SIZE_ALIGNMENT));
+  }
+}
+
+TEST(CompressionOnwire, Corrupted) {
+  using ceph::compression::onwire::rxtx_t;
+  using ceph::compression::onwire::DecompressError;
+  if (!rxtx_t::is_supported()) {
+    GTEST_SKIP() << "no compression support";
+  }
+  auto tx = rxtx_t::create_tx_handler(g_ceph_context);
+  auto bl = make_small_message(0);
+  tx->compress(bl);
+  {
+    auto truncated = bl;
+    truncated.splice(truncated.length() - 1, 1);
+    auto rx = rxtx_t::create_rx_handler(g_ceph_context);
+    EXPECT_THROW(rx->decompress(truncated, 8, 1 << 20), DecompressError);
+  }
+  {
+    // a frame out of the stream: it refers to data the receiver never saw
+    auto second = make_small_message(0);
+    tx->compress(second);
+    auto rx = rxtx_t::create_rx_handler(g_ceph_context);
+    EXPECT_THROW(rx->decompress(second, 8, 1 << 20), DecompressError);
+  }
+}
+
+TEST(CompressionOnwire, TooLarge) {
+  using ceph::compression::onwire::rxtx_t;
+  using ceph::compression::onwire::DecompressError;
+  if (!rxtx_t::is_supported()) {
+    GTEST_SKIP() << "no compression support";
+  }
+  // 1 MiB of zeros compresses to a few KiB
+  bufferlist data;
+  data.append_zero(1 << 20);
+  auto tx = rxtx_t::create_tx_handler(g_ceph_context);
+  auto bl = data;
+  tx->compress(bl);
+  ASSERT_LT(bl.length(), 16u << 10);
+  {
+    auto rx = rxtx_t::create_rx_handler(g_ceph_context);
+    auto copy = bl;
+    EXPECT_THROW(rx->decompress(copy, 8, (1 << 20) - 1), DecompressError);
+  }
+  auto rx = rxtx_t::create_rx_handler(g_ceph_context);
+  rx->decompress(bl, 8, 1 << 20);
+  EXPECT_TRUE(data.contents_equal(bl));
+}
+
+// The peers negotiate the stream compression with the features of their
+// banners: upstream releases advertise bit 1 for their own compression,
+// with its own frames and preamble flag, which must not be mistaken for it.
+TEST(CompressionOnwire, Banner) {
+  using ceph::compression::onwire::rxtx_t;
+  const uint64_t ours = CEPH_MSGR2_SUPPORTED_FEATURES |
+    rxtx_t::get_supported_features();
+  EXPECT_EQ(0u, ours & CEPH_MSGR2_FEATURE_COMPRESSION);
+  EXPECT_EQ(rxtx_t::is_supported(),
+            HAVE_MSGR2_FEATURE(ours, STREAM_COMPRESSION));
+  EXPECT_NE(FRAME_EARLY_DATA_COMPRESSED, FRAME_EARLY_DATA_STREAM_COMPRESSED);
+
+  // an upstream Quincy peer
+  EXPECT_FALSE(rxtx_t::is_negotiated(CEPH_MSGR2_FEATURE_REVISION_1 |
+                                     CEPH_MSGR2_FEATURE_COMPRESSION));
+  // an older peer
+  EXPECT_FALSE(rxtx_t::is_negotiated(CEPH_MSGR2_FEATURE_REVISION_1));
+  EXPECT_FALSE(rxtx_t::is_negotiated(0));
+  // a peer of this tree
+  EXPECT_EQ(rxtx_t::is_supported(), rxtx_t::is_negotiated(ours));
+  EXPECT_EQ(rxtx_t::is_supported(),
+            rxtx_t::is_negotiated(CEPH_MSGR2_FEATURE_REVISION_1 |
+                                  CEPH_MSGR2_FEATURE_COMPRESSION |
+                                  CEPH_MSGR2_FEATURE_STREAM_COMPRESSION));
+}
+
+TEST(CompressionOnwire, TxGate) {
+  ceph::compression::onwire::TxGate gate(100, 0.9);
+  EXPECT_FALSE(gate.want(99));
+  EXPECT_TRUE(gate.want(100));
+  EXPECT_FALSE(gate.want(ceph::compression::onwire::MAX_FRAME_SIZE + 1));
+  // compresses well
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(gate.want(1000));
+    gate.account(1000, 100);
+  }
+  // stops compressing once the average got over the limit ...
+  int compressed = 0;
+  while (gate.want(1000)) {
+    gate.account(1000, 1010);
+    ASSERT_LT(++compressed, 100);
+  }
+  // ... for a while
+  for (unsigned i = 1; i < gate.BACKOFF_FRAMES; i++) {
+    ASSERT_FALSE(gate.want(1000));
+  }
+  EXPECT_TRUE(gate.want(1000));
+}
+
 }  // namespace ceph::msgr::v2
 
 int main(int argc, char* argv[]) {
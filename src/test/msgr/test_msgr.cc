@@ -15,13 +15,18 @@
  */
 
 #include <atomic>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
 #include <stdlib.h>
 #include <time.h>
 #include <set>
 #include <list>
+#include "acconfig.h"
 #include "common/ceph_mutex.h"
 #include "common/ceph_argparse.h"
 #include "global/global_init.h"
@@ -1469,6 +1474,139 @@ TEST_P(MessengerTest, ClientStandbyTest) {
   client_msgr->wait();
 }
 
+#ifdef HAVE_LINUX_TLS_H
+// secure mode with a fixed connection secret, and no actual authentication
+class SecureDummyAuth : public DummyAuthClientServer {
+public:
+  explicit SecureDummyAuth(CephContext *cct) : DummyAuthClientServer(cct) {
+    for (unsigned i = 0; i < 64; i++) {
+      secret.push_back(i * 37 + 11);
+    }
+  }
+
+  int get_auth_request(
+    Connection *con,
+    AuthConnectionMeta *auth_meta,
+    uint32_t *method,
+    std::vector<uint32_t> *preferred_modes,
+    bufferlist *out) override {
+    *method = CEPH_AUTH_NONE;
+    *preferred_modes = { CEPH_CON_MODE_SECURE };
+    return 0;
+  }
+
+  int handle_auth_done(
+    Connection *con,
+    AuthConnectionMeta *auth_meta,
+    uint64_t global_id,
+    uint32_t con_mode,
+    const bufferlist& bl,
+    CryptoKey *session_key,
+    std::string *connection_secret) override {
+    *connection_secret = secret;
+    return 0;
+  }
+
+  uint32_t pick_con_mode(
+    int peer_type,
+    uint32_t auth_method,
+    const std::vector<uint32_t>& preferred_modes) override {
+    return CEPH_CON_MODE_SECURE;
+  }
+
+  int handle_auth_request(
+    Connection *con,
+    AuthConnectionMeta *auth_meta,
+    bool more,
+    uint32_t auth_method,
+    const bufferlist& bl,
+    bufferlist *reply) override {
+    auth_meta->connection_secret = secret;
+    return 1;
+  }
+
+  std::string secret;
+};
+
+// whether the kernel has the "tls" ULP, see probe_ktls() in PosixStack.cc
+static bool have_ktls()
+{
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return false;
+  }
+  int r = ::setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls"));
+  int err = r < 0 ? errno : 0;
+  ::close(fd);
+  return err != ENOENT && err != ENOPROTOOPT;
+}
+
+// the kernel TLS sessions set up so far, in both directions, per
+// /proc/net/tls_stat
+static std::pair<uint64_t, uint64_t> ktls_sessions()
+{
+  std::ifstream stat("/proc/net/tls_stat");
+  std::string name;
+  uint64_t value;
+  std::pair<uint64_t, uint64_t> sessions{0, 0};
+  while (stat >> name >> value) {
+    if (name == "TlsTxSw" || name == "TlsTxDevice") {
+      sessions.first += value;
+    } else if (name == "TlsRxSw" || name == "TlsRxDevice") {
+      sessions.second += value;
+    }
+  }
+  return sessions;
+}
+
+TEST_P(MessengerTest, KernelTLSTest) {
+  if (!have_ktls() || access("/proc/net/tls_stat", R_OK) != 0) {
+    GTEST_SKIP() << "no kernel TLS";
+  }
+  g_ceph_context->_conf.set_val("ms_ktls", "true");
+  SecureDummyAuth secure_auth(g_ceph_context);
+  secure_auth.auth_registry.refresh_config();
+  server_msgr->set_auth_client(&secure_auth);
+  server_msgr->set_auth_server(&secure_auth);
+  client_msgr->set_auth_client(&secure_auth);
+  client_msgr->set_auth_server(&secure_auth);
+
+  FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1");
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+
+  const auto before = ktls_sessions();
+  ConnectionRef conn = client_msgr->connect_to(server_msgr->get_mytype(),
+					       server_msgr->get_myaddrs());
+  // round trips over the kernel TLS socket
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(conn->send_message(new MPing()), 0);
+    std::unique_lock l{cli_dispatcher.lock};
+    cli_dispatcher.cond.wait(l, [&] { return cli_dispatcher.got_new; });
+    cli_dispatcher.got_new = false;
+  }
+  ASSERT_TRUE(conn->is_connected());
+  ASSERT_EQ(10u, static_cast<Session*>(conn->get_priv().get())->get_count());
+  // both ends of the connection switched to kernel TLS
+  const auto after = ktls_sessions();
+  ASSERT_LE(before.first + 2, after.first);
+  ASSERT_LE(before.second + 2, after.second);
+
+  conn->mark_down();
+  server_msgr->shutdown();
+  client_msgr->shutdown();
+  server_msgr->wait();
+  client_msgr->wait();
+  g_ceph_context->_conf.set_val("ms_ktls", "false");
+}
+#endif
+
 TEST_P(MessengerTest, AuthTest) {
   g_ceph_context->_conf.set_val("auth_cluster_required", "cephx");
   g_ceph_context->_conf.set_val("auth_service_required", "cephx");
@@ -0,0 +1,301 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msg/async/TimerWheel.h"
+
+using Wheel = TimerWheel<uint64_t>;
+
+namespace {
+
+// what the wheel expires when advancing to 'now'
+std::vector<uint64_t> expire(Wheel& w, uint64_t now)
+{
+  std::vector<uint64_t> values;
+  w.advance(now);
+  uint64_t id, value;
+  while (w.pop_expired(&id, &value)) {
+    values.push_back(value);
+  }
+  return values;
+}
+
+} // anonymous namespace
+
+TEST(TimerWheel, Basic)
+{
+  Wheel w(1000);
+  ASSERT_FALSE(w.next_tick());
+  w.add(1000, 1005, 5);
+  w.add(1000, 1001, 1);
+  w.add(1000, 1003, 3);
+  w.add(1000, 990, 0);   // in the past
+  ASSERT_EQ(4u, w.size());
+  ASSERT_EQ(1000u, *w.next_tick());
+  ASSERT_EQ(std::vector<uint64_t>({0, 1}), expire(w, 1002));
+  ASSERT_EQ(1003u, *w.next_tick());
+  ASSERT_EQ(std::vector<uint64_t>({3, 5}), expire(w, 1010));
+  ASSERT_TRUE(w.empty());
+  ASSERT_FALSE(w.next_tick());
+}
+
+TEST(TimerWheel, Cancel)
+{
+  Wheel w;
+  uint64_t a = w.add(0, 10, 1);
+  uint64_t b = w.add(0, 20, 2);
+  uint64_t c = w.add(0, 20, 3);
+  ASSERT_NE(0u, a);
+  ASSERT_TRUE(w.cancel(a));
+  ASSERT_FALSE(w.cancel(a));
+  ASSERT_FALSE(w.cancel(0));
+  ASSERT_FALSE(w.cancel(12345678));
+  // reuses the entry of 'a', with another id
+  uint64_t d = w.add(0, 30, 4);
+  ASSERT_NE(a, d);
+  ASSERT_FALSE(w.cancel(a));
+
+  // expired, but not popped yet
+  w.advance(25);
+  ASSERT_TRUE(w.cancel(b));
+  uint64_t id, value;
+  ASSERT_TRUE(w.pop_expired(&id, &value));
+  ASSERT_EQ(c, id);
+  ASSERT_EQ(3u, value);
+  ASSERT_FALSE(w.cancel(c));
+  ASSERT_FALSE(w.pop_expired(&id, &value));
+  ASSERT_EQ(1u, w.size());
+  ASSERT_TRUE(w.cancel(d));
+  ASSERT_TRUE(w.empty());
+}
+
+TEST(TimerWheel, Levels)
+{
+  Wheel w;
+  // one timer per level, and one beyond the reach of the wheels
+  const std::vector<uint64_t> ticks = {
+    100, 300, 70000, 20000000, Wheel::MAX_DELTA + 1000};
+  for (auto t : ticks) {
+    w.add(0, t, t);
+  }
+  uint64_t now = 0;
+  for (auto t : ticks) {
+    // the lower bound may be a cascade, but never after the timer
+    while (true) {
+      auto next = w.next_tick();
+      ASSERT_TRUE(next);
+      ASSERT_LE(*next, t);
+      ASSERT_GE(*next, now);
+      if (*next > now + 1) {
+	ASSERT_TRUE(expire(w, *next - 1).empty());
+      }
+      now = *next;
+      auto values = expire(w, now);
+      if (!values.empty()) {
+	ASSERT_EQ(std::vector<uint64_t>({t}), values);
+	ASSERT_EQ(t, now);
+	break;
+      }
+    }
+  }
+  ASSERT_TRUE(w.empty());
+}
+
+TEST(TimerWheel, Random)
+{
+  // against a multimap
+  std::mt19937_64 rng(42);
+  Wheel w;
+  std::multimap<uint64_t, uint64_t> ref;
+  std::map<uint64_t, std::multimap<uint64_t, uint64_t>::iterator> ids;
+  uint64_t now = 0;
+  uint64_t value = 0;
+  for (int round = 0; round < 2000; round++) {
+    for (int i = rng() % 20; i > 0; i--) {
+      const unsigned range = 4 << (rng() % 28);
+      const uint64_t when = now + rng() % range;
+      const uint64_t id = w.add(now, when, value);
+      // a timer in the past is due in the current tick
+      ids[id] = ref.emplace(std::max(when, w.get_current()), value);
+      value++;
+    }
+    for (int i = rng() % 10; i > 0 && !ids.empty(); i--) {
+      auto p = ids.lower_bound(rng());
+      if (p == ids.end()) {
+	p = ids.begin();
+      }
+      ASSERT_TRUE(w.cancel(p->first));
+      ref.erase(p->second);
+      ids.erase(p);
+    }
+    ASSERT_EQ(ref.size(), w.size());
+    if (!ref.empty()) {
+      // the ticks up to 'now' were processed already
+      ASSERT_LE(*w.next_tick(),
+		std::max(w.get_current(), ref.begin()->first));
+    }
+    now += rng() % (8 << (rng() % 24));
+    w.advance(now);
+    uint64_t id, v;
+    uint64_t last = 0;
+    while (w.pop_expired(&id, &v)) {
+      auto p = ids.find(id);
+      ASSERT_NE(p, ids.end());
+      ASSERT_EQ(p->second->second, v);
+      ASSERT_LE(p->second->first, now);
+      ASSERT_GE(p->second->first, last);
+      last = p->second->first;
+      ref.erase(p->second);
+      ids.erase(p);
+    }
+    if (!ref.empty()) {
+      ASSERT_GT(ref.begin()->first, now);
+    }
+  }
+}
+
+namespace {
+
+// the time events of an EventCenter, as they used to be kept
+class MapTimers {
+  struct timer_t {
+    uint64_t id;
+    uint64_t value;
+  };
+  std::multimap<uint64_t, timer_t> timers;
+  std::map<uint64_t, std::multimap<uint64_t, timer_t>::iterator> ids;
+  uint64_t next_id = 1;
+public:
+  uint64_t add(uint64_t now, uint64_t when, uint64_t value) {
+    uint64_t id = next_id++;
+    ids[id] = timers.emplace(when, timer_t{id, value});
+    return id;
+  }
+  bool cancel(uint64_t id) {
+    auto p = ids.find(id);
+    if (p == ids.end()) {
+      return false;
+    }
+    timers.erase(p->second);
+    ids.erase(p);
+    return true;
+  }
+  template <typename F>
+  void expire(uint64_t now, F&& f) {
+    while (!timers.empty() && timers.begin()->first <= now) {
+      auto p = timers.begin();
+      timer_t t = p->second;
+      ids.erase(t.id);
+      timers.erase(p);
+      f(t.value);
+    }
+  }
+};
+
+class WheelTimers {
+  Wheel w;
+public:
+  uint64_t add(uint64_t now, uint64_t when, uint64_t value) {
+    return w.add(now, when, value);
+  }
+  bool cancel(uint64_t id) {
+    return w.cancel(id);
+  }
+  template <typename F>
+  void expire(uint64_t now, F&& f) {
+    w.advance(now);
+    uint64_t id, value;
+    while (w.pop_expired(&id, &value)) {
+      f(value);
+    }
+  }
+};
+
+/*
+ * The timer churn of the connections of an OSD, in ticks of 1ms: each
+ * connection re-arms its inactivity timeout (15 minutes) whenever it
+ * receives a message, and now and then arms a short timer (a backoff, or
+ * a delayed wakeup) which mostly expires.
+ */
+struct churn_t {
+  unsigned connections;
+  unsigned messages_per_ms;
+  uint64_t ms;
+};
+
+struct conn_t {
+  uint64_t tick_id = 0;
+};
+
+template <typename Timers>
+double run_churn(const churn_t& c, uint64_t *fired)
+{
+  Timers timers;
+  std::vector<conn_t> conns(c.connections);
+  std::mt19937 rng(1);
+  *fired = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t now = 0; now < c.ms; ++now) {
+    for (unsigned m = 0; m < c.messages_per_ms; ++m) {
+      const unsigned n = rng() % c.connections;
+      auto& conn = conns[n];
+      if (conn.tick_id) {
+	timers.cancel(conn.tick_id);
+      }
+      // the value tells the short timers apart
+      conn.tick_id = timers.add(now, now + 900000, n);
+      if (m % 16 == 0) {
+	timers.add(now, now + 1 + rng() % 100, c.connections + n);
+      }
+    }
+    timers.expire(now, [fired](uint64_t) { ++*fired; });
+  }
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const char *name, const churn_t& c, double seconds)
+{
+  const double ops = (double)c.ms * c.messages_per_ms * (2 + 1.0 / 16);
+  std::cout << name << " connections " << c.connections
+	    << " messages/ms " << c.messages_per_ms
+	    << ": " << ops / seconds / 1e6 << " Mops/s" << std::endl;
+}
+
+} // anonymous namespace
+
+TEST(TimerWheel, Churn)
+{
+  churn_t c{1000, 10, 1000};
+  uint64_t map_fired, wheel_fired;
+  run_churn<MapTimers>(c, &map_fired);
+  run_churn<WheelTimers>(c, &wheel_fired);
+  ASSERT_EQ(map_fired, wheel_fired);
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(TimerWheel, DISABLED_Benchmark)
+{
+  for (unsigned connections : {1000, 10000}) {
+    churn_t c{connections, 100, 10000};
+    uint64_t fired;
+    report("multimap", c, run_churn<MapTimers>(c, &fired));
+    report("wheel   ", c, run_churn<WheelTimers>(c, &fired));
+  }
+}
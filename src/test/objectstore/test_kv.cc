@@ -161,6 +161,57 @@ TEST_P(KVTest, PutReopen) {
   fini();
 }
 
+TEST_P(KVTest, Ingest) {
+  ASSERT_EQ(0, db->create_and_open(cout));
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    bufferlist value;
+    value.append("old");
+    t->set("A", "1", value);
+    t->set("A", "2", value);
+    t->set("B", "1", value);
+    db->submit_transaction_sync(t);
+  }
+  std::map<std::pair<string,string>,bufferlist> kvs;
+  for (auto& k : {"10", "2", "3", "9"}) {
+    kvs[{"A", k}].append(string("new") + k);
+  }
+  kvs[{"AA", "1"}].append("new");
+  kvs[{"C", ""}].append("");
+  int r = db->ingest(kvs);
+  if (string(GetParam()) != "rocksdb") {
+    ASSERT_EQ(-EOPNOTSUPP, r);
+    fini();
+    return;
+  }
+  ASSERT_EQ(0, r);
+  fini();
+
+  init();
+  ASSERT_EQ(0, db->open(cout));
+  {
+    std::vector<std::pair<string,string>> expected = {
+      {"A", "1"}, {"A", "10"}, {"A", "2"}, {"A", "3"}, {"A", "9"},
+      {"AA", "1"}, {"B", "1"}, {"C", ""}};
+    std::vector<std::pair<string,string>> got;
+    auto it = db->get_wholespace_iterator();
+    for (it->seek_to_first(); it->valid(); it->next()) {
+      got.push_back(it->raw_key());
+    }
+    ASSERT_EQ(expected, got);
+    bufferlist v;
+    ASSERT_EQ(0, db->get("A", "1", &v));
+    ASSERT_EQ("old", _bl_to_str(v));
+    v.clear();
+    ASSERT_EQ(0, db->get("A", "2", &v));
+    ASSERT_EQ("new2", _bl_to_str(v));
+    v.clear();
+    ASSERT_EQ(0, db->get("A", "10", &v));
+    ASSERT_EQ("new10", _bl_to_str(v));
+  }
+  fini();
+}
+
 TEST_P(KVTest, BenchCommit) {
   int n = 1024;
   ASSERT_EQ(0, db->create_and_open(cout));
@@ -58,3 +58,109 @@ TEST(ECUtil, stripe_info_t)
             make_pair((uint64_t)0, 2*swidth));
 }
 
+
+TEST(ECUtil, offset_len_to_chunk_range)
+{
+  const uint64_t swidth = 4096;
+  const uint64_t ssize = 4;
+  const uint64_t csize = swidth / ssize;
+
+  ECUtil::stripe_info_t s(ssize, swidth);
+
+  // within a single chunk
+  ASSERT_EQ(s.offset_len_to_chunk_range(1, make_pair(csize + 10, (uint64_t)20)),
+	    make_pair((uint64_t)10, (uint64_t)20));
+  ASSERT_EQ(s.offset_len_to_chunk_range(0, make_pair(csize + 10, (uint64_t)20)).second,
+	    0u);
+  ASSERT_EQ(s.offset_len_to_chunk_range(2, make_pair(csize + 10, (uint64_t)20)).second,
+	    0u);
+
+  // across two chunks of a stripe
+  ASSERT_EQ(s.offset_len_to_chunk_range(0, make_pair(csize - 10, (uint64_t)20)),
+	    make_pair(csize - 10, (uint64_t)10));
+  ASSERT_EQ(s.offset_len_to_chunk_range(1, make_pair(csize - 10, (uint64_t)20)),
+	    make_pair((uint64_t)0, (uint64_t)10));
+
+  // across stripes: the tail of the first, the head of the last
+  ASSERT_EQ(s.offset_len_to_chunk_range(3, make_pair(swidth - 10, (uint64_t)20)),
+	    make_pair(csize - 10, (uint64_t)10));
+  ASSERT_EQ(s.offset_len_to_chunk_range(0, make_pair(swidth - 10, (uint64_t)20)),
+	    make_pair(csize, (uint64_t)10));
+  ASSERT_EQ(s.offset_len_to_chunk_range(1, make_pair(swidth - 10, (uint64_t)20)).second,
+	    0u);
+
+  // whole stripes
+  ASSERT_EQ(s.offset_len_to_chunk_range(2, make_pair(swidth, 2 * swidth)),
+	    s.aligned_offset_len_to_chunk(make_pair(swidth, 2 * swidth)));
+
+  // a chunk partially covered in several stripes
+  ASSERT_EQ(s.offset_len_to_chunk_range(1, make_pair(csize + 100, 2 * swidth)),
+	    make_pair((uint64_t)100, 2 * csize));
+}
+
+TEST(ECUtil, reassemble)
+{
+  const uint64_t swidth = 4096;
+  const uint64_t ssize = 4;
+  const uint64_t csize = swidth / ssize;
+
+  ECUtil::stripe_info_t s(ssize, swidth);
+
+  // three stripes of logical data, and the data chunks storing them
+  bufferlist logical;
+  for (uint64_t i = 0; i < 3 * swidth; ++i) {
+    logical.append((char)(i * 7 + i / 13));
+  }
+  map<int, bufferlist> chunks;
+  for (uint64_t stripe = 0; stripe < 3; ++stripe) {
+    for (unsigned i = 0; i < ssize; ++i) {
+      bufferlist bl;
+      bl.substr_of(logical, stripe * swidth + i * csize, csize);
+      chunks[i].claim_append(bl);
+    }
+  }
+
+  const pair<uint64_t, uint64_t> extents[] = {
+    {0, 1},
+    {csize - 1, 2},
+    {swidth - 100, 300},
+    {csize + 5, 2 * swidth},
+    {0, 3 * swidth},
+  };
+  for (auto &&e : extents) {
+    map<int, bufferlist> read;
+    for (unsigned i = 0; i < ssize; ++i) {
+      auto range = s.offset_len_to_chunk_range(i, e);
+      if (range.second) {
+	read[i].substr_of(chunks[i], range.first, range.second);
+      }
+    }
+    bufferlist out, expected;
+    ASSERT_EQ(0, ECUtil::reassemble(s, e, read, &out));
+    expected.substr_of(logical, e.first, e.second);
+    ASSERT_TRUE(out.contents_equal(expected));
+  }
+
+  // the reads beyond the end of the chunks are truncated
+  {
+    pair<uint64_t, uint64_t> e(2 * swidth + 10, 2 * swidth);
+    map<int, bufferlist> read;
+    for (unsigned i = 0; i < ssize; ++i) {
+      auto range = s.offset_len_to_chunk_range(i, e);
+      read[i].substr_of(chunks[i], range.first, 3 * csize - range.first);
+    }
+    bufferlist out, expected;
+    ASSERT_EQ(0, ECUtil::reassemble(s, e, read, &out));
+    expected.substr_of(logical, e.first, swidth - 10);
+    ASSERT_TRUE(out.contents_equal(expected));
+  }
+
+  // a missing data chunk
+  {
+    pair<uint64_t, uint64_t> e(csize - 1, 2);
+    map<int, bufferlist> read;
+    read[0].substr_of(chunks[0], csize - 1, 1);
+    bufferlist out;
+    ASSERT_EQ(-EIO, ECUtil::reassemble(s, e, read, &out));
+  }
+}
@@ -12,6 +12,7 @@
 #include "common/ceph_json.h"
 
 #include <iostream>
+#include <random>
 
 using namespace std;
 
@@ -1943,3 +1944,342 @@ TEST_F(OSDMapTest, BUG_48884)
     }
   }
 }
+
+TEST_F(OSDMapTest, LazyMappingFollowsIncrementals) {
+  set_up_map(12);
+  std::mt19937 rng(1234);
+  LazyOSDMapMapping lazy;
+  lazy.update_pools(osdmap);
+  const int n = get_num_osds();
+  auto random_pg = [&](int64_t pool) {
+    return pg_t(rng() % osdmap.get_pg_pool(pool)->get_pg_num(), pool);
+  };
+  auto random_osds = [&](unsigned num) {
+    std::set<int> s;
+    while (s.size() < num) {
+      s.insert(rng() % n);
+    }
+    return mempool::osdmap::vector<int32_t>(s.begin(), s.end());
+  };
+  std::set<pg_t> temps, primary_temps;
+  uint64_t hits = 0, misses = 0, dropped = 0;
+  for (int round = 0; round < 300; ++round) {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.fsid = osdmap.get_fsid();
+    const int64_t pool = rng() % 2 ? my_rep_pool : my_ec_pool;
+    const int x = rng() % n;
+    switch (rng() % 9) {
+    case 0:
+      if (osdmap.is_down(x) || osdmap.get_num_up_osds() > 8) {
+	inc.new_state[x] = CEPH_OSD_UP;
+      }
+      break;
+    case 1:
+      inc.new_weight[x] = std::array<uint32_t, 3>{
+	0, CEPH_OSD_IN / 2, CEPH_OSD_IN}[rng() % 3];
+      break;
+    case 2:
+      inc.new_primary_affinity[x] = std::array<uint32_t, 3>{
+	0, CEPH_OSD_MAX_PRIMARY_AFFINITY / 2,
+	CEPH_OSD_MAX_PRIMARY_AFFINITY}[rng() % 3];
+      break;
+    case 3:
+      {
+	pg_t pgid = random_pg(pool);
+	if (temps.erase(pgid)) {
+	  inc.new_pg_temp[pgid] = {};
+	} else {
+	  inc.new_pg_temp[pgid] = random_osds(3);
+	  temps.insert(pgid);
+	}
+      }
+      break;
+    case 4:
+      {
+	pg_t pgid = random_pg(pool);
+	if (primary_temps.erase(pgid)) {
+	  inc.new_primary_temp[pgid] = -1;
+	} else {
+	  inc.new_primary_temp[pgid] = x;
+	  primary_temps.insert(pgid);
+	}
+      }
+      break;
+    case 5:
+      {
+	pg_t pgid = random_pg(pool);
+	if (osdmap.have_pg_upmaps(pgid)) {
+	  inc.old_pg_upmap.insert(pgid);
+	  inc.old_pg_upmap_items.insert(pgid);
+	} else if (rng() % 2) {
+	  inc.new_pg_upmap[pgid] = random_osds(3);
+	} else {
+	  vector<int> raw;
+	  int primary;
+	  osdmap.pg_to_raw_osds(pgid, &raw, &primary);
+	  if (!raw.empty() && raw[0] != x) {
+	    inc.new_pg_upmap_items[pgid] = {{raw[0], x}};
+	  }
+	}
+      }
+      break;
+    case 6:
+      {
+	// a pool change which does not move anything
+	pg_pool_t pi = *osdmap.get_pg_pool(pool);
+	pi.snap_seq = pi.snap_seq + 1;
+	pi.last_change = inc.epoch;
+	inc.new_pools[pool] = pi;
+      }
+      break;
+    case 7:
+      if (round % 50 == 7) {
+	pg_pool_t pi = *osdmap.get_pg_pool(my_rep_pool);
+	pi.set_pg_num(pi.get_pg_num() + 8);
+	pi.set_pgp_num(pi.get_pgp_num() + 8);
+	pi.last_change = inc.epoch;
+	inc.new_pools[my_rep_pool] = pi;
+      }
+      break;
+    default:
+      // nothing changed for the PGs
+      inc.new_up_thru[x] = osdmap.get_epoch();
+      break;
+    }
+    dropped += lazy.invalidate(osdmap, inc);
+    osdmap.apply_incremental(inc);
+    lazy.update_pools(osdmap);
+
+    // whatever is still cached is the mapping of this epoch
+    for (auto& [id, pi] : osdmap.get_pools()) {
+      for (ps_t ps = 0; ps < pi.get_pg_num(); ++ps) {
+	pg_t pgid(ps, id);
+	LazyOSDMapMapping::mapping_t cached, expected;
+	LazyOSDMapMapping::calc(osdmap, pgid, &expected);
+	if (lazy.get(pgid, &cached)) {
+	  ++hits;
+	  ASSERT_EQ(expected.up, cached.up) << pgid << " epoch " << inc.epoch;
+	  ASSERT_EQ(expected.up_primary, cached.up_primary) << pgid;
+	  ASSERT_EQ(expected.acting, cached.acting) << pgid;
+	  ASSERT_EQ(expected.acting_primary, cached.acting_primary) << pgid;
+	} else {
+	  ++misses;
+	  if (rng() % 4) {
+	    lazy.set(pgid, std::move(expected));
+	  }
+	}
+      }
+    }
+  }
+  // most of the PGs survive most of the epochs
+  ASSERT_GT(hits, 4 * misses);
+  ASSERT_GT(dropped, 0u);
+  std::cout << "hits " << hits << " misses " << misses
+	    << " dropped " << dropped << std::endl;
+}
+
+TEST_F(OSDMapTest, LazyMappingDropsAll) {
+  set_up_map();
+  LazyOSDMapMapping lazy;
+  auto fill = [&] {
+    lazy.update_pools(osdmap);
+    for (auto& [id, pi] : osdmap.get_pools()) {
+      for (ps_t ps = 0; ps < pi.get_pg_num(); ++ps) {
+	LazyOSDMapMapping::mapping_t m;
+	LazyOSDMapMapping::calc(osdmap, pg_t(ps, id), &m);
+	lazy.set(pg_t(ps, id), std::move(m));
+      }
+    }
+    return lazy.get_num_cached();
+  };
+  const uint64_t all = fill();
+  ASSERT_EQ(128u, all);
+  {
+    // an osd may be picked for the PGs which rejected it so far
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[0] = CEPH_OSD_IN / 2;
+    ASSERT_GT(lazy.invalidate(osdmap, inc), 0u);
+    osdmap.apply_incremental(inc);
+    fill();
+    OSDMap::Incremental inc2(osdmap.get_epoch() + 1);
+    inc2.new_weight[0] = CEPH_OSD_IN;
+    ASSERT_EQ(all, lazy.invalidate(osdmap, inc2));
+    osdmap.apply_incremental(inc2);
+  }
+  {
+    ASSERT_EQ(all, fill());
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    CrushWrapper crush;
+    get_crush(osdmap, crush);
+    crush.encode(inc.crush, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    ASSERT_EQ(all, lazy.invalidate(osdmap, inc));
+    osdmap.apply_incremental(inc);
+  }
+}
+
+// the changes calc_pg_upmaps() made on a small pool before it tested its
+// candidates incrementally: for the same inputs it must still make the same
+TEST_F(OSDMapTest, CalcPgUpmapsRecorded) {
+  set_up_map(20, true);
+  int64_t pool_id;
+  {
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    pending_inc.new_pool_max = osdmap.get_pool_max();
+    pool_id = ++pending_inc.new_pool_max;
+    pg_pool_t empty;
+    auto p = pending_inc.get_new_pool(pool_id, &empty);
+    p->size = 3;
+    p->min_size = 1;
+    p->set_pg_num(128);
+    p->set_pgp_num(128);
+    p->type = pg_pool_t::TYPE_REPLICATED;
+    p->crush_rule = 0;
+    p->set_flag(pg_pool_t::FLAG_HASHPSPOOL);
+    pending_inc.new_pool_names[pool_id] = "small_pool";
+    osdmap.apply_incremental(pending_inc);
+  }
+  using upmaps_t = map<unsigned, vector<pair<int32_t,int32_t>>>;
+  // the pg_upmap_items of each round, at most 8 changes each
+  const vector<pair<int, upmaps_t>> recorded = {
+    {8, {{0, {{0, 11}}},
+	 {2, {{7, 2}}},
+	 {4, {{3, 11}}},
+	 {12, {{3, 2}}},
+	 {16, {{7, 11}}},
+	 {17, {{0, 11}, {13, 19}}},
+	 {18, {{13, 19}}}}},
+    {8, {{2, {{7, 2}, {0, 11}}},
+	 {9, {{1, 2}}},
+	 {12, {{3, 2}, {0, 6}}},
+	 {19, {{13, 11}}},
+	 {22, {{7, 11}}},
+	 {25, {{3, 19}}},
+	 {27, {{0, 8}, {1, 11}}}}},
+    {8, {{5, {{9, 2}}},
+	 {10, {{1, 10}}},
+	 {27, {{0, 8}, {1, 11}, {13, 14}}},
+	 {28, {{3, 8}}},
+	 {30, {{3, 15}, {7, 18}}},
+	 {33, {{7, 6}}},
+	 {39, {{13, 19}}}}},
+    {5, {{1, {{5, 14}, {17, 15}}},
+	 {6, {{9, 19}}},
+	 {15, {{0, 11}}},
+	 {40, {{13, 18}}}}},
+  };
+  // not shuffling the candidates
+  g_ceph_context->_conf.set_val("osd_calc_pg_upmaps_aggressively", "false");
+  auto next_round = [&](upmaps_t *upmaps, set<unsigned> *removed) {
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    int did = osdmap.calc_pg_upmaps(g_ceph_context, 1, 8, {pool_id},
+				    &pending_inc);
+    for (auto& [pg, items] : pending_inc.new_pg_upmap_items) {
+      (*upmaps)[pg.ps()].assign(items.begin(), items.end());
+    }
+    for (auto& pg : pending_inc.old_pg_upmap_items) {
+      removed->insert(pg.ps());
+    }
+    osdmap.apply_incremental(pending_inc);
+    return did;
+  };
+  for (auto& [changes, expected] : recorded) {
+    upmaps_t upmaps;
+    set<unsigned> removed;
+    ASSERT_EQ(changes, next_round(&upmaps, &removed));
+    ASSERT_EQ(expected, upmaps);
+    ASSERT_TRUE(removed.empty());
+  }
+  // osd.11 got most of the remapped pgs: once reweighted, one goes back
+  {
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    pending_inc.new_weight[11] = CEPH_OSD_IN / 2;
+    osdmap.apply_incremental(pending_inc);
+  }
+  {
+    upmaps_t upmaps;
+    set<unsigned> removed;
+    ASSERT_EQ(1, next_round(&upmaps, &removed));
+    ASSERT_TRUE(upmaps.empty());
+    ASSERT_EQ(set<unsigned>{0}, removed);
+  }
+  {
+    upmaps_t upmaps;
+    set<unsigned> removed;
+    ASSERT_EQ(0, next_round(&upmaps, &removed));
+  }
+  g_ceph_context->_conf.rm_val("osd_calc_pg_upmaps_aggressively");
+}
+
+// times calc_pg_upmaps() on a large pool; run with
+// --gtest_also_run_disabled_tests
+TEST_F(OSDMapTest, DISABLED_CalcPgUpmapsLatency) {
+  int osd_num = 1000;
+  int pg_num = 16384;
+  set_up_map(osd_num, true);
+  int64_t pool_id;
+  {
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    pending_inc.new_pool_max = osdmap.get_pool_max();
+    pool_id = ++pending_inc.new_pool_max;
+    pg_pool_t empty;
+    auto p = pending_inc.get_new_pool(pool_id, &empty);
+    p->size = 3;
+    p->min_size = 1;
+    p->set_pg_num(pg_num);
+    p->set_pgp_num(pg_num);
+    p->type = pg_pool_t::TYPE_REPLICATED;
+    p->crush_rule = 0;
+    p->set_flag(pg_pool_t::FLAG_HASHPSPOOL);
+    pending_inc.new_pool_names[pool_id] = "big_pool";
+    osdmap.apply_incremental(pending_inc);
+  }
+  auto max_deviation = [this, pool_id] {
+    map<int, int> pgs_by_osd;
+    for (int ps = 0; ps < osdmap.get_pg_pool(pool_id)->get_pg_num(); ++ps) {
+      vector<int> up;
+      osdmap.pg_to_up_acting_osds(pg_t(ps, pool_id), &up, nullptr,
+				  nullptr, nullptr);
+      for (auto osd : up) {
+	pgs_by_osd[osd]++;
+      }
+    }
+    float target = (float)osdmap.get_pg_pool(pool_id)->get_size() *
+      osdmap.get_pg_pool(pool_id)->get_pg_num() / osdmap.get_num_in_osds();
+    float dev = 0;
+    for (int osd = 0; osd < osdmap.get_max_osd(); ++osd) {
+      dev = std::max(dev, fabsf(pgs_by_osd[osd] - target));
+    }
+    return dev;
+  };
+  const float before = max_deviation();
+
+  // the same changes each time, as long as it does not shuffle things
+  g_ceph_context->_conf.set_val("osd_calc_pg_upmaps_aggressively", "false");
+  OSDMap::Incremental inc1(osdmap.get_epoch() + 1), inc2(osdmap.get_epoch() + 1);
+  ASSERT_EQ(osdmap.calc_pg_upmaps(g_ceph_context, 1, 100, {pool_id}, &inc1),
+	    osdmap.calc_pg_upmaps(g_ceph_context, 1, 100, {pool_id}, &inc2));
+  ASSERT_EQ(inc1.new_pg_upmap_items, inc2.new_pg_upmap_items);
+  ASSERT_EQ(inc1.old_pg_upmap_items, inc2.old_pg_upmap_items);
+  g_ceph_context->_conf.rm_val("osd_calc_pg_upmaps_aggressively");
+
+  int changes = 0;
+  auto start = mono_clock::now();
+  for (int round = 0; round < 5; ++round) {
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    int did = osdmap.calc_pg_upmaps(g_ceph_context, 1, 100, {pool_id},
+				    &pending_inc);
+    if (!did) {
+      break;
+    }
+    changes += did;
+    osdmap.apply_incremental(pending_inc);
+  }
+  auto latency = mono_clock::now() - start;
+  const float after = max_deviation();
+  std::cout << "calc_pg_upmaps (" << osd_num << " osds, " << pg_num
+	    << " pgs) " << changes << " changes, max deviation " << before
+	    << " -> " << after << ", latency: " << timespan_str(latency)
+	    << std::endl;
+  ASSERT_GT(changes, 0);
+  ASSERT_LT(after, before);
+}
@@ -13,6 +13,7 @@
  */
 
 #include <gtest/gtest.h>
+#include "erasure-code/ErasureCode.h"
 #include "osd/PGTransaction.h"
 #include "osd/ECTransaction.h"
 
@@ -122,3 +123,328 @@ TEST(ectransaction, many_writes)
   ASSERT_EQ(0u, plan.to_read.size());
   ASSERT_EQ(1u, plan.will_write.size());
 }
+
+// k data chunks and a single XOR parity chunk, updatable with parity
+// deltas
+class ErasureCodeXor : public ceph::ErasureCode {
+public:
+  explicit ErasureCodeXor(unsigned k) : k(k) {}
+
+  unsigned int get_chunk_count() const override {
+    return k + 1;
+  }
+  unsigned int get_data_chunk_count() const override {
+    return k;
+  }
+  unsigned int get_chunk_size(unsigned int object_size) const override {
+    return (object_size + k - 1) / k;
+  }
+  int encode_chunks(const std::set<int> &want_to_encode,
+		    std::map<int, bufferlist> *encoded) override {
+    char *parity = (*encoded)[k].c_str();
+    const unsigned len = (*encoded)[k].length();
+    memset(parity, 0, len);
+    for (unsigned i = 0; i < k; ++i) {
+      const char *data = (*encoded)[i].c_str();
+      for (unsigned j = 0; j < len; ++j) {
+	parity[j] ^= data[j];
+      }
+    }
+    return 0;
+  }
+  int decode_chunks(const std::set<int> &want_to_read,
+		    const std::map<int, bufferlist> &chunks,
+		    std::map<int, bufferlist> *decoded) override {
+    return -EOPNOTSUPP;
+  }
+  bool supports_parity_delta() const override {
+    return true;
+  }
+  int apply_delta(const std::map<int, bufferptr> &in,
+		  std::map<int, bufferptr> &out) override {
+    char *parity = out.at(k).c_str();
+    for (auto &&[shard, delta] : in) {
+      for (unsigned j = 0; j < delta.length(); ++j) {
+	parity[j] ^= delta[j];
+      }
+    }
+    return 0;
+  }
+
+private:
+  const unsigned k;
+};
+
+namespace {
+
+const unsigned delta_k = 4;
+const ECUtil::stripe_info_t delta_sinfo(delta_k, delta_k * 4096);
+const uint64_t delta_object_size = 2 * delta_sinfo.get_stripe_width();
+
+hobject_t delta_oid()
+{
+  return hobject_t("delta", "", CEPH_NOSNAP, 0, 1, "");
+}
+
+bufferlist pattern(uint64_t len, char seed)
+{
+  bufferlist bl;
+  bufferptr p(len);
+  for (uint64_t i = 0; i < len; ++i) {
+    p[i] = seed + i * 7 + i / 251;
+  }
+  bl.append(std::move(p));
+  return bl;
+}
+
+// the plan of overwriting the (off, len, seed) extents of the object
+ECTransaction::WritePlan plan_overwrite(
+  const std::vector<std::tuple<uint64_t, uint64_t, char>> &writes)
+{
+  PGTransactionUPtr t(new PGTransaction);
+  const hobject_t oid = delta_oid();
+  for (auto &[off, len, seed] : writes) {
+    bufferlist bl = pattern(len, seed);
+    t->write(oid, off, len, bl, 0);
+  }
+  ObjectContextRef obc(new ObjectContext);
+  obc->obs.oi.soid = oid;
+  t->add_obc(obc);
+  return ECTransaction::get_write_plan(
+    delta_sinfo,
+    std::move(t),
+    [&](const hobject_t &i) {
+      ECUtil::HashInfoRef ref(new ECUtil::HashInfo(delta_k + 1));
+      ref->set_total_chunk_size_clear_hash(
+	delta_sinfo.aligned_logical_offset_to_chunk_offset(delta_object_size));
+      ref->set_projected_total_logical_size(delta_sinfo, delta_object_size);
+      return ref;
+    },
+    &dpp);
+}
+
+// the writes and the clone ranges of each shard
+struct ShardOps {
+  std::map<int, std::map<uint64_t, bufferlist>> writes;
+  std::map<int, std::vector<std::pair<uint64_t, uint64_t>>> clones;
+};
+
+ShardOps collect_shard_ops(
+  std::map<shard_id_t, ObjectStore::Transaction> &transactions)
+{
+  ShardOps ops;
+  for (auto &&[shard, t] : transactions) {
+    for (auto i = t.begin(); i.have_op(); ) {
+      auto op = i.decode_op();
+      switch (op->op) {
+      case ObjectStore::Transaction::OP_WRITE:
+	i.decode_bl(ops.writes[shard.id][op->off]);
+	break;
+      case ObjectStore::Transaction::OP_CLONERANGE2:
+	ops.clones[shard.id].emplace_back(op->off, op->len);
+	break;
+      case ObjectStore::Transaction::OP_SETATTR:
+	{
+	  i.decode_string();
+	  bufferlist bl;
+	  i.decode_bl(bl);
+	}
+	break;
+      case ObjectStore::Transaction::OP_SETATTRS:
+	{
+	  std::map<std::string, bufferlist> aset;
+	  i.decode_attrset(aset);
+	}
+	break;
+      default:
+	break;
+      }
+    }
+  }
+  return ops;
+}
+
+struct RollbackExtents : public ObjectModDesc::Visitor {
+  std::vector<std::pair<uint64_t, uint64_t>> extents;
+  void rollback_extents(
+    version_t gen,
+    const std::vector<std::pair<uint64_t, uint64_t>> &e) override {
+    extents.insert(extents.end(), e.begin(), e.end());
+  }
+};
+
+// generates the transactions of the plan and returns the rollback
+// extents of the log entry
+std::vector<std::pair<uint64_t, uint64_t>> generate(
+  ECTransaction::WritePlan &plan,
+  const std::map<hobject_t, extent_map> &partial_extents,
+  const std::map<hobject_t, std::map<int, extent_map>> &delta_reads,
+  std::map<shard_id_t, ObjectStore::Transaction> *transactions)
+{
+  ceph::ErasureCodeInterfaceRef ecimpl(new ErasureCodeXor(delta_k));
+  std::vector<pg_log_entry_t> entries;
+  entries.emplace_back(pg_log_entry_t::MODIFY, delta_oid(),
+		       eversion_t(1, 2), eversion_t(1, 1), 2,
+		       osd_reqid_t(), utime_t(), 0);
+  for (unsigned i = 0; i <= delta_k; ++i) {
+    (*transactions)[shard_id_t(i)];
+  }
+  std::map<hobject_t, extent_map> written;
+  std::set<hobject_t> temp_added, temp_removed;
+  ECTransaction::generate_transactions(
+    plan, ecimpl, pg_t(1, 0), delta_sinfo, partial_extents, delta_reads,
+    entries, &written, transactions, &temp_added, &temp_removed, &dpp);
+  RollbackExtents rollback;
+  entries.front().mod_desc.visit(&rollback);
+  return rollback.extents;
+}
+
+} // anonymous namespace
+
+TEST(ectransaction, plan_parity_delta)
+{
+  const hobject_t oid = delta_oid();
+  ceph::ErasureCodeInterfaceRef ecimpl(new ErasureCodeXor(delta_k));
+  {
+    // chunk 1 of the first stripe and chunk 0 of the second one
+    auto plan = plan_overwrite({{5000, 100, 'a'}, {20000, 300, 'b'}});
+    ASSERT_EQ(1u, plan.to_read.count(oid));
+    const extent_set full_read = plan.to_read.at(oid);
+    const extent_set full_write = plan.will_write.at(oid);
+    ASSERT_TRUE(ECTransaction::plan_parity_delta(
+		  plan, oid, delta_sinfo, ecimpl, &dpp));
+    ASSERT_EQ(0u, plan.to_read.count(oid));
+    auto &dplan = plan.delta_plans.at(oid);
+    ASSERT_EQ(full_read, dplan.stripes);
+    ASSERT_EQ(full_read, dplan.orig_to_read);
+    ASSERT_EQ(full_write, dplan.orig_will_write);
+    ASSERT_EQ((std::set<int>{0, 1}), dplan.data_shards);
+    ASSERT_EQ((std::set<int>{0, 1, 4}), dplan.to_read);
+    extent_set written;
+    written.insert(5000, 100);
+    written.insert(20000, 300);
+    ASSERT_EQ(written, plan.will_write.at(oid));
+
+    ECTransaction::revert_parity_delta(plan, oid);
+    ASSERT_EQ(0u, plan.delta_plans.size());
+    ASSERT_EQ(full_read, plan.to_read.at(oid));
+    ASSERT_EQ(full_write, plan.will_write.at(oid));
+  }
+  {
+    // all the data chunks of a stripe, cheaper to rewrite in full
+    auto plan = plan_overwrite({{100, 4 * 4096 - 200, 'c'}});
+    ASSERT_FALSE(ECTransaction::plan_parity_delta(
+		   plan, oid, delta_sinfo, ecimpl, &dpp));
+    ASSERT_EQ(1u, plan.to_read.count(oid));
+    ASSERT_EQ(0u, plan.delta_plans.size());
+  }
+}
+
+TEST(ectransaction, parity_delta_vs_full_stripe)
+{
+  const hobject_t oid = delta_oid();
+  const std::vector<std::tuple<uint64_t, uint64_t, char>> writes = {
+    {5000, 100, 'a'}, {20000, 300, 'b'}};
+  ceph::ErasureCodeInterfaceRef ecimpl(new ErasureCodeXor(delta_k));
+
+  // the object before the writes, and its chunks
+  bufferlist old_data = pattern(delta_object_size, 'z');
+  std::map<int, bufferlist> old_chunks;
+  {
+    std::set<int> want;
+    for (unsigned i = 0; i <= delta_k; ++i) {
+      want.insert(i);
+    }
+    bufferlist in = old_data;
+    ASSERT_EQ(0, ECUtil::encode(delta_sinfo, ecimpl, in, want, &old_chunks));
+  }
+
+  // full stripe read-modify-write
+  auto full_plan = plan_overwrite(writes);
+  std::map<hobject_t, extent_map> partial_extents;
+  for (auto &&extent : full_plan.to_read.at(oid)) {
+    bufferlist bl;
+    bl.substr_of(old_data, extent.first, extent.second);
+    partial_extents[oid].insert(extent.first, extent.second, bl);
+  }
+  std::map<shard_id_t, ObjectStore::Transaction> full_transactions;
+  auto full_rollback = generate(
+    full_plan, partial_extents, {}, &full_transactions);
+  auto full_ops = collect_shard_ops(full_transactions);
+
+  // parity delta
+  auto delta_plan = plan_overwrite(writes);
+  ASSERT_TRUE(ECTransaction::plan_parity_delta(
+		delta_plan, oid, delta_sinfo, ecimpl, &dpp));
+  auto &dplan = delta_plan.delta_plans.at(oid);
+  std::map<hobject_t, std::map<int, extent_map>> delta_reads;
+  for (int shard : dplan.to_read) {
+    for (auto &&extent : dplan.stripes) {
+      const uint64_t off =
+	delta_sinfo.aligned_logical_offset_to_chunk_offset(extent.first);
+      const uint64_t len =
+	delta_sinfo.aligned_logical_offset_to_chunk_offset(extent.second);
+      bufferlist bl;
+      bl.substr_of(old_chunks[shard], off, len);
+      delta_reads[oid][shard].insert(off, len, bl);
+    }
+  }
+  std::map<shard_id_t, ObjectStore::Transaction> delta_transactions;
+  auto delta_rollback = generate(
+    delta_plan, {}, delta_reads, &delta_transactions);
+  auto delta_ops = collect_shard_ops(delta_transactions);
+
+  // the same extents are saved for rollback, on every shard
+  ASSERT_FALSE(full_rollback.empty());
+  ASSERT_EQ(full_rollback, delta_rollback);
+  ASSERT_EQ(full_ops.clones, delta_ops.clones);
+
+  // only the modified chunks and the parity are written, in the stripes
+  // modifying them: chunk 1 of the first stripe, chunk 0 of the second
+  const uint64_t chunk_size = delta_sinfo.get_chunk_size();
+  ASSERT_EQ(5u, full_ops.writes.size());
+  ASSERT_EQ(3u, delta_ops.writes.size());
+  ASSERT_EQ((std::set<uint64_t>{chunk_size}),
+	    [&] {
+	      std::set<uint64_t> offs;
+	      for (auto &&w : delta_ops.writes.at(0)) {
+		offs.insert(w.first);
+	      }
+	      return offs;
+	    }());
+  ASSERT_EQ(1u, delta_ops.writes.at(1).size());
+  ASSERT_EQ(0u, delta_ops.writes.at(1).begin()->first);
+  ASSERT_EQ(2u, delta_ops.writes.at(delta_k).size());
+
+  // with the content of the full stripe writes, parity included
+  for (auto &&[shard, writes] : delta_ops.writes) {
+    ASSERT_EQ(1u, full_ops.writes.at(shard).size());
+    auto &full = full_ops.writes.at(shard).begin()->second;
+    for (auto &&[off, bl] : writes) {
+      ASSERT_EQ(chunk_size, bl.length());
+      bufferlist expected;
+      expected.substr_of(full, off, chunk_size);
+      ASSERT_TRUE(expected.contents_equal(bl)) << "shard " << shard
+					       << " at " << off;
+    }
+  }
+}
+
+TEST(ectransaction, encode_delta)
+{
+  ErasureCodeXor ecimpl(delta_k);
+  // not a multiple of the word size
+  for (unsigned len : {1u, 7u, 8u, 4096u, 4099u}) {
+    bufferptr o(len), n(len), d(len);
+    for (unsigned i = 0; i < len; ++i) {
+      o[i] = i * 3;
+      n[i] = i * 5 + 1;
+    }
+    ASSERT_EQ(0, ecimpl.encode_delta(o, n, &d));
+    for (unsigned i = 0; i < len; ++i) {
+      ASSERT_EQ((char)(o[i] ^ n[i]), d[i]) << len << " at " << i;
+    }
+  }
+  bufferptr o(8), n(9), d(8);
+  ASSERT_EQ(-EINVAL, ecimpl.encode_delta(o, n, &d));
+}
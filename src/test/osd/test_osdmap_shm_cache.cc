@@ -0,0 +1,185 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include "global/global_context.h"
+#include "include/stringify.h"
+#include "osd/OSDMapShmCache.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+class OSDMapShmCacheTest : public ::testing::Test {
+protected:
+  fs::path path;
+  uuid_d fsid;
+
+  void SetUp() override {
+    char tmpl[] = "/tmp/osdmap_shm_cache.XXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(tmpl));
+    path = tmpl;
+    fsid.generate_random();
+  }
+  void TearDown() override {
+    fs::remove_all(path);
+  }
+
+  ceph::buffer::list make_bl(epoch_t e, size_t len) {
+    ceph::buffer::list bl;
+    bl.append(std::string(len, 'a' + e % 26));
+    return bl;
+  }
+  size_t num_files() {
+    auto d = path / stringify(fsid);
+    return std::distance(fs::directory_iterator(d), fs::directory_iterator{});
+  }
+};
+
+} // anonymous namespace
+
+TEST_F(OSDMapShmCacheTest, Disabled)
+{
+  OSDMapShmCache c(g_ceph_context, fsid, "", 10);
+  ASSERT_FALSE(c.is_enabled());
+  c.put(1, make_bl(1, 10));
+  ceph::buffer::list bl;
+  ASSERT_FALSE(c.get(1, &bl));
+}
+
+TEST_F(OSDMapShmCacheTest, PutGet)
+{
+  OSDMapShmCache a(g_ceph_context, fsid, path, 10);
+  OSDMapShmCache b(g_ceph_context, fsid, path, 10);
+  ASSERT_TRUE(a.is_enabled());
+  ceph::buffer::list bl;
+  ASSERT_FALSE(b.get(5, &bl));
+  a.put(5, make_bl(5, 100000));
+  ASSERT_TRUE(b.get(5, &bl));
+  ASSERT_TRUE(bl.contents_equal(make_bl(5, 100000)));
+  // publishing again does not change what is there
+  b.put(5, make_bl(6, 10));
+  ceph::buffer::list bl2;
+  ASSERT_TRUE(a.get(5, &bl2));
+  ASSERT_TRUE(bl2.contents_equal(make_bl(5, 100000)));
+
+  // another cluster does not see it
+  uuid_d other;
+  other.generate_random();
+  OSDMapShmCache c(g_ceph_context, other, path, 10);
+  ASSERT_FALSE(c.get(5, &bl2));
+}
+
+TEST_F(OSDMapShmCacheTest, Trim)
+{
+  OSDMapShmCache a(g_ceph_context, fsid, path, 4);
+  OSDMapShmCache b(g_ceph_context, fsid, path, 4);
+  ceph::buffer::list mapped;
+  for (epoch_t e = 1; e <= 10; e++) {
+    (e % 2 ? a : b).put(e, make_bl(e, 1000));
+    if (e == 2) {
+      ASSERT_TRUE(a.get(2, &mapped));
+    }
+  }
+  ASSERT_EQ(4u, num_files());
+  ceph::buffer::list bl;
+  ASSERT_FALSE(a.get(6, &bl));
+  ASSERT_TRUE(a.get(7, &bl));
+  ASSERT_TRUE(b.get(10, &bl));
+  // still mapped after it was removed
+  ASSERT_TRUE(mapped.contents_equal(make_bl(2, 1000)));
+  a.trim(9);
+  ASSERT_EQ(2u, num_files());
+  ASSERT_FALSE(b.get(8, &bl));
+}
+
+TEST_F(OSDMapShmCacheTest, TrimLeftovers)
+{
+  OSDMapShmCache a(g_ceph_context, fsid, path, 4);
+  a.put(1, make_bl(1, 10));
+  // OSDs which died while publishing
+  auto d = path / stringify(fsid);
+  for (auto name : {".3.1234.tmp", ".12.1234.tmp", ".5.tmp", "other"}) {
+    std::ofstream(d / name) << "x";
+  }
+  ASSERT_EQ(5u, num_files());
+  a.trim(10);
+  ASSERT_FALSE(fs::exists(d / "1"));
+  ASSERT_FALSE(fs::exists(d / ".3.1234.tmp"));
+  ASSERT_TRUE(fs::exists(d / ".12.1234.tmp"));
+  ASSERT_TRUE(fs::exists(d / ".5.tmp"));
+  ASSERT_TRUE(fs::exists(d / "other"));
+}
+
+TEST_F(OSDMapShmCacheTest, GetMap)
+{
+  // the map of epoch 2, built from the incremental as the OSDs do
+  OSDMap prev;
+  prev.build_simple(g_ceph_context, 0, fsid, 3);
+  ceph::buffer::list prev_bl;
+  prev.encode(prev_bl, CEPH_FEATURES_SUPPORTED_DEFAULT | CEPH_FEATURE_RESERVED);
+  OSDMap::Incremental inc(prev.get_epoch() + 1);
+  inc.fsid = prev.get_fsid();
+  inc.new_max_osd = 4;
+  OSDMap next;
+  next.decode(prev_bl);
+  ASSERT_EQ(0, next.apply_incremental(inc));
+  ceph::buffer::list next_bl;
+  next.encode(next_bl, CEPH_FEATURES_SUPPORTED_DEFAULT | CEPH_FEATURE_RESERVED);
+  inc.have_crc = true;
+  inc.full_crc = next.get_crc();
+
+  // each case in the directory of a cluster of its own
+  auto get_map = [&](const OSDMap::Incremental& inc,
+		     const ceph::buffer::list *published) {
+    uuid_d cluster;
+    cluster.generate_random();
+    OSDMapShmCache c(g_ceph_context, cluster, path, 10);
+    if (published) {
+      c.put(inc.epoch, *published);
+    }
+    ceph::buffer::list bl;
+    auto o = c.get_map(inc, &bl);
+    EXPECT_EQ(!o, bl.length() == 0);
+    return o;
+  };
+
+  auto o = get_map(inc, &next_bl);
+  ASSERT_TRUE(o);
+  ASSERT_EQ(inc.epoch, o->get_epoch());
+  ASSERT_EQ(4, o->get_max_osd());
+
+  // not published
+  ASSERT_FALSE(get_map(inc, nullptr));
+  // no crc to check it against
+  {
+    auto no_crc = inc;
+    no_crc.have_crc = false;
+    ASSERT_FALSE(get_map(no_crc, &next_bl));
+  }
+  // another crc
+  {
+    auto other_crc = inc;
+    other_crc.full_crc = ~inc.full_crc;
+    ASSERT_FALSE(get_map(other_crc, &next_bl));
+  }
+  // the map of another epoch
+  ASSERT_FALSE(get_map(inc, &prev_bl));
+  // corrupted
+  {
+    ceph::buffer::list corrupted;
+    corrupted.append(next_bl.c_str(), next_bl.length());
+    corrupted.c_str()[corrupted.length() / 2] ^= 0xff;
+    ASSERT_FALSE(get_map(inc, &corrupted));
+  }
+  {
+    ceph::buffer::list truncated;
+    truncated.substr_of(next_bl, 0, next_bl.length() / 2);
+    ASSERT_FALSE(get_map(inc, &truncated));
+  }
+}
@@ -0,0 +1,121 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <gtest/gtest.h>
+
+#include "osd/recovery_pacing.h"
+
+using namespace std::chrono_literals;
+using Recovery::BandwidthBudget;
+using Recovery::ObjectHeat;
+
+namespace {
+
+hobject_t make_obj(unsigned i)
+{
+  return hobject_t(object_t("obj" + std::to_string(i)), "", CEPH_NOSNAP, i,
+		   1, "");
+}
+
+}  // namespace
+
+TEST(RecoveryObjectHeat, hottest_first)
+{
+  ObjectHeat heat;
+  auto now = ceph::mono_clock::now();
+
+  for (unsigned i = 0; i < 5; ++i) {
+    for (unsigned j = 0; j <= i; ++j) {
+      heat.note_access(make_obj(i), now);
+    }
+  }
+  auto hot = heat.hottest(now);
+  ASSERT_EQ(5u, hot.size());
+  for (unsigned i = 0; i < 5; ++i) {
+    EXPECT_EQ(make_obj(4 - i), hot[i].first);
+    EXPECT_DOUBLE_EQ(5.0 - i, hot[i].second);
+  }
+
+  heat.erase(make_obj(4));
+  EXPECT_EQ(0.0, heat.get(make_obj(4), now));
+  EXPECT_EQ(make_obj(3), heat.hottest(now).front().first);
+}
+
+TEST(RecoveryObjectHeat, decay)
+{
+  ObjectHeat heat;
+  heat.set_limits(16, 10.0);
+  auto now = ceph::mono_clock::now();
+
+  for (int i = 0; i < 4; ++i) {
+    heat.note_access(make_obj(0), now);
+  }
+  heat.note_access(make_obj(1), now + 20s);
+  heat.note_access(make_obj(1), now + 20s);
+  // 4 accesses two half-lives ago weigh as much as 1 now
+  EXPECT_NEAR(1.0, heat.get(make_obj(0), now + 20s), 1e-9);
+  EXPECT_EQ(make_obj(1), heat.hottest(now + 20s).front().first);
+}
+
+TEST(RecoveryObjectHeat, bounded)
+{
+  ObjectHeat heat;
+  heat.set_limits(8, 60.0);
+  auto now = ceph::mono_clock::now();
+
+  // obj0 is hot, the others are accessed once each
+  for (int i = 0; i < 10; ++i) {
+    heat.note_access(make_obj(0), now);
+  }
+  for (unsigned i = 1; i < 100; ++i) {
+    heat.note_access(make_obj(i), now);
+    ASSERT_LE(heat.size(), 8u);
+  }
+  EXPECT_DOUBLE_EQ(10.0, heat.get(make_obj(0), now));
+  EXPECT_EQ(make_obj(0), heat.hottest(now).front().first);
+}
+
+TEST(RecoveryBandwidthBudget, disabled)
+{
+  BandwidthBudget budget;
+  auto now = ceph::mono_clock::now();
+
+  EXPECT_FALSE(budget.enabled());
+  budget.charge(now, 1 << 30);
+  EXPECT_EQ(7u, budget.get_available(now, 1000, 7));
+}
+
+TEST(RecoveryBandwidthBudget, small_objects_batch)
+{
+  BandwidthBudget budget;
+  budget.set_rate(10 << 20);
+  auto now = ceph::mono_clock::now();
+
+  // learn that objects are 64 KiB
+  for (int i = 0; i < 200; ++i) {
+    budget.charge(now, 64 << 10);
+    now += 10ms;
+  }
+  EXPECT_NEAR(64 << 10, budget.get_avg_object_size(), 1 << 10);
+  now += 2s;
+  // a full bucket covers ~160 of them: up to max_ops start at once
+  EXPECT_EQ(10u, budget.get_available(now, 0, 10));
+  EXPECT_EQ(10u, budget.get_available(now, 100, 10));
+  EXPECT_EQ(0u, budget.get_available(now, 200, 10));
+}
+
+TEST(RecoveryBandwidthBudget, debt)
+{
+  BandwidthBudget budget;
+  budget.set_rate(1 << 20);
+  auto now = ceph::mono_clock::now();
+
+  EXPECT_EQ(1u, budget.get_available(now, 0, 10));
+  // a large object puts the budget 3 seconds in debt
+  budget.charge(now, 4 << 20);
+  EXPECT_EQ(0u, budget.get_available(now, 0, 10));
+  EXPECT_EQ(0u, budget.get_available(now + 2s, 0, 10));
+  EXPECT_EQ(1u, budget.get_available(now + 4s, 0, 10));
+  // the refill never exceeds the burst size
+  EXPECT_LE(budget.get_tokens(), 1 << 20);
+}
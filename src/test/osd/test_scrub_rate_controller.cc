@@ -0,0 +1,111 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <gtest/gtest.h>
+
+#include "osd/scrub_rate_controller.h"
+
+using namespace std::chrono_literals;
+using Scrub::RateController;
+
+namespace {
+
+struct FakeDevice {
+  RateController::device_stats_t stats;
+
+  // advance by 'dt', with the device busy for 'util' of the time
+  void run(ceph::timespan dt, double util, uint64_t ios) {
+    const uint64_t ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count();
+    stats.busy_ns += ns * util;
+    stats.weighted_ns += ns * util;
+    stats.completed += ios;
+  }
+};
+
+}  // namespace
+
+TEST(ScrubRateController, idle_device_full_speed)
+{
+  RateController rc;
+  RateController::targets_t targets;
+  FakeDevice dev;
+  auto now = ceph::mono_clock::now();
+
+  for (int i = 0; i < 10; ++i) {
+    rc.update(now, &dev.stats, targets);
+    now += 1s;
+    dev.run(1s, 0.05, 100);
+  }
+  EXPECT_DOUBLE_EQ(1.0, rc.get_chunk_ratio());
+  EXPECT_DOUBLE_EQ(0.0, rc.get_sleep());
+  EXPECT_LT(rc.get_observed_device_util(), targets.device_util);
+}
+
+TEST(ScrubRateController, busy_device_backs_off_then_recovers)
+{
+  RateController rc;
+  RateController::targets_t targets;
+  targets.device_util = 0.5;
+  targets.max_sleep = 2.0;
+  targets.min_chunk_ratio = 0.1;
+  FakeDevice dev;
+  auto now = ceph::mono_clock::now();
+
+  rc.update(now, &dev.stats, targets);
+  for (int i = 0; i < 10; ++i) {
+    now += 1s;
+    dev.run(1s, 1.0, 1000);
+    rc.update(now, &dev.stats, targets);
+  }
+  EXPECT_LT(rc.get_chunk_ratio(), 0.2);
+  EXPECT_GT(rc.get_sleep(), 1.5);
+  EXPECT_GE(rc.get_chunk_ratio(), targets.min_chunk_ratio);
+  EXPECT_LE(rc.get_sleep(), targets.max_sleep);
+
+  const double throttled_sleep = rc.get_sleep();
+  for (int i = 0; i < 100; ++i) {
+    now += 1s;
+    dev.run(1s, 0.0, 0);
+    rc.update(now, &dev.stats, targets);
+  }
+  EXPECT_LT(rc.get_sleep(), throttled_sleep);
+  EXPECT_DOUBLE_EQ(1.0, rc.get_chunk_ratio());
+}
+
+TEST(ScrubRateController, client_latency)
+{
+  RateController rc;
+  RateController::targets_t targets;
+  targets.device_util = 0;  // ignore the device
+  targets.client_lat = 0.01;
+  auto now = ceph::mono_clock::now();
+
+  // no device stats at all
+  rc.update(now, nullptr, targets);
+  for (int i = 0; i < 10; ++i) {
+    for (int op = 0; op < 100; ++op) {
+      rc.note_client_op(50ms);
+    }
+    now += 1s;
+    rc.update(now, nullptr, targets);
+  }
+  EXPECT_NEAR(0.05, rc.get_observed_client_lat(), 0.001);
+  EXPECT_GT(rc.get_sleep(), 0.0);
+  EXPECT_LT(rc.get_chunk_ratio(), 1.0);
+}
+
+TEST(ScrubRateController, progress_rate)
+{
+  RateController rc;
+  RateController::targets_t targets;
+  auto now = ceph::mono_clock::now();
+
+  rc.update(now, nullptr, targets);
+  for (int i = 0; i < 20; ++i) {
+    rc.note_objects_scrubbed(250);
+    now += 1s;
+    rc.update(now, nullptr, targets);
+  }
+  EXPECT_NEAR(250.0, rc.get_objects_per_sec(), 1.0);
+}
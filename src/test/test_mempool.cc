@@ -15,6 +15,8 @@
  */
 
 #include <stdio.h>
+#include <set>
+#include <thread>
 
 #include "global/global_init.h"
 #include "common/ceph_argparse.h"
@@ -205,6 +207,54 @@ TEST(mempool, test_factory)
    check_usage(mempool::osdmap::id);
 }
 
+struct cached_obj {
+  MEMPOOL_CACHED_CLASS_HELPERS(cached_obj, unittest_1, 64);
+  int a = 0;
+};
+
+TEST(mempool, object_cache)
+{
+  size_t items = mempool::unittest_1::allocated_items();
+  cached_obj *o1 = new cached_obj;
+  delete o1;
+  // kept by this thread, and still accounted for
+  EXPECT_EQ(items + 1, mempool::unittest_1::allocated_items());
+  cached_obj *o2 = new cached_obj;
+  EXPECT_EQ(o1, o2);
+  delete o2;
+
+  // freed by another thread than the one allocating them
+  std::vector<cached_obj *> objs;
+  for (int i = 0; i < 256; i++) {
+    objs.push_back(new cached_obj);
+  }
+  std::set<cached_obj *> freed(objs.begin(), objs.end());
+  std::thread t([&objs] {
+    for (auto o : objs) {
+      delete o;
+    }
+  });
+  t.join();
+  // the central list kept 64 of them, the others were released
+  EXPECT_EQ(items + 64, mempool::unittest_1::allocated_items());
+  objs.clear();
+  for (int i = 0; i < 64; i++) {
+    objs.push_back(new cached_obj);
+    EXPECT_EQ(1u, freed.count(objs.back()));
+  }
+  for (auto o : objs) {
+    delete o;
+  }
+
+  ostringstream ostr;
+  Formatter* f = Formatter::create("json-pretty", "json-pretty", "json-pretty");
+  mempool::dump(f);
+  f->flush(ostr);
+  delete f;
+  ASSERT_NE(ostr.str().find("object_caches"), std::string::npos);
+  ASSERT_NE(ostr.str().find("cached_obj"), std::string::npos);
+}
+
 TEST(mempool, vector)
 {
   {